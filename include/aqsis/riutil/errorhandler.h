@@ -96,6 +96,11 @@ class ErrorHandler
         inline ErrorCategory verbosity() const;
         inline void setVerbosity(ErrorCategory verbosity);
 
+        /// Get the number of Error and Severe messages reported so far.
+        ///
+        /// Messages filtered out by the verbosity are counted too.
+        inline int errorCount() const;
+
         // The following mess defines the formatting functions.  It would be
         // possible to do this without the macros if we assumed c++0x variadic
         // templates support.
@@ -105,7 +110,8 @@ class ErrorHandler
 
 #       define AQSIS_DEFINE_LOGGING_FUNC(category, funcName)            \
         TINYFORMAT_WRAP_FORMAT(void, funcName,                          \
-            if(category < m_verbosity) return; std::ostringstream oss;, \
+            countError(category); if(category < m_verbosity) return;    \
+            std::ostringstream oss;,                                    \
             oss,                                                        \
             dispatch(category | code, oss.str());                       \
         )
@@ -131,7 +137,8 @@ class ErrorHandler
         /// The log() function is like error() and friends, but expects you to
         /// define the ErrorCategory as part of the code.
         TINYFORMAT_WRAP_FORMAT(void, log,
-            if(code < m_verbosity) return; std::ostringstream oss;,
+            countError(code); if(code < m_verbosity) return;
+            std::ostringstream oss;,
             oss,
             dispatch(code, oss.str());
         )
@@ -154,14 +161,18 @@ class ErrorHandler
     private:
         friend class detail::ErrorFormatter;
 
+        inline void countError(int code);
+
         ErrorCategory m_verbosity;
+        int m_errorCount;
 };
 
 
 //==============================================================================
 // Implementation details
 inline ErrorHandler::ErrorHandler(ErrorCategory verbosity)
-    : m_verbosity(verbosity)
+    : m_verbosity(verbosity),
+    m_errorCount(0)
 { }
 
 inline ErrorHandler::ErrorCategory ErrorHandler::verbosity() const
@@ -174,6 +185,18 @@ inline void ErrorHandler::setVerbosity(ErrorCategory verbosity)
     m_verbosity = verbosity;
 }
 
+inline int ErrorHandler::errorCount() const
+{
+    return m_errorCount;
+}
+
+inline void ErrorHandler::countError(int code)
+{
+    ErrorCategory category = errorCategory(code);
+    if(category == Error || category == Severe)
+        ++m_errorCount;
+}
+
 inline ErrorHandler::ErrorCategory ErrorHandler::errorCategory(int code)
 {
     return static_cast<ErrorCategory>(0xFF000000 & code);
@@ -0,0 +1,136 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+///
+/// \brief Index of the frames in a multi-frame RIB file.
+///
+
+#ifndef AQSIS_RIBINDEX_H_INCLUDED
+#define AQSIS_RIBINDEX_H_INCLUDED
+
+#include <aqsis/config.h>
+
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace Aqsis
+{
+
+//------------------------------------------------------------------------------
+/// Byte offsets of the frames in an ASCII RIB stream.
+///
+/// Selecting a few frames from a long animation with the framedrop filter
+/// means parsing every frame before them.  With an index, only the requests
+/// outside any FrameBegin/FrameEnd block (the shared header state) and the
+/// desired frames themselves need to be read; everything else can be skipped
+/// with a seek.
+///
+/// The index is built by a lexical scan which only understands comments,
+/// strings and request names, so it's far cheaper than a parse.  Gzipped and
+/// binary encoded RIB can't be indexed, since byte offsets in the former
+/// can't be seeked to and the latter may define encoded strings inside a
+/// skipped frame.
+class AQSIS_RIUTIL_SHARE RibIndex
+{
+    public:
+        typedef boost::uint64_t Offset;
+        /// Half open range [first, second) of bytes in the stream.
+        typedef std::pair<Offset, Offset> Range;
+
+        /// Location of a single FrameBegin/FrameEnd block.
+        struct Frame
+        {
+            int number;     ///< Number passed to FrameBegin
+            Range range;    ///< Bytes from "FrameBegin" to after "FrameEnd"
+        };
+
+        RibIndex();
+
+        /// Build the index by scanning a RIB stream.
+        ///
+        /// \return false if the stream can't be indexed, in which case the
+        ///         index is left empty.
+        bool build(std::istream& ribStream);
+
+        /// Read an index previously saved with write().
+        ///
+        /// \return false if the index is malformed.
+        bool read(std::istream& in);
+        /// Save the index in a simple text format.
+        void write(std::ostream& out) const;
+
+        /// Get the size of the indexed stream in bytes.
+        Offset streamSize() const;
+        /// Get the frames found in the stream, in stream order.
+        const std::vector<Frame>& frames() const;
+
+        /// Get the byte ranges which must be parsed to render some frames.
+        ///
+        /// The ranges cover everything outside a frame block, and the frame
+        /// blocks for any of the desired frames, in stream order.
+        std::vector<Range> ranges(const std::vector<int>& desiredFrames) const;
+
+    private:
+        Offset m_streamSize;
+        std::vector<Frame> m_frames;
+};
+
+/// Get the name of the file in which the index for ribFileName is cached.
+AQSIS_RIUTIL_SHARE std::string ribIndexFileName(const std::string& ribFileName);
+
+/// Parse a frame list such as "1,3,5,6-9,10-20" into a list of frames.
+///
+/// Throws an XqValidation if the list is malformed.
+AQSIS_RIUTIL_SHARE void parseFrameList(const char* frames,
+                                       std::vector<int>& desiredFrames);
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+inline RibIndex::Offset RibIndex::streamSize() const
+{
+    return m_streamSize;
+}
+
+inline const std::vector<RibIndex::Frame>& RibIndex::frames() const
+{
+    return m_frames;
+}
+
+} // namespace Aqsis
+
+#endif // AQSIS_RIBINDEX_H_INCLUDED
+// vi: set et:
@@ -75,6 +75,24 @@ struct RibWriterOptions
     char indentChar;
     /// Path for finding archive files
     std::string archivePath;
+    /// Name of the file the RIB stream is written to, or empty if it has
+    /// none (such as stdout).  Used to place split archives.
+    std::string outputFileName;
+    /// Move primitives with at least this many parameter values into
+    /// separate archive files (zero to disable).
+    size_t splitArchiveThreshold;
+    /// Prefix for the names of split archive files.
+    ///
+    /// Archives are named <prefix>_000000.rib and so on.  A relative prefix
+    /// is resolved against the directory of outputFileName (or the current
+    /// directory if there's no output file), and the archives are referred
+    /// to from the main stream by the prefix as given, so that they're found
+    /// relative to the main RIB file.  An empty prefix uses the name of the
+    /// output file without its .rib or .rib.gz extension, or "archive" if
+    /// there's no output file.
+    std::string splitArchivePrefix;
+    /// Number of threads writing split archives (zero for one per core)
+    int splitArchiveThreads;
 
     RibWriterOptions()
         : interpolateArchives(false),
@@ -83,7 +101,11 @@ struct RibWriterOptions
         useGzip(false),
         indentStep(4),
         indentChar(' '),
-        archivePath(".")
+        archivePath("."),
+        outputFileName(),
+        splitArchiveThreshold(0),
+        splitArchivePrefix(),
+        splitArchiveThreads(0)
     { }
 };
 
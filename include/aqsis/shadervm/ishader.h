@@ -186,6 +186,16 @@ AQSIS_SHADERVM_SHARE boost::shared_ptr<IqShader> createShaderVM(IqRenderer* rend
  */
 AQSIS_SHADERVM_SHARE void shutdownShaderVM();
 
+/** \brief Get the approximate number of bytes which shutdownShaderVM() would
+ * free.
+ */
+AQSIS_SHADERVM_SHARE TqUlong shaderVMPooledMemory();
+
+/** \brief Get the number of shader temporaries which have been allocated, and
+ * the number of times one was reused from the pools instead.
+ */
+AQSIS_SHADERVM_SHARE void shaderVMTemporaryCounts(TqUlong& allocated, TqUlong& reused);
+
 //@}
 
 } // namespace Aqsis
@@ -28,6 +28,9 @@
 
 #include	<aqsis/aqsis.h>
 
+#include	<string>
+#include	<vector>
+
 #include	<boost/shared_ptr.hpp>
 
 #include	<aqsis/shadervm/ishaderdata.h>
@@ -140,6 +143,29 @@ AQSIS_SHADERVM_SHARE extern TqInt gDefLightUses;
 AQSIS_SHADERVM_SHARE
 void clearShaderSystemCaches();
 
+/// Clear static caches of point cloud data ready for next frame
+///
+/// The point clouds are loaded again when next needed, so this may also be
+/// used to release memory between buckets.
+AQSIS_SHADERVM_SHARE
+void clearPointCloudCache();
+
+/// Get the number of bytes used by the point clouds which have been loaded for
+/// point-based occlusion and indirect diffuse.
+AQSIS_SHADERVM_SHARE
+TqUlong pointCloudCacheMemory();
+
+/// Get the names of the point cloud files read since the last call.
+///
+/// The names are appended to fileNames, as given to the shadeops.
+AQSIS_SHADERVM_SHARE
+void takePointCloudFilesRead(std::vector<std::string>& fileNames);
+
+/// Get the names of the point cloud files written by bake3d() since the last
+/// call.
+AQSIS_SHADERVM_SHARE
+void takePointCloudFilesWritten(std::vector<std::string>& fileNames);
+
 //----------------------------------------------------------------------
 /** \struct IqShaderExecEnv
  * Interface to shader execution environment.
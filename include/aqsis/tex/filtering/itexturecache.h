@@ -40,6 +40,9 @@
 
 #include <aqsis/aqsis.h>
 
+#include <string>
+#include <vector>
+
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -92,6 +95,16 @@ struct AQSIS_TEX_SHARE IqTextureCache
 	/// Delete all textures from the cache
 	virtual void flush() = 0;
 
+	/** \brief Get the files which samplers have been looked up for.
+	 *
+	 * Returns the full path of each file looked up by one of the find*()
+	 * functions since the last call, even if it has since been flushed from
+	 * the cache.
+	 *
+	 * \param fileNames - the file names are appended here.
+	 */
+	virtual void takeFilesRead(std::vector<std::string>& fileNames) = 0;
+
 	/** \brief Return the texture file attributes for the named file.
 	 *
 	 * If the file is not found or is otherwise invalid, return 0.
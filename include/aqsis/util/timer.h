@@ -39,11 +39,18 @@
 #include <ctime>
 #include <vector>
 
-#include <boost/shared_ptr.hpp>
-#include <boost/timer.hpp>
+#include <aqsis/config.h>
 
 namespace Aqsis {
 
+/** \brief Get the time in seconds from a monotonic wall clock.
+ *
+ * The zero of the clock is arbitrary, so only differences are meaningful.
+ * The clock is cheap to read, and isn't affected by changes to the system
+ * time.
+ */
+AQSIS_UTIL_SHARE double monotonicTime();
+
 //------------------------------------------------------------------------------
 /** \brief Simple accumulated timer class.
  *
@@ -72,10 +79,13 @@ class CqTimer
 		/// Return total number of timing samples recorded.
 		long numSamples() const;
 
+		/// Add the samples recorded by another timer into this one.
+		void merge(const CqTimer& other);
+
 	private:
 		double m_totalTime;    ///< total time
 		long m_numSamples;     ///< total number of samples
-		boost::timer m_timer;  ///< current timer
+		double m_startTime;    ///< time at which start() was last called
 };
 
 
@@ -110,6 +120,9 @@ class CqTimerSet
 		/// Get a timer by name, or create a new one if it doesn't exist.
 		CqTimer& getTimer(typename EnumClassT::Enum id);
 
+		/// Add the samples recorded by the timers in another set to this one.
+		void merge(const CqTimerSet& other);
+
 		/// Dump timing results to the given stream
 		void printTimes(std::ostream& ostr) const;
 
@@ -118,7 +131,7 @@ class CqTimerSet
 		static std::string timeToString(double time);
 
 		struct SqTimeSort;
-		typedef std::vector<boost::shared_ptr<CqTimer> > TqTimerVec;
+		typedef std::vector<CqTimer> TqTimerVec;
 		TqTimerVec m_timers;
 };
 
@@ -155,17 +168,18 @@ class CqScopeTimer
 // CqTimer implementation
 inline CqTimer::CqTimer()
 	: m_totalTime(0),
-	m_numSamples(0)
+	m_numSamples(0),
+	m_startTime(0)
 { }
 
 inline void CqTimer::start()
 {
-	m_timer.restart();
+	m_startTime = monotonicTime();
 }
 
 inline void CqTimer::stop()
 {
-	m_totalTime += m_timer.elapsed();
+	m_totalTime += monotonicTime() - m_startTime;
 	++m_numSamples;
 }
 
@@ -187,21 +201,31 @@ inline long CqTimer::numSamples() const
 	return m_numSamples;
 }
 
+inline void CqTimer::merge(const CqTimer& other)
+{
+	m_totalTime += other.m_totalTime;
+	m_numSamples += other.m_numSamples;
+}
+
 
 //------------------------------------------------------------------------------
 // CqTimerSet implementation
 template<typename EnumClassT>
 inline CqTimerSet<EnumClassT>::CqTimerSet()
 	: m_timers(EnumClassT::size)
+{ }
+
+template<typename EnumClassT>
+inline CqTimer& CqTimerSet<EnumClassT>::getTimer(typename EnumClassT::Enum id)
 {
-	for(int i = 0; i < EnumClassT::size; ++i)
-		m_timers[i].reset(new CqTimer());
+	return m_timers[id];
 }
 
 template<typename EnumClassT>
-inline CqTimer& CqTimerSet<EnumClassT>::getTimer(typename EnumClassT::Enum id)
+void CqTimerSet<EnumClassT>::merge(const CqTimerSet& other)
 {
-	return *m_timers[id];
+	for(int i = 0; i < EnumClassT::size; ++i)
+		m_timers[i].merge(other.m_timers[i]);
 }
 
 /// Functor for sorting times in decreasing order.
@@ -230,7 +254,7 @@ void CqTimerSet<EnumClassT>::printTimes(std::ostream& ostr) const
 	for(int i = 0, end = m_timers.size(); i < end; ++i)
 	{
 		sorted.push_back(std::make_pair(
-			static_cast<typename EnumClassT::Enum>(i), m_timers[i].get()));
+			static_cast<typename EnumClassT::Enum>(i), &m_timers[i]));
 	}
 	std::sort(sorted.begin(), sorted.end(), SqTimeSort());
 
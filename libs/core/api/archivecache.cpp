@@ -0,0 +1,167 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+		\brief Implements the on-disk cache of parsed RIB archives.
+*/
+
+#include	"archivecache.h"
+
+#include	<iomanip>
+#include	<sstream>
+
+#include	<boost/filesystem/fstream.hpp>
+#include	<boost/filesystem/operations.hpp>
+#include	<boost/scoped_ptr.hpp>
+
+#ifndef	AQSIS_SYSTEM_WIN32
+#include	<unistd.h>
+#else
+#include	<process.h>
+#define	getpid _getpid
+#endif
+
+#include	<aqsis/riutil/errorhandler.h>
+#include	<aqsis/riutil/ribwriter.h>
+#include	<aqsis/riutil/ricxx_filter.h>
+#include	<aqsis/riutil/risyms.h>
+#include	<aqsis/util/logging.h>
+#include	"inputsignature.h"
+#include	"stats.h"
+
+namespace Aqsis {
+
+namespace {
+
+void noFreeProc(RtPointer data)
+{ }
+
+/// Filter which stops the cache writer from freeing procedural data.
+///
+/// The data belongs to the renderer, which gets the same calls.
+class KeepProceduralDataFilter : public PassthroughFilter
+{
+	public:
+		virtual RtVoid Procedural(RtPointer data, RtConstBound bound,
+				RtProcSubdivFunc refineproc, RtProcFreeFunc freeproc)
+		{
+			nextFilter().Procedural(data, bound, refineproc, noFreeProc);
+		}
+};
+
+} // anon namespace
+
+
+boostfs::path archiveCacheEntry(const boostfs::path& cacheDir,
+		const boostfs::path& archive)
+{
+	CqInputSignature hash;
+	std::ostream out(&hash);
+	out << native(boostfs::system_complete(archive)) << '\n'
+		<< boostfs::file_size(archive) << '\n'
+		<< boostfs::last_write_time(archive);
+	out.flush();
+	std::ostringstream entryName;
+	entryName << std::hex << std::setfill('0') << std::setw(16)
+		<< hash.value() << ".rib";
+	return cacheDir / entryName.str();
+}
+
+void parseArchiveCached(Ri::RendererServices& services,
+		const boostfs::path& archive, const char* name,
+		const boostfs::path& cacheDir)
+{
+	boostfs::path entry = archiveCacheEntry(cacheDir, archive);
+	{
+		boostfs::ifstream cachedFile(entry, std::ios::binary);
+		if(cachedFile)
+		{
+			STATS_INC( ARC_cache_hits );
+			services.parseRib(cachedFile, name);
+			return;
+		}
+	}
+	STATS_INC( ARC_cache_misses );
+
+	boostfs::ifstream archiveFile(archive, std::ios::binary);
+	std::ostringstream tmpName;
+	tmpName << native(entry) << '.' << getpid() << ".tmp";
+	boostfs::path tmpEntry = tmpName.str();
+	boostfs::ofstream entryFile(tmpEntry, std::ios::binary);
+	if(!entryFile)
+	{
+		Aqsis::log() << warning << "Could not create archive cache entry \""
+			<< tmpName.str() << "\"" << std::endl;
+		services.parseRib(archiveFile, name);
+		return;
+	}
+
+	// Parse the archive into the renderer, writing the calls to the cache
+	// entry on the way through.
+	KeepProceduralDataFilter keepProcData;
+	RibWriterOptions opts;
+	opts.useBinary = true;
+	boost::scoped_ptr<RibWriterServices> writer(createRibWriter(entryFile, opts));
+	registerStdFuncs(*writer);
+	writer->addFilter(keepProcData);
+	boost::scoped_ptr<Ri::Filter> tee(createTeeFilter(writer->firstFilter()));
+	tee->setNextFilter(services.firstFilter());
+	tee->setRendererServices(services);
+	int errorCount = services.errorHandler().errorCount();
+	try
+	{
+		services.parseRib(archiveFile, name, *tee);
+	}
+	catch(...)
+	{
+		writer.reset();
+		entryFile.close();
+		boostfs::remove(tmpEntry);
+		throw;
+	}
+	writer.reset();
+	entryFile.close();
+	if(!entryFile)
+	{
+		Aqsis::log() << warning << "Could not write archive cache entry \""
+			<< tmpName.str() << "\"" << std::endl;
+		boostfs::remove(tmpEntry);
+		return;
+	}
+	// Requests with errors may be missing from the entry, and replaying it
+	// wouldn't report them again, so it is only kept if the archive was read
+	// without errors.
+	if(services.errorHandler().errorCount() != errorCount)
+	{
+		boostfs::remove(tmpEntry);
+		return;
+	}
+	try
+	{
+		boostfs::rename(tmpEntry, entry);
+	}
+	catch(boostfs::filesystem_error& /*e*/)
+	{
+		// Another render may have created the entry first.
+		boostfs::remove(tmpEntry);
+	}
+}
+
+} // namespace Aqsis
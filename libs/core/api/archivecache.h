@@ -0,0 +1,66 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+		\brief Declares the on-disk cache of parsed RIB archives.
+*/
+
+#ifndef ARCHIVECACHE_H_INCLUDED
+#define ARCHIVECACHE_H_INCLUDED 1
+
+#include	<aqsis/aqsis.h>
+
+#include	<aqsis/riutil/ricxx.h>
+#include	<aqsis/util/file.h>
+
+namespace Aqsis {
+
+/** \brief Get the path of the cache entry for an archive file.
+ *
+ * Entries are named by a hash of the full path, size and modification time of
+ * the archive, so an edited archive gets a new entry, and stale entries are
+ * simply never used again.
+ */
+boostfs::path archiveCacheEntry(const boostfs::path& cacheDir,
+		const boostfs::path& archive);
+
+/** \brief Parse an archive file through the archive cache.
+ *
+ * If the cache holds an entry for the archive, the entry is parsed instead of
+ * the archive itself.  Otherwise the archive is parsed, and a binary RIB copy
+ * of the interface calls is saved in the cache as it goes.  Binary RIB is
+ * much quicker to parse than ascii, since no numbers need to be converted
+ * from text.
+ *
+ * Entries are created under a temporary name and renamed when complete, so
+ * several renders may share one cache directory.
+ *
+ * \param services - services used to parse; calls go to services.firstFilter()
+ * \param archive - archive file to read
+ * \param name - name of the archive, for error reporting
+ * \param cacheDir - directory holding the cache entries
+ */
+void parseArchiveCached(Ri::RendererServices& services,
+		const boostfs::path& archive, const char* name,
+		const boostfs::path& cacheDir);
+
+} // namespace Aqsis
+
+#endif // ARCHIVECACHE_H_INCLUDED
@@ -145,9 +145,12 @@ void CqWorldModeBlock::AddContextLightSource( const CqLightsourcePtr& pLS )
 
 CqAttributeModeBlock::CqAttributeModeBlock( const boost::shared_ptr<CqModeBlock>& pconParent ) : CqModeBlock( pconParent, Attribute )
 {
-	// Create new Attributes as they must be pushed/popped by the state change.
-	m_pattrCurrent.reset(new CqAttributes( *pconParent->m_pattrCurrent ));
-	m_ptransCurrent.reset( new CqTransform(*pconParent->m_ptransCurrent.get() ) );
+	// Share the parent state; the attributes are copied on the first write
+	// (see CqAttributes::Write()) and transforms are replaced rather than
+	// modified, so the parent is restored just by dropping these references.
+	// Equal states taken by primitives are interned in StorePrimitive().
+	m_pattrCurrent = pconParent->m_pattrCurrent;
+	m_ptransCurrent = pconParent->m_ptransCurrent;
 	m_poptCurrent.reset( new CqOptions(*pconParent->m_poptCurrent.get() ) );
 }
 
@@ -174,7 +177,9 @@ CqTransformModeBlock::CqTransformModeBlock( const boost::shared_ptr<CqModeBlock>
 	{
 		m_pattrCurrent.reset(new CqAttributes);
 	}
-	m_ptransCurrent.reset( new CqTransform(*pconParent->m_ptransCurrent.get() ) );
+	// Transforms are replaced rather than modified, so the parent transform
+	// can be shared until the first change.
+	m_ptransCurrent = pconParent->m_ptransCurrent;
 	m_poptCurrent.reset( new CqOptions(*pconParent->m_poptCurrent.get() ) );
 }
 
@@ -193,9 +198,9 @@ CqTransformModeBlock::~CqTransformModeBlock()
 
 CqSolidModeBlock::CqSolidModeBlock( CqString& type, const boost::shared_ptr<CqModeBlock>& pconParent ) : CqModeBlock( pconParent, Solid ), m_strType( type )
 {
-	// Create new Attributes as they must be pushed/popped by the state change.
-	m_pattrCurrent.reset(new CqAttributes( *pconParent->m_pattrCurrent ));
-	m_ptransCurrent.reset( new CqTransform(*pconParent->m_ptransCurrent.get() ) );
+	// Share the parent state until it is written, as for AttributeBegin.
+	m_pattrCurrent = pconParent->m_pattrCurrent;
+	m_ptransCurrent = pconParent->m_ptransCurrent;
 	m_poptCurrent.reset( new CqOptions(*pconParent->m_poptCurrent.get() ) );
 
 	// Create a new CSG tree node of the appropriate type.
@@ -229,6 +234,19 @@ CqSolidModeBlock::~CqSolidModeBlock()
 }
 
 
+//---------------------------------------------------------------------
+/** End the solid context.
+ * Once the outermost solid block is complete its CSG tree can no longer
+ * change, so compile it for fast evaluation when sampling.
+ */
+
+void CqSolidModeBlock::EndSolidModeBlock()
+{
+	if ( m_pCSGNode && !m_pCSGNode->pParent() )
+		m_pCSGNode->compileTree();
+}
+
+
 //---------------------------------------------------------------------
 /** Default constructor.
  */
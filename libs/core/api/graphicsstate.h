@@ -211,6 +211,15 @@ class CqModeBlock : public boost::enable_shared_from_this<CqModeBlock>
 			m_ptransCurrent = NewTrans;
 			return ( prev );
 		}
+		/** Replace the current attributes and transform with their interned copies.
+		 * Called as primitives take the current state, so that following
+		 * primitives find the state interned already.
+		 */
+		virtual	void	internState()
+		{
+			m_pattrCurrent = CqAttributes::Intern( m_pattrCurrent );
+			m_ptransCurrent = CqTransform::Intern( m_ptransCurrent );
+		}
 		/** Get the current time, used only within Motion blocks, all other contexts return 0.
 		 * \return the current frame time as a float.
 		 */
@@ -636,8 +645,7 @@ class CqSolidModeBlock : public CqModeBlock
 		/** Delete the solid context.
 		 * \attention This is the only valid context deletion from within this block.
 		 */
-		virtual	void	EndSolidModeBlock()
-		{}
+		virtual	void	EndSolidModeBlock();
 
 		virtual IqOptionsPtr	poptCurrent() const
 		{
@@ -742,6 +750,14 @@ class CqObjectModeBlock : public CqModeBlock
 			assert( false );
 			return CqAttributesPtr();
 		}	// Illegal to change attributes here.
+		/** Intern the attributes at the parent context, and the transform here.
+		 */
+		virtual	void	internState()
+		{
+			CqAttributesPtr attrs = CqAttributes::Intern( pconParent() ->pattrCurrent() );
+			pconParent() ->pattrCurrent( attrs );
+			m_ptransCurrent = CqTransform::Intern( m_ptransCurrent );
+		}
 
 	private:
 };
@@ -1,4 +1,5 @@
 set(api_srcs
+	archivecache.cpp
 	condition.cpp
 	genpoly.cpp
 	graphicsstate.cpp
@@ -10,6 +11,7 @@ set(api_srcs
 make_absolute(api_srcs ${api_SOURCE_DIR})
 
 set(api_hdrs
+	archivecache.h
 	condition.h
 	genpoly.h
 	graphicsstate.h
@@ -34,6 +34,7 @@
 
 #include	<boost/filesystem/fstream.hpp>
 
+#include	"archivecache.h"
 #include	"imagebuffer.h"
 #include	"lights.h"
 #include	"renderer.h"
@@ -654,6 +655,14 @@ RtVoid RiCxxCore::WorldBegin()
 	// initialiseCropWindow() currently needs to be called befure SetImage() (ugh)
 	QGetRenderContext()->initialiseCropWindow();
 	QGetRenderContext()->pImage()->SetImage();
+	// Multipass frames render the world for several sets of displays, so the
+	// buckets of the final image can't be matched with their inputs.
+	const TqInt* pMultipass = QGetRenderContext()->poptCurrent()->GetIntegerOption("Render", "multipass");
+	if(QGetRenderContext()->isIncremental() && !(pMultipass && pMultipass[0]))
+		QGetRenderContext()->pImage()->setFrameSignature(
+				QGetRenderContext()->inputSignature().value());
+	else
+		QGetRenderContext()->pImage()->setFrameSignature(0);
 
 	CqRandom().Reseed('a'+'q'+'s'+'i'+'s');
 }
@@ -694,11 +703,26 @@ RtVoid RiCxxCore::WorldEnd()
 		fFailed = true;
 	}
 
-	// Remove all cached textures.
-	QGetRenderContext()->textureCache().flush();
+	// Remove all cached textures.  Incremental renders keep them for the next
+	// frame, unless this frame was a depth pass which may have replaced a
+	// shadow map.
+	TqInt displayMode = QGetRenderContext()->poptCurrent()->GetIntegerOption( "System", "DisplayMode" ) [ 0 ];
+	if( !QGetRenderContext()->isIncremental() || (displayMode & DMode_Z) )
+		QGetRenderContext()->textureCache().flush();
 
 	// Clear out point cloud caches, etc.
 	clearShaderSystemCaches();
+	if(QGetRenderContext()->isIncremental())
+	{
+		// Point clouds are only complete when every bucket was shaded, so
+		// a frame which bakes them can't be reused.
+		std::vector<std::string> filesWritten;
+		takePointCloudFilesWritten(filesWritten);
+		if(!filesWritten.empty())
+			QGetRenderContext()->pImage()->forgetFrame();
+		for(TqInt i = 0, numFiles = filesWritten.size(); i < numFiles; ++i)
+			QGetRenderContext()->noteFileWritten(filesWritten[i]);
+	}
 
 	// Delete the world context
 	QGetRenderContext() ->EndWorldModeBlock();
@@ -3160,6 +3184,22 @@ RtVoid RiCxxCore::MotionEnd()
 }
 
 
+//----------------------------------------------------------------------
+/** Record a texture made by the Make* calls, so that incremental frames
+ * reading it are rendered again when it changes.
+ */
+static void noteFileMade(const std::vector<boost::filesystem::path>& inFileNames,
+		RtConstString outFileName)
+{
+	if(!QGetRenderContext()->isIncremental())
+		return;
+	std::vector<std::string> inputNames;
+	for(size_t i = 0; i < inFileNames.size(); ++i)
+		inputNames.push_back(native(inFileNames[i]));
+	QGetRenderContext()->noteFileMade(inputNames, outFileName);
+}
+
+
 //----------------------------------------------------------------------
 // Convert a picture to a texture.
 RtVoid RiCxxCore::MakeTexture(RtConstString imagefile, RtConstString texturefile, RtConstToken swrap, RtConstToken twrap, RtFilterFunc filterfunc, RtFloat swidth, RtFloat twidth, const ParamList& pList)
@@ -3171,6 +3211,7 @@ RtVoid RiCxxCore::MakeTexture(RtConstString imagefile, RtConstString texturefile
 		= QGetRenderContext()->poptCurrent()->findRiFile(imagefile, "texture");
 	makeTexture(inFileName, texturefile, SqFilterInfo(filterfunc, swidth, twidth),
 			wrapModes, pList);
+	noteFileMade(std::vector<boost::filesystem::path>(1, inFileName), texturefile);
 }
 
 
@@ -3187,6 +3228,7 @@ RtVoid RiCxxCore::MakeLatLongEnvironment(RtConstString imagefile, RtConstString
 		->findRiFile(imagefile, "texture");
 	makeLatLongEnvironment(inFileName, reflfile, SqFilterInfo(filterfunc,
 				swidth, twidth), pList);
+	noteFileMade(std::vector<boost::filesystem::path>(1, inFileName), reflfile);
 }
 
 
@@ -3205,13 +3247,20 @@ RtVoid RiCxxCore::MakeCubeFaceEnvironment(RtConstString px, RtConstString nx, Rt
 
 	const IqOptions& opts = *QGetRenderContext()->poptCurrent();
 
+	std::vector<boost::filesystem::path> faceNames;
+	faceNames.push_back(opts.findRiFile(px, "texture"));
+	faceNames.push_back(opts.findRiFile(nx, "texture"));
+	faceNames.push_back(opts.findRiFile(py, "texture"));
+	faceNames.push_back(opts.findRiFile(ny, "texture"));
+	faceNames.push_back(opts.findRiFile(pz, "texture"));
+	faceNames.push_back(opts.findRiFile(nz, "texture"));
 	makeCubeFaceEnvironment(
-		opts.findRiFile(px, "texture"), opts.findRiFile(nx, "texture"),
-		opts.findRiFile(py, "texture"), opts.findRiFile(ny, "texture"),
-		opts.findRiFile(pz, "texture"), opts.findRiFile(nz, "texture"),
+		faceNames[0], faceNames[1], faceNames[2],
+		faceNames[3], faceNames[4], faceNames[5],
 		reflfile, fov, SqFilterInfo(filterfunc, swidth, twidth),
 		pList
 	);
+	noteFileMade(faceNames, reflfile);
 }
 
 
@@ -3227,6 +3276,7 @@ RtVoid RiCxxCore::MakeShadow(RtConstString picfile, RtConstString shadowfile, co
 	boost::filesystem::path inFileName = QGetRenderContext()->poptCurrent()
 		->findRiFile(picfile, "texture");
 	makeShadow(inFileName, shadowfile, pList);
+	noteFileMade(std::vector<boost::filesystem::path>(1, inFileName), shadowfile);
 }
 
 
@@ -3245,6 +3295,7 @@ RtVoid RiCxxCore::MakeOcclusion(const StringArray& picfiles, RtConstString shado
 			->findRiFile(picfiles[i], "texture") );
 	}
 	makeOcclusion(fileNames, shadowfile, pList);
+	noteFileMade(fileNames, shadowfile);
 }
 
 //----------------------------------------------------------------------
@@ -3422,14 +3473,20 @@ RtVoid RiCxxCore::SubdivisionMesh(RtConstToken scheme, const IntArray& nvertices
 
 RtVoid RiCxxCore::ReadArchive(RtConstToken name, RtArchiveCallback callback, const ParamList& pList)
 {
-	// Open the archive file
-	boost::filesystem::ifstream archiveFile(
-			QGetRenderContext()->poptCurrent()->findRiFile(name, "archive"),
-			std::ios::binary);
+	boost::filesystem::path archivePath =
+		QGetRenderContext()->poptCurrent()->findRiFile(name, "archive");
+	const CqString* cacheDir = QGetRenderContext()->poptCurrent()
+		->GetStringOption("archive", "cachedir");
 	// Parse the archive
 	RtArchiveCallback savedCallback = m_archiveCallback;
 	m_archiveCallback = callback;
-	m_apiServices.parseRib(archiveFile, name);
+	if(cacheDir && !cacheDir->empty())
+		parseArchiveCached(m_apiServices, archivePath, name, cacheDir->c_str());
+	else
+	{
+		boost::filesystem::ifstream archiveFile(archivePath, std::ios::binary);
+		m_apiServices.parseRib(archiveFile, name);
+	}
 	m_archiveCallback = savedCallback;
 }
 
@@ -3834,6 +3891,109 @@ RtVoid	CreateGPrim( const boost::shared_ptr<CqSurface>& pSurface )
 }
 
 
+//==============================================================================
+/** Filter feeding the interface calls into the input signature of the renderer.
+ *
+ * The calls are passed on to a RIB writer which serialises them into the
+ * signature.  Scoping blocks push and pop the signature, so that the contents
+ * of a block only affect the signature of the gprims inside it.  The frame
+ * and world blocks aren't written, so that identical frames have identical
+ * signatures wherever they occur in the stream.
+ */
+class InputSignatureFilter : public PassthroughFilter
+{
+	public:
+		InputSignatureFilter(CqInputSignature& signature, std::ostream& out)
+			: m_signature(signature),
+			m_out(out)
+		{ }
+
+		virtual RtVoid FrameBegin(RtInt number)
+		{
+			m_signature.push();
+		}
+		virtual RtVoid FrameEnd()
+		{
+			m_signature.pop();
+		}
+		virtual RtVoid WorldBegin()
+		{
+			m_signature.push();
+		}
+		virtual RtVoid WorldEnd()
+		{
+			m_signature.pop();
+		}
+		virtual RtVoid AttributeBegin()
+		{
+			m_signature.push();
+			nextFilter().AttributeBegin();
+		}
+		virtual RtVoid AttributeEnd()
+		{
+			nextFilter().AttributeEnd();
+			m_signature.pop();
+		}
+		virtual RtVoid TransformBegin()
+		{
+			m_signature.push();
+			nextFilter().TransformBegin();
+		}
+		virtual RtVoid TransformEnd()
+		{
+			nextFilter().TransformEnd();
+			m_signature.pop();
+		}
+		virtual RtVoid SolidBegin(RtConstToken type)
+		{
+			m_signature.push();
+			nextFilter().SolidBegin(type);
+		}
+		virtual RtVoid SolidEnd()
+		{
+			nextFilter().SolidEnd();
+			m_signature.pop();
+		}
+		virtual RtVoid Procedural(RtPointer data, RtConstBound bound,
+								  RtProcSubdivFunc refineproc,
+								  RtProcFreeFunc freeproc)
+		{
+			// The RIB writer frees the procedural data, so write the
+			// request here instead.
+			m_out << "Procedural";
+			for(TqInt i = 0; i < 6; ++i)
+				m_out << ' ' << bound[i];
+			TqInt numStrings = 0;
+			if(refineproc == services().getProcSubdivFunc("DelayedReadArchive"))
+				numStrings = 1;
+			else if(refineproc == services().getProcSubdivFunc("RunProgram")
+					|| refineproc == services().getProcSubdivFunc("DynamicLoad"))
+				numStrings = 2;
+			if(numStrings > 0)
+			{
+				const RtConstString* strings = static_cast<RtConstString*>(data);
+				for(TqInt i = 0; i < numStrings; ++i)
+					m_out << " \"" << strings[i] << '"';
+			}
+			else
+			{
+				// Data of other procedurals can't be compared, so make sure
+				// the signature always differs.
+				m_out << ' ' << data;
+			}
+			m_out << '\n';
+		}
+		virtual RtVoid ArchiveRecord(RtConstToken type, const char* string)
+		{
+			// Comments don't affect the image.
+		}
+
+	private:
+		CqInputSignature& m_signature;
+		std::ostream& m_out;
+};
+
+
 //==============================================================================
 /// Api services for the core renderer.
 class CoreRendererServices : public Ri::RendererServices
@@ -3844,16 +4004,17 @@ class CoreRendererServices : public Ri::RendererServices
 			m_api(),
 			m_parser(),
 			m_filterChain(),
+			m_utilFilter(0),
 			m_errorHandler()
 		{
 			m_api.reset(new RiCxxCore(*this));
 			// Add renderer utility filter.  We do this here rather than in
 			// addFilter() because this is a special filter which should only
 			// be added once.
-			Ri::Filter* utilFilter = createRenderUtilFilter(TestCondition);
-			utilFilter->setNextFilter(*m_api);
-			utilFilter->setRendererServices(*this);
-			m_filterChain.push_back(boost::shared_ptr<Ri::Renderer>(utilFilter));
+			m_utilFilter = createRenderUtilFilter(TestCondition);
+			m_utilFilter->setNextFilter(*m_api);
+			m_utilFilter->setRendererServices(*this);
+			m_filterChain.push_back(boost::shared_ptr<Ri::Renderer>(m_utilFilter));
 			// Add RI validation
 			addFilter("validate");
 		}
@@ -3906,7 +4067,12 @@ class CoreRendererServices : public Ri::RendererServices
                                const Ri::ParamList& filterParams = Ri::ParamList())
         {
             boost::shared_ptr<Ri::Filter> filter;
-            if(!strcmp(name, "echorib"))
+            if(!strcmp(name, "incremental"))
+            {
+                addIncrementalFilter();
+                return;
+            }
+            else if(!strcmp(name, "echorib"))
             {
                 if(!m_echoRibWriter)
                 {
@@ -3954,16 +4120,49 @@ class CoreRendererServices : public Ri::RendererServices
         }
 
     private:
+        /// Feed all calls reaching the core into its input signature, and
+        /// turn on incremental rendering.
+        void addIncrementalFilter()
+        {
+            if(m_signatureTee)
+                return;
+            m_signatureStream.reset(new std::ostream(
+                        &m_renderContext->inputSignature()));
+            RibWriterOptions opts;
+            opts.handleProcedurals = false;
+            m_signatureWriter.reset(createRibWriter(*m_signatureStream, opts));
+            registerStdFuncs(*m_signatureWriter);
+            m_signatureFilter.reset(new InputSignatureFilter(
+                        m_renderContext->inputSignature(), *m_signatureStream));
+            m_signatureFilter->setNextFilter(m_signatureWriter->firstFilter());
+            m_signatureFilter->setRendererServices(*this);
+            // The signature must only see the calls which reach the core, so
+            // it goes directly after the utility filter, which handles
+            // conditionals and archives.
+            m_signatureTee.reset(createTeeFilter(*m_signatureFilter));
+            m_signatureTee->setNextFilter(*m_api);
+            m_signatureTee->setRendererServices(*this);
+            m_utilFilter->setNextFilter(*m_signatureTee);
+            m_renderContext->setIncremental(true);
+        }
+
         /// Core render context
         boost::shared_ptr<CqRenderer> m_renderContext;
         /// Core renderer API
         boost::shared_ptr<RiCxxCore> m_api;
         /// RIB writer for the echo API filter
         boost::shared_ptr<RibWriterServices> m_echoRibWriter;
+        /// Stream, RIB writer and filters feeding the input signature.
+        boost::shared_ptr<std::ostream> m_signatureStream;
+        boost::shared_ptr<RibWriterServices> m_signatureWriter;
+        boost::shared_ptr<InputSignatureFilter> m_signatureFilter;
+        boost::shared_ptr<Ri::Filter> m_signatureTee;
         /// Parser for ReadArchive.  May be NULL (created on demand).
         boost::shared_ptr<RibParser> m_parser;
         /// Chain of filters
         std::vector<boost::shared_ptr<Ri::Renderer> > m_filterChain;
+        /// Renderer utility filter, owned by m_filterChain.
+        Ri::Filter* m_utilFilter;
         /// Error handler.
         AqsisLogErrorHandler m_errorHandler;
 };
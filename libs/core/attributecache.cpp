@@ -0,0 +1,103 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/// \file \brief Attribute cache
+
+#include "attributecache.h"
+
+#include <aqsis/util/sstring.h>
+#include "attributes.h"
+
+namespace Aqsis {
+
+// SqAttributeCache implementation
+SqAttributeCache::SqAttributeCache()
+	: matte(0),
+	smoothShading(true),
+	orientation(false),
+	color(1, 1, 1),
+	opacity(1, 1, 1),
+	shadingRate(1),
+	focusFactor(1),
+	motionFactor(1),
+	sides(2),
+	cullBackfacing(true),
+	cullHidden(true),
+	diceBinary(false),
+	diceRasterOrient(true),
+	trimOutside(false),
+	expandGrids(0),
+	displacementBound(0),
+	displacementBoundSpace("object")
+{
+	lodBounds[0] = 0;
+	lodBounds[1] = 1;
+	basisStep[0] = basisStep[1] = 3;
+	const TqFloat defaultTexCoords[8] = {0, 0, 1, 0, 0, 1, 1, 1};
+	for(TqInt i = 0; i < 8; ++i)
+		textureCoordinates[i] = defaultTexCoords[i];
+}
+
+void SqAttributeCache::cacheAttributes(const IqAttributes& attrs)
+{
+	// System attributes, which always exist.
+	matte = attrs.GetIntegerAttribute("System", "Matte")[0];
+	smoothShading = attrs.GetIntegerAttribute("System", "ShadingInterpolation")[0]
+		== ShadingInterp_Smooth;
+	const TqFloat* lod = attrs.GetFloatAttribute("System", "LevelOfDetailBounds");
+	lodBounds[0] = lod[0];
+	lodBounds[1] = lod[1];
+	orientation = attrs.GetIntegerAttribute("System", "Orientation")[0] != 0;
+	color = attrs.GetColorAttribute("System", "Color")[0];
+	opacity = attrs.GetColorAttribute("System", "Opacity")[0];
+	const TqInt* step = attrs.GetIntegerAttribute("System", "BasisStep");
+	basisStep[0] = step[0];
+	basisStep[1] = step[1];
+	const TqFloat* texCoords = attrs.GetFloatAttribute("System", "TextureCoordinates");
+	for(TqInt i = 0; i < 8; ++i)
+		textureCoordinates[i] = texCoords[i];
+	shadingRate = attrs.GetFloatAttribute("System", "ShadingRate")[0];
+	focusFactor = attrs.GetFloatAttribute("System", "GeometricFocusFactor")[0];
+	motionFactor = attrs.GetFloatAttribute("System", "GeometricMotionFactor")[0];
+	sides = attrs.GetIntegerAttribute("System", "Sides")[0];
+
+	// Optional attributes.
+	cullBackfacing = attrs.GetIntegerAttributeDef("cull", "backfacing", 1) == 1;
+	cullHidden = attrs.GetIntegerAttributeDef("cull", "hidden", 1) == 1;
+	diceBinary = attrs.GetIntegerAttributeDef("dice", "binary", 0) != 0;
+	diceRasterOrient = attrs.GetIntegerAttributeDef("dice", "rasterorient", 1) != 0;
+
+	trimOutside = false;
+	if(const CqString* sense = attrs.GetStringAttribute("trimcurve", "sense"))
+		trimOutside = *sense == "outside";
+
+	expandGrids = 0;
+	if(const TqFloat* expand = attrs.GetFloatAttribute("aqsis", "expandgrids"))
+		expandGrids = *expand;
+
+	displacementBound = 0;
+	if(const TqFloat* bound = attrs.GetFloatAttribute("displacementbound", "sphere"))
+		displacementBound = *bound;
+	displacementBoundSpace = "object";
+	if(const CqString* space = attrs.GetStringAttribute("displacementbound", "coordinatesystem"))
+		displacementBoundSpace = *space;
+}
+
+} // namespace Aqsis
@@ -0,0 +1,81 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/// \file \brief Attribute cache
+
+#ifndef ATTRIBUTECACHE_H_INCLUDED
+#define ATTRIBUTECACHE_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+#include <aqsis/math/color.h>
+#include <aqsis/util/sstring.h>
+
+namespace Aqsis {
+
+struct IqAttributes;
+
+
+/** \brief Cache of RiAttributes for fast access during rendering.
+ *
+ * Like SqOptionCache, this holds the attributes which are looked up for every
+ * gprim, grid or micropolygon, so that they can be read without going through
+ * the generic string keyed attribute lookup.  Each attribute state holds its
+ * own cache; see CqAttributes::cache().
+ *
+ * Other user attributes are still found by name.  The renderer itself reads
+ * them only when reporting errors, and shaders look them up by names only
+ * known at run time, once per grid, through a lookup which already compares
+ * precomputed hashes.
+ */
+struct SqAttributeCache
+{
+	TqInt matte;            ///< Matte mode (0 = off, 1 = on, 2 = matte alpha)
+	bool smoothShading;     ///< ShadingInterpolation is "smooth"
+	TqFloat lodBounds[2];   ///< Relative importance bounds for level of detail
+	bool orientation;       ///< Orientation is flipped from the default
+	CqColor color;          ///< Color
+	CqColor opacity;        ///< Opacity
+	TqInt basisStep[2];     ///< Steps of the u and v patch bases
+	TqFloat textureCoordinates[8];  ///< TextureCoordinates, as (s,t) pairs
+
+	TqFloat shadingRate;    ///< Requested shading rate
+	TqFloat focusFactor;    ///< Dicing multiplier for depth of field
+	TqFloat motionFactor;   ///< Dicing multiplier for motion blur
+
+	TqInt sides;            ///< Number of visible sides
+	bool cullBackfacing;    ///< Cull micropolygons facing away when sides == 1
+	bool cullHidden;        ///< Cull gprims which are occluded
+	bool diceBinary;        ///< Dice with power of two grid sizes
+	bool diceRasterOrient;  ///< Measure dice sizes in raster space
+	bool trimOutside;       ///< Trim curve sense is "outside"
+	TqFloat expandGrids;    ///< Amount to grow grids by to hide cracks
+	TqFloat displacementBound;      ///< Radius of the displacement bound sphere
+	CqString displacementBoundSpace;///< Coordinate system of displacementBound
+
+	/// Initialise all attributes to their RenderMan defaults.
+	SqAttributeCache();
+	/// Populate the cache with attributes extracted from attrs.
+	void cacheAttributes(const IqAttributes& attrs);
+};
+
+
+} // namespace Aqsis
+
+#endif // ATTRIBUTECACHE_H_INCLUDED
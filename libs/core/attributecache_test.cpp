@@ -0,0 +1,97 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file Unit tests for the cache of commonly used attributes.
+ */
+
+#include "attributes.h"
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+#include "parameters.h"
+
+BOOST_AUTO_TEST_SUITE(attributecache_tests)
+
+using namespace Aqsis;
+
+BOOST_AUTO_TEST_CASE(SqAttributeCache_defaults)
+{
+	CqAttributes attrs;
+	const SqAttributeCache& cache = attrs.cache();
+	BOOST_CHECK_EQUAL(cache.sides, 2);
+	BOOST_CHECK(!cache.orientation);
+	BOOST_CHECK(cache.color == CqColor(1, 1, 1));
+	BOOST_CHECK_EQUAL(cache.basisStep[0], 3);
+	BOOST_CHECK_EQUAL(cache.basisStep[1], 3);
+	BOOST_CHECK_EQUAL(cache.textureCoordinates[2], 1);
+	BOOST_CHECK_EQUAL(cache.displacementBound, 0);
+	BOOST_CHECK_EQUAL(cache.displacementBoundSpace, "object");
+}
+
+BOOST_AUTO_TEST_CASE(SqAttributeCache_system_write_invalidates)
+{
+	CqAttributes attrs;
+	BOOST_CHECK_EQUAL(attrs.cache().sides, 2);
+
+	// The typed write accessors go through pAttributeWrite().
+	attrs.GetIntegerAttributeWrite("System", "Sides")[0] = 1;
+	BOOST_CHECK_EQUAL(attrs.cache().sides, 1);
+
+	attrs.GetColorAttributeWrite("System", "Color")[0] = CqColor(1, 0, 0);
+	attrs.GetIntegerAttributeWrite("System", "BasisStep")[1] = 1;
+	BOOST_CHECK(attrs.cache().color == CqColor(1, 0, 0));
+	BOOST_CHECK_EQUAL(attrs.cache().basisStep[1], 1);
+}
+
+BOOST_AUTO_TEST_CASE(SqAttributeCache_user_write_invalidates)
+{
+	CqAttributes attrs;
+	BOOST_CHECK_EQUAL(attrs.cache().displacementBound, 0);
+
+	// Attributes created by RiAttribute are added through pAttributeWrite().
+	CqParameterTypedUniform<TqFloat, type_float, TqFloat>* sphere =
+		new CqParameterTypedUniform<TqFloat, type_float, TqFloat>("sphere");
+	sphere->pValue()[0] = 0.5f;
+	attrs.pAttributeWrite("displacementbound")->AddParameter(sphere);
+	BOOST_CHECK_EQUAL(attrs.cache().displacementBound, 0.5f);
+
+	*attrs.GetFloatAttributeWrite("displacementbound", "sphere") = 2;
+	BOOST_CHECK_EQUAL(attrs.cache().displacementBound, 2);
+}
+
+BOOST_AUTO_TEST_CASE(SqAttributeCache_copy_is_independent)
+{
+	CqAttributes attrs;
+	attrs.GetIntegerAttributeWrite("System", "Sides")[0] = 1;
+	BOOST_CHECK_EQUAL(attrs.cache().sides, 1);
+
+	// A copied state keeps the cache, and writes to it leave the original
+	// alone.
+	CqAttributesPtr copy = attrs.Clone();
+	BOOST_CHECK_EQUAL(copy->cache().sides, 1);
+	copy->GetIntegerAttributeWrite("System", "Sides")[0] = 2;
+	BOOST_CHECK_EQUAL(copy->cache().sides, 2);
+	BOOST_CHECK_EQUAL(attrs.cache().sides, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
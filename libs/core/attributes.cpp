@@ -24,6 +24,9 @@
 */
 
 #include	"attributes.h"
+
+#include	<boost/thread/mutex.hpp>
+
 #include	"renderer.h"
 #include	"shaders.h"
 #include	"trimcurve.h"
@@ -34,6 +37,10 @@ namespace Aqsis {
 
 std::list<CqAttributes*>	Attribute_stack;
 
+CqAttributes::TqInternTable CqAttributes::m_internTable;
+/// Guards CqAttributes::m_internTable, as states may be released by the bucket threads.
+static boost::mutex internTableMutex;
+
 
 const TqUlong CqAttributes::CqHashTable::tableSize = 127;
 
@@ -105,6 +112,8 @@ const TqUlong CqAttributes::CqHashTable::tableSize = 127;
  */
 
 CqAttributes::CqAttributes()
+	: m_cacheValid( false ),
+	m_interned( false )
 {
 	Attribute_stack.push_front( this );
 	m_StackIterator = Attribute_stack.begin();
@@ -136,6 +145,8 @@ CqAttributes::CqAttributes()
  */
 
 CqAttributes::CqAttributes( const CqAttributes& From )
+	: m_cacheValid( false ),
+	m_interned( false )
 {
 	*this = From;
 
@@ -161,6 +172,7 @@ CqAttributes::~CqAttributes()
 
 	// Remove ourself from the stack
 	Attribute_stack.erase( m_StackIterator );
+	Unintern();
 }
 
 //---------------------------------------------------------------------
@@ -178,6 +190,8 @@ CqAttributes& CqAttributes::operator=( const CqAttributes& From )
 	//		m_aAttributes[ i ] ->AddRef();
 	//	}
 	m_aAttributes = From.m_aAttributes;
+	m_cache = From.m_cache;
+	m_cacheValid = From.m_cacheValid;
 
 	m_apLightsources = From.m_apLightsources;
 
@@ -192,6 +206,95 @@ CqAttributes& CqAttributes::operator=( const CqAttributes& From )
 }
 
 
+//---------------------------------------------------------------------
+/** Find or add the shared state equal to pAttr.
+ */
+
+CqAttributesPtr CqAttributes::Intern( const CqAttributesPtr& pAttr )
+{
+	if ( !pAttr || pAttr->m_interned )
+		return ( pAttr );
+	// Trim loops are not copied with the attributes, so states holding them
+	// are left alone.
+	if ( !pAttr->m_TrimLoops.aLoops().empty() )
+		return ( pAttr );
+
+	// Fill the cache first, so that it is shared along with the state.
+	pAttr->cache();
+	TqUlong hash = pAttr->ValuesHash();
+
+	boost::mutex::scoped_lock lock( internTableMutex );
+	std::pair<TqInternTable::iterator, TqInternTable::iterator> range = m_internTable.equal_range( hash );
+	for ( TqInternTable::iterator i = range.first; i != range.second; ++i )
+	{
+		// States being destroyed by another thread have expired already.
+		CqAttributesPtr pInterned = i->second.lock();
+		if ( pInterned && pInterned->ValuesEqual( *pAttr ) )
+		{
+			STATS_INC( ATR_shared );
+			return ( pInterned );
+		}
+	}
+	pAttr->m_internIterator = m_internTable.insert( TqInternTable::value_type( hash, pAttr ) );
+	pAttr->m_interned = true;
+	STATS_INC( ATR_interned );
+	return ( pAttr );
+}
+
+
+//---------------------------------------------------------------------
+/** Remove this state from the interned states, prior to changing it.
+ */
+
+void CqAttributes::Unintern()
+{
+	if ( !m_interned )
+		return;
+	boost::mutex::scoped_lock lock( internTableMutex );
+	m_internTable.erase( m_internIterator );
+	m_interned = false;
+}
+
+
+//---------------------------------------------------------------------
+/** Compare all the values making up two attribute states.
+ */
+
+bool CqAttributes::ValuesEqual( const CqAttributes& From ) const
+{
+	if ( m_pshadDisplacement != From.m_pshadDisplacement ||
+	     m_pshadAreaLightSource != From.m_pshadAreaLightSource ||
+	     m_pshadSurface != From.m_pshadSurface ||
+	     m_pshadAtmosphere != From.m_pshadAtmosphere ||
+	     m_pshadInteriorVolume != From.m_pshadInteriorVolume ||
+	     m_pshadExteriorVolume != From.m_pshadExteriorVolume )
+		return ( false );
+	if ( m_apLightsources.size() != From.m_apLightsources.size() ||
+	     !From.m_TrimLoops.aLoops().empty() )
+		return ( false );
+	for ( TqUint i = 0; i < m_apLightsources.size(); ++i )
+	{
+		if ( m_apLightsources[ i ].lock() != From.m_apLightsources[ i ].lock() )
+			return ( false );
+	}
+	return ( m_aAttributes.ValuesEqual( From.m_aAttributes ) );
+}
+
+
+//---------------------------------------------------------------------
+/** Get a hash of the attribute values, consistent with ValuesEqual().
+ */
+
+TqUlong CqAttributes::ValuesHash() const
+{
+	TqUlong h = m_aAttributes.ValuesHash();
+	h = h * 31 + static_cast<TqUlong>( reinterpret_cast<std::size_t>( m_pshadSurface.get() ) );
+	h = h * 31 + static_cast<TqUlong>( reinterpret_cast<std::size_t>( m_pshadDisplacement.get() ) );
+	h = h * 31 + m_apLightsources.size();
+	return ( h );
+}
+
+
 //---------------------------------------------------------------------
 /** Get a system attribute parameter.
  * \param strName The name of the attribute.
@@ -41,6 +41,7 @@
 #include	<aqsis/ri/ri.h>
 #include	<aqsis/math/matrix.h>
 #include	"options.h"
+#include	"attributecache.h"
 #include	<aqsis/math/spline.h>
 #include	"trimcurve.h"
 #include	<aqsis/core/iattributes.h>
@@ -76,9 +77,23 @@ class CqAttributes : public IqAttributes, public boost::enable_shared_from_this<
 			CqAttributesPtr pWrite(shared_from_this());
 			if ( pWrite.use_count() > 2 )
 				pWrite = Clone();
+			else
+				Unintern();
 			return ( pWrite );
 		}
 
+		/** Get the shared attribute state equal to the given one.
+		 *
+		 * Attributes are copied when written, so scenes which restate the
+		 * same attributes for each primitive build many equal states.
+		 * Interning the states taken by primitives lets them share one copy.
+		 * An interned state is removed from the table when it is next
+		 * written in place.
+		 * \param pAttr the attribute state to look up.
+		 * \return the interned state equal to pAttr, which is pAttr itself if no equal state was interned.
+		 */
+		static CqAttributesPtr Intern( const CqAttributesPtr& pAttr );
+
 		CqAttributes& operator=( const CqAttributes& From );
 
 		/** Add a new user defined attribute.
@@ -87,6 +102,7 @@ class CqAttributes : public IqAttributes, public boost::enable_shared_from_this<
 		void	AddAttribute( const boost::shared_ptr<CqNamedParameterList>& pAttribute )
 		{
 			m_aAttributes.Add( pAttribute );
+			m_cacheValid = false;
 		}
 		/** Get a pointer to a named user defined attribute.
 		 * \param strName the name of the attribute to retrieve.
@@ -104,6 +120,7 @@ class CqAttributes : public IqAttributes, public boost::enable_shared_from_this<
 		 */
 		boost::shared_ptr<CqNamedParameterList> pAttributeWrite( const char* strName )
 		{
+			m_cacheValid = false;
 			boost::shared_ptr<CqNamedParameterList> pAttr = m_aAttributes.Find( strName );
 			if ( pAttr )
 			{
@@ -241,6 +258,21 @@ class CqAttributes : public IqAttributes, public boost::enable_shared_from_this<
 			return ( CqAttributesPtr(new CqAttributes( *this )) );
 		}
 
+		/** Get the commonly used attributes of this state.
+		 *
+		 * The cache is filled on first use after the attributes change, so
+		 * should be warmed up before the state is shared between threads.
+		 * \return the cached attributes.
+		 */
+		const SqAttributeCache& cache() const
+		{
+			if ( !m_cacheValid )
+			{
+				m_cache.cacheAttributes( *this );
+				m_cacheValid = true;
+			}
+			return ( m_cache );
+		}
 		const	CqParameter* pParameter( const char* strName, const char* strParam ) const;
 		CqParameter* pParameterWrite( const char* strName, const char* strParam );
 
@@ -460,6 +492,33 @@ class CqAttributes : public IqAttributes, public boost::enable_shared_from_this<
 					return ( *this );
 				}
 
+				/** Compare the values of all parameter lists held by two tables.
+				 */
+				bool ValuesEqual( const CqHashTable& From ) const
+				{
+					if( m_ParameterLists.size() != From.m_ParameterLists.size() )
+						return ( false );
+					plist_const_iterator it = m_ParameterLists.begin();
+					plist_const_iterator itFrom = From.m_ParameterLists.begin();
+					for( ; it != m_ParameterLists.end(); ++it, ++itFrom )
+					{
+						if( it->second != itFrom->second &&
+						    ( it->first != itFrom->first || !it->second->ValuesEqual( *itFrom->second ) ) )
+							return ( false );
+					}
+					return ( true );
+				}
+
+				/** Get a hash of the parameter lists, consistent with ValuesEqual().
+				 */
+				TqUlong ValuesHash() const
+				{
+					TqUlong h = 0;
+					for( plist_const_iterator it = m_ParameterLists.begin(); it != m_ParameterLists.end(); ++it )
+						h = h * 31 + it->second->ValuesHash();
+					return ( h );
+				}
+
 			private:
 				plist_type	m_ParameterLists;
 		};
@@ -478,6 +537,17 @@ class CqAttributes : public IqAttributes, public boost::enable_shared_from_this<
 		std::vector<boost::weak_ptr<CqLightsource> > m_apLightsources;	///< a set of currently available lightsources.
 
 		std::list<CqAttributes*>::iterator	m_StackIterator;	///< the index of this attribute state in the global stack, used for destroying when last reference is removed.
+		mutable SqAttributeCache m_cache;	///< commonly used attributes, valid if m_cacheValid is set.
+		mutable bool	m_cacheValid;	///< m_cache is up to date with the attributes.
+
+		bool	ValuesEqual( const CqAttributes& From ) const;
+		TqUlong	ValuesHash() const;
+		void	Unintern();
+
+		typedef std::multimap<TqUlong, boost::weak_ptr<CqAttributes> > TqInternTable;
+		static TqInternTable	m_internTable;	///< interned states, by ValuesHash().
+		TqInternTable::iterator	m_internIterator;	///< the entry of this state in m_internTable, valid if m_interned is set.
+		bool	m_interned;	///< this state is in m_internTable, so shared between primitives.
 }
 ;
 
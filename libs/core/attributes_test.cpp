@@ -0,0 +1,96 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file Unit tests for sharing equal attribute states between primitives.
+ */
+
+#include "attributes.h"
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+#include "parameters.h"
+
+BOOST_AUTO_TEST_SUITE(attributes_tests)
+
+using namespace Aqsis;
+
+BOOST_AUTO_TEST_CASE(CqAttributes_intern_equal_states)
+{
+	CqAttributesPtr attrs1(new CqAttributes());
+	CqAttributesPtr attrs2(new CqAttributes());
+	BOOST_CHECK(CqAttributes::Intern(attrs1) == attrs1);
+	BOOST_CHECK(CqAttributes::Intern(attrs2) == attrs1);
+
+	// Interning again finds the same state.
+	BOOST_CHECK(CqAttributes::Intern(attrs1) == attrs1);
+}
+
+BOOST_AUTO_TEST_CASE(CqAttributes_intern_different_states)
+{
+	CqAttributesPtr attrs1(new CqAttributes());
+	CqAttributesPtr attrs2(new CqAttributes());
+	attrs2->GetIntegerAttributeWrite("System", "Sides")[0] = 1;
+	BOOST_CHECK(CqAttributes::Intern(attrs1) == attrs1);
+	BOOST_CHECK(CqAttributes::Intern(attrs2) == attrs2);
+
+	// User attributes are compared by value too.
+	CqAttributesPtr attrs3(new CqAttributes());
+	CqParameterTypedUniform<TqFloat, type_float, TqFloat>* param =
+		new CqParameterTypedUniform<TqFloat, type_float, TqFloat>("bias");
+	param->pValue()[0] = 0.5f;
+	attrs3->pAttributeWrite("user")->AddParameter(param);
+	BOOST_CHECK(CqAttributes::Intern(attrs3) == attrs3);
+}
+
+BOOST_AUTO_TEST_CASE(CqAttributes_write_after_intern)
+{
+	CqAttributesPtr attrs1(new CqAttributes());
+	BOOST_CHECK(CqAttributes::Intern(attrs1) == attrs1);
+
+	// A shared state is copied on write, leaving the interned one alone.
+	CqAttributesPtr primitiveAttrs = attrs1;
+	CqAttributesPtr written = attrs1->Write();
+	BOOST_CHECK(written != attrs1);
+	written->GetIntegerAttributeWrite("System", "Sides")[0] = 1;
+	BOOST_CHECK_EQUAL(attrs1->cache().sides, 2);
+	primitiveAttrs.reset();
+
+	// An unshared state is written in place, so must leave the table.
+	attrs1->Write()->GetIntegerAttributeWrite("System", "Sides")[0] = 1;
+	CqAttributesPtr attrs2(new CqAttributes());
+	BOOST_CHECK(CqAttributes::Intern(attrs2) == attrs2);
+}
+
+BOOST_AUTO_TEST_CASE(CqAttributes_intern_released_state)
+{
+	CqAttributesPtr attrs1(new CqAttributes());
+	attrs1->GetIntegerAttributeWrite("System", "Orientation")[0] = 1;
+	BOOST_CHECK(CqAttributes::Intern(attrs1) == attrs1);
+	attrs1.reset();
+
+	CqAttributesPtr attrs2(new CqAttributes());
+	attrs2->GetIntegerAttributeWrite("System", "Orientation")[0] = 1;
+	BOOST_CHECK(CqAttributes::Intern(attrs2) == attrs2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -65,6 +65,15 @@ CqBucket::CqBucket()
 	m_gPrims()
 { }
 
+//----------------------------------------------------------------------
+CqBucket::~CqBucket()
+{
+	// Buckets are only copied while they're empty, so any surfaces left here
+	// (if the render was stopped early) were accounted by this bucket.
+	for(TqSurfaceQueue::const_iterator i = m_gPrims.begin(); i != m_gPrims.end(); ++i)
+		CqStats::freeMemory( EqMemoryStats::Gprims, (*i)->memoryUsage() );
+}
+
 //----------------------------------------------------------------------
 TqInt CqBucket::getCol() const
 {
@@ -37,6 +37,7 @@
 #include	<boost/array.hpp>
 
 #include	"surface.h"
+#include	"stats.h"
 #include	<aqsis/math/color.h>
 #include	"imagepixel.h"
 #include	"iddmanager.h"
@@ -44,28 +45,6 @@
 
 namespace Aqsis {
 
-struct SqBucketCacheSegment
-{
-	enum	EqBucketCacheSide
-	{
-		left = 0,
-		right = 1,
-		top = 2,
-		bottom = 3,
-
-		top_left = 4,
-		bottom_left = 5,
-		top_right = 6,
-		bottom_right = 7,
-
-		last
-	};
-	EqBucketCacheSide side;
-	TqInt			  size;
-	std::vector<CqImagePixelPtr>	cache;
-};
-
-
 //-----------------------------------------------------------------------
 /** Class holding data about a particular bucket.
  */
@@ -73,15 +52,15 @@ struct SqBucketCacheSegment
 class CqBucket
 {
 	public:
-		typedef boost::array<boost::shared_ptr<SqBucketCacheSegment>, SqBucketCacheSegment::last > TqCache;
-		
 		CqBucket();
+		~CqBucket();
 
 		/** Add a GPRim to the stack of deferred GPrims.
 		* \param The Gprim to be added.
 		 */
 		void	AddGPrim( const boost::shared_ptr<CqSurface>& pGPrim )
 		{
+			CqStats::allocMemory( EqMemoryStats::Gprims, pGPrim->memoryUsage() );
 			m_gPrims.push_back(pGPrim);
 			std::push_heap(m_gPrims.begin(), m_gPrims.end(),
 						   closest_surface());
@@ -106,6 +85,7 @@ class CqBucket
 		{
 			if (!m_gPrims.empty())
 			{
+				CqStats::freeMemory( EqMemoryStats::Gprims, m_gPrims.front()->memoryUsage() );
 				std::pop_heap(m_gPrims.begin(), m_gPrims.end(),
 							  closest_surface());
 				m_gPrims.pop_back();
@@ -155,10 +135,6 @@ class CqBucket
 
 		std::vector<boost::shared_ptr<CqMicroPolygon> >& micropolygons();
 
-		const TqCache& cacheSegments() const;
-		void setCacheSegment(SqBucketCacheSegment::EqBucketCacheSide side, boost::shared_ptr<SqBucketCacheSegment>& seg);
-		void clearCache();
-
 	private:
 		/// This is a compare functor for sorting surfaces in order of depth.
 		struct closest_surface
@@ -203,8 +179,6 @@ class CqBucket
 		/// completely deallocated when the bucket is done.
 		typedef std::vector<boost::shared_ptr<CqSurface> > TqSurfaceQueue;
 		TqSurfaceQueue m_gPrims;
-
-		TqCache m_cacheSegments;
 };
 
 
@@ -217,18 +191,6 @@ inline std::vector<boost::shared_ptr<CqMicroPolygon> >& CqBucket::micropolygons(
 	return m_micropolygons;
 }
 
-inline void CqBucket::setCacheSegment(SqBucketCacheSegment::EqBucketCacheSide side, boost::shared_ptr<SqBucketCacheSegment>& seg)
-{
-	// Check there isn't already a cache segment for the position.
-	assert(!m_cacheSegments[side]);
-	m_cacheSegments[side] = seg;
-}
-
-inline const CqBucket::TqCache& CqBucket::cacheSegments() const
-{
-	return m_cacheSegments;
-}
-
 inline TqInt CqBucket::getXPosition() const
 {
 	return m_xPosition;
@@ -261,14 +223,6 @@ inline void CqBucket::setSize(TqInt xsize, TqInt ysize)
 	m_ySize = ysize;
 }
 
-inline void CqBucket::clearCache()
-{
-
-	for(TqInt cseg = 0; cseg < SqBucketCacheSegment::last; ++cseg)
-		m_cacheSegments[cseg].reset();
-}
-
-
 } // namespace Aqsis
 
 //}  // End of #ifdef BUCKET_H_INCLUDED
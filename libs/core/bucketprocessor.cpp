@@ -18,8 +18,6 @@
 
 #include	"bucketprocessor.h"
 
-#include	<valarray>
-
 #include	<aqsis/math/math.h>
 #include	"bucket.h"
 #include	"imagebuffer.h"
@@ -40,6 +38,15 @@ CqBucketProcessor::CqBucketProcessor(CqImageBuffer& imageBuf,
 	m_aieImage(),
 	m_pixelPool(optCache.xSamps, optCache.ySamps),
 	m_aFilterValues(),
+	m_xFilterValues(),
+	m_yFilterValues(),
+	m_filterWeightTotal(0),
+	m_filterSeparable(false),
+	m_filterSampleData(),
+	m_filterRowSamples(),
+	m_filterRowCounts(),
+	m_filteredSamples(),
+	m_filteredCounts(),
 	m_CurrentMpgSampleInfo(),
 	m_OcclusionTree(),
 	m_DataRegion(),
@@ -58,14 +65,16 @@ void CqBucketProcessor::setupCacheInformation()
 	TqInt overlapy = m_DiscreteShiftY*2;
 	TqInt width = m_optCache.xBucketSize + overlapx;
 	TqInt height = m_optCache.yBucketSize + overlapy;
-	m_cacheRegions[SqBucketCacheSegment::top_left] = CqRegion(0, 0, overlapx, overlapy);
-	m_cacheRegions[SqBucketCacheSegment::top] = CqRegion(overlapx, 0, width-overlapx, overlapy);
-	m_cacheRegions[SqBucketCacheSegment::top_right] = CqRegion(width-overlapx, 0, width, overlapy);
-	m_cacheRegions[SqBucketCacheSegment::left] = CqRegion(0, overlapy, overlapx, height-overlapy);
-	m_cacheRegions[SqBucketCacheSegment::right] = CqRegion(width-overlapx, overlapy, width, height-overlapy);
-	m_cacheRegions[SqBucketCacheSegment::bottom_left] = CqRegion(0, height-overlapy, overlapx, height);
-	m_cacheRegions[SqBucketCacheSegment::bottom] = CqRegion(overlapx, height-overlapy, width-overlapx, height);
-	m_cacheRegions[SqBucketCacheSegment::bottom_right] = CqRegion(width-overlapx, height-overlapy, width, height);
+	m_borderRegions[Border_TopLeft] = CqRegion(0, 0, overlapx, overlapy);
+	m_borderRegions[Border_Top] = CqRegion(overlapx, 0, width-overlapx, overlapy);
+	m_borderRegions[Border_TopRight] = CqRegion(width-overlapx, 0, width, overlapy);
+	m_borderRegions[Border_Left] = CqRegion(0, overlapy, overlapx, height-overlapy);
+	m_borderRegions[Border_Right] = CqRegion(width-overlapx, overlapy, width, height-overlapy);
+	m_borderRegions[Border_BottomLeft] = CqRegion(0, height-overlapy, overlapx, height);
+	m_borderRegions[Border_Bottom] = CqRegion(overlapx, height-overlapy, width-overlapx, height);
+	m_borderRegions[Border_BottomRight] = CqRegion(width-overlapx, height-overlapy, width, height);
+	m_sharedTiles.assign(0);
+	m_sharedTilesInUse.assign(false);
 }
 
 void CqBucketProcessor::setBucket(CqBucket* bucket)
@@ -92,6 +101,49 @@ void CqBucketProcessor::reset()
 	m_hasValidSamples = false;
 }
 
+void CqBucketProcessor::setupRegions()
+{
+	TqInt xPos = m_bucket->getXPosition();
+	TqInt yPos = m_bucket->getYPosition();
+	TqInt xSize = m_bucket->getXSize();
+	TqInt ySize = m_bucket->getYSize();
+
+	m_DisplayRegion = CqRegion( xPos, yPos, xPos+xSize, yPos+ySize );
+	m_DataRegion = CqRegion( xPos - m_DiscreteShiftX, yPos - m_DiscreteShiftY,
+							 xPos + m_optCache.xBucketSize + m_DiscreteShiftX,
+							 yPos + m_optCache.yBucketSize + m_DiscreteShiftY );
+}
+
+void CqBucketProcessor::skipBucket()
+{
+	assert(m_bucket);
+
+	setupRegions();
+
+	// Drop our claim on any tiles shared by the neighbours; the neighbours
+	// still to come will sample their borders with this bucket themselves.
+	CqSampleTileStore& store = m_imageBuf.sampleTiles();
+	for(TqInt border = 0; border < Border_Last; ++border)
+	{
+		if(m_borderRegions[border].area() > 0)
+			store.release(borderRasterRegion(border));
+	}
+
+	// Pass any waiting surfaces on to the other buckets they cover.  Waiting
+	// micropolygons were added to each of the buckets they cover, so they
+	// are just dropped here.
+	std::vector<boost::shared_ptr<CqSurface> > surfaces;
+	surfaces.reserve(m_bucket->cGPrims());
+	while(m_bucket->hasPendingSurfaces())
+	{
+		surfaces.push_back(m_bucket->pTopSurface());
+		m_bucket->popSurface();
+	}
+	m_bucket->SetProcessed();
+	for(TqInt i = 0, end = surfaces.size(); i < end; ++i)
+		m_imageBuf.RepostSurface(*m_bucket, surfaces[i]);
+}
+
 void CqBucketProcessor::preProcess(IqSampler* sampler)
 {
 	assert(m_bucket);
@@ -99,16 +151,14 @@ void CqBucketProcessor::preProcess(IqSampler* sampler)
 	{
 		AQSIS_TIME_SCOPE(Prepare_bucket);
 
+		setupRegions();
+		findSharedTiles();
+
 		TqInt xPos = m_bucket->getXPosition();
 		TqInt yPos = m_bucket->getYPosition();
 		TqInt xSize = m_bucket->getXSize();
 		TqInt ySize = m_bucket->getYSize();
 
-		m_DisplayRegion = CqRegion( xPos, yPos, xPos+xSize, yPos+ySize );
-		m_DataRegion = CqRegion( xPos - m_DiscreteShiftX, yPos - m_DiscreteShiftY,
-								 xPos + m_optCache.xBucketSize + m_DiscreteShiftX,
-								 yPos + m_optCache.yBucketSize + m_DiscreteShiftY );
-
 		TqInt sminx = xPos - m_DiscreteShiftX;
 		TqInt sminy = yPos - m_DiscreteShiftY;
 		TqInt smaxx = xPos + xSize + m_DiscreteShiftX;
@@ -124,15 +174,15 @@ void CqBucketProcessor::preProcess(IqSampler* sampler)
 		if ( smaxy > QGetRenderContext()->cropWindowYMax() + m_DiscreteShiftY )
 			smaxy = static_cast<TqInt>(QGetRenderContext()->cropWindowYMax() + m_DiscreteShiftY );
 
-		// Now shrink the sample region according to any cache segments that have been
-		// applied.
-		if(m_bucket->cacheSegments()[SqBucketCacheSegment::left])
+		// Now shrink the sample region to exclude any edges which have already
+		// been sampled by the neighbouring buckets.
+		if(m_sharedTiles[Border_Left])
 			sminx += m_DiscreteShiftX*2;
-		if(m_bucket->cacheSegments()[SqBucketCacheSegment::right])
+		if(m_sharedTiles[Border_Right])
 			smaxx -= m_DiscreteShiftX*2;
-		if(m_bucket->cacheSegments()[SqBucketCacheSegment::top])
+		if(m_sharedTiles[Border_Top])
 			sminy += m_DiscreteShiftY*2;
-		if(m_bucket->cacheSegments()[SqBucketCacheSegment::bottom])
+		if(m_sharedTiles[Border_Bottom])
 			smaxy -= m_DiscreteShiftY*2;
 		m_SampleRegion = CqRegion(sminx, sminy, smaxx, smaxy);
 
@@ -174,28 +224,16 @@ void CqBucketProcessor::preProcess(IqSampler* sampler)
 				CqVector2D bPos2 = CqVector2D(x, y);
 				m_aieImage[which]->clear();
 				m_aieImage[which]->setSamples(sampler, bPos2);
+				if(m_optCache.adaptiveStride > 1)
+					m_aieImage[which]->setSampleStride(m_optCache.adaptiveStride);
 			}
 		}
+		if(QGetRenderContext()->UsingDepthOfField())
+			setupLensSamples();
 		InitialiseFilterValues();
 	}
-	
-	const CqBucket::TqCache& cache = m_bucket->cacheSegments();
-	if(cache[SqBucketCacheSegment::left])
-		applyCacheSegment(SqBucketCacheSegment::left, cache[SqBucketCacheSegment::left]);
-	if(cache[SqBucketCacheSegment::right])
-		applyCacheSegment(SqBucketCacheSegment::right, cache[SqBucketCacheSegment::right]);
-	if(cache[SqBucketCacheSegment::top])
-		applyCacheSegment(SqBucketCacheSegment::top, cache[SqBucketCacheSegment::top]);
-	if(cache[SqBucketCacheSegment::bottom])
-		applyCacheSegment(SqBucketCacheSegment::bottom, cache[SqBucketCacheSegment::bottom]);
-	if(cache[SqBucketCacheSegment::top_left])
-		applyCacheSegment(SqBucketCacheSegment::top_left, cache[SqBucketCacheSegment::top_left]);
-	if(cache[SqBucketCacheSegment::top_right])
-		applyCacheSegment(SqBucketCacheSegment::top_right, cache[SqBucketCacheSegment::top_right]);
-	if(cache[SqBucketCacheSegment::bottom_left])
-		applyCacheSegment(SqBucketCacheSegment::bottom_left, cache[SqBucketCacheSegment::bottom_left]);
-	if(cache[SqBucketCacheSegment::bottom_right])
-		applyCacheSegment(SqBucketCacheSegment::bottom_right, cache[SqBucketCacheSegment::bottom_right]);
+
+	useSharedTiles();
 
 	{
 		AQSIS_TIME_SCOPE(Occlusion_culling_initialisation);
@@ -235,6 +273,8 @@ void CqBucketProcessor::process()
 	{
 		AQSIS_TIME_SCOPE(Render_MPGs);
 		RenderWaitingMPs();
+		if(m_optCache.adaptiveStride > 1)
+			refineAdaptiveSamples();
 	}
 }
 
@@ -256,103 +296,7 @@ void CqBucketProcessor::postProcess()
 		ExposeBucket();
 	}
 
-	boost::shared_ptr<SqBucketCacheSegment> top_left, top_right, bottom_left, bottom_right;
-
-	std::vector<CqBucket*> neighbours;
-	m_imageBuf.axialNeighbours(*m_bucket, neighbours);
-	if(neighbours[CqImageBuffer::left] && !neighbours[CqImageBuffer::left]->IsProcessed())
-	{
-		boost::shared_ptr<SqBucketCacheSegment> cacheSegment(new SqBucketCacheSegment);
-		buildCacheSegment(SqBucketCacheSegment::left, cacheSegment);
-		neighbours[CqImageBuffer::left]->setCacheSegment(SqBucketCacheSegment::right, cacheSegment);
-
-		if(!neighbours[CqImageBuffer::left]->cacheSegments()[SqBucketCacheSegment::top_right])
-		{
-			top_left = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-			buildCacheSegment(SqBucketCacheSegment::top_left, top_left);
-			neighbours[CqImageBuffer::left]->setCacheSegment(SqBucketCacheSegment::top_right, top_left);
-		}
-		if(!neighbours[CqImageBuffer::left]->cacheSegments()[SqBucketCacheSegment::bottom_right])
-		{
-			bottom_left = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-			buildCacheSegment(SqBucketCacheSegment::bottom_left, bottom_left);
-			neighbours[CqImageBuffer::left]->setCacheSegment(SqBucketCacheSegment::bottom_right, bottom_left);
-		}
-	}
-	if(neighbours[CqImageBuffer::right] && !neighbours[CqImageBuffer::right]->IsProcessed())
-	{
-		boost::shared_ptr<SqBucketCacheSegment> cacheSegment(new SqBucketCacheSegment);
-		buildCacheSegment(SqBucketCacheSegment::right, cacheSegment);
-		neighbours[CqImageBuffer::right]->setCacheSegment(SqBucketCacheSegment::left, cacheSegment);
-		if(!neighbours[CqImageBuffer::right]->cacheSegments()[SqBucketCacheSegment::top_left])
-		{
-			top_right = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-			buildCacheSegment(SqBucketCacheSegment::top_right, top_right);
-			neighbours[CqImageBuffer::right]->setCacheSegment(SqBucketCacheSegment::top_left, top_right);
-		}
-		if(!neighbours[CqImageBuffer::right]->cacheSegments()[SqBucketCacheSegment::bottom_left])
-		{
-			bottom_right = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-			buildCacheSegment(SqBucketCacheSegment::bottom_right, bottom_right);
-			neighbours[CqImageBuffer::right]->setCacheSegment(SqBucketCacheSegment::bottom_left, bottom_right);
-		}
-	}
-	if(neighbours[CqImageBuffer::above] && !neighbours[CqImageBuffer::above]->IsProcessed())
-	{
-		boost::shared_ptr<SqBucketCacheSegment> cacheSegment(new SqBucketCacheSegment);
-		buildCacheSegment(SqBucketCacheSegment::top, cacheSegment);
-		neighbours[CqImageBuffer::above]->setCacheSegment(SqBucketCacheSegment::bottom, cacheSegment);
-		if(!neighbours[CqImageBuffer::above]->cacheSegments()[SqBucketCacheSegment::bottom_left])
-		{
-			if(!top_left)
-			{
-				top_left = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-				buildCacheSegment(SqBucketCacheSegment::top_left, top_left);
-			}
-			neighbours[CqImageBuffer::above]->setCacheSegment(SqBucketCacheSegment::bottom_left, top_left);
-		}
-		if(!neighbours[CqImageBuffer::above]->cacheSegments()[SqBucketCacheSegment::bottom_right])
-		{
-			if(!top_right)
-			{
-				top_right = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-				buildCacheSegment(SqBucketCacheSegment::top_right, top_right);
-			}
-			neighbours[CqImageBuffer::above]->setCacheSegment(SqBucketCacheSegment::bottom_right, top_right);
-		}
-	}
-	if(neighbours[CqImageBuffer::below] && !neighbours[CqImageBuffer::below]->IsProcessed())
-	{
-		boost::shared_ptr<SqBucketCacheSegment> cacheSegment(new SqBucketCacheSegment);
-		buildCacheSegment(SqBucketCacheSegment::bottom, cacheSegment);
-		neighbours[CqImageBuffer::below]->setCacheSegment(SqBucketCacheSegment::top, cacheSegment);
-		if(!neighbours[CqImageBuffer::below]->cacheSegments()[SqBucketCacheSegment::top_left])
-		{
-			if(!bottom_left)
-			{
-				bottom_left = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-				buildCacheSegment(SqBucketCacheSegment::bottom_left, bottom_left);
-			}
-			neighbours[CqImageBuffer::below]->setCacheSegment(SqBucketCacheSegment::top_left, bottom_left);
-		}
-		if(!neighbours[CqImageBuffer::below]->cacheSegments()[SqBucketCacheSegment::top_right])
-		{
-			if(!bottom_right)
-			{
-				bottom_right = boost::shared_ptr<SqBucketCacheSegment>(new SqBucketCacheSegment);
-				buildCacheSegment(SqBucketCacheSegment::bottom_right, bottom_right);
-			}
-			neighbours[CqImageBuffer::below]->setCacheSegment(SqBucketCacheSegment::top_right, bottom_right);
-		}
-	}
-
-	for(TqInt cseg = 0; cseg < SqBucketCacheSegment::last; ++cseg)
-	{
-		if(m_bucket->cacheSegments()[cseg])
-			dropSegment(cseg);
-	}
-
-	m_bucket->clearCache();
+	shareBorderTiles();
 
 	assert(!m_bucket->IsProcessed());
 	m_bucket->SetProcessed();
@@ -374,14 +318,28 @@ void CqBucketProcessor::CombineElements()
 	}
 }
 
+namespace {
+
+/** \brief Add a weighted block of sample data into an accumulator.
+ *
+ * The loop is kept free of branches and indirection so that the compiler can
+ * vectorise it across all the channels of the sample.
+ */
+inline void accumulateWeighted(TqFloat* acc, const TqFloat* data,
+		TqFloat weight, TqInt size)
+{
+	for(TqInt k = 0; k < size; ++k)
+		acc[k] += weight*data[k];
+}
+
+} // anonymous namespace
+
 //----------------------------------------------------------------------
 /** Filter the samples in this bucket according to type and filter widths.
  */
 
 void CqBucketProcessor::FilterBucket()
 {
-	CqImagePixelPtr * pie;
-
 	std::map<TqInt, CqRenderer::SqOutputDataEntry> channelMap;
 	// Setup the channel buffer ready to accept the output data.
 	// First fill in the default display value r, g, b, a, and z.
@@ -399,6 +357,16 @@ void CqBucketProcessor::FilterBucket()
 
 	TqInt depthIndex = m_channelBuffer.getChannelIndex("z");
 
+	// Flatten the channel map into (channel buffer offset, sample data
+	// offset) pairs so that the per-pixel copy below is a simple loop.
+	std::vector<std::pair<TqInt, TqInt> > channelOffsets;
+	for( std::map<TqInt, CqRenderer::SqOutputDataEntry>::iterator channel_i = channelMap.begin(); channel_i != channelMap.end(); ++channel_i )
+	{
+		for(TqInt k = 0; k < channel_i->second.m_NumSamples; ++k)
+			channelOffsets.push_back(std::make_pair(channel_i->first + k,
+						channel_i->second.m_Offset + k));
+	}
+
 	// Allocate a buffer for the channel information, big enough to hold the display region.
 	m_channelBuffer.allocate(DisplayRegion().width(), DisplayRegion().height());
 	TqInt datasize = QGetRenderContext()->GetOutputDataTotalSize();
@@ -407,259 +375,53 @@ void CqBucketProcessor::FilterBucket()
 	std::vector<TqFloat>	aCoverages;
 	aCoverages.resize( DisplayRegion().area() );
 
-	TqInt xmax = m_DiscreteShiftX;
-	TqInt ymax = m_DiscreteShiftY;
-	TqFloat xfwo2 = std::ceil(m_optCache.xFiltSize) * 0.5f;
-	TqFloat yfwo2 = std::ceil(m_optCache.yFiltSize) * 0.5f;
 	TqInt numSubPixels = ( m_optCache.xSamps * m_optCache.ySamps );
 
-	TqInt	xlen = DataRegion().width();
-
-	TqInt SampleCount = 0;
-
 	TqInt x, y;
 	TqInt i = 0;
 
-	TqInt endy = DisplayRegion().yMax();
-	TqInt endx = DisplayRegion().xMax();
-
-	bool useSeperable = true;
+	TqInt endy = DisplayRegion().height();
+	TqInt endx = DisplayRegion().width();
 
 	if(m_hasValidSamples)
 	{
-		// non-seperable is faster for very small filter widths.
-		if(m_optCache.xFiltSize <= 16.0 || m_optCache.yFiltSize <= 16.0)
-			useSeperable = false;
-
-		// FIXME: Separable filters currently crash!  Additionally,
-		// * Some filter types are inherently unseparable (eg, disk, catmull-rom)
-		// * Separable filters are a lot faster where applicable.  The comment
-		//   & heuristic above appears to be incorrect.
-		useSeperable = false;
+		gatherFilterSamples();
+		m_filteredSamples.assign(DisplayRegion().area()*datasize, 0.0f);
+		m_filteredCounts.assign(DisplayRegion().area(), 0);
+		if(m_filterSeparable)
+			filterSeparable(datasize);
+		else
+			filterNonSeparable(datasize);
 
-		if(useSeperable)
+		TqFloat oneOverGTot = 1.0f / m_filterWeightTotal;
+		const TqFloat* samples = &m_filteredSamples[0];
+		for ( y = 0; y < endy; y++ )
 		{
-			// seperable filter. filtering by fx,fy is equivalent to filtering
-			// by fx,1 followed by 1,fy.
-
-			TqInt size = DisplayRegion().width() * DisplayRegion().height() * m_optCache.ySamps;
-			std::valarray<TqFloat> intermediateSamples( 0.0f, size * datasize);
-			std::valarray<TqInt> sampleCounts(0, size);
-			for ( y = DisplayRegion().yMin() - ymax; y < endy + ymax ; y++ )
+			for ( x = 0; x < endx; x++, samples += datasize )
 			{
-				TqFloat ycent = y + 0.5f;
-				TqInt pixelRow = (y-(DisplayRegion().yMin()-ymax)) * m_optCache.ySamps;
-				for ( x = DisplayRegion().xMin(); x < endx ; x++ )
+				IqChannelBuffer::TqChannelPtr pixelData = m_channelBuffer(x, y, 0);
+				TqInt SampleCount = m_filteredCounts[i];
+				if ( SampleCount == 0 )
 				{
-					TqFloat xcent = x + 0.5f;
-
-					// Get the element at the left side of the filter area.
-					ImageElement( x - xmax, y, pie );
-
-					TqInt pixelIndex = pixelRow*DisplayRegion().width() + x-DisplayRegion().xMin();
-
-					// filter just in x first
-					for ( TqInt sy = 0; sy < m_optCache.ySamps; sy++ )
-					{
-						TqFloat gTot = 0.0;
-						SampleCount = 0;
-						std::valarray<TqFloat> samples( 0.0f, datasize);
-
-						CqImagePixelPtr* pie2 = pie;
-						for ( TqInt fx = -xmax; fx <= xmax; fx++ )
-						{
-							TqInt index = (ymax*(2*xmax + 1) + fx + xmax) * numSubPixels;
-							// Now go over each subsample within the pixel
-							TqInt sampleIndex = sy * m_optCache.xSamps;
-
-							for ( TqInt sx = 0; sx < m_optCache.xSamps; sx++ )
-							{
-								SqSampleData const& sampleData = (*pie2)->SampleData( sampleIndex );
-								CqVector2D vecS = sampleData.position;
-								vecS -= CqVector2D( xcent, ycent );
-								if ( vecS.x() >= -xfwo2 && vecS.y() >= -yfwo2 && vecS.x() <= xfwo2 && vecS.y() <= yfwo2 )
-								{
-									TqFloat g = m_aFilterValues[index + sampleIndex];
-									gTot += g;
-									SqImageSample& opv = (*pie2)->occludingHit(sampleIndex);
-									if ( opv.flags & SqImageSample::Flag_Valid )
-									{
-										TqFloat* data = (*pie2)->sampleHitData(opv);
-										for ( TqInt k = 0; k < datasize; ++k )
-											samples[k] += data[k] * g;
-										sampleCounts[pixelIndex]++;
-									}
-								}
-								sampleIndex++;
-							}
-							pie2++;
-						}
-
-						// store the intermediate result
-						for ( TqInt k = 0; k < datasize; k ++)
-							intermediateSamples[pixelIndex*datasize + k] = samples[k] / gTot;
-
-						pixelIndex += DisplayRegion().width();
-					}
+					for(TqInt k = 0, numOffsets = channelOffsets.size(); k < numOffsets; ++k)
+						pixelData[channelOffsets[k].first] = 0.0f;
+					// Set the depth to infinity.
+					pixelData[depthIndex] = FLT_MAX;
+					aCoverages[i] = 0.0;
 				}
-			}
-
-			// now filter in y.
-			for ( y = DisplayRegion().yMin(); y < endy ; y++ )
-			{
-				TqFloat ycent = y + 0.5f;
-				for ( x = DisplayRegion().xMin(); x < endx ; x++ )
+				else
 				{
-					TqFloat xcent = x + 0.5f;
-					TqFloat gTot = 0.0;
-					SampleCount = 0;
-					std::valarray<TqFloat> samples( 0.0f, datasize);
-
-					TqInt fy;
-					// Get the element at the top of the filter area.
-					ImageElement( x, y - ymax, pie );
-					for ( fy = -ymax; fy <= ymax; fy++ )
-					{
-						CqImagePixelPtr* pie2 = pie;
+					// Copy the filtered sample data into the channel buffer.
+					for(TqInt k = 0, numOffsets = channelOffsets.size(); k < numOffsets; ++k)
+						pixelData[channelOffsets[k].first] = samples[channelOffsets[k].second] * oneOverGTot;
 
-						TqInt index = ((fy + ymax)*(2*xmax + 1) + xmax) * numSubPixels;
-						// Now go over each y subsample within the pixel
-						TqInt sx = m_optCache.xSamps / 2; // use the samples in the centre of the pixel.
-						TqInt sy = 0;
-						TqInt sampleIndex = sx;
-						TqInt pixelRow = (y + fy - (DisplayRegion().yMin()-ymax)) * m_optCache.ySamps;
-						TqInt pixelIndex = pixelRow*DisplayRegion().width() + x-DisplayRegion().xMin();
-
-						for ( sy = 0; sy < m_optCache.ySamps; sy++ )
-						{
-							SqSampleData const& sampleData = (*pie2)->SampleData( sampleIndex );
-							CqVector2D vecS = sampleData.position;
-							vecS -= CqVector2D( xcent, ycent );
-							if ( vecS.x() >= -xfwo2 && vecS.y() >= -yfwo2 && vecS.x() <= xfwo2 && vecS.y() <= yfwo2 )
-							{
-								TqFloat g = m_aFilterValues[index + sampleIndex];
-								gTot += g;
-								if(sampleCounts[pixelIndex] > 0)
-								{
-									SampleCount += sampleCounts[pixelIndex];
-									for ( TqInt k = 0; k < datasize; k++)
-										samples[k] += intermediateSamples[pixelIndex * datasize + k] * g;
-								}
-							}
-							sampleIndex += m_optCache.xSamps;
-							pixelIndex += DisplayRegion().width();
-						}
-
-						pie += xlen;
-					}
-
-					// Set depth to infinity if no samples.
-					if ( SampleCount == 0 )
-					{
-						aCoverages[i] = 0.0;
-					}
+					if ( SampleCount >= numSubPixels)
+						aCoverages[ i ] = 1.0;
 					else
-					{
-						float oneOverGTot = 1.0 / gTot;
-
-						// Copy the filtered sample data into the channel buffer.
-						for( std::map<TqInt, CqRenderer::SqOutputDataEntry>::iterator channel_i = channelMap.begin(); channel_i != channelMap.end(); ++channel_i )
-						{
-							for(TqInt i = 0; i < channel_i->second.m_NumSamples; ++i)
-								m_channelBuffer(x, y, channel_i->first)[i] = samples[channel_i->second.m_Offset + i] * oneOverGTot;
-						}
-
-						if ( SampleCount >= numSubPixels)
-							aCoverages[ i ] = 1.0;
-						else
-							aCoverages[ i ] = ( TqFloat ) SampleCount / ( TqFloat ) (numSubPixels );
-					}
-
-					i++;
+						aCoverages[ i ] = ( TqFloat ) SampleCount / ( TqFloat ) (numSubPixels );
 				}
-			}
-		}
-		else
-		{
-			// non-seperable filter
-			for ( y = DisplayRegion().yMin(); y < endy ; y++ )
-			{
-				TqFloat ycent = y + 0.5f;
-				for ( x = DisplayRegion().xMin(); x < endx ; x++ )
-				{
-					TqFloat xcent = x + 0.5f;
-					TqFloat gTot = 0.0;
-					SampleCount = 0;
-					std::valarray<TqFloat> samples( 0.0f, datasize);
-
-					// Get the element at the upper left corner of the filter area.
-					ImageElement( x - xmax, y - ymax, pie );
-					for (TqInt fy = -ymax; fy <= ymax; fy++, pie += xlen )
-					{
-						CqImagePixelPtr* pie2 = pie;
-						for (TqInt fx = -xmax; fx <= xmax; fx++, ++pie2 )
-						{
-							TqInt index = ((fy + ymax)*(2*xmax+1) + fx + xmax) * numSubPixels;
-							// Now go over each subsample within the pixel
-							TqInt sampleIndex = 0;
-							for (TqInt sy = 0; sy < m_optCache.ySamps; sy++ )
-							{
-								for (TqInt sx = 0; sx < m_optCache.xSamps; sx++ )
-								{
-									SqSampleData const& sampleData = (*pie2)->SampleData( sampleIndex );
-									CqVector2D vecS = sampleData.position;
-									vecS -= CqVector2D( xcent, ycent );
-									if ( vecS.x() >= -xfwo2 && vecS.y() >= -yfwo2 && vecS.x() <= xfwo2 && vecS.y() <= yfwo2 )
-									{
-										TqFloat g = m_aFilterValues[index+sampleIndex];
-										gTot += g;
-										SqImageSample& opv = (*pie2)->occludingHit(sampleIndex);
-										if ( opv.flags & SqImageSample::Flag_Valid )
-										{
-											TqFloat* data = (*pie2)->sampleHitData(opv);
-											for ( TqInt k = 0; k < datasize; ++k )
-												samples[k] += data[k] * g;
-											SampleCount++;
-										}
-									}
-									sampleIndex++;
-								}
-							}
-						}
-					}
-
-
-					// Set depth to infinity if no samples.
-					if ( SampleCount == 0 )
-					{
-						for( std::map<TqInt, CqRenderer::SqOutputDataEntry>::iterator channel_i = channelMap.begin(); channel_i != channelMap.end(); ++channel_i )
-						{
-							for(TqInt i = 0; i < channel_i->second.m_NumSamples; ++i)
-								m_channelBuffer(x-DisplayRegion().xMin(), y-DisplayRegion().yMin(), channel_i->first)[i] = 0.0f;
-						}
-						// Set the depth to infinity.
-						m_channelBuffer(x-DisplayRegion().xMin(), y-DisplayRegion().yMin(), depthIndex)[0] = FLT_MAX;
-						aCoverages[i] = 0.0;
-					}
-					else
-					{
-						float oneOverGTot = 1.0 / gTot;
-						
-						// Copy the filtered sample data into the channel buffer.
-						for( std::map<TqInt, CqRenderer::SqOutputDataEntry>::iterator channel_i = channelMap.begin(); channel_i != channelMap.end(); ++channel_i )
-						{
-							for(TqInt i = 0; i < channel_i->second.m_NumSamples; ++i)
-								m_channelBuffer(x-DisplayRegion().xMin(), y-DisplayRegion().yMin(), channel_i->first)[i] = samples[channel_i->second.m_Offset + i] * oneOverGTot;
-						}
 
-						if ( SampleCount >= numSubPixels)
-							aCoverages[ i ] = 1.0;
-						else
-							aCoverages[ i ] = ( TqFloat ) SampleCount / ( TqFloat ) (numSubPixels );
-					}
-
-					i++;
-				}
+				i++;
 			}
 		}
 	}
@@ -671,18 +433,15 @@ void CqBucketProcessor::FilterBucket()
 		{
 			for(TqInt x = 0; x < DisplayRegion().width(); ++x)
 			{
-				for( std::map<TqInt, CqRenderer::SqOutputDataEntry>::iterator channel_i = channelMap.begin(); channel_i != channelMap.end(); ++channel_i )
-				{
-					for(TqInt i = 0; i < channel_i->second.m_NumSamples; ++i)
-						m_channelBuffer(x, y, channel_i->first)[i] = 0.0f;
-				}
+				IqChannelBuffer::TqChannelPtr pixelData = m_channelBuffer(x, y, 0);
+				for(TqInt k = 0, numOffsets = channelOffsets.size(); k < numOffsets; ++k)
+					pixelData[channelOffsets[k].first] = 0.0f;
 				// Set the depth to infinity.
-				m_channelBuffer(x, y, depthIndex)[0] = FLT_MAX;
+				pixelData[depthIndex] = FLT_MAX;
 				aCoverages[ i++ ] = 0.0f;
 			}
 		}
 	}
-
 	i = 0;
 	endy = DisplayRegion().height();
 	endx = DisplayRegion().width();
@@ -740,6 +499,145 @@ void CqBucketProcessor::FilterBucket()
 	}
 }
 
+//----------------------------------------------------------------------
+/** Collect the occluding hit data for every subpixel touched by the filter.
+ *
+ * The result is a 2D grid of subpixels covering the display region plus the
+ * filter overlap, stored row by row so that both filtering passes can walk it
+ * linearly.  Empty subpixels are marked with a null pointer.
+ */
+void CqBucketProcessor::gatherFilterSamples()
+{
+	TqInt xSamps = m_optCache.xSamps;
+	TqInt ySamps = m_optCache.ySamps;
+	TqInt gatherWidth = DisplayRegion().width() + 2*m_DiscreteShiftX;
+	TqInt gatherHeight = DisplayRegion().height() + 2*m_DiscreteShiftY;
+	TqInt rowLen = gatherWidth*xSamps;
+
+	m_filterSampleData.resize(rowLen*gatherHeight*ySamps);
+	for(TqInt py = 0; py < gatherHeight; ++py)
+	{
+		for(TqInt px = 0; px < gatherWidth; ++px)
+		{
+			CqImagePixel& pixel = *m_aieImage[py*DataRegion().width() + px];
+			const TqFloat** dest = &m_filterSampleData[py*ySamps*rowLen + px*xSamps];
+			TqInt sampleIndex = 0;
+			for(TqInt sy = 0; sy < ySamps; ++sy, dest += rowLen)
+			{
+				for(TqInt sx = 0; sx < xSamps; ++sx, ++sampleIndex)
+				{
+					const SqImageSample& hit = pixel.occludingHit(sampleIndex);
+					dest[sx] = (hit.flags & SqImageSample::Flag_Valid)
+						? pixel.sampleHitData(hit) : 0;
+				}
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+/** Filter the gathered samples with the full 2D table of filter weights.
+ */
+void CqBucketProcessor::filterNonSeparable(TqInt datasize)
+{
+	TqInt xSamps = m_optCache.xSamps;
+	TqInt ySamps = m_optCache.ySamps;
+	TqInt filterCols = (2*m_DiscreteShiftX + 1)*xSamps;
+	TqInt filterRows = (2*m_DiscreteShiftY + 1)*ySamps;
+	TqInt rowLen = (DisplayRegion().width() + 2*m_DiscreteShiftX)*xSamps;
+
+	TqFloat* filtered = &m_filteredSamples[0];
+	TqInt* counts = &m_filteredCounts[0];
+	for(TqInt y = 0, endy = DisplayRegion().height(); y < endy; ++y)
+	{
+		for(TqInt x = 0, endx = DisplayRegion().width(); x < endx; ++x)
+		{
+			const TqFloat* weights = &m_aFilterValues[0];
+			const TqFloat* const* samples = &m_filterSampleData[y*ySamps*rowLen + x*xSamps];
+			TqInt count = 0;
+			for(TqInt j = 0; j < filterRows; ++j, samples += rowLen, weights += filterCols)
+			{
+				for(TqInt i = 0; i < filterCols; ++i)
+				{
+					if(samples[i] && weights[i] != 0)
+					{
+						accumulateWeighted(filtered, samples[i], weights[i], datasize);
+						++count;
+					}
+				}
+			}
+			*counts++ = count;
+			filtered += datasize;
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+/** Filter the gathered samples in two passes with a separable filter.
+ *
+ * Filtering by w(x,y) = wx(x)*wy(y) is equivalent to filtering every row of
+ * subpixels by wx, followed by filtering the resulting columns by wy.
+ */
+void CqBucketProcessor::filterSeparable(TqInt datasize)
+{
+	TqInt xSamps = m_optCache.xSamps;
+	TqInt ySamps = m_optCache.ySamps;
+	TqInt filterCols = (2*m_DiscreteShiftX + 1)*xSamps;
+	TqInt filterRows = (2*m_DiscreteShiftY + 1)*ySamps;
+	TqInt width = DisplayRegion().width();
+	TqInt height = DisplayRegion().height();
+	TqInt rowLen = (width + 2*m_DiscreteShiftX)*xSamps;
+	TqInt numRows = (height + 2*m_DiscreteShiftY)*ySamps;
+
+	// Filter in x, giving one intermediate result per display pixel column
+	// for each row of subpixels.
+	m_filterRowSamples.assign(numRows*width*datasize, 0.0f);
+	m_filterRowCounts.assign(numRows*width, 0);
+	TqFloat* rowSamples = &m_filterRowSamples[0];
+	TqInt* rowCounts = &m_filterRowCounts[0];
+	for(TqInt r = 0; r < numRows; ++r)
+	{
+		for(TqInt x = 0; x < width; ++x)
+		{
+			const TqFloat* const* samples = &m_filterSampleData[r*rowLen + x*xSamps];
+			TqInt count = 0;
+			for(TqInt i = 0; i < filterCols; ++i)
+			{
+				if(samples[i] && m_xFilterValues[i] != 0)
+				{
+					accumulateWeighted(rowSamples, samples[i], m_xFilterValues[i], datasize);
+					++count;
+				}
+			}
+			*rowCounts++ = count;
+			rowSamples += datasize;
+		}
+	}
+
+	// Now filter the intermediate results in y.
+	TqFloat* filtered = &m_filteredSamples[0];
+	TqInt* counts = &m_filteredCounts[0];
+	for(TqInt y = 0; y < height; ++y)
+	{
+		for(TqInt x = 0; x < width; ++x)
+		{
+			TqInt index = y*ySamps*width + x;
+			TqInt count = 0;
+			for(TqInt j = 0; j < filterRows; ++j, index += width)
+			{
+				if(m_filterRowCounts[index] > 0 && m_yFilterValues[j] != 0)
+				{
+					accumulateWeighted(filtered, &m_filterRowSamples[index*datasize],
+							m_yFilterValues[j], datasize);
+					count += m_filterRowCounts[index];
+				}
+			}
+			*counts++ = count;
+			filtered += datasize;
+		}
+	}
+}
+
 void CqBucketProcessor::ImageElement( TqInt iXPos, TqInt iYPos, CqImagePixelPtr*& pie )
 {
 	iXPos -= DisplayRegion().xMin();
@@ -803,52 +701,105 @@ void CqBucketProcessor::ExposeBucket()
 
 //----------------------------------------------------------------------
 /** Initialise the cache of filter values.
+ *
+ * The filter is tabulated over the grid of subpixels which it covers, and
+ * the table is checked for separability so that FilterBucket() can use the
+ * cheaper two-pass filter whenever possible.
  */
 void CqBucketProcessor::InitialiseFilterValues()
 {
 	if( !m_aFilterValues.empty() )
 		return;
 
-	// Allocate and fill in the filter values array for each pixel.
-	TqInt numSubPixels = m_optCache.xSamps * m_optCache.ySamps;
-	TqInt numPixels = (lceil(m_optCache.xFiltSize) + 1) * (lceil(m_optCache.yFiltSize) + 1);
+	TqInt xSamps = m_optCache.xSamps;
+	TqInt ySamps = m_optCache.ySamps;
+	TqInt xmax = m_DiscreteShiftX;
+	TqInt ymax = m_DiscreteShiftY;
+	TqInt filterCols = (2*xmax + 1)*xSamps;
+	TqInt filterRows = (2*ymax + 1)*ySamps;
 
-	m_aFilterValues.resize(numPixels*numSubPixels);
+	m_aFilterValues.resize(filterCols*filterRows);
 
 	RtFilterFunc pFilter;
 	pFilter = QGetRenderContext() ->poptCurrent()->funcFilter();
 
-	TqInt xmax = m_DiscreteShiftX;
-	TqInt ymax = m_DiscreteShiftY;
-	TqFloat xfwo2 = std::ceil(m_optCache.xFiltSize) * 0.5f;
-	TqFloat yfwo2 = std::ceil(m_optCache.yFiltSize) * 0.5f;
+	TqFloat xwidth = std::ceil(m_optCache.xFiltSize);
+	TqFloat ywidth = std::ceil(m_optCache.yFiltSize);
+	TqFloat xfwo2 = xwidth * 0.5f;
+	TqFloat yfwo2 = ywidth * 0.5f;
 
-	// Go over every pixel touched by the filter
-	for(TqInt py = -ymax; py <= ymax; py++)
+	// Go over every subpixel touched by the filter
+	TqInt maxIndex = 0;
+	for(TqInt j = 0; j < filterRows; ++j)
 	{
-		for(TqInt px = -xmax; px <= xmax; px++)
+		for(TqInt i = 0; i < filterCols; ++i)
 		{
-			// index of the start of the filter storage for the pixel.
-			TqInt subPixelIndex = ((py + ymax)*(2*xmax+1) + px + xmax)*numSubPixels;
-			// Go over every subpixel in the pixel.
-			for (TqInt sy = 0; sy < m_optCache.ySamps; sy++ )
+			// Evaluate the filter at the centre of the subpixel.  The
+			// samples aren't actually at the subpixel centers but the
+			// small inaccuracy doesn't seem to affect image quality
+			// since the noise from the underlying image is much greater.
+			TqFloat fx = (i + 0.5f) / xSamps - xmax - 0.5f;
+			TqFloat fy = (j + 0.5f) / ySamps - ymax - 0.5f;
+			TqFloat w = 0;
+			if ( fx >= -xfwo2 && fy >= -yfwo2 && fx <= xfwo2 && fy <= yfwo2 )
+				w = ( *pFilter ) ( fx, fy, xwidth, ywidth );
+			TqInt index = j*filterCols + i;
+			m_aFilterValues[index] = w;
+			if(std::fabs(w) > std::fabs(m_aFilterValues[maxIndex]))
+				maxIndex = index;
+		}
+	}
+
+	// Try to factor the table into the product of the row and the column
+	// passing through the largest weight.  This picks up the separable
+	// builtin filters (box, gaussian, sinc, mitchell) along with any user
+	// filters which happen to be separable, without needing to know anything
+	// about the filter function itself.
+	TqFloat maxWeight = m_aFilterValues[maxIndex];
+	TqInt maxRow = maxIndex / filterCols;
+	TqInt maxCol = maxIndex % filterCols;
+	m_xFilterValues.resize(filterCols);
+	m_yFilterValues.resize(filterRows);
+	m_filterSeparable = maxWeight != 0 && (xmax > 0 || ymax > 0);
+	if(m_filterSeparable)
+	{
+		for(TqInt i = 0; i < filterCols; ++i)
+			m_xFilterValues[i] = m_aFilterValues[maxRow*filterCols + i] / maxWeight;
+		for(TqInt j = 0; j < filterRows; ++j)
+			m_yFilterValues[j] = m_aFilterValues[j*filterCols + maxCol];
+		TqFloat tolerance = 1e-4f * std::fabs(maxWeight);
+		for(TqInt j = 0; j < filterRows && m_filterSeparable; ++j)
+		{
+			for(TqInt i = 0; i < filterCols; ++i)
 			{
-				for (TqInt sx = 0; sx < m_optCache.xSamps; sx++, ++subPixelIndex )
+				if(std::fabs(m_aFilterValues[j*filterCols + i]
+						- m_yFilterValues[j]*m_xFilterValues[i]) > tolerance)
 				{
-					// Evaluate the filter at the centre of the subpixel.  The
-					// samples aren't actually at the subpixel centers but the
-					// small inaccuracy doesn't seem to affect image quality
-					// since the noise from the underlying image is much greater.
-					TqFloat fx = (sx + 0.5f) / m_optCache.xSamps + px - 0.5f;
-					TqFloat fy = (sy + 0.5f) / m_optCache.ySamps + py - 0.5f;
-					TqFloat w = 0;
-					if ( fx >= -xfwo2 && fy >= -yfwo2 && fx <= xfwo2 && fy <= yfwo2 )
-						w = ( *pFilter ) ( fx, fy, std::ceil(m_optCache.xFiltSize), std::ceil(m_optCache.yFiltSize) );
-					m_aFilterValues[ subPixelIndex ] = w;
+					m_filterSeparable = false;
+					break;
 				}
 			}
 		}
 	}
+
+	// The filter weights don't depend on the sample positions, so the
+	// normalisation factor is the same for every pixel.
+	m_filterWeightTotal = 0;
+	if(m_filterSeparable)
+	{
+		TqFloat xTot = 0;
+		TqFloat yTot = 0;
+		for(TqInt i = 0; i < filterCols; ++i)
+			xTot += m_xFilterValues[i];
+		for(TqInt j = 0; j < filterRows; ++j)
+			yTot += m_yFilterValues[j];
+		m_filterWeightTotal = xTot*yTot;
+	}
+	else
+	{
+		for(TqInt i = 0, end = m_aFilterValues.size(); i < end; ++i)
+			m_filterWeightTotal += m_aFilterValues[i];
+	}
 }
 
 void CqBucketProcessor::CalculateDofBounds()
@@ -909,6 +860,35 @@ void CqBucketProcessor::CalculateDofBounds()
 }
 
 
+//----------------------------------------------------------------------
+/** Group the samples of the pixels in the sample region by lens stratum.
+ */
+void CqBucketProcessor::setupLensSamples()
+{
+	TqInt numPixels = m_aieImage.size();
+	m_lensSamples.resize(m_NumDofBounds*numPixels);
+	TqInt stride = DataRegion().width();
+	for(TqInt y = SampleRegion().yMin(), yend = SampleRegion().yMax(); y < yend; ++y)
+	{
+		for(TqInt x = SampleRegion().xMin(), xend = SampleRegion().xMax(); x < xend; ++x)
+		{
+			TqInt which = (y - DisplayRegion().yMin() + m_DiscreteShiftY)*stride
+				+ x - DisplayRegion().xMin() + m_DiscreteShiftX;
+			const CqImagePixel& pixel = *m_aieImage[which];
+			for(TqInt i = 0; i < m_NumDofBounds; ++i)
+			{
+				SqLensSample& lensSample = m_lensSamples[i*numPixels + which];
+				lensSample.index = pixel.GetDofOffsetIndex(i);
+				const SqSampleData& sampleData = pixel.SampleData(lensSample.index);
+				lensSample.position = sampleData.position;
+				lensSample.dofOffset = sampleData.dofOffset;
+				lensSample.time = sampleData.time;
+			}
+		}
+	}
+}
+
+
 //----------------------------------------------------------------------
 /** Render any waiting MPs.
  
@@ -926,25 +906,70 @@ void CqBucketProcessor::RenderWaitingMPs()
 		CqMicroPolygon* mp = (*itMP).get();
 		RenderMicroPoly( mp );
 	}
+	// When sampling adaptively, the MPs are needed again once it's known
+	// which pixels need more samples.
+	if(m_optCache.adaptiveStride > 1)
+	{
+		m_adaptiveMPs.insert(m_adaptiveMPs.end(), m_bucket->micropolygons().begin(),
+				m_bucket->micropolygons().end());
+	}
 	m_bucket->micropolygons().clear();
 
 	m_OcclusionTree.updateTree();
 }
 
 
+//----------------------------------------------------------------------
+/** Test the sparse samples in each pixel of the sample region, and render
+    the retained MPs again into the remaining samples of any pixels where
+    they disagree.  Pixels which pass the test have their skipped samples
+    filled in from the sparse ones during CombineElements().
+ */
+void CqBucketProcessor::refineAdaptiveSamples()
+{
+	bool needsRefinement = false;
+	for(TqInt y = m_SampleRegion.yMin() - m_DisplayRegion.yMin() + m_DiscreteShiftY, endY = m_SampleRegion.yMax() - m_DisplayRegion.yMin() + m_DiscreteShiftY; y < endY; ++y)
+	{
+		for(TqInt x = m_SampleRegion.xMin() - m_DisplayRegion.xMin() + m_DiscreteShiftX, endX = m_SampleRegion.xMax() - m_DisplayRegion.xMin() + m_DiscreteShiftX; x < endX; ++x)
+		{
+			CqImagePixel& pixel = *m_aieImage[(y*m_DataRegion.width())+x];
+			if(pixel.needsRefinement(m_optCache.adaptiveThreshold))
+			{
+				pixel.refineSamples();
+				needsRefinement = true;
+			}
+		}
+	}
+
+	if(needsRefinement)
+	{
+		for ( std::vector<boost::shared_ptr<CqMicroPolygon> >::iterator itMP = m_adaptiveMPs.begin();
+				itMP != m_adaptiveMPs.end();
+				itMP++ )
+		{
+			RenderMicroPoly( (*itMP).get() );
+		}
+	}
+	m_adaptiveMPs.clear();
+}
+
+
 //----------------------------------------------------------------------
 /** Render the given Surface
  */
 void CqBucketProcessor::RenderSurface( boost::shared_ptr<CqSurface>& surface )
 {
-	// Cull surface if it's hidden
-	if ( !surface->pCSGNode() && !( (m_optCache.displayMode & DMode_Z) &&
-	                                (m_optCache.depthFilter == Filter_Max ||
-	                                 m_optCache.depthFilter == Filter_Average) ) )
+	// Cull surface if it's hidden.  With adaptive sampling, surfaces can't
+	// be culled: they may be visible only at the samples skipped by the
+	// sparse pass, and their micropolygons are needed when refining them.
+	if ( !surface->pCSGNode() && m_optCache.adaptiveStride <= 1 &&
+		 !( (m_optCache.displayMode & DMode_Z) &&
+	        (m_optCache.depthFilter == Filter_Max ||
+	         m_optCache.depthFilter == Filter_Average) ) )
 	{
 		AQSIS_TIME_SCOPE(Occlusion_culling);
 		if ( surface->fCachedBound() &&
-			 ( surface->pAttributes()->GetIntegerAttributeDef( "cull", "hidden", 1 ) == 1 ) &&
+			 surface->attributeCache().cullHidden &&
 		     m_OcclusionTree.canCull(surface->GetCachedRasterBound()) )
 		{
 			m_imageBuf.RepostSurface(*m_bucket, surface);
@@ -961,9 +986,7 @@ void CqBucketProcessor::RenderSurface( boost::shared_ptr<CqSurface>& surface )
 		QGetRenderContext()->matSpaceToSpace("camera", "raster", NULL, NULL,
 											 QGetRenderContextI()->Time(),
 											 diceCoords);
-		const TqInt* rasterOrient = surface->pAttributes()->
-								GetIntegerAttribute("dice", "rasterorient");
-		if(rasterOrient && *rasterOrient == 0)
+		if(!surface->attributeCache().diceRasterOrient)
 		{
 			// Non raster-oriented dicing: dice the object as if all parts of
 			// the surface face the camera.  When dicing in raster space, the
@@ -1075,6 +1098,12 @@ void CqBucketProcessor::RenderMicroPoly( CqMicroPolygon* pMP )
 	                  !( (m_optCache.displayMode & DMode_Z) &&
 	                     (m_optCache.depthFilter == Filter_Max ||
 	                      m_optCache.depthFilter == Filter_Average) );
+	// Hits behind layers of semitransparent surfaces can also be culled
+	// once their accumulated opacity reaches the threshold.  This would
+	// change the depth seen by depth filters and the parity of CSG
+	// intersections, so it's not done in those cases.
+	m_CurrentMpgSampleInfo.isOpacityCullable = m_CurrentMpgSampleInfo.isCullable
+		&& !(m_optCache.displayMode & DMode_Z) && !CqCSGTreeNode::IsRequired();
 
 	// Cache output sample info for this mpg so we don't have to keep fetching
 	// it for each sample.
@@ -1162,6 +1191,8 @@ void CqBucketProcessor::RenderMPG_Static( CqMicroPolygon* pMPG)
 				for ( m = start_m; m < end_m; m++, index++ )
 				{
 					SqSampleData const& sampleData = (*pie2)->SampleData( index );
+					if(!sampleData.isActive)
+						continue;
 					const CqVector2D& vecP = sampleData.position;
 					const TqFloat time = 0.0;
 
@@ -1213,6 +1244,28 @@ void CqBucketProcessor::RenderMPG_Static( CqMicroPolygon* pMPG)
 	}
 }
 
+namespace {
+
+/** \brief Determine whether a DoF sample can hit anything inside a bound.
+ *
+ * The sample sees points in the bound when it's displaced along its lens
+ * offset by their circle of confusion, which lies between cocMin and cocMax.
+ */
+inline bool lensSampleInBound(const CqBound& bound, const CqVector2D& position,
+		const CqVector2D& dofOffset, const CqVector2D& cocMin,
+		const CqVector2D& cocMax)
+{
+	CqVector2D lo = position + compMul(cocMin, dofOffset);
+	CqVector2D hi = position + compMul(cocMax, dofOffset);
+	if(dofOffset.x() < 0)
+		std::swap(lo.x(), hi.x());
+	if(dofOffset.y() < 0)
+		std::swap(lo.y(), hi.y());
+	return bound.Intersects(lo, hi);
+}
+
+} // anonymous namespace
+
 // this function assumes that either dof or mb or both are being used.
 void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving, bool UsingDof )
 {
@@ -1278,8 +1331,8 @@ void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving,
 			}
 		}
 
-		TqFloat maxCocX = 0;
-		TqFloat maxCocY = 0;
+		CqVector2D minCoc;
+		CqVector2D maxCoc;
 
 		TqFloat bminx = Bound.vecMin().x();
 		TqFloat bmaxx = Bound.vecMax().x();
@@ -1299,8 +1352,11 @@ void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving,
 		{
 			const CqVector2D& minZCoc = QGetRenderContext()->GetCircleOfConfusion( Bound.vecMin().z() );
 			const CqVector2D& maxZCoc = QGetRenderContext()->GetCircleOfConfusion( Bound.vecMax().z() );
-			maxCocX = max( minZCoc.x(), maxZCoc.x() );
-			maxCocY = max( minZCoc.y(), maxZCoc.y() );
+			maxCoc = max( minZCoc, maxZCoc );
+			// The blur is smallest at one of the z extents of the bound,
+			// unless the bound spans the focal plane.
+			if(QGetRenderContext()->MinCoCForBound(Bound) > 0)
+				minCoc = min(minZCoc, maxZCoc);
 			bound_maxDof = m_NumDofBounds;
 		}
 		else
@@ -1313,12 +1369,19 @@ void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving,
 			if(UsingDof)
 			{
 				// now shift the bounding box to cover only a given range of
-				// lens positions.
-				const CqBound DofBound = DofSubBound( bound_numDof );
-				TqFloat leftOffset = DofBound.vecMax().x() * maxCocX;
-				TqFloat rightOffset = DofBound.vecMin().x() * maxCocX;
-				TqFloat topOffset = DofBound.vecMax().y() * maxCocY;
-				TqFloat bottomOffset = DofBound.vecMin().y() * maxCocY;
+				// lens positions.  The offsets are the extremes of coc*lens
+				// position over the stratum; note that the smallest
+				// circle of confusion gives the extreme where the stratum
+				// doesn't contain the lens centre.
+				const CqBound& DofBound = DofSubBound( bound_numDof );
+				TqFloat leftOffset = DofBound.vecMax().x()
+					* (DofBound.vecMax().x() > 0 ? maxCoc.x() : minCoc.x());
+				TqFloat rightOffset = DofBound.vecMin().x()
+					* (DofBound.vecMin().x() < 0 ? maxCoc.x() : minCoc.x());
+				TqFloat topOffset = DofBound.vecMax().y()
+					* (DofBound.vecMax().y() > 0 ? maxCoc.y() : minCoc.y());
+				TqFloat bottomOffset = DofBound.vecMin().y()
+					* (DofBound.vecMin().y() < 0 ? maxCoc.y() : minCoc.y());
 
 				bminx = mpgbminx - leftOffset;
 				bmaxx = mpgbmaxx - rightOffset;
@@ -1347,21 +1410,37 @@ void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving,
 				continue;
 
 			ImageElement( sX, sY, pie );
+			// The lens samples for this stratum are laid out in the same
+			// order as the pixels.
+			TqInt lensRow = 0;
+			if(UsingDof)
+				lensRow = bound_numDof*m_aieImage.size() + (pie - &m_aieImage[0]);
 
 			for( int iY = sY; iY < eY; ++iY)
 			{
 				pie2 = pie;
 				pie += nextx;
+				TqInt lensIndex = lensRow;
+				lensRow += nextx;
 
-				for(int iX = sX; iX < eX; ++iX, ++pie2)
+				for(int iX = sX; iX < eX; ++iX, ++pie2, ++lensIndex)
 				{
 					TqInt index;
 					if(UsingDof)
 					{
 						// when using dof only one sample per pixel can
 						// possibbly hit (the one corresponding to the
-						// current bounding box).
-						index = (*pie2)->GetDofOffsetIndex(bound_numDof);
+						// current bounding box).  Most of these can be
+						// rejected using only the grouped lens samples,
+						// without touching the pixel data.
+						const SqLensSample& lensSample = m_lensSamples[lensIndex];
+						CqStats::IncI( CqStats::SPL_count );
+						if(IsMoving && (lensSample.time < time0 || lensSample.time > time1))
+							continue;
+						if(!lensSampleInBound(Bound, lensSample.position,
+									lensSample.dofOffset, minCoc, maxCoc))
+							continue;
+						index = lensSample.index;
 					}
 					else
 					{
@@ -1378,20 +1457,12 @@ void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving,
 
 						index++;
 
-						CqStats::IncI( CqStats::SPL_count );
-
-						if(IsMoving && (time < time0 || time > time1))
-						{
+						if(!sampleData.isActive)
 							continue;
-						}
 
 						// check if sample lies inside mpg bounding box.
 						if ( UsingDof )
 						{
-							CqBound DofBound(bminx, bminy, bminz, bmaxx, bmaxy, bmaxz);
-
-							if(!DofBound.Contains2D( vecP ))
-								continue;
 							// Occlusion cull the micropoly bound against the
 							// current opaque sample hit.
 							if(isCullable && Bound.vecMin().z() > sampleData.occlZ)
@@ -1425,6 +1496,11 @@ void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving,
 						}
 						else
 						{
+							CqStats::IncI( CqStats::SPL_count );
+
+							if(IsMoving && (time < time0 || time > time1))
+								continue;
+
 							if(!Bound.Contains2D( vecP ))
 								continue;
 							// Occlusion cull the micropoly bound against the
@@ -1508,8 +1584,7 @@ void CqBucketProcessor::StoreSample( CqMicroPolygon* pMPG, CqImagePixel* pie2, T
 			{
 				// view -->      |          |          |
 				// direc      hitPrevZ      D     sampleData.occlZ
-				sampleData.occlZ = D;
-				m_OcclusionTree.setSampleDepth(D, sampleData.occlusionIndex);
+				setOccludingDepth(pie2, index, D);
 				// In this special case, we don't actually have to store the
 				// hit since the depth is greater than the occluding surface,
 				// so return early.
@@ -1519,24 +1594,18 @@ void CqBucketProcessor::StoreSample( CqMicroPolygon* pMPG, CqImagePixel* pie2, T
 			{
 				// view -->      |          |          |
 				// direc         D      hitPrevZ    sampleData.occlZ
-				sampleData.occlZ = hitPrevZ;
-				m_OcclusionTree.setSampleDepth(hitPrevZ, sampleData.occlusionIndex);
+				setOccludingDepth(pie2, index, hitPrevZ);
 			}
 		}
 		else
-		{
-			sampleData.occlZ = D;
-			m_OcclusionTree.setSampleDepth(D, sampleData.occlusionIndex);
-		}
+			setOccludingDepth(pie2, index, D);
 		hit->flags = SqImageSample::Flag_Valid;
 	}
 	else
 	{
 		// Otherwise create some new storage for the hit data in sample hit
-		// vector.
-		pie2->Values(index).push_back(SqImageSample());
-		hit = &pie2->Values(index).back();
-		pie2->allocateHitData(*hit);
+		// vector, which is kept sorted by depth.
+		hit = &pie2->insertHit(index, D);
 	}
 
 	// Compute the color and opacity of the micropolygon at the hit point.
@@ -1558,10 +1627,39 @@ void CqBucketProcessor::StoreSample( CqMicroPolygon* pMPG, CqImagePixel* pie2, T
 
 	// Update CSG pointer and flags.
 	hit->csgNode = pMPG->pGrid()->pCSGNode();
+	if(hit->csgNode)
+		pie2->markHasCSGHits();
 	hit->flags |= currentGridInfo.matteFlag;
 
 	// Mark the pixel as containing valid samples, used later for the cacheing and reuse.
 	pie2->markHasValidSamples();
+
+	// Drop any semitransparent hits which are now hidden.  If the hits in
+	// front become opaque enough, they occlude everything behind them just
+	// like an opaque surface would.  Note that this invalidates hit.
+	if(m_CurrentMpgSampleInfo.isOpacityCullable && !pie2->Values(index).empty())
+	{
+		TqFloat cullDepth = pie2->cullHiddenHits(index, m_optCache.oThreshold);
+		if(cullDepth < sampleData.occlZ)
+		{
+			setOccludingDepth(pie2, index, cullDepth);
+			pie2->occludingHit(index).flags = 0;
+		}
+	}
+}
+
+/** Set the occluding depth of a sample, and update the occlusion tree.
+ *
+ * When the pixel is sampled sparsely for adaptive sampling, the samples
+ * skipped in the stride block of the given sample are left at infinite depth
+ * until they're refined.  A sparse sample says nothing about what's visible
+ * at the skipped ones, for example through a gap narrower than the block.
+ */
+void CqBucketProcessor::setOccludingDepth(CqImagePixel* pie2, TqInt index, TqFloat depth)
+{
+	SqSampleData& sampleData = pie2->SampleData( index );
+	sampleData.occlZ = depth;
+	m_OcclusionTree.setSampleDepth(depth, sampleData.occlusionIndex);
 }
 
 
@@ -1638,54 +1736,140 @@ void CqBucketProcessor::StoreExtraData( CqMicroPolygon* pMPG, TqFloat* hitData)
 	}
 }
 
-void CqBucketProcessor::buildCacheSegment(SqBucketCacheSegment::EqBucketCacheSide side, boost::shared_ptr<SqBucketCacheSegment>& seg)
+CqRegion CqBucketProcessor::borderRasterRegion(TqInt border) const
 {
-	CqRegion& segmentRegion = m_cacheRegions[side];
-
-	TqInt segRowLen = segmentRegion.width();
-	TqInt numPixels = segmentRegion.area();
-	seg->cache.resize(numPixels);
+	const CqRegion& region = m_borderRegions[border];
+	TqInt x = m_DataRegion.xMin();
+	TqInt y = m_DataRegion.yMin();
+	return CqRegion(region.xMin() + x, region.yMin() + y,
+			region.xMax() + x, region.yMax() + y);
+}
 
-	for(TqInt y = segmentRegion.yMin(), sy = 0, endY = segmentRegion.yMax(); y < endY; ++y, ++sy)
+TqInt CqBucketProcessor::borderConsumers(TqInt border) const
+{
+	// Offsets of the buckets overlapping each border part, terminated by a
+	// zero offset.
+	static const TqInt neighbourOffsets[Border_Last][4][2] = {
+		{ {-1, 0}, {0, 0} },                    // Border_Left
+		{ {1, 0}, {0, 0} },                     // Border_Right
+		{ {0, -1}, {0, 0} },                    // Border_Top
+		{ {0, 1}, {0, 0} },                     // Border_Bottom
+		{ {-1, 0}, {0, -1}, {-1, -1}, {0, 0} }, // Border_TopLeft
+		{ {1, 0}, {0, -1}, {1, -1}, {0, 0} },   // Border_TopRight
+		{ {-1, 0}, {0, 1}, {-1, 1}, {0, 0} },   // Border_BottomLeft
+		{ {1, 0}, {0, 1}, {1, 1}, {0, 0} }      // Border_BottomRight
+	};
+	TqInt consumers = 0;
+	for(TqInt i = 0; i < 4; ++i)
 	{
-		for(TqInt x = segmentRegion.xMin(), sx = 0, endX = segmentRegion.xMax(); x < endX; ++x, ++sx)
-		{
-			TqInt which = (y*m_DataRegion.width())+x;
-			seg->cache[(sy*segRowLen)+sx] = m_aieImage[which];
-			m_aieImage[which] = m_pixelPool.allocate();
-		}
+		const TqInt* offset = neighbourOffsets[border][i];
+		if(offset[0] == 0 && offset[1] == 0)
+			break;
+		const CqBucket* neighbour = m_imageBuf.neighbour(*m_bucket,
+				offset[0], offset[1]);
+		if(neighbour && !neighbour->IsProcessed())
+			++consumers;
 	}
+	return consumers;
 }
 
-void CqBucketProcessor::applyCacheSegment(SqBucketCacheSegment::EqBucketCacheSide side, const boost::shared_ptr<SqBucketCacheSegment>& seg)
+/** Find the border parts of the bucket which have already been sampled by a
+ * neighbouring bucket.
+ */
+void CqBucketProcessor::findSharedTiles()
 {
-	CqRegion& segmentRegion = m_cacheRegions[side];
-	TqInt segRowLen = segmentRegion.width();
+	const CqSampleTileStore& store = m_imageBuf.sampleTiles();
+	for(TqInt border = 0; border < Border_Last; ++border)
+	{
+		m_sharedTiles[border] = 0;
+		m_sharedTilesInUse[border] = false;
+		if(m_borderRegions[border].area() > 0)
+			m_sharedTiles[border] = store.find(borderRasterRegion(border));
+	}
+}
 
-	for(TqInt y = segmentRegion.yMin(), sy = 0, endY = segmentRegion.yMax(); y < endY; ++y, ++sy)
+/** Use the pixels of the shared tiles found by findSharedTiles() in place of
+ * the pixels of this bucket.
+ *
+ * A tile is only used if it lies outside the sample region.  This may not be
+ * the case for a corner which was shared by a diagonal neighbour without the
+ * adjacent edges; the corner is then sampled again as usual.
+ */
+void CqBucketProcessor::useSharedTiles()
+{
+	TqInt rowLen = m_DataRegion.width();
+	for(TqInt border = 0; border < Border_Last; ++border)
 	{
-		for(TqInt x = segmentRegion.xMin(), sx = 0, endX = segmentRegion.xMax(); x < endX; ++x, ++sx)
+		const std::vector<CqImagePixelPtr>* tile = m_sharedTiles[border];
+		if(!tile)
+			continue;
+		CqRegion rasterRegion = borderRasterRegion(border);
+		if(rasterRegion.xMax() > m_SampleRegion.xMin()
+			&& rasterRegion.xMin() < m_SampleRegion.xMax()
+			&& rasterRegion.yMax() > m_SampleRegion.yMin()
+			&& rasterRegion.yMin() < m_SampleRegion.yMax())
+			continue;
+
+		const CqRegion& region = m_borderRegions[border];
+		std::vector<CqImagePixelPtr>::const_iterator tilePixel = tile->begin();
+		for(TqInt y = region.yMin(), endY = region.yMax(); y < endY; ++y)
 		{
-			TqInt which = (y*m_DataRegion.width())+x;
-			m_pixelPool.free(m_aieImage[which]);
-			m_aieImage[which] = seg->cache[(sy*segRowLen)+sx];
-			m_hasValidSamples |= m_aieImage[which]->hasValidSamples();
+			for(TqInt x = region.xMin(), endX = region.xMax(); x < endX; ++x)
+			{
+				TqInt which = (y*rowLen)+x;
+				m_pixelPool.free(m_aieImage[which]);
+				m_aieImage[which] = *tilePixel++;
+				m_hasValidSamples |= m_aieImage[which]->hasValidSamples();
+			}
 		}
+		m_sharedTilesInUse[border] = true;
 	}
 }
 
-
-void CqBucketProcessor::dropSegment(TqInt side)
+/** Share the border parts of the bucket with the unprocessed neighbouring
+ * buckets, and release the shared tiles used by this bucket.
+ */
+void CqBucketProcessor::shareBorderTiles()
 {
-	CqRegion& segmentRegion = m_cacheRegions[side]; 
-
-	for(TqInt y = segmentRegion.yMin(), sy = 0, endY = segmentRegion.yMax(); y < endY; ++y, ++sy)
+	CqSampleTileStore& store = m_imageBuf.sampleTiles();
+	TqInt rowLen = m_DataRegion.width();
+	std::vector<CqImagePixelPtr> tilePixels;
+	for(TqInt border = 0; border < Border_Last; ++border)
 	{
-		for(TqInt x = segmentRegion.xMin(), sx = 0, endX = segmentRegion.xMax(); x < endX; ++x, ++sx)
+		const CqRegion& region = m_borderRegions[border];
+		if(region.area() == 0)
+			continue;
+		CqRegion rasterRegion = borderRasterRegion(border);
+		bool inUse = m_sharedTilesInUse[border];
+		// A tile which wasn't found in preProcess() may have been shared
+		// since by a bucket processed at the same time as this one, in which
+		// case this bucket was counted as one of its consumers.
+		if(!store.release(rasterRegion) && !m_sharedTiles[border])
 		{
-			TqInt which = (y*m_DataRegion.width())+x;
-			m_aieImage[which] = m_pixelPool.allocate();
+			TqInt consumers = borderConsumers(border);
+			if(consumers == 0)
+				continue;
+			tilePixels.reserve(region.area());
+			for(TqInt y = region.yMin(), endY = region.yMax(); y < endY; ++y)
+			{
+				for(TqInt x = region.xMin(), endX = region.xMax(); x < endX; ++x)
+					tilePixels.push_back(m_aieImage[(y*rowLen)+x]);
+			}
+			store.publish(rasterRegion, tilePixels, consumers);
+			inUse = true;
+		}
+		if(inUse)
+		{
+			// The pixels now belong to the tile, so replace them with fresh
+			// ones for the next bucket.
+			for(TqInt y = region.yMin(), endY = region.yMax(); y < endY; ++y)
+			{
+				for(TqInt x = region.xMin(), endX = region.xMax(); x < endX; ++x)
+					m_aieImage[(y*rowLen)+x] = m_pixelPool.allocate();
+			}
 		}
+		m_sharedTiles[border] = 0;
+		m_sharedTilesInUse[border] = false;
 	}
 }
 
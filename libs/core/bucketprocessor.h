@@ -81,6 +81,14 @@ class CqBucketProcessor
 		 */
 		void postProcess();
 
+		/** Skip the bucket, which is unchanged since it was last rendered.
+		 *
+		 * The bucket is marked as processed without being rendered, and the
+		 * surfaces waiting in it are reposted to the other buckets they
+		 * cover.  DisplayRegion() is valid afterwards.
+		 */
+		void skipBucket();
+
 		//-------------- Reorganise -------------------------
 		
 		CqChannelBuffer& getChannelBuffer();
@@ -102,15 +110,37 @@ class CqBucketProcessor
 		//--------------------------------------------------
 		friend class CqSampleIterator;
 
+		void	setupRegions();
 		void	InitialiseFilterValues();
 		void	CalculateDofBounds();
+		void	setupLensSamples();
 		void	CombineElements();
 		void	FilterBucket();
+		void	gatherFilterSamples();
+		void	filterNonSeparable(TqInt datasize);
+		void	filterSeparable(TqInt datasize);
 		void	ExposeBucket();
 
-		void	buildCacheSegment(SqBucketCacheSegment::EqBucketCacheSide side, boost::shared_ptr<SqBucketCacheSegment>& seg);
-		void	applyCacheSegment(SqBucketCacheSegment::EqBucketCacheSide side, const boost::shared_ptr<SqBucketCacheSegment>& seg);
-		void	dropSegment(TqInt side);
+		/// Parts of the data region which overlap the neighbouring buckets.
+		enum EqBucketBorder
+		{
+			Border_Left = 0,
+			Border_Right,
+			Border_Top,
+			Border_Bottom,
+			Border_TopLeft,
+			Border_TopRight,
+			Border_BottomLeft,
+			Border_BottomRight,
+			Border_Last
+		};
+		/// Get the region of a border part in raster space.
+		CqRegion	borderRasterRegion(TqInt border) const;
+		/// Count the unprocessed buckets other than this which overlap a border part.
+		TqInt	borderConsumers(TqInt border) const;
+		void	findSharedTiles();
+		void	useSharedTiles();
+		void	shareBorderTiles();
 
 		void ImageElement( TqInt iXPos, TqInt iYPos, CqImagePixelPtr*& pie );
 
@@ -118,6 +148,10 @@ class CqBucketProcessor
 		/** Render any waiting MPs.
 		 */
 		void RenderWaitingMPs();
+		/** Refine the pixels whose sparse adaptive samples disagree, by
+		 * sampling the retained MPs again at the skipped sample positions.
+		 */
+		void refineAdaptiveSamples();
 		void RenderSurface( boost::shared_ptr<CqSurface>& surface);
 		void ImageElement( TqInt iXPos, TqInt iYPos, CqImagePixel*& pie ) const;
 		/** Render a particular micropolygon.
@@ -136,6 +170,7 @@ class CqBucketProcessor
 		void	StoreSample(CqMicroPolygon* pMPG, CqImagePixel* pie2, TqInt index,
 							TqFloat D, const CqVector2D& uv);
 		void	StoreExtraData( CqMicroPolygon* pMPG, TqFloat* hitData);
+		void	setOccludingDepth(CqImagePixel* pie2, TqInt index, TqFloat depth);
 		const CqBound& DofSubBound(TqInt index) const;
 
 		void setupCacheInformation();
@@ -156,11 +191,45 @@ class CqBucketProcessor
 		TqInt	m_NumDofBounds;
 
 		std::vector<CqBound>		m_DofBounds;
+		/// Lens stratum index data for a sample, copied from the pixel.
+		struct SqLensSample
+		{
+			CqVector2D position;  ///< Sample position
+			CqVector2D dofOffset; ///< DoF lens offset
+			TqFloat time;         ///< Sample time
+			TqInt index;          ///< Index of the sample within the pixel
+		};
+		/** \brief Samples of each pixel grouped by their DoF lens stratum.
+		 *
+		 * The samples of stratum i lie in the i'th block of m_aieImage.size()
+		 * entries, in the same order as m_aieImage, so that the samples which
+		 * can be reached by a micropolygon through one range of lens positions
+		 * are contiguous in memory.
+		 */
+		std::vector<SqLensSample>	m_lensSamples;
 		std::vector<CqImagePixelPtr>	m_aieImage;
 		CqPixelPool m_pixelPool;
 
-		/// Vector of precalculated filter weights
+		/// Vector of precalculated filter weights, one per subpixel under the filter.
 		std::vector<TqFloat>	m_aFilterValues;
+		/// Factors of m_aFilterValues in x and y, valid for separable filters.
+		std::vector<TqFloat>	m_xFilterValues;
+		std::vector<TqFloat>	m_yFilterValues;
+		/// Sum of the filter weights, used to normalise the filtered samples.
+		TqFloat	m_filterWeightTotal;
+		/// True if the filter can be applied in two one-dimensional passes.
+		bool	m_filterSeparable;
+		/// Occluding hit data for each subpixel under the filter, or null if empty.
+		std::vector<const TqFloat*>	m_filterSampleData;
+		/// Intermediate results of the x pass for separable filters.
+		std::vector<TqFloat>	m_filterRowSamples;
+		std::vector<TqInt>	m_filterRowCounts;
+		/// Unnormalised filtered samples and sample counts for each display pixel.
+		std::vector<TqFloat>	m_filteredSamples;
+		std::vector<TqInt>	m_filteredCounts;
+
+		/// Micropolygons retained for the refinement pass of adaptive sampling.
+		std::vector<boost::shared_ptr<CqMicroPolygon> > m_adaptiveMPs;
 
 		SqMpgSampleInfo m_CurrentMpgSampleInfo;
 
@@ -178,7 +247,12 @@ class CqBucketProcessor
 
 		CqChannelBuffer	m_channelBuffer;
 
-		boost::array<CqRegion, SqBucketCacheSegment::last> m_cacheRegions;
+		/// Regions of the border parts, relative to the data region.
+		boost::array<CqRegion, Border_Last> m_borderRegions;
+		/// Pixels of the border parts already sampled by a neighbouring bucket.
+		boost::array<const std::vector<CqImagePixelPtr>*, Border_Last> m_sharedTiles;
+		/// Whether the pixels of a shared tile are used in place of our own.
+		boost::array<bool, Border_Last> m_sharedTilesInUse;
 };
 
 
@@ -26,6 +26,8 @@
 #include	"csgtree.h"
 #include	"imagepixel.h"
 
+#include	<aqsis/util/logging.h>
+
 namespace Aqsis {
 
 bool CqCSGTreeNode::m_bCSGRequired = false;
@@ -154,6 +156,151 @@ void CqCSGTreeNode::ProcessTree( std::vector<SqImageSample>& samples )
 }
 
 
+//------------------------------------------------------------------------------
+/**
+ *	Compile the tree below this node for fast evaluation by resolveHits().
+ *	Trees with too many nodes are left uncompiled, and are resolved by the
+ *	general ProcessTree() instead.
+ */
+void CqCSGTreeNode::compileTree()
+{
+	boost::shared_ptr<SqCSGCompiledTree> tree( new SqCSGCompiledTree );
+	TqInt nextBit = 0;
+	tree->root = compileNode( *tree, nextBit );
+	if ( !tree->root )
+	{
+		Aqsis::log() << debug << "CSG tree too large to compile, using slow CSG evaluation" << std::endl;
+		tree.reset();
+	}
+	setCompiledTree( tree );
+}
+
+
+//------------------------------------------------------------------------------
+/**
+ *	Assign bits to this node and its children in post-order, and add the
+ *	operations to the compiled tree.
+ *
+ *	@param	tree	Compiled tree to add operations to.
+ *	@param	nextBit	Index of the next bit to assign.
+ *
+ *	@return			The bit assigned to this node, or 0 if there are too many nodes.
+ */
+boost::uint64_t CqCSGTreeNode::compileNode( SqCSGCompiledTree& tree, TqInt& nextBit )
+{
+	SqCSGCompiledTree::SqOperation op;
+	op.type = NodeType();
+	op.children = 0;
+	op.firstChild = 0;
+	if ( NodeType() != CSGNodeType_Primitive )
+	{
+		std::list<boost::weak_ptr<CqCSGTreeNode> >::const_iterator
+		ii = lChildren().begin(), ie = lChildren().end();
+		for (; ii != ie; ++ii)
+		{
+			boost::uint64_t childBit = 0;
+			if ( boost::shared_ptr<CqCSGTreeNode> pChild = ii->lock() )
+				childBit = pChild->compileNode( tree, nextBit );
+			else if ( nextBit < SqCSGCompiledTree::maxNodes )
+			{
+				// A child which no longer exists is never entered, but
+				// still counts towards the state of the operation.
+				childBit = boost::uint64_t( 1 ) << nextBit++;
+			}
+			if ( !childBit )
+				return ( 0 );
+			if ( !op.children )
+				op.firstChild = childBit;
+			op.children |= childBit;
+		}
+	}
+	if ( nextBit >= SqCSGCompiledTree::maxNodes )
+		return ( 0 );
+	m_compiledBit = boost::uint64_t( 1 ) << nextBit++;
+	if ( NodeType() != CSGNodeType_Primitive )
+	{
+		op.bit = m_compiledBit;
+		tree.operations.push_back( op );
+	}
+	return ( m_compiledBit );
+}
+
+
+//------------------------------------------------------------------------------
+/**
+ *	Share the compiled tree with this node and all its children.
+ */
+void CqCSGTreeNode::setCompiledTree( const boost::shared_ptr<const SqCSGCompiledTree>& tree )
+{
+	m_compiledTree = tree;
+	if ( NodeType() == CSGNodeType_Primitive )
+		return;
+	std::list<boost::weak_ptr<CqCSGTreeNode> >::const_iterator
+	ii = lChildren().begin(), ie = lChildren().end();
+	for (; ii != ie; ++ii)
+	{
+		if ( boost::shared_ptr<CqCSGTreeNode> pChild = ii->lock() )
+			pChild->setCompiledTree( tree );
+	}
+}
+
+
+//------------------------------------------------------------------------------
+/**
+ *	Resolve the CSG trees for a depth sorted list of samples.
+ *	For each tree, the samples are scanned from front to back while toggling
+ *	the bits of the primitives they belong to, so the mask holds the
+ *	primitives containing the current point, assuming the camera starts
+ *	outside all solids.  A sample is kept only where it changes whether the
+ *	point is inside the resulting solid.
+ *
+ *	@param	samples	Array of samples to resolve.
+ */
+void CqCSGTreeNode::resolveHits( std::vector<SqImageSample>& samples )
+{
+	TqInt first = 0;
+	while ( true )
+	{
+		// Find the first sample in a tree which hasn't been resolved yet.
+		TqInt numSamples = samples.size();
+		while ( first < numSamples && !samples[first].csgNode )
+			++first;
+		if ( first == numSamples )
+			return;
+
+		const SqCSGCompiledTree* tree = samples[first].csgNode->m_compiledTree.get();
+		if ( !tree )
+		{
+			samples[first].csgNode->ProcessTree( samples );
+			first = 0;
+			continue;
+		}
+
+		// Compact the surviving samples in place.
+		boost::uint64_t inside = 0;
+		bool isInside = false;
+		TqInt out = first;
+		for ( TqInt i = first; i < numSamples; ++i )
+		{
+			const CqCSGTreeNode* node = samples[i].csgNode.get();
+			if ( node && node->m_compiledTree.get() == tree )
+			{
+				inside ^= node->m_compiledBit;
+				bool newIsInside = tree->isInside( inside );
+				if ( newIsInside == isInside )
+					continue;
+				isInside = newIsInside;
+				samples[i].csgNode.reset();
+			}
+			if ( out != i )
+				samples[out] = samples[i];
+			++out;
+		}
+		samples.erase( samples.begin() + out, samples.end() );
+	}
+}
+
+
 //------------------------------------------------------------------------------
 /**
  *	Pass the sample list through the CSG node.
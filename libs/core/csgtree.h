@@ -32,6 +32,7 @@
 #include	<vector>
 #include	<list>
 
+#include	<boost/cstdint.hpp>
 #include	<boost/weak_ptr.hpp>
 #include	<boost/shared_ptr.hpp>
 #include	<boost/enable_shared_from_this.hpp>
@@ -41,6 +42,7 @@
 namespace Aqsis {
 
 struct SqImageSample;
+struct SqCSGCompiledTree;
 
 
 //------------------------------------------------------------------------------
@@ -54,6 +56,7 @@ class CqCSGTreeNode : public boost::enable_shared_from_this<CqCSGTreeNode>
 		/** Default constructor.
 		 */
 		CqCSGTreeNode()
+			: m_compiledBit(0)
 		{}
 		virtual	~CqCSGTreeNode();
 
@@ -111,13 +114,30 @@ class CqCSGTreeNode : public boost::enable_shared_from_this<CqCSGTreeNode>
 
 		void	ProcessTree( std::vector<SqImageSample>& samples );
 
+		/** Compile the tree below this node into the compact form used by
+		 *  resolveHits().  Call on the root node once the tree is complete.
+		 */
+		void	compileTree();
+		/** Resolve the CSG operations for a depth sorted list of samples.
+		 *  Samples which aren't on the surface of the resulting solids are
+		 *  removed, and the CSG node of the rest is cleared.  Each tree is
+		 *  resolved in place in a single front to back pass, tracking the
+		 *  primitives which contain the current point with a bitmask.
+		 */
+		static void resolveHits( std::vector<SqImageSample>& samples );
+
 		static boost::shared_ptr<CqCSGTreeNode> CreateNode( CqString& type );
 		static bool IsRequired();
 		static void SetRequired(bool value);
 
 
 	private:
+		boost::uint64_t	compileNode( SqCSGCompiledTree& tree, TqInt& nextBit );
+		void	setCompiledTree( const boost::shared_ptr<const SqCSGCompiledTree>& tree );
+
 		boost::shared_ptr<CqCSGTreeNode>	m_pParent;		///< Pointer to the parent CSG node.
+		boost::shared_ptr<const SqCSGCompiledTree>	m_compiledTree;	///< Compiled form of the tree containing this node, if any.
+		boost::uint64_t	m_compiledBit;	///< Bit for this node in the compiled tree.
 		std::list<boost::weak_ptr<CqCSGTreeNode> >	m_lChildren;	///< List of children nodes.
 		static bool m_bCSGRequired;    ///< Tell imagebuffer the processing for CSG is not required
 }
@@ -261,6 +281,71 @@ class CqCSGNodeDifference : public CqCSGTreeNode
 };
 
 
+//------------------------------------------------------------------------------
+/**
+ *	Compact form of a CSG tree for fast evaluation.
+ *	Each node of the tree is assigned a bit, in post-order so that children
+ *	come before their parents.  Given a mask with the bits of the primitives
+ *	containing a point set, the state of each operation node can then be
+ *	evaluated in turn, finishing at the root.
+ */
+struct SqCSGCompiledTree
+{
+	/// Maximum number of nodes in a tree which can be compiled.
+	static const TqInt maxNodes = 64;
+
+	struct SqOperation
+	{
+		CqCSGTreeNode::EqCSGNodeType type;	///< Type of the operation.
+		boost::uint64_t bit;		///< Bit representing the node.
+		boost::uint64_t children;	///< Bits of all the children of the node.
+		boost::uint64_t firstChild;	///< Bit of the first child of the node.
+	};
+
+	/// Operation nodes of the tree, in post-order.
+	std::vector<SqOperation> operations;
+	/// Bit representing the root of the tree.
+	boost::uint64_t root;
+
+	/** Determine whether a point is inside the solid.
+	 *
+	 *	@param	inside	Mask of the primitives containing the point.
+	 */
+	bool	isInside( boost::uint64_t inside ) const;
+};
+
+
+//-----------------------------------------------------------------------
+// Implementation details
+//-----------------------------------------------------------------------
+
+inline bool SqCSGCompiledTree::isInside( boost::uint64_t inside ) const
+{
+	for ( std::vector<SqOperation>::const_iterator op = operations.begin();
+	        op != operations.end(); ++op )
+	{
+		boost::uint64_t children = inside & op->children;
+		bool isIn = false;
+		switch ( op->type )
+		{
+			case CqCSGTreeNode::CSGNodeType_Union:
+				isIn = children != 0;
+				break;
+			case CqCSGTreeNode::CSGNodeType_Intersection:
+				isIn = children == op->children;
+				break;
+			case CqCSGTreeNode::CSGNodeType_Difference:
+				isIn = ( children & op->firstChild ) && !( children & ~op->firstChild );
+				break;
+			default:
+				break;
+		}
+		if ( isIn )
+			inside |= op->bit;
+	}
+	return ( inside & root ) != 0;
+}
+
 //-----------------------------------------------------------------------
 
 } // namespace Aqsis
@@ -164,12 +164,34 @@ TqInt CqDDManager::DisplayBucket( const CqRegion& DRegion, const IqChannelBuffer
 	std::vector< boost::shared_ptr<CqDisplayRequest> >::iterator i;
 	for ( i = m_displayRequests.begin(); i != m_displayRequests.end(); ++i )
 	{
-		(*i)->DisplayBucket(DRegion, pBuffer);
+		if ( !m_preview || (*i)->isInteractive() )
+			(*i)->DisplayBucket(DRegion, pBuffer);
 	}
 	return ( 0 );
 
 }
 
+void CqDDManager::SetPreview( bool preview )
+{
+	m_preview = preview;
+}
+
+bool CqDDManager::isPreview() const
+{
+	return m_preview;
+}
+
+bool CqDDManager::fDisplayInteractive()
+{
+	std::vector< boost::shared_ptr<CqDisplayRequest> >::iterator i;
+	for ( i = m_displayRequests.begin(); i != m_displayRequests.end(); ++i )
+	{
+		if ( (*i)->isInteractive() )
+			return ( true );
+	}
+	return ( false );
+}
+
 bool CqDDManager::fDisplayNeeds( const TqChar* var )
 {
 	static TqUlong rgb = CqString::hash( "rgb" );
@@ -624,6 +646,7 @@ void CqDisplayRequest::LoadDisplayLibrary( SqDDMemberData& ddMemberData, CqSimpl
 			}
 		}
 
+		m_interactive = false;
 		if ( NULL != m_QueryMethod )
 		{
 			PtDspySizeInfo size;
@@ -632,6 +655,7 @@ void CqDisplayRequest::LoadDisplayLibrary( SqDDMemberData& ddMemberData, CqSimpl
 			owinfo.interactive = 0;
 			owinfo.overwrite = 1;
 			err = (*m_QueryMethod)(m_imageHandle, PkOverwriteQuery, sizeof(owinfo), &owinfo);
+			m_interactive = err == PkDspyErrorNone && owinfo.interactive && owinfo.overwrite;
 		}
 	}
 }
@@ -950,6 +974,17 @@ void CqDisplayRequest::PrepareSystemParameters()
 	ConstructIntsParameter("origin", origin, 2, parameter);
 	m_customParams.push_back(parameter);
 
+	// "BucketSize", so that displays writing tiled files can match their
+	// tiles to the buckets.
+	TqInt bucketSize[2] = { 16, 16 };
+	if(const TqInt* size = QGetRenderContext()->poptCurrent()->GetIntegerOption( "limits", "bucketsize" ))
+	{
+		bucketSize[0] = size[0];
+		bucketSize[1] = size[1];
+	}
+	ConstructIntsParameter("BucketSize", bucketSize, 2, parameter);
+	m_customParams.push_back(parameter);
+
 	// "PixelAspectRatio"
 	TqFloat PixelAspectRatio = QGetRenderContext() ->poptCurrent()->GetFloatOption( "System", "PixelAspectRatio" ) [ 0 ];
 	ConstructFloatsParameter("PixelAspectRatio", &PixelAspectRatio, 1, parameter);
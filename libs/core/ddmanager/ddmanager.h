@@ -101,7 +101,7 @@ class CqDisplayRequest : public IqDisplayRequest
 				m_modeHash(modeHash), m_modeID(modeID), m_AOVOffset(dataOffset),
 				m_AOVSize(dataSize), m_QuantizeZeroVal(quantizeZeroVal), m_QuantizeOneVal(quantizeOneVal),
 				m_QuantizeMinVal(quantizeMinVal), m_QuantizeMaxVal(quantizeMaxVal), m_QuantizeDitherVal(quantizeDitherVal), m_QuantizeSpecified(quantizeSpecified), m_QuantizeDitherSpecified(quantizeDitherSpecified),
-				m_isLoaded(false)
+				m_isLoaded(false), m_interactive(false)
 		{}
 		virtual ~CqDisplayRequest();
 
@@ -129,6 +129,10 @@ class CqDisplayRequest : public IqDisplayRequest
 		 * to override.
 		 */
 		virtual void DisplayBucket( const CqRegion& DRegion, const IqChannelBuffer* pBuffer);
+		/* Query if the display can replace regions of the image it has
+		 * already been sent, so may be sent a preview.
+		 */
+		bool isInteractive() const;
 
 		//----------------------------------------------
 		// Pure virtual functions
@@ -181,6 +185,7 @@ class CqDisplayRequest : public IqDisplayRequest
 		DspyImageCloseMethod		m_CloseMethod;
 		DspyImageDelayCloseMethod	m_DelayCloseMethod;
 		bool			m_isLoaded;
+		bool			m_interactive;
 
 		/// \todo Some of the instance data from SqDisplayRequest
 		//  should be split out into a new structure,
@@ -237,7 +242,7 @@ class CqDeepDisplayRequest : virtual public CqDisplayRequest
 class CqDDManager : public IqDDManager
 {
 	public:
-		CqDDManager() : m_Uses(0)
+		CqDDManager() : m_Uses(0), m_preview(false)
 		{}
 		virtual ~CqDDManager()
 		{}
@@ -261,6 +266,9 @@ class CqDDManager : public IqDDManager
 		virtual	TqInt	OpenDisplays(TqInt width, TqInt height);
 		virtual	TqInt	CloseDisplays();
 		virtual	TqInt	DisplayBucket( const CqRegion& DRegion, const IqChannelBuffer* pBucket );
+		virtual	void	SetPreview( bool preview );
+		virtual	bool	isPreview() const;
+		virtual	bool	fDisplayInteractive();
 		virtual	bool	fDisplayNeeds( const TqChar* var );
 		virtual	TqInt	Uses();
 
@@ -270,6 +278,7 @@ class CqDDManager : public IqDDManager
 		static SqDDMemberData m_MemberData;
 		CqSimplePlugin m_DspyPlugin;
 		TqInt 	m_Uses;
+		bool	m_preview;	///< Only send buckets to interactive displays.
 };
 
 
@@ -292,6 +301,12 @@ bool CqDisplayRequest::isLoaded() const
 	return m_isLoaded;
 }
 
+bool CqDisplayRequest::isInteractive() const
+{
+	// Displays which collect scanlines can't take a second copy of a bucket.
+	return m_interactive && !(m_flags.flags & PkDspyFlagsWantsScanLineOrder);
+}
+
 TqInt CqDDManager::numDisplayRequests()
 {
 	return m_displayRequests.size();
@@ -96,6 +96,16 @@ struct IqDDManager
 	/** Display a bucket.
 	 */
 	virtual	TqInt	DisplayBucket( const CqRegion& DRegion, const IqChannelBuffer* pBuffer ) = 0;
+	/** Send buckets only to the interactive displays, which will have them
+	 *  replaced by later buckets covering the same region.
+	 */
+	virtual	void	SetPreview( bool preview ) = 0;
+	/** Determine if buckets are only being sent to the interactive displays.
+	 */
+	virtual	bool	isPreview() const = 0;
+	/** Determine if any of the open displays can show a preview of the image.
+	 */
+	virtual bool	fDisplayInteractive() = 0;
 	/** Determine if any of the displays need the named shader variable.
 	 */
 	virtual bool	fDisplayNeeds( const TqChar* var) = 0;
@@ -627,7 +627,7 @@ CqCubicCurvesGroup::CqCubicCurvesGroup(
 	m_ncurves = ncurves;
 	m_periodic = periodic;
 
-	const TqInt vStep = pAttributes()->GetIntegerAttribute("System", "BasisStep")[1];
+	const TqInt vStep = attributeCache().basisStep[1];
 	// add up the total number of vertices
 	m_nTotalVerts = 0;
 	TqInt i;
@@ -683,7 +683,7 @@ CqParameter* CqCubicCurvesGroup::convertToBezierBasis(CqParameter* param)
 			inParam->CloneType(inParam->strName().c_str(), arrSize));
 	newParam->SetSize(m_nVertsBezier);
 	// Step between cubic curve segments in current basis.
-	const TqInt vStep = pAttributes()->GetIntegerAttribute("System", "BasisStep")[1];
+	const TqInt vStep = attributeCache().basisStep[1];
 	// Vertex index to the start of the current curve
 	TqInt currCurveStart = 0;
 	// Index into the full parameter array for the converted output vertices.
@@ -789,7 +789,7 @@ void CqCubicCurvesGroup::AddPrimitiveVariable(CqParameter* param)
 TqUint CqCubicCurvesGroup::cVarying() const
 {
 
-	TqInt vStep = pAttributes() ->GetIntegerAttribute( "System", "BasisStep" ) [ 1 ];
+	TqInt vStep = attributeCache().basisStep[ 1 ];
 	TqUint varying_count = 0;
 	TqInt i;
 
@@ -846,7 +846,7 @@ TqInt CqCubicCurvesGroup::Split(
 
 	// number of points to skip between curves
 	TqInt vStep =
-	    pAttributes() ->GetIntegerAttribute( "System", "BasisStep" ) [ 1 ];
+	    attributeCache().basisStep[ 1 ];
 
 	// information about which parameters are used
 	TqInt bUses = Uses();
@@ -288,7 +288,7 @@ bool CqCurve::GetNormal( TqInt index, CqVector3D& normal ) const
 	else
 	{
 		bool CSO = pTransform()->GetHandedness(pTransform()->Time(0));
-		bool O = pAttributes() ->GetIntegerAttribute( "System", "Orientation" ) [ 0 ] != 0;
+		bool O = attributeCache().orientation;
 		if ( (O && CSO) || (!O && !CSO) )
 			normal = CqVector3D(0, 0, -1);
 		else
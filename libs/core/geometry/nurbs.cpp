@@ -1534,7 +1534,7 @@ void CqSurfaceNURBS::GenerateGeometricNormals( TqInt uDiceSize, TqInt vDiceSize,
 	assert( NULL != P() );
 
 	bool CSO = pTransform()->GetHandedness(pTransform()->Time(0));
-	bool O = pAttributes() ->GetIntegerAttribute( "System", "Orientation" ) [ 0 ] != 0;
+	bool O = attributeCache().orientation;
 
 	CqVector3D	N;
 	CqVector4D P;
@@ -1714,8 +1714,7 @@ bool	CqSurfaceNURBS::Diceable(const CqMatrix& matCtoR)
 	m_vDiceSize = max<TqInt>(lround(MaxvLen), 1);
 
 	// Ensure power of 2 to avoid cracking
-	const TqInt *binary = pAttributes() ->GetIntegerAttribute( "dice", "binary" );
-	if ( binary && *binary)
+	if ( attributeCache().diceBinary )
 	{
 		m_uDiceSize = ceilPow2( m_uDiceSize );
 		m_vDiceSize = ceilPow2( m_vDiceSize );
@@ -1981,7 +1980,7 @@ void CqSurfaceNURBS::SetDefaultPrimitiveVariables( bool bUseDef_st )
 		}
 	}
 
-	const TqFloat* pTC = pAttributes() ->GetFloatAttribute( "System", "TextureCoordinates" );
+	const TqFloat* pTC = attributeCache().textureCoordinates;
 	CqVector2D st1( pTC[ 0 ], pTC[ 1 ] );
 	CqVector2D st2( pTC[ 2 ], pTC[ 3 ] );
 	CqVector2D st3( pTC[ 4 ], pTC[ 5 ] );
@@ -353,8 +353,7 @@ bool	CqSurfacePatchBicubic::Diceable(const CqMatrix& matCtoR)
 	m_vDiceSize = max<TqInt>(lround( vLen ), 1);
 
 	// Ensure power of 2 to avoid cracking
-	const TqInt *binary = pAttributes() ->GetIntegerAttribute( "dice", "binary" );
-	if ( binary && *binary)
+	if ( attributeCache().diceBinary )
 	{
 		m_uDiceSize = ceilPow2( m_uDiceSize );
 		m_vDiceSize = ceilPow2( m_vDiceSize );
@@ -710,8 +709,7 @@ bool	CqSurfacePatchBilinear::Diceable(const CqMatrix& matCtoR)
 	m_vDiceSize = static_cast<TqInt>( vLen );
 
 	// Ensure power of 2 to avoid cracking
-	const TqInt *binary = pAttributes() ->GetIntegerAttribute( "dice", "binary" );
-	if ( binary && *binary)
+	if ( attributeCache().diceBinary )
 	{
 		m_uDiceSize = ceilPow2( m_uDiceSize );
 		m_vDiceSize = ceilPow2( m_vDiceSize );
@@ -972,15 +970,15 @@ void CqSurfacePatchMeshBicubic::SplitInternally()
 
 	CqVector4D vecPoint;
 	TqInt iP = 0;
-	TqInt uStep = pAttributes() ->GetIntegerAttribute( "System", "BasisStep" ) [ 0 ];
-	TqInt vStep = pAttributes() ->GetIntegerAttribute( "System", "BasisStep" ) [ 1 ];
+	TqInt uStep = attributeCache().basisStep[ 0 ];
+	TqInt vStep = attributeCache().basisStep[ 1 ];
 
 	TqInt nvaryingu = ( m_uPeriodic ) ? m_uPatches : m_uPatches + 1;
 	TqInt nvaryingv = ( m_vPeriodic ) ? m_vPatches : m_vPatches + 1;
 
 	TqInt MyUses = Uses();
 
-	const TqFloat* pTC = pAttributes() ->GetFloatAttribute( "System", "TextureCoordinates" );
+	const TqFloat* pTC = attributeCache().textureCoordinates;
 	CqVector2D st1( pTC[ 0 ], pTC[ 1 ] );
 	CqVector2D st2( pTC[ 2 ], pTC[ 3 ] );
 	CqVector2D st3( pTC[ 4 ], pTC[ 5 ] );
@@ -1203,7 +1201,7 @@ TqInt CqSurfacePatchMeshBilinear::Split( std::vector<boost::shared_ptr<CqSurface
 	RtInt iP = 0;
 	TqInt MyUses = Uses();
 
-	const TqFloat* pTC = pAttributes() ->GetFloatAttribute( "System", "TextureCoordinates" );
+	const TqFloat* pTC = attributeCache().textureCoordinates;
 	CqVector2D st1( pTC[ 0 ], pTC[ 1 ] );
 	CqVector2D st2( pTC[ 2 ], pTC[ 3 ] );
 	CqVector2D st3( pTC[ 4 ], pTC[ 5 ] );
@@ -160,20 +160,16 @@ CqMicroPolyGridBase* CqPoints::Dice()
 	{
 		if ( pPoints()->bHasVar(EnvVars_Cs) )
 			NaturalDice( pPoints()->Cs(), nVertices(), 1, pGrid->pVar(EnvVars_Cs) );
-		else if ( NULL != pAttributes() ->GetColorAttribute( "System", "Color" ) )
-			pGrid->pVar(EnvVars_Cs) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Color" ) [ 0 ] );
 		else
-			pGrid->pVar(EnvVars_Cs) ->SetColor( CqColor( 1, 1, 1 ) );
+			pGrid->pVar(EnvVars_Cs) ->SetColor( attributeCache().color );
 	}
 
 	if ( USES( lUses, EnvVars_Os ) && ( NULL != pGrid->pVar(EnvVars_Os) ) )
 	{
 		if ( pPoints()->bHasVar(EnvVars_Os) )
 			NaturalDice( pPoints()->Os(), nVertices(), 1, pGrid->pVar(EnvVars_Os) );
-		else if ( NULL != pAttributes() ->GetColorAttribute( "System", "Opacity" ) )
-			pGrid->pVar(EnvVars_Os) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Opacity" ) [ 0 ] );
 		else
-			pGrid->pVar(EnvVars_Os) ->SetColor( CqColor( 1, 1, 1 ) );
+			pGrid->pVar(EnvVars_Os) ->SetColor( attributeCache().opacity );
 	}
 
 	if ( USES( lUses, EnvVars_s ) && ( NULL != pGrid->pVar(EnvVars_s) ) && pPoints()->bHasVar(EnvVars_s) )
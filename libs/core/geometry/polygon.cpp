@@ -77,7 +77,7 @@ TqInt CqPolygonBase::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits
 	// primitives leave it up to the CalcNormals function on the MPGrid, because we
 	// are forcing N to be setup here, so clockwise nature is important.
 	bool CSO = pTransform()->GetHandedness(pTransform()->Time(0));
-	bool O = pAttributes() ->GetIntegerAttribute( "System", "Orientation" ) [ 0 ] != 0;
+	bool O = Surface().attributeCache().orientation;
 
 	indexA = 0;
 	indexB = 1;
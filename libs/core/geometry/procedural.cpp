@@ -113,6 +113,22 @@ void    CqProcedural::Transform( const CqMatrix& matTx, const CqMatrix& matITTx,
 }
 
 
+/**
+ * Clone the procedural.  The clone shares the procedural data with the
+ * original, which must outlive it as only the original frees the data.
+ */
+CqSurface* CqProcedural::Clone() const
+{
+	CqProcedural* clone = new CqProcedural();
+	CqSurface::CloneData( clone );
+	clone->m_Bound = m_Bound;
+	clone->m_pconStored = m_pconStored;
+	clone->m_pData = m_pData;
+	clone->m_pSubdivFunc = m_pSubdivFunc;
+	clone->m_pFreeFunc = 0;
+	return ( clone );
+}
+
 /**
  * CqProcedural destructor.
  */
@@ -106,11 +106,7 @@ class CqProcedural : public CqSurface
 		{
 			return ( 0 );
 		}
-		virtual CqSurface* Clone() const
-		{
-			//return(new CqProcedural(*this));
-			return(NULL);
-		}
+		virtual CqSurface* Clone() const;
 		//------------------------------------------------------ Protexted
 	protected:
 		/* Contexy saved when the Procedural was declared */
@@ -177,8 +177,7 @@ TqInt CqQuadric::DiceAll( CqMicroPolyGrid* pGrid )
 	// handedness of the current transformation here.  Instead we only need to
 	// consider the current orientation when deciding whether to flip the
 	// normals.
-	bool flipNormals = pAttributes()->
-		GetIntegerAttribute("System", "Orientation")[0] != 0;
+	bool flipNormals = attributeCache().orientation;
 
 	pGrid->pVar(EnvVars_P)->GetPointPtr(pointGrid);
 	pGrid->pVar(EnvVars_Ng)->GetNormalPtr(normalGrid);
@@ -335,8 +334,7 @@ TqUlong CqQuadric::EstimateGridSize(const CqMatrix& matCtoR)
 	m_vDiceSize = lceil(ESTIMATEGRIDSIZE * maxvsize/sqrtShadingRate);
 
 	// Ensure power of 2 to avoid cracking
-	const TqInt *binary = pAttributes() ->GetIntegerAttribute( "dice", "binary" );
-	if ( binary && *binary)
+	if ( attributeCache().diceBinary )
 	{
 		m_uDiceSize = ceilPow2( m_uDiceSize );
 		m_vDiceSize = ceilPow2( m_vDiceSize );
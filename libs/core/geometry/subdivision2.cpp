@@ -1917,18 +1917,12 @@ CqMicroPolyGridBase* CqSurfaceSubdivisionPatch::DiceExtract()
 		// If the color and opacity are not defined, use the system values.
 		if ( USES( lUses, EnvVars_Cs ) && !pTopology()->pPoints()->bHasVar(EnvVars_Cs) )
 		{
-			if ( pAttributes() ->GetColorAttribute( "System", "Color" ) )
-				pGrid->pVar(EnvVars_Cs) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Color" ) [ 0 ] );
-			else
-				pGrid->pVar(EnvVars_Cs) ->SetColor( CqColor( 1, 1, 1 ) );
+			pGrid->pVar(EnvVars_Cs) ->SetColor( attributeCache().color );
 		}
 
 		if ( USES( lUses, EnvVars_Os ) && !pTopology()->pPoints()->bHasVar(EnvVars_Os) )
 		{
-			if ( pAttributes() ->GetColorAttribute( "System", "Opacity" ) )
-				pGrid->pVar(EnvVars_Os) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Opacity" ) [ 0 ] );
-			else
-				pGrid->pVar(EnvVars_Os) ->SetColor( CqColor( 1, 1, 1 ) );
+			pGrid->pVar(EnvVars_Os) ->SetColor( attributeCache().opacity );
 		}
 		apGrids.push_back( pGrid );
 
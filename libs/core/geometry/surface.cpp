@@ -66,6 +66,47 @@ CqString CqSurface::strName() const
 }
 
 
+//---------------------------------------------------------------------
+/** Estimate the memory used by this surface, most of which is the storage for
+ * the primitive variables.  Values shared with clones are counted in full.
+ */
+
+CqStats::TqMemorySize CqSurface::memoryUsage() const
+{
+	CqStats::TqMemorySize bytes = sizeof(CqSurface);
+	for ( std::vector<CqParameter*>::const_iterator iUP = m_aUserParams.begin();
+			iUP != m_aUserParams.end(); ++iUP )
+	{
+		TqInt valueSize = sizeof(TqFloat);
+		switch ( ( *iUP )->Type() )
+		{
+			case type_point:
+			case type_color:
+			case type_triple:
+			case type_normal:
+			case type_vector:
+				valueSize = sizeof(CqVector3D);
+				break;
+			case type_hpoint:
+				valueSize = sizeof(CqVector4D);
+				break;
+			case type_matrix:
+			case type_sixteentuple:
+				valueSize = sizeof(CqMatrix);
+				break;
+			case type_string:
+				valueSize = sizeof(CqString);
+				break;
+			default:
+				break;
+		}
+		bytes += sizeof(CqParameter) + static_cast<CqStats::TqMemorySize>( ( *iUP )->Size() )
+			* ( *iUP )->Count() * valueSize;
+	}
+	return bytes;
+}
+
+
 //---------------------------------------------------------------------
 /** Work out which standard shader variables this surface requires by looking at the shaders.
  */
@@ -254,7 +295,7 @@ void CqSurface::SetDefaultPrimitiveVariables( bool bUseDef_st )
 		s() ->SetSize( 4 );
 		TqInt i;
 		for ( i = 0; i < 4; i++ )
-			s() ->pValue() [ i ] = m_pAttributes->GetFloatAttribute( "System", "TextureCoordinates" ) [ i * 2 ];
+			s() ->pValue() [ i ] = attributeCache().textureCoordinates[ i * 2 ];
 	}
 
 	if ( USES( bUses, EnvVars_t ) && bUseDef_st && !bHasVar(EnvVars_t))
@@ -263,7 +304,7 @@ void CqSurface::SetDefaultPrimitiveVariables( bool bUseDef_st )
 		t() ->SetSize( 4 );
 		TqInt i;
 		for ( i = 0; i < 4; i++ )
-			t() ->pValue() [ i ] = m_pAttributes->GetFloatAttribute( "System", "TextureCoordinates" ) [ ( i * 2 ) + 1 ];
+			t() ->pValue() [ i ] = attributeCache().textureCoordinates[ ( i * 2 ) + 1 ];
 	}
 
 	if ( USES( bUses, EnvVars_u ) )
@@ -483,18 +524,12 @@ CqMicroPolyGridBase* CqSurface::Dice()
 	// Special case handlers for primitive variables that have defaults.
 	if ( !isDONE( lDone, EnvVars_Cs ) && USES( lUses, EnvVars_Cs ) && ( NULL != pGrid->pVar(EnvVars_Cs) ) )
 	{
-		if ( NULL != pAttributes() ->GetColorAttribute( "System", "Color" ) )
-			pGrid->pVar(EnvVars_Cs) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Color" ) [ 0 ] );
-		else
-			pGrid->pVar(EnvVars_Cs) ->SetColor( CqColor( 1, 1, 1 ) );
+		pGrid->pVar(EnvVars_Cs) ->SetColor( attributeCache().color );
 	}
 
 	if ( !isDONE( lDone, EnvVars_Os ) && USES( lUses, EnvVars_Os ) && ( NULL != pGrid->pVar(EnvVars_Os) ) )
 	{
-		if ( NULL != pAttributes() ->GetColorAttribute( "System", "Opacity" ) )
-			pGrid->pVar(EnvVars_Os) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Opacity" ) [ 0 ] );
-		else
-			pGrid->pVar(EnvVars_Os) ->SetColor( CqColor( 1, 1, 1 ) );
+		pGrid->pVar(EnvVars_Os) ->SetColor( attributeCache().opacity );
 	}
 
 	// If the shaders need N and they have been explicitly specified, then bilinearly interpolate them.
@@ -689,9 +724,13 @@ static void transformCuboid(CqVector3D out[8], const CqVector3D in[8],
 
 TqFloat CqSurface::AdjustedShadingRate() const
 {
-	TqFloat shadingRate =
-		m_pAttributes->GetFloatAttribute("System", "ShadingRate")[0];
+	const SqAttributeCache& attrCache = attributeCache();
+	TqFloat shadingRate = attrCache.shadingRate;
 	CqRenderer* context = QGetRenderContext();
+	// Progressive previews are rendered with a coarser shading rate than
+	// was asked for.
+	if(const TqFloat* rateScale = context->GetFloatOption("System", "ShadingRateScale"))
+		shadingRate *= rateScale[0];
 	if(context->UsingDepthOfField())
 	{
 		// Adjust dice size with the CoC *area*.  This ensures that very blurry
@@ -701,8 +740,7 @@ TqFloat CqSurface::AdjustedShadingRate() const
 		//
 		// If this isn't included then render time increases roughly
 		// quadratically with number of pixels which makes things very slow.
-		const TqFloat focusFactor =
-			m_pAttributes->GetFloatAttribute("System", "GeometricFocusFactor")[0];
+		const TqFloat focusFactor = attrCache.focusFactor;
 		const TqFloat minCoC = context->MinCoCForBound(m_Bound);
 
 		// We need a factor which decides the desired ratio of the area of the
@@ -729,8 +767,7 @@ TqFloat CqSurface::AdjustedShadingRate() const
 	// Adjust shadingRate based on motionfactor
 
 	//get motionfactor variable from rib, camera transform
-	const TqFloat* motionFactor = m_pAttributes->GetFloatAttribute("System", "GeometricMotionFactor");
-	TqFloat motionFac = motionFactor[0];
+	TqFloat motionFac = attrCache.motionFactor;
 	CqTransformPtr cameraTransform = context->GetCameraTransform();
 
 	if (motionFac > 0.0 && (isMoving() || cameraTransform->isMoving() ) )
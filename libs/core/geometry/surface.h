@@ -89,6 +89,9 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 
 		virtual CqString	strName() const;
 		virtual	TqInt	Uses() const;
+		/** Get an estimate of the number of bytes used by this surface.
+		 */
+		CqStats::TqMemorySize	memoryUsage() const;
 
 		/**
 		* \todo Review: Unused parameter pGrid
@@ -131,6 +134,13 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 		{
 			return ( m_pAttributes );
 		}
+		/** Get the commonly used attributes of this GPrim.
+		 * \return A reference to the cache held by the attributes state.
+		 */
+		const SqAttributeCache& attributeCache() const
+		{
+			return ( m_pAttributes->cache() );
+		}
 		/** Get a pointer to the transformation state associated with this GPrim.
 		 * \return A pointer to a CqTransform class.
 		 */
@@ -138,6 +148,13 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 		{
 			return ( boost::static_pointer_cast<IqTransform>( m_pTransform ) );
 		}
+		/** Share the attributes and transform of this GPrim with any other GPrims holding equal states.
+		 */
+		void	InternState()
+		{
+			m_pAttributes = CqAttributes::Intern( m_pAttributes );
+			m_pTransform = CqTransform::Intern( m_pTransform );
+		}
 		virtual	void	SetSurfaceParameters( const CqSurface& From );
 		/** Force this GPrim to be undiceable, usually if it crosses the epsilon and eye plane.
 		 */
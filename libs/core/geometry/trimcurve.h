@@ -150,6 +150,10 @@ class CqTrimLoopArray
 		{
 			return ( m_aLoops );
 		}
+		const std::vector<CqTrimLoop>& aLoops() const
+		{
+			return ( m_aLoops );
+		}
 
 		void	Prepare( CqSurface* pSurface );
 		const	bool	TrimPoint( const CqVector2D& v ) const;
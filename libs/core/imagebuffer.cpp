@@ -29,6 +29,9 @@
 #include    <windows.h>
 #endif
 #include	<math.h>
+#include	<algorithm>
+
+#include	<boost/scoped_ptr.hpp>
 
 #include	<aqsis/math/math.h>
 #include	"stats.h"
@@ -39,12 +42,18 @@
 #include	"bucketprocessor.h"
 #include	"threadscheduler.h"
 #include	"multijitter.h"
+#include	"sobolsampler.h"
 #include	"grid.h"
+#include	"texturemap_old.h"
+#include	<aqsis/shadervm/ishader.h>
+#include	<aqsis/shadervm/ishaderexecenv.h>
 
 
 namespace Aqsis {
 
 static TqInt bucketmodulo = -1;
+/// Maximum number of frames kept for comparison by incremental renders.
+static const TqInt maxFrameRecords = 4;
 //static TqInt bucketdirection = -1;
 
 #define MULTIPROCESSING_NBUCKETS 1
@@ -228,12 +237,116 @@ void	CqImageBuffer::SetImage()
 }
 
 
+//----------------------------------------------------------------------
+/** Start recording the inputs of each bucket, to be compared against the
+ * last render of the same frame in RenderImage().
+ */
+
+void	CqImageBuffer::setFrameSignature(CqInputSignature::TqHash signature)
+{
+	m_collectSignatures = signature != 0;
+	m_frameSignature = signature;
+	m_frameViews = 0;
+	m_bucketSignatures.assign(m_cXBuckets*m_cYBuckets, signature);
+}
+
+
+//----------------------------------------------------------------------
+/** Drop the bucket signatures recorded for the last frame, so that it is
+ * rendered in full next time.
+ */
+
+void	CqImageBuffer::forgetFrame()
+{
+	for(TqInt view = 0; view < m_frameViews; ++view)
+	{
+		TqFrameRecords::iterator record = m_frameRecords.find(viewSignature(view));
+		if(record != m_frameRecords.end())
+			record->second.bucketSignatures.clear();
+	}
+}
+
+
+//----------------------------------------------------------------------
+/** Get the record of a previous frame with the given signature, creating an
+ * empty one if there isn't one already.
+ */
+
+CqImageBuffer::SqFrameRecord& CqImageBuffer::frameRecord(CqInputSignature::TqHash signature)
+{
+	TqFrameRecords::iterator record = m_frameRecords.find(signature);
+	if(record != m_frameRecords.end())
+		return record->second;
+	if(static_cast<TqInt>(m_frameRecordOrder.size()) >= maxFrameRecords)
+	{
+		m_frameRecords.erase(m_frameRecordOrder.front());
+		m_frameRecordOrder.pop_front();
+	}
+	m_frameRecordOrder.push_back(signature);
+	return m_frameRecords[signature];
+}
+
+
+//----------------------------------------------------------------------
+/** Get the key of the record of a view of the current frame, such as one
+ * eye of a stereo pair.
+ */
+
+CqInputSignature::TqHash CqImageBuffer::viewSignature(TqInt view) const
+{
+	return CqInputSignature::combine(m_frameSignature, view);
+}
+
+
 //----------------------------------------------------------------------
 /** Delete the allocated memory for the image buffer.
  */
 
 void	CqImageBuffer::DeleteImage()
 {
+	m_sampleTiles.clear();
+}
+
+
+//----------------------------------------------------------------------
+/** Measure the memory held by caches, and release them if the memory in use
+ * is close to the limit.
+ *
+ * The caches are only released once they hold a tenth of the memory in use.
+ * Otherwise a render whose other memory alone is close to the limit would
+ * drop the caches after every round of buckets and load them straight back.
+ */
+
+bool	CqImageBuffer::checkMemory( CqStats::TqMemorySize limit )
+{
+	CqStats::setMemory( EqMemoryStats::Shader_temporaries, shaderVMPooledMemory() );
+	CqStats::setMemory( EqMemoryStats::Texture_tiles, QGetRenderContext()->Stats().GetTextureMemory() );
+	CqStats::setMemory( EqMemoryStats::Point_clouds, pointCloudCacheMemory() );
+	if ( limit <= 0 )
+		return false;
+
+	// Start releasing memory when within a fifth of the limit, to leave room
+	// for the next buckets to work in.
+	CqStats::TqMemorySize used = CqStats::totalMemory();
+	if ( used < limit - limit/5 )
+		return false;
+	CqStats::TqMemorySize releasable = CqStats::totalMemory( EqMemoryStats::Shader_temporaries )
+		+ CqStats::totalMemory( EqMemoryStats::Texture_tiles )
+		+ CqStats::totalMemory( EqMemoryStats::Point_clouds );
+	if ( releasable < used/10 )
+		return used > limit;
+
+	Aqsis::log() << info << "Memory use of " << used/1024
+		<< "K is close to the limit, releasing caches" << std::endl;
+	CqTextureMapOld::FlushCache();
+	QGetRenderContext()->textureCache().flush();
+	clearPointCloudCache();
+	shutdownShaderVM();
+
+	CqStats::setMemory( EqMemoryStats::Shader_temporaries, shaderVMPooledMemory() );
+	CqStats::setMemory( EqMemoryStats::Texture_tiles, QGetRenderContext()->Stats().GetTextureMemory() );
+	CqStats::setMemory( EqMemoryStats::Point_clouds, pointCloudCacheMemory() );
+	return CqStats::totalMemory() > limit;
 }
 
 
@@ -348,9 +461,11 @@ bool CqImageBuffer::CullSurface( CqBound& Bound, const boost::shared_ptr<CqSurfa
 //----------------------------------------------------------------------
 /** Add a new surface to the front of the list of waiting ones.
  * \param pSurface A pointer to a CqSurface derived class, surface should at this point be in camera space.
+ * \param signature Hash of the inputs of the surface, recorded against the buckets it covers if signatures are being collected.
  */
 
-void CqImageBuffer::PostSurface( const boost::shared_ptr<CqSurface>& pSurface )
+void CqImageBuffer::PostSurface( const boost::shared_ptr<CqSurface>& pSurface,
+                                 CqInputSignature::TqHash signature )
 {
 	AQSIS_TIME_SCOPE(Post_surface);
 	// Count the number of total gprims
@@ -361,14 +476,8 @@ void CqImageBuffer::PostSurface( const boost::shared_ptr<CqSurface>& pSurface )
 	pSurface->Bound(&Bound);
 
 	// Take into account the displacement bound extension.
-	TqFloat db = 0.0f;
-	CqString strCoordinateSystem( "object" );
-	const TqFloat* pattrDispclacementBound = pSurface->pAttributes() ->GetFloatAttribute( "displacementbound", "sphere" );
-	const CqString* pattrCoordinateSystem = pSurface->pAttributes() ->GetStringAttribute( "displacementbound", "coordinatesystem" );
-	if ( pattrDispclacementBound != 0 )
-		db = pattrDispclacementBound[ 0 ];
-	if ( pattrCoordinateSystem != 0 )
-		strCoordinateSystem = pattrCoordinateSystem[ 0 ];
+	TqFloat db = pSurface->attributeCache().displacementBound;
+	const CqString& strCoordinateSystem = pSurface->attributeCache().displacementBoundSpace;
 
 	if ( db != 0.0f )
 	{
@@ -415,6 +524,29 @@ void CqImageBuffer::PostSurface( const boost::shared_ptr<CqSurface>& pSurface )
 	XMaxb = clamp( XMaxb, m_bucketRegion.xMin(), m_bucketRegion.xMax()-1 );
 	YMaxb = clamp( YMaxb, m_bucketRegion.yMin(), m_bucketRegion.yMax()-1 );
 
+	// Previews are rendered with coarser options than the frame itself, so
+	// aren't recorded.
+	if ( m_collectSignatures && !QGetRenderContext()->pDDmanager()->isPreview() )
+	{
+		// Record the surface against each bucket it may affect.  An
+		// undiceable surface has no usable raster bound, so it may affect any
+		// bucket, and the bucket it is posted to must be rendered to split it.
+		bool undiceable = pSurface->IsUndiceable();
+		TqInt yEnd = undiceable ? m_bucketRegion.yMax()-1 : YMaxb;
+		TqInt xEnd = undiceable ? m_bucketRegion.xMax()-1 : XMaxb;
+		for ( TqInt yb = undiceable ? m_bucketRegion.yMin() : YMinb; yb <= yEnd; ++yb )
+		{
+			for ( TqInt xb = undiceable ? m_bucketRegion.xMin() : XMinb; xb <= xEnd; ++xb )
+			{
+				CqInputSignature::TqHash& bucketSignature = m_bucketSignatures[yb*m_cXBuckets + xb];
+				if ( bucketSignature != 0 )
+					bucketSignature = CqInputSignature::combine( bucketSignature, signature );
+			}
+		}
+		if ( undiceable )
+			m_bucketSignatures[YMinb*m_cXBuckets + XMinb] = 0;
+	}
+
 	// Sanity check we are not putting into a bucket that has already been processed.
 	CqBucket* bucket = &Bucket( XMinb, YMinb );
 	if ( bucket->IsProcessed() )
@@ -694,8 +826,34 @@ void CqImageBuffer::RenderImage()
 	CqMultiJitteredSampler jitteredSampler(m_optCache.xSamps, m_optCache.ySamps);
 	CqGridSampler gridSampler(m_optCache.xSamps, m_optCache.ySamps);
 
-	// Determine whether the user has asked for sample jittering
+	boost::scoped_ptr<CqSobolSampler> sobolSampler;
+
+	// Determine which sample pattern the user has asked for.
 	IqSampler* sampler = &jitteredSampler;
+	if(const CqString* pattern = QGetRenderContext()->poptCurrent()->
+			GetStringOption("Hider", "samplepattern"))
+	{
+		if(*pattern == "sobol")
+		{
+			if(CqSobolSampler::supports(m_optCache.xSamps, m_optCache.ySamps))
+			{
+				sobolSampler.reset(new CqSobolSampler(m_optCache.xSamps,
+							m_optCache.ySamps));
+				sampler = sobolSampler.get();
+			}
+			else
+			{
+				Aqsis::log() << warning << "Sample pattern \"sobol\" requires a power "
+					"of two number of PixelSamples, using \"multijitter\"\n";
+			}
+		}
+		else if(*pattern != "multijitter")
+		{
+			Aqsis::log() << warning << "Invalid samplepattern \"" << *pattern
+				<< "\", samplepattern set to \"multijitter\"\n";
+		}
+	}
+	// Determine whether the user has asked for sample jittering
 	if(const TqInt* jitter = QGetRenderContext()->poptCurrent()->
 			GetIntegerOption("Hider", "jitter"))
 	{
@@ -703,6 +861,40 @@ void CqImageBuffer::RenderImage()
 			sampler = &gridSampler;
 	}
 
+	// Buckets whose inputs are the same as when the frame was last rendered
+	// are sent to the display from the previous output rather than rendered
+	// again.  The inputs include the textures, shadow maps and point clouds
+	// read by the frame, but the gprims which read them aren't known, so if
+	// any have changed the whole frame is rendered.
+	SqFrameRecord* prevFrame = 0;
+	bool reuseBuckets = false;
+	std::vector<std::string> filesRead;
+	if ( QGetRenderContext()->isIncremental() )
+	{
+		// Start recording the files read by this frame.
+		QGetRenderContext()->takeFilesRead( filesRead );
+		filesRead.clear();
+	}
+	// Surfaces split while rendering were already recorded with their
+	// parents.  Previews neither use nor replace the record of the view.
+	bool collecting = m_collectSignatures;
+	m_collectSignatures = false;
+	if ( collecting && !QGetRenderContext()->pDDmanager()->isPreview() )
+	{
+		prevFrame = &frameRecord( viewSignature( m_frameViews ) );
+		reuseBuckets = prevFrame->bucketSignatures.size() == m_bucketSignatures.size()
+			&& prevFrame->filesSignature == QGetRenderContext()->fileSignature( prevFrame->filesRead );
+		prevFrame->bucketOutputs.resize( m_bucketSignatures.size() );
+	}
+	TqInt reusedBuckets = 0;
+
+	// Memory limit, in kB.
+	CqStats::TqMemorySize memoryLimit = 0;
+	if(const TqInt* limit = QGetRenderContext()->poptCurrent()->
+			GetIntegerOption("limits", "memory"))
+		memoryLimit = static_cast<CqStats::TqMemorySize>(limit[0])*1024;
+	bool memoryWarned = false;
+
 	// Iterate over all buckets...
 	bool pendingBuckets = true;
 	while ( pendingBuckets && !m_fQuit )
@@ -712,6 +904,27 @@ void CqImageBuffer::RenderImage()
 
 		for (int i = 0; pendingBuckets && i < numConcurrentBuckets; ++i)
 		{
+			if ( reuseBuckets )
+			{
+				while ( pendingBuckets && !m_fQuit )
+				{
+					const CqBucket& bucket = CurrentBucket();
+					TqInt index = bucket.getRow()*m_cXBuckets + bucket.getCol();
+					if ( m_bucketSignatures[index] == 0
+						|| m_bucketSignatures[index] != prevFrame->bucketSignatures[index] )
+						break;
+					bucketProcessors[i]->setBucket(&CurrentBucket());
+					bucketProcessors[i]->skipBucket();
+					QGetRenderContext() ->pDDmanager() ->DisplayBucket( bucketProcessors[i]->DisplayRegion(), &prevFrame->bucketOutputs[index] );
+					bucketProcessors[i]->reset();
+					++reusedBuckets;
+					iBucket += 1;
+					pendingBuckets = NextBucket(order);
+				}
+				if ( !pendingBuckets || m_fQuit )
+					break;
+			}
+
 			bucketProcessors[i]->setBucket(&CurrentBucket());
 
 			// Prepare the bucket processor
@@ -745,6 +958,9 @@ void CqImageBuffer::RenderImage()
 				if (bucket)
 				{
 					QGetRenderContext() ->pDDmanager() ->DisplayBucket( bucketProcessors[i]->DisplayRegion(), &(bucketProcessors[i]->getChannelBuffer()) );
+					if ( prevFrame )
+						prevFrame->bucketOutputs[bucket->getRow()*m_cXBuckets + bucket->getCol()]
+							= bucketProcessors[i]->getChannelBuffer();
 				}
 			}
 			bucketProcessors[i]->reset();
@@ -762,6 +978,48 @@ void CqImageBuffer::RenderImage()
 				SetProcessWorkingSetSize( GetCurrentProcess(), 0xffffffff, 0xffffffff );
 #endif
 		}
+
+		if ( checkMemory( memoryLimit ) && !memoryWarned )
+		{
+			Aqsis::log() << warning << "Exceeding the memory limit of "
+				<< memoryLimit/1024 << "K" << std::endl;
+			memoryWarned = true;
+		}
+	}
+
+	// Drop any tiles left over if the render was stopped early.
+	m_sampleTiles.clear();
+
+	if ( prevFrame )
+	{
+		// Only a complete image can be reused by a later frame.  The reused
+		// buckets read the same files as last time, without opening them.
+		if ( m_fQuit )
+			prevFrame->bucketSignatures.clear();
+		else
+			prevFrame->bucketSignatures = m_bucketSignatures;
+		QGetRenderContext()->takeFilesRead( filesRead );
+		if ( reusedBuckets > 0 )
+			filesRead.insert( filesRead.end(), prevFrame->filesRead.begin(), prevFrame->filesRead.end() );
+		std::sort( filesRead.begin(), filesRead.end() );
+		filesRead.erase( std::unique( filesRead.begin(), filesRead.end() ), filesRead.end() );
+		prevFrame->filesRead.swap( filesRead );
+		prevFrame->filesSignature = QGetRenderContext()->fileSignature( prevFrame->filesRead );
+		Aqsis::log() << info << "Reused " << reusedBuckets << " of "
+			<< m_bucketRegion.area() << " buckets from the previous frame" << std::endl;
+
+		// The next view of the frame starts with fresh bucket signatures.
+		++m_frameViews;
+		m_bucketSignatures.assign( m_bucketSignatures.size(), m_frameSignature );
+	}
+	m_collectSignatures = collecting;
+	if ( QGetRenderContext()->isIncremental() && reusedBuckets < m_bucketRegion.area() )
+	{
+		// Later frames may read the images written by this one, such as
+		// shadow maps.  An image made only from reused buckets is unchanged.
+		IqDDManager* ddManager = QGetRenderContext()->pDDmanager();
+		for ( TqInt i = 0, numRequests = ddManager->numDisplayRequests(); i < numRequests; ++i )
+			QGetRenderContext()->noteFileWritten( ddManager->displayRequest( i )->name() );
 	}
 
 	// Pass >100 through to progress to allow it to indicate completion.
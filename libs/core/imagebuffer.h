@@ -30,13 +30,18 @@
 
 #include	<aqsis/aqsis.h>
 
+#include	<deque>
+#include	<map>
 #include	<vector>
 
 #include	"surface.h"
 #include	<aqsis/math/vector2d.h>
 #include   	"bucket.h"
+#include	"channelbuffer.h"
+#include	"inputsignature.h"
 #include	"mpdump.h"
 #include	"optioncache.h"
+#include	"sampletilestore.h"
 
 namespace Aqsis {
 
@@ -84,12 +89,16 @@ class CqImageBuffer
 				m_cXBuckets( 0 ),
 				m_cYBuckets( 0 ),
 				m_CurrentBucketCol( 0 ),
-				m_CurrentBucketRow( 0 )
+				m_CurrentBucketRow( 0 ),
+				m_collectSignatures( false ),
+				m_frameSignature( 0 ),
+				m_frameViews( 0 )
 		{}
 		~CqImageBuffer();
 
 		void AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew );
-		void PostSurface( const boost::shared_ptr<CqSurface>& pSurface );
+		void PostSurface( const boost::shared_ptr<CqSurface>& pSurface,
+		                  CqInputSignature::TqHash signature = 0 );
 		/** \brief Repost a previously posted surface into the next unfinished bucket.
 		 *
 		 * The surface is reposted it to the next unfinished bucket within the
@@ -105,7 +114,32 @@ class CqImageBuffer
 		void RenderImage();
 
 		void SetImage();
+		/** \brief Reuse the buckets which are unchanged since the frame was last rendered.
+		 *
+		 * Must be called after SetImage() and before any surfaces are
+		 * posted, and applies until the next call.  Each surface posted
+		 * afterwards adds its input signature to the buckets it covers.  Each
+		 * RenderImage() outside of a preview then compares the buckets
+		 * against the same view of the last frame rendered with the same
+		 * frame signature, and copies any bucket whose signature matches from
+		 * the previous output rather than rendering it.
+		 *
+		 * \param signature - hash of the options of the frame, or zero if
+		 * the frame shouldn't be reused.
+		 */
+		void setFrameSignature(CqInputSignature::TqHash signature);
+		/** Stop the last frame rendered from being reused by later frames.
+		 *
+		 * Used for frames with side effects, such as baking point clouds,
+		 * which need every bucket to be shaded.
+		 */
+		void forgetFrame();
 		void Quit();
+		/// Return true if rendering has been stopped by Quit().
+		bool IsQuit() const
+		{
+			return m_fQuit;
+		}
 		void Release();
 
 		enum EqNeighbourLocation
@@ -121,6 +155,15 @@ class CqImageBuffer
 		 *  \param neighbours - A reference to the array to be filled.
 		 */
 		void	axialNeighbours(CqBucket const& bucket, std::vector<CqBucket*>& neighbours);
+		/** Get the bucket at an offset from another.
+		 *
+		 *  \param bucket - The bucket whose neighbour is to be found.
+		 *  \param dx, dy - Offset of the neighbour in buckets.
+		 *  \return The neighbour, or null if it lies outside the rendered buckets.
+		 */
+		CqBucket*	neighbour(CqBucket const& bucket, TqInt dx, TqInt dy);
+		/// Get the store of pixels shared between neighbouring buckets.
+		CqSampleTileStore&	sampleTiles();
 
 	private:
 		/// Get a pointer to the bucket at position x,y in the grid.
@@ -143,6 +186,42 @@ class CqImageBuffer
 		std::vector<std::vector<CqBucket> >	m_Buckets; ///< Array of bucket storage classes (row/col)
 		TqInt	m_CurrentBucketCol;	///< Column index of the bucket currently being processed.
 		TqInt	m_CurrentBucketRow;	///< Row index of the bucket currently being processed.
+		CqSampleTileStore	m_sampleTiles;	///< Pixels shared between neighbouring buckets.
+
+		/// True if surfaces should be recorded against the bucket signatures.
+		bool	m_collectSignatures;
+		/// Hash of the options of the current frame.
+		CqInputSignature::TqHash	m_frameSignature;
+		/// Number of views of the current frame rendered so far.
+		TqInt	m_frameViews;
+		/** Hash of the inputs of each bucket, indexed by row*m_cXBuckets+col.
+		 * A zero signature means the bucket must always be rendered.
+		 */
+		std::vector<CqInputSignature::TqHash>	m_bucketSignatures;
+		/// Bucket inputs and outputs of a previously rendered frame.
+		struct SqFrameRecord
+		{
+			std::vector<CqInputSignature::TqHash> bucketSignatures;
+			std::vector<CqChannelBuffer> bucketOutputs;
+			/// Textures, shadow maps and point clouds read by the frame.
+			std::vector<std::string> filesRead;
+			/// Hash of the contents of filesRead when the frame was rendered.
+			CqInputSignature::TqHash filesSignature;
+
+			SqFrameRecord() : filesSignature( 0 ) {}
+		};
+		typedef std::map<CqInputSignature::TqHash, SqFrameRecord> TqFrameRecords;
+		/** Previously rendered views, keyed by frame signature and view.
+		 * Several are kept so that the passes of a multipass render, such as
+		 * shadow maps, and each view of a stereo pair can be compared against
+		 * the same pass of the last run.
+		 */
+		TqFrameRecords	m_frameRecords;
+		/// Keys of m_frameRecords, oldest first.
+		std::deque<CqInputSignature::TqHash>	m_frameRecordOrder;
+
+		SqFrameRecord&	frameRecord(CqInputSignature::TqHash signature);
+		CqInputSignature::TqHash	viewSignature(TqInt view) const;
 
 #if ENABLE_MPDUMP
 		CqMPDump	m_mpdump;
@@ -150,6 +229,16 @@ class CqImageBuffer
 
 		bool	CullSurface( CqBound& Bound, const boost::shared_ptr<CqSurface>& pSurface );
 		void	DeleteImage();
+		/** \brief Measure the memory held by caches, and release them if the
+		 * memory in use is close to the limit.
+		 *
+		 * Must only be called while no buckets are being processed.
+		 *
+		 * \param limit - Option "limits" "memory" in bytes, or zero for no limit.
+		 * \return true if the memory in use is over the limit even after the
+		 * caches have been released.
+		 */
+		bool	checkMemory( CqStats::TqMemorySize limit );
 
 		/** Move to the next bucket to process.
 		 */
@@ -187,6 +276,21 @@ inline void CqImageBuffer::axialNeighbours(CqBucket const& bucket, std::vector<C
 		neighbours[below] = &Bucket(bx, by+1);
 }
 
+inline CqBucket* CqImageBuffer::neighbour(CqBucket const& bucket, TqInt dx, TqInt dy)
+{
+	TqInt bx = bucket.getCol() + dx;
+	TqInt by = bucket.getRow() + dy;
+	if(bx < m_bucketRegion.xMin() || bx >= m_bucketRegion.xMax()
+		|| by < m_bucketRegion.yMin() || by >= m_bucketRegion.yMax())
+		return 0;
+	return &Bucket(bx, by);
+}
+
+inline CqSampleTileStore& CqImageBuffer::sampleTiles()
+{
+	return m_sampleTiles;
+}
+
 //-----------------------------------------------------------------------
 
 } // namespace Aqsis
@@ -34,6 +34,7 @@
 #include <aqsis/math/math.h>
 #include <aqsis/math/random.h>
 #include "renderer.h"
+#include "stats.h"
 
 
 namespace Aqsis {
@@ -49,9 +50,13 @@ CqImagePixel::CqImagePixel(TqInt xSamples, TqInt ySamples)
 		m_YSamples(ySamples),
 		m_samples(new SqSampleData[xSamples*ySamples]),
 		m_hitSamples(),
+		m_freeHitSamples(),
 		m_DofOffsetIndices(new TqInt[xSamples*ySamples]),
 		m_refCount(0),
-		m_hasValidSamples(false)
+		m_hasValidSamples(false),
+		m_hasCSGHits(false),
+		m_sampleStride(1),
+		m_memoryUsage(0)
 {
 	assert(xSamples > 0);
 	assert(ySamples > 0);
@@ -62,6 +67,17 @@ CqImagePixel::CqImagePixel(TqInt xSamples, TqInt ySamples)
 	m_hitSamples.resize(nSamples*sampSize);
 	for(TqInt i = 0; i < nSamples; ++i)
 		m_samples[i].occludingHit.index = i*sampSize;
+
+	// Only the storage for occluding hits is accounted; the extra hits
+	// behind transparent surfaces come and go too quickly to be worth it.
+	m_memoryUsage = sizeof(CqImagePixel) + nSamples*(sizeof(SqSampleData)
+			+ sizeof(TqInt) + sampSize*sizeof(TqFloat));
+	CqStats::allocMemory(EqMemoryStats::Sample_buffers, m_memoryUsage);
+}
+
+CqImagePixel::~CqImagePixel()
+{
+	CqStats::freeMemory(EqMemoryStats::Sample_buffers, m_memoryUsage);
 }
 
 void CqImagePixel::swap(CqImagePixel& other)
@@ -70,9 +86,13 @@ void CqImagePixel::swap(CqImagePixel& other)
 	assert(m_YSamples == other.m_YSamples);
 
 	m_hitSamples.swap(other.m_hitSamples);
+	m_freeHitSamples.swap(other.m_freeHitSamples);
 	m_samples.swap(other.m_samples);
 	m_DofOffsetIndices.swap(other.m_DofOffsetIndices);
 	m_hasValidSamples = other.m_hasValidSamples;
+	std::swap(m_hasCSGHits, other.m_hasCSGHits);
+	std::swap(m_sampleStride, other.m_sampleStride);
+	std::swap(m_memoryUsage, other.m_memoryUsage);
 }
 
 void CqImagePixel::setupGridPattern(CqVector2D& offset, TqFloat opentime,
@@ -107,7 +127,10 @@ void CqImagePixel::clear()
 	TqInt nSamples = numSamples();
 	TqInt sampSize = SqImageSample::sampleSize;
 	m_hitSamples.resize(nSamples*sampSize);
+	m_freeHitSamples.clear();
 	m_hasValidSamples = false;
+	m_hasCSGHits = false;
+	m_sampleStride = 1;
 	for(TqInt i = 0; i < nSamples; ++i)
 	{
 		if(!m_samples[i].data.empty())
@@ -118,6 +141,7 @@ void CqImagePixel::clear()
 		m_samples[i].occludingHit.index = i*sampSize;
 		// Reset the occluding depth to the maximum.
 		m_samples[i].occlZ = FLT_MAX;
+		m_samples[i].isActive = true;
 	}
 }
 
@@ -125,7 +149,7 @@ void CqImagePixel::clear()
 //----------------------------------------------------------------------
 /** Get the color at the specified sample point by blending the colors that appear at that point.
  */
-// Ascending depth sorting functor
+// Ascending depth ordering functor, for searching the depth-sorted hit lists.
 class CqAscendingDepthSort
 {
 	private:
@@ -139,8 +163,67 @@ class CqAscendingDepthSort
 			return m_pixel.sampleHitData(splStart)[Sample_Depth]
 				< m_pixel.sampleHitData(splEnd)[Sample_Depth];
 		}
+		bool operator()(TqFloat depth, const SqImageSample& spl) const
+		{
+			return depth < m_pixel.sampleHitData(spl)[Sample_Depth];
+		}
 };
 
+SqImageSample& CqImagePixel::insertHit(TqInt index, TqFloat depth)
+{
+	assert(index < numSamples());
+	std::vector<SqImageSample>& hits = m_samples[index].data;
+	std::vector<SqImageSample>::iterator pos = std::upper_bound(hits.begin(),
+			hits.end(), depth, CqAscendingDepthSort(*this));
+	pos = hits.insert(pos, SqImageSample());
+	allocateHitData(*pos);
+	sampleHitData(*pos)[Sample_Depth] = depth;
+	return *pos;
+}
+
+TqFloat CqImagePixel::cullHiddenHits(TqInt index, const CqColor& oThreshold)
+{
+	assert(index < numSamples());
+	SqSampleData& sampleData = m_samples[index];
+	std::vector<SqImageSample>& hits = sampleData.data;
+
+	// Walk the hits front to back, accumulating opacity until it's clear
+	// that nothing further back can be seen.
+	TqFloat opacity[3] = { 0, 0, 0 };
+	TqFloat transmittance[3] = { 1, 1, 1 };
+	TqFloat cullDepth = FLT_MAX;
+	std::vector<SqImageSample>::iterator hit = hits.begin();
+	for(std::vector<SqImageSample>::iterator end = hits.end(); hit != end; ++hit)
+	{
+		const TqFloat* hitData = sampleHitData(*hit);
+		if(hitData[Sample_Depth] >= sampleData.occlZ)
+			break;
+		if(cullDepth < FLT_MAX)
+			break;
+		// Matte objects don't composite like other surfaces, so we just
+		// leave the rest of the hits alone if one is in the way.
+		if(hit->flags & SqImageSample::Flag_Matte)
+			return FLT_MAX;
+		for(TqInt c = 0; c < 3; ++c)
+		{
+			TqFloat o = clamp(hitData[Sample_ORed + c], 0.0f, 1.0f);
+			opacity[c] += transmittance[c]*o;
+			transmittance[c] *= 1 - o;
+		}
+		if(   opacity[0] >= oThreshold.r()
+		   && opacity[1] >= oThreshold.g()
+		   && opacity[2] >= oThreshold.b())
+			cullDepth = hitData[Sample_Depth];
+	}
+
+	// Recycle the storage of the hidden hits.
+	for(std::vector<SqImageSample>::iterator i = hit, end = hits.end(); i != end; ++i)
+		m_freeHitSamples.push_back(i->index);
+	hits.erase(hit, hits.end());
+
+	return cullDepth;
+}
+
 void CqImagePixel::Combine( enum EqDepthFilter depthfilter, CqColor zThreshold )
 {
 	TqUint samplecount = 0;
@@ -157,69 +240,61 @@ void CqImagePixel::Combine( enum EqDepthFilter depthfilter, CqColor zThreshold )
 		{
 			if (occlHit.flags & SqImageSample::Flag_Valid)
 			{
-				//	insert occlHit into samples if it holds valid data.
-				sampleData.data.push_back(occlHit);
-			}
-			// Sort the samples by depth.
-			std::sort(sampleData.data.begin(), sampleData.data.end(), CqAscendingDepthSort(*this));
-
-			// Find out if any of the samples are in a CSG tree.
-			bool bProcessed;
-			bool CqCSGRequired = CqCSGTreeNode::IsRequired();
-			if (CqCSGRequired)
-			{
-				do
-				{
-					bProcessed = false;
-					//Warning ProcessTree add or remove elements in samples list
-					//We could not optimized the for loop here at all.
-					for ( std::vector<SqImageSample>::iterator isample = sampleData.data.begin();
-					        isample != sampleData.data.end();
-					        ++isample )
-					{
-						if ( isample->csgNode )
-						{
-							isample->csgNode->ProcessTree( sampleData.data );
-							bProcessed = true;
-							break;
-						}
-					}
-				}
-				while ( bProcessed );
+				//	insert occlHit into samples if it holds valid data.  The
+				//	samples are already sorted by depth (see insertHit()).
+				sampleData.data.insert(std::upper_bound(sampleData.data.begin(),
+							sampleData.data.end(), sampleHitData(occlHit)[Sample_Depth],
+							CqAscendingDepthSort(*this)), occlHit);
 			}
 
-			CqColor samplecolor;
-			CqColor sampleopacity;
+			// Resolve the CSG trees for any samples which are part of one.
+			// Pixels which saw no CSG surfaces skip this entirely.
+			if (m_hasCSGHits)
+				CqCSGTreeNode::resolveHits( sampleData.data );
+
+			// Composite the hits front to back.  Each hit contributes
+			// col = A + B*colBehind and opa = a + b*opaBehind, which we
+			// accumulate along with the transmittances B and b of the hits in
+			// front.  Once both transmittances reach zero the remaining hits
+			// can't contribute any colour, so only their depths are examined.
+			TqFloat samplecolor[3] = { 0, 0, 0 };
+			TqFloat sampleopacity[3] = { 0, 0, 0 };
+			TqFloat colTrans[3] = { 1, 1, 1 };
+			TqFloat opaTrans[3] = { 1, 1, 1 };
+			bool visible = true;
 			bool samplehit = false;
 			TqFloat opaqueDepths[2] = { sampleData.occlZ, FLT_MAX };
+			TqInt numOpaque = 0;
 			TqFloat maxOpaqueDepth = FLT_MAX;
 
-			for ( std::vector<SqImageSample>::reverse_iterator sample = sampleData.data.rbegin();
-			        sample != sampleData.data.rend();
+			for ( std::vector<SqImageSample>::iterator sample = sampleData.data.begin();
+			        sample != sampleData.data.end();
 			        sample++ )
 			{
 				TqFloat* sample_data = sampleHitData(*sample);
-				if ( sample->flags & SqImageSample::Flag_Matte )
+				if(visible)
 				{
-					samplecolor = CqColor(
-						lerp( sample_data[Sample_ORed], samplecolor.r(), 0.0f ),
-						lerp( sample_data[Sample_OGreen], samplecolor.g(), 0.0f ),
-						lerp( sample_data[Sample_OBlue], samplecolor.b(), 0.0f )
-					);
-					sampleopacity = CqColor(
-						lerp( sample_data[Sample_Red], sampleopacity.r(), 0.0f ),
-						lerp( sample_data[Sample_Green], sampleopacity.g(), 0.0f ),
-						lerp( sample_data[Sample_Blue], sampleopacity.b(), 0.0f )
-					);
-				}
-				else
-				{
-					samplecolor = ( samplecolor *
-					                ( gColWhite - CqColor(clamp(sample_data[Sample_ORed], 0.0f, 1.0f), clamp(sample_data[Sample_OGreen], 0.0f, 1.0f), clamp(sample_data[Sample_OBlue], 0.0f, 1.0f)) ) ) +
-					              CqColor(sample_data[Sample_Red], sample_data[Sample_Green], sample_data[Sample_Blue]);
-					sampleopacity = ( ( gColWhite - sampleopacity ) *
-					                  CqColor(sample_data[Sample_ORed], sample_data[Sample_OGreen], sample_data[Sample_OBlue]) ) +
-					                sampleopacity;
+					if ( sample->flags & SqImageSample::Flag_Matte )
+					{
+						for(TqInt c = 0; c < 3; ++c)
+						{
+							colTrans[c] *= 1 - sample_data[Sample_ORed + c];
+							opaTrans[c] *= 1 - sample_data[Sample_Red + c];
+						}
+					}
+					else
+					{
+						for(TqInt c = 0; c < 3; ++c)
+						{
+							TqFloat o = sample_data[Sample_ORed + c];
+							samplecolor[c] += colTrans[c]*sample_data[Sample_Red + c];
+							sampleopacity[c] += opaTrans[c]*o;
+							colTrans[c] *= 1 - clamp(o, 0.0f, 1.0f);
+							opaTrans[c] *= 1 - o;
+						}
+					}
+					visible = colTrans[0] != 0 || colTrans[1] != 0 || colTrans[2] != 0
+						|| opaTrans[0] != 0 || opaTrans[1] != 0 || opaTrans[2] != 0;
 				}
 
 				// Now determine if the sample opacity meets the limit for
@@ -230,12 +305,19 @@ void CqImagePixel::Combine( enum EqDepthFilter depthfilter, CqColor zThreshold )
 				   && sample_data[Sample_OGreen] >= zThreshold.g()
 				   && sample_data[Sample_OBlue]  >= zThreshold.b())
 				{
-					// Make sure we store the nearest and second nearest depth values.
-					opaqueDepths[1] = opaqueDepths[0];
-					opaqueDepths[0] = sample_data[Sample_Depth];
-					// Store the max opaque depth too, if not already stored.
-					if(!(maxOpaqueDepth < FLT_MAX))
-						maxOpaqueDepth = sample_data[Sample_Depth];
+					// Make sure we store the nearest and second nearest depth
+					// values.  If only one is found, the occluding depth
+					// serves as the second.
+					if(numOpaque == 0)
+					{
+						opaqueDepths[1] = opaqueDepths[0];
+						opaqueDepths[0] = sample_data[Sample_Depth];
+					}
+					else if(numOpaque == 1)
+						opaqueDepths[1] = sample_data[Sample_Depth];
+					++numOpaque;
+					// The max opaque depth is the furthest one found.
+					maxOpaqueDepth = sample_data[Sample_Depth];
 				}
 				samplehit = true;
 			}
@@ -253,12 +335,12 @@ void CqImagePixel::Combine( enum EqDepthFilter depthfilter, CqColor zThreshold )
 				occlHit = *sampleData.data.begin();
 				TqFloat* occlData = sampleHitData(occlHit);
 				// Set the color and opacity.
-				occlData[Sample_Red] = samplecolor.r();
-				occlData[Sample_Green] = samplecolor.g();
-				occlData[Sample_Blue] = samplecolor.b();
-				occlData[Sample_ORed] = sampleopacity.r();
-				occlData[Sample_OGreen] = sampleopacity.g();
-				occlData[Sample_OBlue] = sampleopacity.b();
+				occlData[Sample_Red] = samplecolor[0];
+				occlData[Sample_Green] = samplecolor[1];
+				occlData[Sample_Blue] = samplecolor[2];
+				occlData[Sample_ORed] = sampleopacity[0];
+				occlData[Sample_OGreen] = sampleopacity[1];
+				occlData[Sample_OBlue] = sampleopacity[2];
 				occlHit.flags |= SqImageSample::Flag_Valid;
 
 				TqFloat& occlDepth = occlData[Sample_Depth];
@@ -329,6 +411,152 @@ void CqImagePixel::Combine( enum EqDepthFilter depthfilter, CqColor zThreshold )
 			}
 		}
 	}
+
+	if(m_sampleStride > 1)
+		fillStrideBlocks();
+}
+
+void CqImagePixel::setSampleStride(TqInt stride)
+{
+	assert(stride > 0);
+	m_sampleStride = stride;
+	TqInt nSamples = numSamples();
+	for(TqInt i = 0; i < nSamples; ++i)
+		m_samples[i].isActive = stride == 1;
+	if(stride == 1)
+		return;
+	for(TqInt by = 0, nby = (m_YSamples + stride - 1)/stride; by < nby; ++by)
+		for(TqInt bx = 0, nbx = (m_XSamples + stride - 1)/stride; bx < nbx; ++bx)
+			m_samples[strideBlockSample(bx, by)].isActive = true;
+}
+
+bool CqImagePixel::needsRefinement(TqFloat threshold) const
+{
+	if(m_sampleStride == 1)
+		return false;
+
+	TqFloat minCol[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	TqFloat maxCol[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	TqFloat minAlpha = FLT_MAX;
+	TqFloat maxAlpha = -FLT_MAX;
+	TqFloat minDepth = FLT_MAX;
+	TqFloat maxDepth = -FLT_MAX;
+	TqInt stride = m_sampleStride;
+	for(TqInt by = 0, nby = (m_YSamples + stride - 1)/stride; by < nby; ++by)
+	{
+		for(TqInt bx = 0, nbx = (m_XSamples + stride - 1)/stride; bx < nbx; ++bx)
+		{
+			const SqSampleData& sampleData = m_samples[strideBlockSample(bx, by)];
+			const SqImageSample& occlHit = sampleData.occludingHit;
+			const TqFloat* occlData = 0;
+			if(occlHit.flags & SqImageSample::Flag_Valid)
+				occlData = sampleHitData(occlHit);
+
+			// Estimate the final sample values by compositing the hits front
+			// to back, finishing with the occluding hit if there is one.
+			TqFloat col[3] = { 0, 0, 0 };
+			TqFloat trans[3] = { 1, 1, 1 };
+			TqFloat depth = FLT_MAX;
+			std::vector<SqImageSample>::const_iterator hit = sampleData.data.begin();
+			std::vector<SqImageSample>::const_iterator end = sampleData.data.end();
+			while(true)
+			{
+				const TqFloat* hitData = 0;
+				TqUint flags = 0;
+				if(hit != end && (!occlData
+						|| sampleHitData(*hit)[Sample_Depth] < occlData[Sample_Depth]))
+				{
+					if(hit->csgNode)
+						return true;
+					hitData = sampleHitData(*hit);
+					flags = hit->flags;
+					++hit;
+				}
+				else if(occlData)
+				{
+					hitData = occlData;
+					flags = occlHit.flags;
+					occlData = 0;
+				}
+				else
+					break;
+				for(TqInt c = 0; c < 3; ++c)
+				{
+					if(!(flags & SqImageSample::Flag_Matte))
+						col[c] += trans[c]*hitData[Sample_Red + c];
+					trans[c] *= 1 - clamp(hitData[Sample_ORed + c], 0.0f, 1.0f);
+				}
+				depth = std::min(depth, hitData[Sample_Depth]);
+			}
+
+			for(TqInt c = 0; c < 3; ++c)
+			{
+				minCol[c] = std::min(minCol[c], col[c]);
+				maxCol[c] = std::max(maxCol[c], col[c]);
+			}
+			TqFloat alpha = 1 - (trans[0] + trans[1] + trans[2])/3;
+			minAlpha = std::min(minAlpha, alpha);
+			maxAlpha = std::max(maxAlpha, alpha);
+			minDepth = std::min(minDepth, depth);
+			maxDepth = std::max(maxDepth, depth);
+		}
+	}
+
+	for(TqInt c = 0; c < 3; ++c)
+	{
+		if(maxCol[c] - minCol[c] > threshold*std::max(maxCol[c] + minCol[c], 1.0f))
+			return true;
+	}
+	if(maxAlpha - minAlpha > threshold)
+		return true;
+	// Refine where some samples saw a surface and others didn't, or where
+	// they saw surfaces at significantly different depths.
+	if(maxDepth == FLT_MAX)
+		return minDepth != FLT_MAX;
+	return maxDepth - minDepth > threshold*std::fabs(minDepth);
+}
+
+void CqImagePixel::refineSamples()
+{
+	TqInt nSamples = numSamples();
+	for(TqInt i = 0; i < nSamples; ++i)
+		m_samples[i].isActive = !m_samples[i].isActive;
+	m_sampleStride = 1;
+}
+
+void CqImagePixel::fillStrideBlocks()
+{
+	TqInt stride = m_sampleStride;
+	TqInt sampSize = SqImageSample::sampleSize;
+	for(TqInt by = 0, nby = (m_YSamples + stride - 1)/stride; by < nby; ++by)
+	{
+		for(TqInt bx = 0, nbx = (m_XSamples + stride - 1)/stride; bx < nbx; ++bx)
+		{
+			TqInt activeIndex = strideBlockSample(bx, by);
+			const SqSampleData& active = m_samples[activeIndex];
+			for(TqInt y = by*stride, endY = std::min(y + stride, m_YSamples); y < endY; ++y)
+			{
+				for(TqInt x = bx*stride, endX = std::min(x + stride, m_XSamples); x < endX; ++x)
+				{
+					TqInt index = y*m_XSamples + x;
+					if(index == activeIndex)
+						continue;
+					// Skipped samples never had their own occluding hit
+					// storage reassigned by Combine(), so it's safe to
+					// overwrite.
+					SqSampleData& sampleData = m_samples[index];
+					sampleData.occlZ = active.occlZ;
+					sampleData.occludingHit.flags = active.occludingHit.flags;
+					if(active.occludingHit.flags & SqImageSample::Flag_Valid)
+					{
+						const TqFloat* src = sampleHitData(active.occludingHit);
+						std::copy(src, src + sampSize,
+								sampleHitData(sampleData.occludingHit));
+					}
+				}
+			}
+		}
+	}
 }
 
 void CqImagePixel::setSamples(IqSampler* sampler, CqVector2D& offset)
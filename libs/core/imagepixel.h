@@ -28,6 +28,7 @@
 
 #include	<aqsis/aqsis.h>
 
+#include	<algorithm>
 #include	<vector>
 #include	<cfloat> // for FLT_MAX
 
@@ -145,6 +146,8 @@ struct SqSampleData : private boost::noncopyable
 	 * or other more exotic depth filters)
 	 */
 	TqFloat occlZ;
+	/// True if micropolygons should be sampled here during the current pass.
+	bool isActive;
 
 	/// Default construct members & set numeric members to 0 except occlZ=FLT_MAX.
 	SqSampleData();
@@ -164,6 +167,7 @@ class CqImagePixel : private boost::noncopyable
 		 * \param ySamples - number of sub-pixel samples in the y-direction
 		 */
 		CqImagePixel(TqInt xSamples, TqInt ySamples);
+		~CqImagePixel();
 
 		/** \brief Swap the internal sample data with another pixel.
 		 *
@@ -240,6 +244,31 @@ class CqImagePixel : private boost::noncopyable
 		/// Allocate space for a single block of sample hit data.
 		void allocateHitData(SqImageSample& hit);
 
+		/** \brief Insert a new semitransparent hit for a sample.
+		 *
+		 * The hits stored in Values() are kept sorted by ascending depth, so
+		 * the new hit is inserted at the position given by its depth, and has
+		 * its hit data allocated.
+		 *
+		 * \param index - The index of the sample within the pixel.
+		 * \param depth - The depth of the new hit.
+		 * \return A reference to the new hit, valid until the next insertion.
+		 */
+		SqImageSample& insertHit(TqInt index, TqFloat depth);
+
+		/** \brief Drop the hits of a sample which can no longer be seen.
+		 *
+		 * Hits lying behind the occluding depth are discarded, as are hits
+		 * behind the point where the accumulated opacity of the hits in front
+		 * reaches oThreshold.  The storage of discarded hits is recycled.
+		 *
+		 * \param index - The index of the sample within the pixel.
+		 * \param oThreshold - Accumulated opacity at which hits are hidden.
+		 * \return The depth at which the accumulated opacity reached
+		 * oThreshold, or FLT_MAX if it did not.
+		 */
+		TqFloat cullHiddenHits(TqInt index, const CqColor& oThreshold);
+
 		/** \brief Combine the sample values accumulated at each sample.
 		 *  
 		 *  The successful sample hits recorded at each sample point are
@@ -252,6 +281,37 @@ class CqImagePixel : private boost::noncopyable
 		 */
 		void	Combine( EqDepthFilter eDepthFilter, CqColor zThreshold );
 
+		/** \brief Sample only a sparse subset of the samples in the pixel.
+		 *
+		 * The subpixel grid is divided into stride x stride blocks, and a
+		 * single sample from each block is left active.  Until the pixel is
+		 * refined, Combine() copies the result of that sample to the rest of
+		 * the block.  The samples are chosen to cover the range of sample
+		 * times evenly.
+		 *
+		 * \param stride - Spacing of the active samples; 1 activates all samples.
+		 */
+		void setSampleStride(TqInt stride);
+		/// Get the spacing of the active samples, as set by setSampleStride()
+		TqInt sampleStride() const;
+		/** \brief Determine whether the sparse samples are inadequate.
+		 *
+		 * The colour, alpha and depth seen by the active samples are compared,
+		 * and the pixel needs refinement if any of them differ by more than
+		 * threshold.  Colour is compared relative to the brightness of the
+		 * samples when it is greater than one.  Samples containing CSG hits
+		 * always require refinement.
+		 *
+		 * \param threshold - Maximum allowed contrast between the samples.
+		 */
+		bool needsRefinement(TqFloat threshold) const;
+		/** \brief Activate the samples skipped because of setSampleStride()
+		 *
+		 * Samples which are already sampled are deactivated, so that a second
+		 * pass over the micropolygons only fills in the missing samples.
+		 */
+		void refineSamples();
+
 		/** \brief Get the sample data for the specified sample index.
 		 *
 		 * \param The index of the required sample point.
@@ -293,6 +353,9 @@ class CqImagePixel : private boost::noncopyable
 		/// Check if the pixel has any valid samples.
 		bool hasValidSamples();
 
+		/// Mark this pixel as having hits on surfaces which are part of a CSG tree.
+		void markHasCSGHits();
+
 		/** \brief Fill in the sample data using the given distribution object.
 		 *  Initialise the camera sample information for this pixel, including
 		 *  position, depth of field data, motion time and level of detail values.
@@ -317,6 +380,8 @@ class CqImagePixel : private boost::noncopyable
 		boost::scoped_array<SqSampleData> m_samples;
 		/// Vector storing sample data for the sample hits within the pixel.
 		std::vector<TqFloat> m_hitSamples;
+		/// Indices of hit data blocks in m_hitSamples released by cullHiddenHits()
+		std::vector<TqInt> m_freeHitSamples;
 		/// A mapping from dof bounding-box index to the sample that contains a
 		/// dof offset in that bb.
 		boost::scoped_array<TqInt> m_DofOffsetIndices;
@@ -324,6 +389,17 @@ class CqImagePixel : private boost::noncopyable
 		int m_refCount;
 		/// A flag to indicate successful sample hits in this pixel.
 		bool m_hasValidSamples;
+		/// A flag to indicate that the CSG trees need to be resolved in Combine().
+		bool m_hasCSGHits;
+		/// Spacing of the active samples on the subpixel grid.
+		TqInt m_sampleStride;
+		/// Bytes of sample storage accounted in CqStats.
+		TqInt m_memoryUsage;
+
+		/// Get the index of the active sample in block (bx,by) of the sample stride.
+		TqInt strideBlockSample(TqInt bx, TqInt by) const;
+		/// Copy the combined values of active samples to the rest of their blocks.
+		void fillStrideBlocks();
 }; 
 
 /// Intrusive reference counted pointer to a pixel class.
@@ -400,7 +476,8 @@ inline SqSampleData::SqSampleData()
 	detailLevel(0),
 	data(),
 	occludingHit(),
-	occlZ(FLT_MAX)
+	occlZ(FLT_MAX),
+	isActive(true)
 { }
 
 
@@ -421,6 +498,24 @@ inline TqInt CqImagePixel::numSamples() const
 	return m_XSamples*m_YSamples;
 }
 
+inline TqInt CqImagePixel::sampleStride() const
+{
+	return m_sampleStride;
+}
+
+inline TqInt CqImagePixel::strideBlockSample(TqInt bx, TqInt by) const
+{
+	TqInt s = m_sampleStride;
+	TqInt x = bx*s;
+	TqInt y = by*s;
+	// Stagger the sample position within the block.  Sample times increase
+	// with the sample index, so this spreads the chosen samples over the
+	// shutter interval rather than just the beginning of each row of blocks.
+	x += std::min(by % s, m_XSamples - x - 1);
+	y += std::min(bx % s, m_YSamples - y - 1);
+	return y*m_XSamples + x;
+}
+
 inline TqInt CqImagePixel::GetDofOffsetIndex(TqInt i) const
 {
 	return m_DofOffsetIndices[i];
@@ -469,6 +564,13 @@ inline TqFloat* CqImagePixel::sampleHitData(const SqImageSample& hit)
 inline void CqImagePixel::allocateHitData(SqImageSample& hit)
 {
 	assert(hit.index == -1);
+	if(!m_freeHitSamples.empty())
+	{
+		// Reuse the storage of a hit which was culled.
+		hit.index = m_freeHitSamples.back();
+		m_freeHitSamples.pop_back();
+		return;
+	}
 	// Using a std::vector for m_hitSamples allows the sample size to grow as
 	// necessary with O(log(N)) reallocations for N hits.  The reallocation
 	// time is irrelevant when CqImagePixel's are recycled through the pipeline
@@ -511,6 +613,11 @@ inline bool CqImagePixel::hasValidSamples()
 	return m_hasValidSamples;
 }
 
+inline void CqImagePixel::markHasCSGHits()
+{
+	m_hasCSGHits = true;
+}
+
 //------------------------------------------------------------------------------
 // CqPixelPool implementation
 inline CqPixelPool::CqPixelPool(TqInt xSamples, TqInt ySamples)
@@ -0,0 +1,95 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file
+		\brief Implements the running hash of the scene description.
+*/
+
+#include	"inputsignature.h"
+
+#include	<cassert>
+
+namespace Aqsis {
+
+namespace {
+
+// Parameters of the 64 bit FNV-1a hash.
+const CqInputSignature::TqHash fnvOffsetBasis = 14695981039346656037ULL;
+const CqInputSignature::TqHash fnvPrime = 1099511628211ULL;
+
+} // anon namespace
+
+
+CqInputSignature::CqInputSignature()
+	: m_value(fnvOffsetBasis),
+	m_savedValues()
+{ }
+
+void CqInputSignature::reset()
+{
+	m_value = fnvOffsetBasis;
+	m_savedValues.clear();
+}
+
+void CqInputSignature::push()
+{
+	m_savedValues.push_back(m_value);
+}
+
+void CqInputSignature::pop()
+{
+	// Unbalanced blocks are reported by the validation filter; just ignore
+	// them here.
+	if(m_savedValues.empty())
+		return;
+	m_value = m_savedValues.back();
+	m_savedValues.pop_back();
+}
+
+CqInputSignature::TqHash CqInputSignature::combine(TqHash a, TqHash b)
+{
+	return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+}
+
+CqInputSignature::int_type CqInputSignature::overflow(int_type c)
+{
+	if(!traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		m_value ^= static_cast<unsigned char>(traits_type::to_char_type(c));
+		m_value *= fnvPrime;
+	}
+	return traits_type::not_eof(c);
+}
+
+std::streamsize CqInputSignature::xsputn(const char* s, std::streamsize n)
+{
+	TqHash value = m_value;
+	for(std::streamsize i = 0; i < n; ++i)
+	{
+		value ^= static_cast<unsigned char>(s[i]);
+		value *= fnvPrime;
+	}
+	m_value = value;
+	return n;
+}
+
+} // namespace Aqsis
@@ -0,0 +1,92 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file
+		\brief Declares a running hash of the scene description fed to the renderer.
+*/
+
+#ifndef INPUTSIGNATURE_H_INCLUDED //{
+#define INPUTSIGNATURE_H_INCLUDED 1
+
+#include	<aqsis/aqsis.h>
+
+#include	<streambuf>
+#include	<vector>
+
+#include	<boost/cstdint.hpp>
+#include	<boost/noncopyable.hpp>
+
+namespace Aqsis {
+
+//------------------------------------------------------------------------------
+/** \brief Running hash of the interface calls which make up a scene.
+ *
+ * The signature is a stream buffer, so that the interface calls can be
+ * serialised into it by a RIB writer.  The bytes written are hashed as they
+ * arrive, and are not stored.
+ *
+ * Scoped blocks such as AttributeBegin/AttributeEnd should be bracketed by
+ * push() and pop(), so that the contents of a block don't change the
+ * signature of anything which follows it.  The value() at any point then
+ * identifies the calls which may have affected a gprim created there.
+ */
+class CqInputSignature : public std::streambuf, boost::noncopyable
+{
+	public:
+		typedef boost::uint64_t TqHash;
+
+		CqInputSignature();
+
+		/// Forget all input written so far.
+		void reset();
+		/// Save the current value, to be restored by the matching pop().
+		void push();
+		/// Restore the value saved by the last unmatched push().
+		void pop();
+		/// Get the hash of the input written so far.
+		TqHash value() const;
+
+		/// Combine two hashes.  The result depends on the order of a and b.
+		static TqHash combine(TqHash a, TqHash b);
+
+	protected:
+		virtual int_type overflow(int_type c);
+		virtual std::streamsize xsputn(const char* s, std::streamsize n);
+
+	private:
+		TqHash m_value;
+		std::vector<TqHash> m_savedValues;
+};
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+
+inline CqInputSignature::TqHash CqInputSignature::value() const
+{
+	return m_value;
+}
+
+} // namespace Aqsis
+
+#endif // INPUTSIGNATURE_H_INCLUDED
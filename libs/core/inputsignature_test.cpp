@@ -0,0 +1,89 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file Unit tests for the running hash of the scene description.
+ */
+
+#include "inputsignature.h"
+
+#include <ostream>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(inputsignature_tests)
+
+using namespace Aqsis;
+
+BOOST_AUTO_TEST_CASE(CqInputSignature_same_input)
+{
+	CqInputSignature sig1;
+	CqInputSignature sig2;
+	BOOST_CHECK_EQUAL(sig1.value(), sig2.value());
+
+	std::ostream out1(&sig1);
+	std::ostream out2(&sig2);
+	out1 << "Sphere 1 -1 1 360\n";
+	// Writing in pieces gives the same result as writing all at once.
+	out2 << "Sphere 1 " << -1 << ' ' << 1 << " 360\n";
+	BOOST_CHECK_EQUAL(sig1.value(), sig2.value());
+
+	out2 << "Sphere 1 -1 1 180\n";
+	BOOST_CHECK(sig1.value() != sig2.value());
+
+	sig1.reset();
+	sig2.reset();
+	BOOST_CHECK_EQUAL(sig1.value(), sig2.value());
+}
+
+BOOST_AUTO_TEST_CASE(CqInputSignature_push_pop)
+{
+	CqInputSignature sig;
+	std::ostream out(&sig);
+	out << "Surface \"plastic\"\n";
+	CqInputSignature::TqHash outer = sig.value();
+
+	sig.push();
+	out << "Color 1 0 0\n";
+	CqInputSignature::TqHash inner = sig.value();
+	BOOST_CHECK(inner != outer);
+	sig.push();
+	out << "Sphere 1 -1 1 360\n";
+	sig.pop();
+	BOOST_CHECK_EQUAL(sig.value(), inner);
+	sig.pop();
+	BOOST_CHECK_EQUAL(sig.value(), outer);
+
+	// Unbalanced pops leave the value alone.
+	sig.pop();
+	BOOST_CHECK_EQUAL(sig.value(), outer);
+}
+
+BOOST_AUTO_TEST_CASE(CqInputSignature_combine)
+{
+	CqInputSignature::TqHash a = 1;
+	CqInputSignature::TqHash b = 2;
+	BOOST_CHECK(CqInputSignature::combine(a, b) != CqInputSignature::combine(b, a));
+	BOOST_CHECK(CqInputSignature::combine(a, b) != a);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
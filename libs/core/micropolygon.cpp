@@ -45,9 +45,9 @@ CqObjectPool<CqMovingMicroPolygonKey>	CqMovingMicroPolygonKey::m_thePool;
 
 void CqMicroPolyGridBase::CacheGridInfo(const boost::shared_ptr<const CqSurface>& surface)
 {
-	const IqAttributes& attrs = *pAttributes();
+	const SqAttributeCache& attrs = surface->attributeCache();
 	// Determine the matte flag type.
-	switch(attrs.GetIntegerAttribute("System", "Matte")[0])
+	switch(attrs.matte)
 	{
 		case 0:  m_CurrentGridInfo.matteFlag = 0;                              break;
 		default: m_CurrentGridInfo.matteFlag = SqImageSample::Flag_Matte;      break;
@@ -55,14 +55,12 @@ void CqMicroPolyGridBase::CacheGridInfo(const boost::shared_ptr<const CqSurface>
 	}
 
 	// Cache the shading interpolation type.
-	m_CurrentGridInfo.useSmoothShading = attrs.GetIntegerAttribute("System",
-			"ShadingInterpolation")[0] == ShadingInterp_Smooth;
+	m_CurrentGridInfo.useSmoothShading = attrs.smoothShading;
 
 	m_CurrentGridInfo.usesDataMap
 		= !(QGetRenderContext() ->GetMapOfOutputDataEntries().empty());
 
-	m_CurrentGridInfo.lodBounds
-		= attrs.GetFloatAttribute("System", "LevelOfDetailBounds");
+	m_CurrentGridInfo.lodBounds = attrs.lodBounds;
 }
 
 
@@ -73,7 +71,8 @@ void CqMicroPolyGridBase::CacheGridInfo(const boost::shared_ptr<const CqSurface>
 CqMicroPolyGrid::CqMicroPolyGrid() : CqMicroPolyGridBase(),
 		m_bShadingNormals( false ),
 		m_bGeometricNormals( false ), 
-		m_pShaderExecEnv(IqShaderExecEnv::create(QGetRenderContextI()))
+		m_pShaderExecEnv(IqShaderExecEnv::create(QGetRenderContextI())),
+		m_memoryUsage( 0 )
 {
 	STATS_INC( GRD_allocated );
 	STATS_INC( GRD_current );
@@ -94,6 +93,7 @@ CqMicroPolyGrid::~CqMicroPolyGrid()
 
 	STATS_INC( GRD_deallocated );
 	STATS_DEC( GRD_current );
+	CqStats::freeMemory( EqMemoryStats::Grids, m_memoryUsage );
 
 	// Delete any cloned shader output variables.
 	std::vector<IqShaderData*>::iterator outputVar;
@@ -146,6 +146,19 @@ void CqMicroPolyGrid::Initialise( TqInt cu, TqInt cv, const boost::shared_ptr<Cq
 	TqInt size = numMicroPolygons(cu, cv);
 	CacheGridInfo(pSurface);
 
+	// Most of the storage for a grid is in the shader variables, so estimate
+	// it as a vector per shading point for each standard variable used.
+	TqInt numVars = 0;
+	for ( TqInt var = 0; var < EnvVars_Last; ++var )
+	{
+		if ( USES( lUses, var ) )
+			++numVars;
+	}
+	CqStats::freeMemory( EqMemoryStats::Grids, m_memoryUsage );
+	m_memoryUsage = sizeof(CqMicroPolyGrid)
+		+ numShadingPoints(cu, cv) * numVars * sizeof(CqVector3D);
+	CqStats::allocMemory( EqMemoryStats::Grids, m_memoryUsage );
+
 	STATS_INC( GRD_size_4 + clamp<TqInt>(CqStats::stats_log2(size) - 2, 0, 7) );
 }
 
@@ -178,7 +191,7 @@ void CqMicroPolyGrid::CalcNormals()
 	// of the cross product must be reversed if the formula is to give the
 	// correct normal after RiScale(1,1,-1) or similar transformations.
 	bool CSO = this->pSurface()->pTransform()->GetHandedness(this->pSurface()->pTransform()->Time(0));
-	bool O = pAttributes() ->GetIntegerAttribute( "System", "Orientation" ) [ 0 ] != 0;
+	bool O = pSurface() ->attributeCache().orientation;
 	bool flipNormals = O ^ CSO;
 
 	const CqVector3D* pP = 0;
@@ -353,9 +366,9 @@ void CqMicroPolyGrid::Shade( bool canCullGrid )
 	TqInt gsmin1 = gs - 1;
 
 	// Expand grids to prevent grid cracking if enabled
-	const TqFloat* gridExpand = pAttributes()->GetFloatAttribute("aqsis", "expandgrids");
-	if(gridExpand && *gridExpand > 0)
-		ExpandGridBoundaries(*gridExpand);
+	TqFloat gridExpand = pSurface()->attributeCache().expandGrids;
+	if(gridExpand > 0)
+		ExpandGridBoundaries(gridExpand);
 
 	// Calculate geometric normals if not specified by the surface.
 	if ( !bGeometricNormals() && USES( lUses, EnvVars_Ng ) )
@@ -429,8 +442,8 @@ void CqMicroPolyGrid::Shade( bool canCullGrid )
 	}
 
 	// Now try and cull any hidden MPs if Sides==1
-	if ( ( pAttributes() ->GetIntegerAttribute( "System", "Sides" ) [ 0 ] == 1 ) && !m_pCSGNode &&
-		 ( pAttributes() ->GetIntegerAttributeDef( "cull", "backfacing", 1 ) == 1 ) )
+	const SqAttributeCache& attrCache = pSurface() ->attributeCache();
+	if ( attrCache.sides == 1 && !m_pCSGNode && attrCache.cullBackfacing )
 	{
 		AQSIS_TIME_SCOPE(Backface_culling);
 
@@ -752,11 +765,7 @@ void CqMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 
 	AQSIS_TIMER_START(Bust_grids);
 	// Get the required trim curve sense, if specified, defaults to "inside".
-	const CqString* pattrTrimSense = pAttributes() ->GetStringAttribute( "trimcurve", "sense" );
-	CqString strTrimSense( "inside" );
-	if ( pattrTrimSense != 0 )
-		strTrimSense = pattrTrimSense[ 0 ];
-	bool bOutside = strTrimSense == "outside";
+	bool bOutside = pSurface() ->attributeCache().trimOutside;
 
 	// Determine whether we need to bother with trimming or not.
 	bool bCanBeTrimmed = pSurface() ->bCanBeTrimmed() && NULL != pVar(EnvVars_u) && NULL != pVar(EnvVars_v);
@@ -956,8 +965,9 @@ void CqMotionMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 	CqMatrix matCameraToRaster;
 	QGetRenderContext() ->matSpaceToSpace( "camera", "raster", NULL, NULL, QGetRenderContext()->Time(), matCameraToRaster );
 	// Check to see if this surface is single sided, if so, we can do backface culling.
-	bool canBeBFCulled = ( pAttributes() ->GetIntegerAttribute( "System", "Sides" ) [ 0 ] == 1 ) && !pGridA->usesCSG() &&
-						 ( pAttributes() ->GetIntegerAttributeDef( "cull", "backfacing", 1 ) == 1 );
+	const SqAttributeCache& attrCache = pSurface() ->attributeCache();
+	bool canBeBFCulled = attrCache.sides == 1 && !pGridA->usesCSG() &&
+						 attrCache.cullBackfacing;
 
 	ADDREF( pGridA );
 
@@ -1054,11 +1064,7 @@ void CqMotionMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 
 	AQSIS_TIMER_START(Bust_grids);
 	// Get the required trim curve sense, if specified, defaults to "inside".
-	const CqString* pattrTrimSense = pAttributes() ->GetStringAttribute( "trimcurve", "sense" );
-	CqString strTrimSense( "inside" );
-	if ( pattrTrimSense != 0 )
-		strTrimSense = pattrTrimSense[ 0 ];
-	bool bOutside = strTrimSense == "outside";
+	bool bOutside = pSurface() ->attributeCache().trimOutside;
 
 	// Determine whether we need to bother with trimming or not.
 	bool bCanBeTrimmed = pSurface() ->bCanBeTrimmed() && NULL != pGridA->pVar(EnvVars_u) && NULL != pGridA->pVar(EnvVars_v);
@@ -1167,6 +1173,7 @@ CqMicroPolygon::CqMicroPolygon(CqMicroPolyGridBase* pGrid, TqInt Index ) : m_pGr
 	TqInt cMPG = STATS_GETI( MPG_current );
 	TqInt cPeak = STATS_GETI( MPG_peak );
 	STATS_SETI( MPG_peak, cMPG > cPeak ? cMPG : cPeak );
+	CqStats::allocMemory( EqMemoryStats::Micropolygons, sizeof(CqMicroPolygon) );
 	ADDREF(pGrid);
 }
 
@@ -1181,6 +1188,7 @@ CqMicroPolygon::~CqMicroPolygon()
 		RELEASEREF( m_pGrid );
 	STATS_INC( MPG_deallocated );
 	STATS_DEC( MPG_current );
+	CqStats::freeMemory( EqMemoryStats::Micropolygons, sizeof(CqMicroPolygon) );
 	if ( !IsHit() )
 		STATS_INC( MPG_missed );
 }
@@ -1594,11 +1602,7 @@ bool CqMicroPolygon::Sample( CqHitTestCache& hitTestCache, SqSampleData const& s
 		if ( IsTrimmed() )
 		{
 			// Get the required trim curve sense, if specified, defaults to "inside".
-			const CqString * pattrTrimSense = pGrid() ->pAttributes() ->GetStringAttribute( "trimcurve", "sense" );
-			CqString strTrimSense( "inside" );
-			if ( pattrTrimSense != 0 )
-				strTrimSense = pattrTrimSense[ 0 ];
-			bool bOutside = strTrimSense == "outside";
+			bool bOutside = pGrid() ->pSurface() ->attributeCache().trimOutside;
 
 			TqFloat u, v;
 
@@ -91,6 +91,8 @@ struct SqMpgSampleInfo
 	bool smoothInterpolation;
 	/// True when samples hitting the micropolygon are occlusion cullable
 	bool isCullable;
+	/// True when hits hidden behind semitransparent layers may be culled
+	bool isOpacityCullable;
 	/// True when the micropolygon is fully opaque
 	bool isOpaque;
 };
@@ -388,6 +390,7 @@ class CqMicroPolyGrid : public CqMicroPolyGridBase
 		std::vector<IqShaderData*>	m_apShaderOutputVariables;	///< Vector of pointers to shader output variables.
 	protected:
 		boost::shared_ptr<IqShaderExecEnv> m_pShaderExecEnv;	///< Pointer to the shader execution environment for this grid.
+		TqInt m_memoryUsage;	///< Estimated bytes used, as accounted in CqStats.
 
 }
 ;
@@ -21,6 +21,8 @@
 
 #include "optioncache.h"
 
+#include <algorithm>
+
 #include <aqsis/util/logging.h>
 #include <aqsis/util/sstring.h>
 
@@ -42,7 +44,10 @@ SqOptionCache::SqOptionCache()
 	maxEyeSplits(1),
 	displayMode(DMode_None),
 	depthFilter(Filter_Min),
-	zThreshold()
+	zThreshold(),
+	oThreshold(1.0f),
+	adaptiveStride(1),
+	adaptiveThreshold(0.05f)
 { }
 
 void SqOptionCache::cacheOptions(const IqOptions& opts)
@@ -114,6 +119,23 @@ void SqOptionCache::cacheOptions(const IqOptions& opts)
 	zThreshold = CqColor(1.0f);
 	if(const CqColor* zTh = opts.GetColorOption("limits", "zthreshold"))
 		zThreshold = zTh[0];
+
+	// Cache othreshold.  Hits behind layers of semitransparent surfaces whose
+	// accumulated opacity reaches this value are discarded.  The default of
+	// 1,1,1 only discards hits which can't possibly be seen.
+	oThreshold = CqColor(1.0f);
+	if(const CqColor* oTh = opts.GetColorOption("limits", "othreshold"))
+		oThreshold = oTh[0];
+
+	// Adaptive sampling.  The initial samples are spaced adaptiveStride
+	// subpixels apart, but there's no point unless they leave at least two
+	// samples in each direction to compare against each other.
+	adaptiveStride = 1;
+	if(const TqInt* adaptive = opts.GetIntegerOption("Hider", "adaptive"))
+		adaptiveStride = std::max(1, std::min(adaptive[0], std::min(xSamps, ySamps)/2));
+	adaptiveThreshold = 0.05f;
+	if(const TqFloat* adaptThresh = opts.GetFloatOption("Hider", "adaptivethreshold"))
+		adaptiveThreshold = adaptThresh[0];
 }
 
 } // namespace Aqsis
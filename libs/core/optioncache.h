@@ -67,6 +67,10 @@ struct SqOptionCache
 
 	EqDepthFilter depthFilter; ///< Type of depth filter to use
 	CqColor zThreshold; ///< Opacity threshold for inclusion in depth maps
+	CqColor oThreshold; ///< Accumulated opacity beyond which hits are hidden
+
+	TqInt adaptiveStride; ///< Subpixel spacing of initial adaptive samples (1 = off)
+	TqFloat adaptiveThreshold; ///< Sample contrast above which pixels are refined
 
 	/// Initialise all options to non-catastrophic defaults.
 	SqOptionCache();
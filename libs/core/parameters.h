@@ -29,6 +29,7 @@
 
 #include	<aqsis/aqsis.h>
 
+#include	<cstring>
 #include	<vector>
 
 #include	<boost/shared_ptr.hpp>
@@ -38,6 +39,7 @@
 #include	<aqsis/shadervm/ishaderdata.h>
 #include	<aqsis/core/iparameter.h>
 #include	"bilinear.h"
+#include	"sharedvalues.h"
 #include	<aqsis/riutil/primvartoken.h>
 #include	<aqsis/math/vectorcast.h>
 
@@ -55,6 +57,23 @@ namespace Aqsis {
 template<typename SLT, typename T>
 SLT paramToShaderType(const T& paramVal);
 
+/** \brief Compare two single parameter values.
+ *
+ * Used to find attribute states holding the same values; see
+ * CqAttributes::Intern().
+ */
+template<typename T>
+bool paramValueEqual(const T& a, const T& b);
+/** \brief Hash a single parameter value, consistently with paramValueEqual().
+ */
+TqUlong paramValueHash(TqFloat f);
+TqUlong paramValueHash(TqInt i);
+TqUlong paramValueHash(const CqString& s);
+TqUlong paramValueHash(const CqColor& c);
+TqUlong paramValueHash(const CqVector3D& v);
+TqUlong paramValueHash(const CqVector4D& v);
+TqUlong paramValueHash(const CqMatrix& m);
+
 //----------------------------------------------------------------------
 /** \class CqParameter
  * Class storing a parameter with a name and value.
@@ -144,6 +163,23 @@ class CqParameter : public IqParameter
 		 */
 		virtual	void	SetValue(const CqParameter* pFrom, TqInt idxTarget, TqInt idxSource ) = 0;
 
+		/** Compare the values held by two parameters.
+		 * Only the uniform classes, which attributes are stored in, are
+		 * compared; other parameters never compare equal.
+		 * \param From Parameter to compare with.
+		 * \return true if From has the same name, class, type and values.
+		 */
+		virtual	bool	ValuesEqual( const CqParameter& From ) const
+		{
+			return ( false );
+		}
+		/** Get a hash of the parameter name and values, consistent with ValuesEqual().
+		 */
+		virtual	TqUlong	ValuesHash() const
+		{
+			return ( m_hash );
+		}
+
 		/** Get a reference to the parameter name.
 		 */
 		const	CqString& strName() const
@@ -211,6 +247,33 @@ class CqParameterTyped : public CqParameter
 		}
 
 	protected:
+		/** Compare the first count values with those of another parameter.
+		 */
+		bool	ValuesEqual( const CqParameter& From, TqInt count ) const
+		{
+			if ( From.hash() != this->hash() || From.Class() != this->Class() ||
+			     From.Type() != this->Type() || From.Count() != this->Count() ||
+			     From.Size() != this->Size() )
+				return ( false );
+			const T* values = pValue();
+			const T* fromValues = static_cast<const CqParameterTyped<T, SLT>&>( From ).pValue();
+			for ( TqInt i = 0; i < count; ++i )
+			{
+				if ( !paramValueEqual( values[ i ], fromValues[ i ] ) )
+					return ( false );
+			}
+			return ( true );
+		}
+		/** Hash the name and first count values.
+		 */
+		TqUlong	ValuesHash( TqInt count ) const
+		{
+			TqUlong h = this->hash();
+			const T* values = pValue();
+			for ( TqInt i = 0; i < count; ++i )
+				h = h * 31 + paramValueHash( values[ i ] );
+			return ( h );
+		}
 };
 
 
@@ -333,15 +396,8 @@ class CqParameterTypedVarying : public CqParameterTyped<T, SLT>
 		 */
 		CqParameterTypedVarying<T, I, SLT>& operator=( const CqParameterTypedVarying<T, I, SLT>& From )
 		{
-
-			TqInt size = From.m_aValues.size();
-
-			m_aValues.resize( size );
-
-			for ( TqUint j = 0; j < (TqUint) size; j++ )
-			{
-				m_aValues[ j ] = From.m_aValues[ j ];
-			}
+			// The values are shared until one of the copies is written.
+			m_aValues = From.m_aValues;
 			return ( *this );
 		}
 
@@ -355,7 +411,7 @@ class CqParameterTypedVarying : public CqParameterTyped<T, SLT>
 		}
 
 	private:
-		std::vector<T>	m_aValues;		///< Vector of values, one per varying index.
+		CqSharedValues<T>	m_aValues;		///< Vector of values, one per varying index.
 }
 ;
 
@@ -410,6 +466,14 @@ class CqParameterTypedUniform : public CqParameterTyped<T, SLT>
 		{
 			m_aValues.clear();
 		}
+		virtual	bool	ValuesEqual( const CqParameter& From ) const
+		{
+			return ( CqParameterTyped<T, SLT>::ValuesEqual( From, m_aValues.size() ) );
+		}
+		virtual	TqUlong	ValuesHash() const
+		{
+			return ( CqParameterTyped<T, SLT>::ValuesHash( m_aValues.size() ) );
+		}
 
 		virtual void	Subdivide( CqParameter* pResult1, CqParameter* pResult2, bool u, IqSurface* pSurface = 0 )
 		{
@@ -919,7 +983,8 @@ class CqParameterTypedVaryingArray : public CqParameterTyped<T, SLT>
 		CqParameterTypedVaryingArray<T, I, SLT>& operator=( const CqParameterTypedVaryingArray<T, I, SLT>& From )
 		{
 			m_size = From.m_size;
-			m_aValues.assign(From.m_aValues.begin(), From.m_aValues.end());
+			// The values are shared until one of the copies is written.
+			m_aValues = From.m_aValues;
 			return ( *this );
 		}
 
@@ -934,7 +999,7 @@ class CqParameterTypedVaryingArray : public CqParameterTyped<T, SLT>
 
 	private:
 		TqInt m_size;  ///< number of values stored ( == m_aValues.size()/m_Count )
-		std::vector<T>	m_aValues;		///< Array of varying values.
+		CqSharedValues<T>	m_aValues;		///< Array of varying values.
 }
 ;
 
@@ -988,6 +1053,14 @@ class CqParameterTypedUniformArray : public CqParameterTyped<T, SLT>
 		}
 		virtual	void	Clear()
 		{}
+		virtual	bool	ValuesEqual( const CqParameter& From ) const
+		{
+			return ( CqParameterTyped<T, SLT>::ValuesEqual( From, this->m_Count ) );
+		}
+		virtual	TqUlong	ValuesHash() const
+		{
+			return ( CqParameterTyped<T, SLT>::ValuesHash( this->m_Count ) );
+		}
 
 		virtual void	Subdivide( CqParameter* pResult1, CqParameter* pResult2, bool u, IqSurface* pSurface = 0 )
 		{}
@@ -1376,6 +1449,9 @@ class CqParameterTypedFaceVertexArray : public CqParameterTypedVertexArray<T, I,
 template <class T, EqVariableType I, class SLT>
 void CqParameterTypedVarying<T, I, SLT>::Dice( TqInt u, TqInt v, IqShaderData* pResult, IqSurface* pSurface )
 {
+	// Read through a const reference, so that dicing doesn't unshare values
+	// which are shared with a clone.
+	const CqParameterTypedVarying<T, I, SLT>& self = *this;
 	assert( pResult->Type() == this->Type() );
 
 	// Check if the target is a varying variable, if not, this is an error.
@@ -1406,10 +1482,10 @@ void CqParameterTypedVarying<T, I, SLT>::Dice( TqInt u, TqInt v, IqShaderData* p
 			TqInt iu;
 			for ( iu = 0; iu <= u; iu++ )
 			{
-				res = BilinearEvaluate<T>( pValue( 0 ) [ 0 ],
-				                           pValue( 1 ) [ 0 ],
-				                           pValue( 2 ) [ 0 ],
-				                           pValue( 3 ) [ 0 ],
+				res = BilinearEvaluate<T>( self.pValue( 0 ) [ 0 ],
+				                           self.pValue( 1 ) [ 0 ],
+				                           self.pValue( 2 ) [ 0 ],
+				                           self.pValue( 3 ) [ 0 ],
 				                           iu * diu, iv * div );
 				( *pResData++ ) = paramToShaderType<SLT,T>(res);
 			}
@@ -1418,7 +1494,7 @@ void CqParameterTypedVarying<T, I, SLT>::Dice( TqInt u, TqInt v, IqShaderData* p
 	else
 	{
 		TqInt iv;
-		res = pValue( 0 ) [ 0 ];
+		res = self.pValue( 0 ) [ 0 ];
 		for ( iv = 0; iv <= v; iv++ )
 		{
 			TqInt iu;
@@ -1454,6 +1530,7 @@ void CqParameterTypedVarying<T, I, SLT>::CopyToShaderVariable( IqShaderData* pRe
 template <class T, EqVariableType I, class SLT>
 void CqParameterTypedVaryingArray<T, I, SLT>::Dice( TqInt u, TqInt v, IqShaderData* pResult, IqSurface* pSurface )
 {
+	const CqParameterTypedVaryingArray<T, I, SLT>& self = *this;
 	assert( pResult->Type() == this->Type() );
 	assert( pResult->Class() == class_varying );
 	assert( pResult->Size() == Size() );
@@ -1482,10 +1559,10 @@ void CqParameterTypedVaryingArray<T, I, SLT>::Dice( TqInt u, TqInt v, IqShaderDa
 			{
 				for( arrayIndex = 0; arrayIndex < this->Count(); arrayIndex++ )
 				{
-					res = BilinearEvaluate<T>( pValue( 0 ) [ arrayIndex ],
-								   pValue( 1 ) [ arrayIndex ],
-								   pValue( 2 ) [ arrayIndex ],
-								   pValue( 3 ) [ arrayIndex ],
+					res = BilinearEvaluate<T>( self.pValue( 0 ) [ arrayIndex ],
+								   self.pValue( 1 ) [ arrayIndex ],
+								   self.pValue( 2 ) [ arrayIndex ],
+								   self.pValue( 3 ) [ arrayIndex ],
 								   iu * diu, iv * div );
 					( *(pResData[arrayIndex])++ ) = paramToShaderType<SLT,T>(res);
 				}
@@ -1523,6 +1600,7 @@ void CqParameterTypedVaryingArray<T, I, SLT>::CopyToShaderVariable( IqShaderData
 template <class T, EqVariableType I, class SLT>
 void CqParameterTypedVaryingArray<T, I, SLT>::DiceOne( TqInt u, TqInt v, IqShaderData* pResult, IqSurface* pSurface, TqInt ArrayIndex )
 {
+	const CqParameterTypedVaryingArray<T, I, SLT>& self = *this;
 	assert( pResult->Type() == this->Type() );
 	assert( pResult->Class() == class_varying );
 	assert( this->Count() > ArrayIndex );
@@ -1546,10 +1624,10 @@ void CqParameterTypedVaryingArray<T, I, SLT>::DiceOne( TqInt u, TqInt v, IqShade
 			TqInt iu;
 			for ( iu = 0; iu <= u; iu++ )
 			{
-				res = BilinearEvaluate<T>( pValue( 0 ) [ ArrayIndex ],
-				                           pValue( 1 ) [ ArrayIndex ],
-				                           pValue( 2 ) [ ArrayIndex ],
-				                           pValue( 3 ) [ ArrayIndex ],
+				res = BilinearEvaluate<T>( self.pValue( 0 ) [ ArrayIndex ],
+				                           self.pValue( 1 ) [ ArrayIndex ],
+				                           self.pValue( 2 ) [ ArrayIndex ],
+				                           self.pValue( 3 ) [ ArrayIndex ],
 				                           iu * diu, iv * div );
 				( *pResData++ ) = paramToShaderType<SLT,T>(res);
 			}
@@ -1637,6 +1715,31 @@ class CqNamedParameterList
 		{
 			return m_hash;
 		}
+		/** Compare the parameters held by two lists.
+		 * \return true if both lists hold parameters with the same names and values.
+		 */
+		bool	ValuesEqual( const CqNamedParameterList& From ) const
+		{
+			if ( m_hash != From.m_hash || m_aParameters.size() != From.m_aParameters.size() )
+				return ( false );
+			for ( std::vector<CqParameter*>::const_iterator i = m_aParameters.begin(); i != m_aParameters.end(); i++ )
+			{
+				const CqParameter* pFrom = From.pParameter( ( *i ) ->strName().c_str() );
+				if ( !pFrom || !( *i ) ->ValuesEqual( *pFrom ) )
+					return ( false );
+			}
+			return ( true );
+		}
+		/** Get a hash of the list, consistent with ValuesEqual().
+		 */
+		TqUlong	ValuesHash() const
+		{
+			// Parameters may be held in any order, so their hashes are summed.
+			TqUlong h = m_hash;
+			for ( std::vector<CqParameter*>::const_iterator i = m_aParameters.begin(); i != m_aParameters.end(); i++ )
+				h += ( *i ) ->ValuesHash();
+			return ( h );
+		}
 	private:
 		CqString	m_strName;			///< The name of this parameter list.
 		std::vector<CqParameter*>	m_aParameters;		///< A vector of name/value parameters.
@@ -1982,6 +2085,65 @@ inline CqVector3D paramToShaderType(const CqVector4D& paramVal)
 	return vectorCast<CqVector3D>(paramVal);
 }
 
+template<typename T>
+inline bool paramValueEqual(const T& a, const T& b)
+{
+	return a == b;
+}
+
+template<>
+inline bool paramValueEqual(const CqVector4D& a, const CqVector4D& b)
+{
+	return a.x() == b.x() && a.y() == b.y() && a.z() == b.z() && a.h() == b.h();
+}
+
+inline TqUlong paramValueHash(TqFloat f)
+{
+	// Hash the bits, taking care that 0 and -0 compare equal.
+	if(f == 0)
+		return 0;
+	TqUint32 bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+inline TqUlong paramValueHash(TqInt i)
+{
+	return static_cast<TqUlong>(i);
+}
+
+inline TqUlong paramValueHash(const CqString& s)
+{
+	return CqString::hash(s.c_str());
+}
+
+inline TqUlong paramValueHash(const CqColor& c)
+{
+	return (paramValueHash(c.r())*31 + paramValueHash(c.g()))*31
+		+ paramValueHash(c.b());
+}
+
+inline TqUlong paramValueHash(const CqVector3D& v)
+{
+	return (paramValueHash(v.x())*31 + paramValueHash(v.y()))*31
+		+ paramValueHash(v.z());
+}
+
+inline TqUlong paramValueHash(const CqVector4D& v)
+{
+	return ((paramValueHash(v.x())*31 + paramValueHash(v.y()))*31
+		+ paramValueHash(v.z()))*31 + paramValueHash(v.h());
+}
+
+inline TqUlong paramValueHash(const CqMatrix& m)
+{
+	TqUlong h = 0;
+	for(TqInt i = 0; i < 4; ++i)
+		for(TqInt j = 0; j < 4; ++j)
+			h = h*31 + paramValueHash(m[i][j]);
+	return h;
+}
+
 
 } // namespace Aqsis
 
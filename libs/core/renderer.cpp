@@ -25,10 +25,12 @@
 
 #include	<aqsis/aqsis.h>
 
+#include	<cmath>
 #include	<cstring> // for memcmp, strcmp
 #include	<time.h>
 #include	<boost/bind.hpp>
 #include	<boost/filesystem/fstream.hpp>
+#include	<boost/filesystem/operations.hpp>
 
 #include	"imagebuffer.h"
 #include	"lights.h"
@@ -40,6 +42,7 @@
 #include	"transform.h"
 #include	"texturemap_old.h"
 #include	<aqsis/shadervm/ishader.h>
+#include	<aqsis/util/file.h>
 #include	"tiffio.h"
 
 
@@ -101,11 +104,19 @@ CqRenderer::CqRenderer()
 	m_pRaytracer(CreateRaytracer()),
 	m_clippingVolume(),
 	m_aWorld(),
+	m_aWorldSignatures(),
 	m_cropWindowXMin(0),
 	m_cropWindowXMax(0),
 	m_cropWindowYMin(0),
 	m_cropWindowYMax(0),
-	m_aCoordSystems(CoordSystem_Last)
+	m_aCoordSystems(CoordSystem_Last),
+	m_inputSignature(),
+	m_incremental(false),
+	m_fileGenerations(),
+	m_oldMapFilesRead(),
+	m_sessionFilesRead(),
+	m_fileSources(),
+	m_renderingWorld(false)
 {
 	m_pDDManager->Initialise();
 
@@ -668,6 +679,25 @@ void	CqRenderer::ptransConcatCurrentTime( const CqMatrix& matTrans )
  */
 
 void CqRenderer::RenderWorld(bool clone)
+{
+	if(!clone)
+	{
+		const TqFloat* separation = GetFloatOption("stereo", "eyeseparation");
+		if(separation && separation[0] > 0)
+		{
+			RenderStereo(separation[0]);
+			return;
+		}
+	}
+	RenderView(clone, !clone);
+}
+
+
+//----------------------------------------------------------------------
+/** Render the world as seen from the current camera.
+ */
+
+void CqRenderer::RenderView(bool clone, bool previews)
 {
 	// While rendering, all primitives should fasttrack straight into the pipeline, 
 	// and shaders should automatically initialise, the easiest way to ensure this
@@ -679,29 +709,160 @@ void CqRenderer::RenderWorld(bool clone)
 		multiPass = pMultipass[0];
 		pMultipass[0] = 0;
 	}
+	m_renderingWorld = true;
 
 	initialiseCropWindow();
 
 	// Ensure that the camera and projection matrices are initialised.
 	poptCurrent()->InitialiseCamera();
-	pImage()->SetImage();
 
 	PrepareShaders();
 
+	m_pDDManager->OpenDisplays(m_cropWindowXMax - m_cropWindowXMin, m_cropWindowYMax - m_cropWindowYMin);
+
+	if(previews)
+	{
+		if(const TqInt* progressive = GetIntegerOption("Hider", "progressive"))
+			RenderPreviews(progressive[0]);
+	}
+
+	pImage()->SetImage();
 	if(clone)
 		PostCloneOfWorld();
 	else
 		PostWorld();
 
-	m_pDDManager->OpenDisplays(m_cropWindowXMax - m_cropWindowXMin, m_cropWindowYMax - m_cropWindowYMin);
 	pImage() ->RenderImage();
 	m_pDDManager->CloseDisplays();
 
+	m_renderingWorld = false;
 	if(NULL != pMultipass)
 		pMultipass[0] = multiPass;
 }
 
 
+namespace {
+
+/// Get the name of the image of one view of a stereo pair, eg, "out_left.tif".
+std::string viewImageName(const std::string& name, const char* view)
+{
+	std::string::size_type dot = name.rfind('.');
+	std::string::size_type slash = name.find_last_of("/\\");
+	if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		dot = name.size();
+	return name.substr(0, dot) + "_" + view + name.substr(dot);
+}
+
+/// Move a camera sideways by the given distance along its own x axis.
+CqTransformPtr offsetCamera(const CqTransformPtr& camera, TqFloat offset)
+{
+	// The camera transform takes world to camera space, so moving the camera
+	// moves camera space points the other way.
+	CqMatrix shift;
+	shift.Translate(-offset, 0, 0);
+	CqTransformPtr result(new CqTransform(*camera));
+	if(camera->isMoving())
+	{
+		for(TqInt i = 0; i < camera->cTimes(); ++i)
+		{
+			TqFloat time = camera->Time(i);
+			result->SetCurrentTransform(time, shift * camera->matObjectToWorld(time));
+		}
+	}
+	else
+		result->ResetTransform(shift * camera->matObjectToWorld(0), camera->GetHandedness(0));
+	return result;
+}
+
+} // anon namespace
+
+
+//----------------------------------------------------------------------
+/** Render a left and right view of the world.
+ */
+
+void CqRenderer::RenderStereo(TqFloat separation)
+{
+	TqFloat convergence = 0;
+	if(const TqFloat* conv = GetFloatOption("stereo", "convergence"))
+		convergence = conv[0];
+
+	// Each view goes to its own copy of the requested displays.
+	std::vector<std::string> imageNames;
+	for(TqInt i = 0; i < m_pDDManager->numDisplayRequests(); ++i)
+		imageNames.push_back(m_pDDManager->displayRequest(i)->name());
+
+	CqTransformPtr centreCamera = GetCameraTransform();
+	for(TqInt eye = 0; eye < 2; ++eye)
+	{
+		const char* view = eye == 0 ? "left" : "right";
+		TqFloat offset = (eye == 0 ? -0.5f : 0.5f) * separation;
+		Aqsis::log() << info << "Rendering " << view << " view" << std::endl;
+
+		for(TqInt i = 0; i < m_pDDManager->numDisplayRequests(); ++i)
+			m_pDDManager->displayRequest(i)->name() = viewImageName(imageNames[i], view);
+
+		IqOptionsPtr opts = pushOptions();
+		if(convergence > 0 && opts->GetIntegerOption("System", "Projection")[0]
+				== ProjectionPerspective)
+		{
+			// Shift the screen window so that points at the convergence
+			// distance line up in both views.
+			TqFloat s = tan(degToRad(opts->GetFloatOption("System", "FOV")[0])/2.0f);
+			TqFloat shift = -offset/(convergence*s);
+			TqFloat* screenWindow = opts->GetFloatOptionWrite("System", "ScreenWindow", 4);
+			screenWindow[0] += shift;
+			screenWindow[1] += shift;
+		}
+		SetCameraTransform(offsetCamera(centreCamera, offset));
+
+		// The left view renders a clone of the world, so that the right view
+		// can render the world itself.
+		RenderView(eye == 0, true);
+
+		popOptions();
+	}
+	SetCameraTransform(centreCamera);
+
+	for(TqInt i = 0; i < m_pDDManager->numDisplayRequests(); ++i)
+		m_pDDManager->displayRequest(i)->name() = imageNames[i];
+}
+
+
+//----------------------------------------------------------------------
+/** Render coarse previews of the world to the interactive displays.
+ */
+
+void CqRenderer::RenderPreviews(TqInt passes)
+{
+	if(passes <= 0 || m_aWorld.empty() || !m_pDDManager->fDisplayInteractive())
+		return;
+
+	m_pDDManager->SetPreview(true);
+	for(TqInt pass = 0; pass < passes && !pImage()->IsQuit(); ++pass)
+	{
+		Aqsis::log() << info << "Rendering preview pass " << pass + 1
+			<< " of " << passes << std::endl;
+
+		IqOptionsPtr opts = pushOptions();
+
+		// A single sample per pixel, and micropolygons with twice the edge
+		// length of the following pass.
+		opts->GetIntegerOptionWrite( "System", "PixelSamples" ) [ 0 ] = 1;
+		opts->GetIntegerOptionWrite( "System", "PixelSamples" ) [ 1 ] = 1;
+		opts->GetFloatOptionWrite( "System", "ShadingRateScale" ) [ 0 ]
+			= std::ldexp(1.0f, 2*(passes - pass));
+
+		pImage()->SetImage();
+		PostCloneOfWorld();
+		pImage()->RenderImage();
+
+		popOptions();
+	}
+	m_pDDManager->SetPreview(false);
+}
+
+
 //----------------------------------------------------------------------
 /** Render any automatic shadow passes.
  */
@@ -1258,10 +1419,19 @@ boost::shared_ptr<IqShader> CqRenderer::CreateShader(
 
 void CqRenderer::StorePrimitive( const boost::shared_ptr<CqSurface>& pSurface )
 {
+	// Share equal attribute and transform states between primitives, and fill
+	// the attribute cache while only one thread can see the attributes.
+	if ( m_pconCurrent )
+		m_pconCurrent->internState();
+	pSurface->InternState();
+	pSurface->attributeCache();
+
 	// If we are not in a mode that allows 'extra' passes, then fasttrack the primitive directly into the pipeline.
-	const TqInt* pMultipass = GetIntegerOption("Render", "multipass");
-	if(pMultipass && pMultipass[0])
+	if(keepsWorld())
+	{
 		m_aWorld.push_back(pSurface);
+		m_aWorldSignatures.push_back(m_inputSignature.value());
+	}
 	else
 	{
 		CqMatrix matWtoC, matNWtoC, matVWtoC;
@@ -1270,10 +1440,28 @@ void CqRenderer::StorePrimitive( const boost::shared_ptr<CqSurface>& pSurface )
 		QGetRenderContext() ->matVSpaceToSpace( "world", "camera", NULL, pSurface->pTransform().get(), 0, matVWtoC );
 		pSurface->Transform( matWtoC, matNWtoC, matVWtoC);
 		pSurface->PrepareTrimCurve();
-		PostSurface(pSurface);
+		PostSurface(pSurface, m_inputSignature.value());
 	}
 }
 
+bool CqRenderer::keepsWorld() const
+{
+	// Once rendering has started, any new primitives go straight to the
+	// pipeline.
+	if(m_renderingWorld)
+		return false;
+	const TqInt* pMultipass = GetIntegerOption("Render", "multipass");
+	if(pMultipass && pMultipass[0])
+		return true;
+	// Progressive rendering renders the world once for each preview, and
+	// stereo rendering once for each view.
+	const TqInt* pProgressive = GetIntegerOption("Hider", "progressive");
+	if(pProgressive && pProgressive[0] > 0)
+		return true;
+	const TqFloat* pSeparation = GetFloatOption("stereo", "eyeseparation");
+	return pSeparation && pSeparation[0] > 0;
+}
+
 void CqRenderer::PostWorld()
 {
 	while(!m_aWorld.empty())
@@ -1286,8 +1474,9 @@ void CqRenderer::PostWorld()
 		QGetRenderContext() ->matVSpaceToSpace( "world", "camera", NULL, pSurface->pTransform().get(), 0, matVWtoC );
 		pSurface->Transform( matWtoC, matNWtoC, matVWtoC);
 		pSurface->PrepareTrimCurve();
-		PostSurface(pSurface);
+		PostSurface(pSurface, m_aWorldSignatures.front());
 		m_aWorld.pop_front();
+		m_aWorldSignatures.pop_front();
 	}
 }
 	
@@ -1295,21 +1484,27 @@ void CqRenderer::PostWorld()
 void CqRenderer::PostCloneOfWorld()
 {
 	std::deque<boost::shared_ptr<CqSurface> >::iterator i;
-	for(i=m_aWorld.begin(); i!=m_aWorld.end(); i++)
+	std::deque<CqInputSignature::TqHash>::iterator signature = m_aWorldSignatures.begin();
+	for(i=m_aWorld.begin(); i!=m_aWorld.end(); i++, signature++)
 	{
 		boost::shared_ptr<CqSurface> pSurface((*i)->Clone());
+		// Surfaces which can't be cloned are only rendered with the world
+		// itself.
+		if(!pSurface)
+			continue;
 		CqMatrix matWtoC, matNWtoC, matVWtoC;
 		QGetRenderContext() ->matSpaceToSpace( "world", "camera", NULL, pSurface->pTransform().get(), 0, matWtoC );
 		QGetRenderContext() ->matNSpaceToSpace( "world", "camera", NULL, pSurface->pTransform().get(), 0, matNWtoC );
 		QGetRenderContext() ->matVSpaceToSpace( "world", "camera", NULL, pSurface->pTransform().get(), 0, matVWtoC );
 		pSurface->Transform( matWtoC, matNWtoC, matVWtoC);
 		pSurface->PrepareTrimCurve();
-		PostSurface(pSurface);
+		PostSurface(pSurface, *signature);
 	}
 }
 
 
-void CqRenderer::PostSurface( const boost::shared_ptr<CqSurface>& pSurface )
+void CqRenderer::PostSurface( const boost::shared_ptr<CqSurface>& pSurface,
+                              CqInputSignature::TqHash signature )
 {
 	// Check the level of detail settings to see if this surface should be culled or not.
 	const TqFloat* rangeAttr = pSurface->pAttributes()->GetFloatAttribute( "System", "LODRanges" );
@@ -1353,7 +1548,7 @@ void CqRenderer::PostSurface( const boost::shared_ptr<CqSurface>& pSurface )
 		pSurface->pAttributes()->GetFloatAttributeWrite( "System", "LevelOfDetailBounds" ) [ 1 ] = maxImportance;
 	}
 
-	pImage()->PostSurface(pSurface);
+	pImage()->PostSurface(pSurface, signature);
 }
 
 
@@ -1421,19 +1616,102 @@ IqTextureCache& CqRenderer::textureCache()
 
 IqTextureMapOld* CqRenderer::GetEnvironmentMap( const CqString& strFileName )
 {
+	if(m_incremental)
+		m_oldMapFilesRead.insert(strFileName);
 	return ( CqTextureMapOld::GetEnvironmentMap( strFileName ) );
 }
 
 IqTextureMapOld* CqRenderer::GetOcclusionMap( const CqString& strFileName )
 {
+	if(m_incremental)
+		m_oldMapFilesRead.insert(strFileName);
 	return ( CqTextureMapOld::GetShadowMap( strFileName ) );
 }
 
 IqTextureMapOld* CqRenderer::GetLatLongMap( const CqString& strFileName )
 {
+	if(m_incremental)
+		m_oldMapFilesRead.insert(strFileName);
 	return ( CqTextureMapOld::GetLatLongMap( strFileName ) );
 }
 
+/** Get the name by which a file is identified for incremental rendering.
+ *
+ * The name is made absolute, and any "." components are dropped so that
+ * names found through the search paths match those given to displays.
+ */
+static std::string fileKey(const std::string& fileName)
+{
+	boostfs::path complete = boostfs::system_complete(fileName);
+	boostfs::path key;
+	for(boostfs::path::iterator i = complete.begin(); i != complete.end(); ++i)
+	{
+		if(*i != ".")
+			key /= *i;
+	}
+	return native(key);
+}
+
+void CqRenderer::noteFileWritten(const std::string& fileName)
+{
+	std::string key = fileKey(fileName);
+	++m_fileGenerations[key];
+	// Textures stay cached between incremental frames, so drop the cached
+	// copy of a file which has been replaced.
+	if(m_sessionFilesRead.erase(key))
+	{
+		m_textureCache->flush();
+		CqTextureMapOld::FlushCache();
+	}
+}
+
+void CqRenderer::noteFileMade(const std::vector<std::string>& inputNames,
+		const std::string& fileName)
+{
+	CqInputSignature::TqHash inputs = fileSignature(inputNames);
+	std::string key = fileKey(fileName);
+	std::map<std::string, CqInputSignature::TqHash>::iterator source
+		= m_fileSources.find(key);
+	if(source == m_fileSources.end() || source->second != inputs)
+	{
+		m_fileSources[key] = inputs;
+		noteFileWritten(fileName);
+	}
+}
+
+void CqRenderer::takeFilesRead(std::vector<std::string>& fileNames)
+{
+	TqInt numOld = fileNames.size();
+	m_textureCache->takeFilesRead(fileNames);
+	takePointCloudFilesRead(fileNames);
+	fileNames.insert(fileNames.end(), m_oldMapFilesRead.begin(), m_oldMapFilesRead.end());
+	m_oldMapFilesRead.clear();
+	for(std::vector<std::string>::const_iterator name = fileNames.begin() + numOld;
+			name != fileNames.end(); ++name)
+		m_sessionFilesRead.insert(fileKey(*name));
+}
+
+CqInputSignature::TqHash CqRenderer::fileSignature(const std::vector<std::string>& fileNames) const
+{
+	CqInputSignature hash;
+	std::ostream out(&hash);
+	for(std::vector<std::string>::const_iterator name = fileNames.begin();
+			name != fileNames.end(); ++name)
+	{
+		std::string key = fileKey(*name);
+		out << key << '\n';
+		std::map<std::string, TqInt>::const_iterator generation = m_fileGenerations.find(key);
+		if(generation != m_fileGenerations.end())
+			out << "written " << generation->second << '\n';
+		else if(boostfs::exists(key))
+			out << boostfs::file_size(key) << ' ' << boostfs::last_write_time(key) << '\n';
+		else
+			out << "missing\n";
+	}
+	out.flush();
+	return hash.value();
+}
+
 const char* CqRenderer::textureSearchPath()
 {
 	const CqString* pathPtr = poptCurrent()->GetStringOption("searchpath", "texture");
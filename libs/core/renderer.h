@@ -28,6 +28,8 @@
 //{
 #define RENDERER_H_INCLUDED 1
 
+#include	<map>
+#include	<set>
 #include	<vector>
 #include	<iostream>
 #include	<time.h>
@@ -49,6 +51,7 @@
 #include	"lights.h"
 
 #include	"clippingvolume.h"
+#include	"inputsignature.h"
 
 namespace Aqsis {
 
@@ -215,6 +218,54 @@ class CqRenderer : public IqRenderer
 		 */
 		const char* textureSearchPath();
 
+		/** Get the running hash of the interface calls made so far.
+		 *
+		 * The hash is only updated when incremental rendering is enabled.
+		 */
+		CqInputSignature& inputSignature()
+		{
+			return m_inputSignature;
+		}
+		/// Return true if unchanged buckets may be reused from the previous frame.
+		bool isIncremental() const
+		{
+			return m_incremental;
+		}
+		/// Enable or disable reuse of unchanged buckets between frames.
+		void setIncremental(bool incremental)
+		{
+			m_incremental = incremental;
+		}
+		/** Record that the session has written a file which may be read by
+		 * later frames, such as a shadow map.
+		 *
+		 * Files written by the session are identified by the number of times
+		 * they've been written rather than by their modification time, so a
+		 * display writing the same image again doesn't count as a change.
+		 */
+		void noteFileWritten(const std::string& fileName);
+		/** Record that the session has made a file from others, such as a
+		 * shadow map made from a depth image.
+		 *
+		 * The file only counts as written when the files it was made from
+		 * have changed since it was last made.
+		 */
+		void noteFileMade(const std::vector<std::string>& inputNames,
+				const std::string& fileName);
+		/** Get the textures, shadow maps and point clouds read since the
+		 * last call.
+		 *
+		 * \param fileNames - the file names are appended here.
+		 */
+		void takeFilesRead(std::vector<std::string>& fileNames);
+		/** Get a hash identifying the current contents of a set of files.
+		 *
+		 * The hash covers the path, size and modification time of each file,
+		 * or the number of times it has been written for files written by the
+		 * session.
+		 */
+		CqInputSignature::TqHash fileSignature(const std::vector<std::string>& fileNames) const;
+
 		virtual	bool	GetBasisMatrix( CqMatrix& matBasis, const CqString& name );
 
 
@@ -232,6 +283,25 @@ class CqRenderer : public IqRenderer
 		virtual	void	Initialise();
 		virtual	void	RenderWorld(bool clone = false);
 		virtual void	RenderAutoShadows();
+		/** Render a left and right view of the world for stereo viewing.
+		 *
+		 * The views are rendered from cameras either side of the current
+		 * camera, to copies of the requested displays whose names have
+		 * "_left" and "_right" added.  Both views share the parsed world,
+		 * shaders and texture cache.
+		 *
+		 * \param separation - distance between the two cameras.
+		 */
+		void	RenderStereo(TqFloat separation);
+		/** Render quick, coarse previews of the world to the interactive displays.
+		 *
+		 * Each preview pass uses one sample per pixel and a shading rate
+		 * which is four times finer than the pass before, so that the
+		 * displays are refined towards the final image.
+		 *
+		 * \param passes - number of preview passes to render.
+		 */
+		void	RenderPreviews(TqInt passes);
 
 		virtual	void	AddDisplayRequest( const TqChar* name, const TqChar* type, const TqChar* mode, TqInt modeID, TqInt dataOffset, TqInt dataSize, std::map<std::string, void*>& mapOfArguments );
 		virtual	void	ClearDisplayRequests();
@@ -278,10 +348,20 @@ class CqRenderer : public IqRenderer
 		/// Find the light associated with the given name
 		CqLightsourcePtr findLight(const char* name);
 
-		void	PostSurface( const boost::shared_ptr<CqSurface>& pSurface );
+		void	PostSurface( const boost::shared_ptr<CqSurface>& pSurface,
+		                     CqInputSignature::TqHash signature );
 		void	StorePrimitive( const boost::shared_ptr<CqSurface>& pSurface );
 		void	PostWorld();
 		void	PostCloneOfWorld();
+		/** Render the world from the current camera to the display requests.
+		 *
+		 * \param clone - render a clone of the world, leaving the world to
+		 *                be rendered again.
+		 * \param previews - render any progressive previews first.
+		 */
+		void	RenderView(bool clone, bool previews);
+		/// Return true if gprims are kept until WorldEnd to be rendered more than once.
+		bool	keepsWorld() const;
 
 		/** Set the world to screen matrix.
 		 * \param mat The new matrix to use as the world to screen transformation.
@@ -580,6 +660,8 @@ class CqRenderer : public IqRenderer
 		CqClippingVolume	m_clippingVolume;
 
 		std::deque<boost::shared_ptr<CqSurface> >	m_aWorld;
+		/// Input signature of each surface in m_aWorld when it was stored.
+		std::deque<CqInputSignature::TqHash>	m_aWorldSignatures;
 
 		// Cached calculated cropwindow coordinates in raster space.
 		TqInt				m_cropWindowXMin;
@@ -588,6 +670,14 @@ class CqRenderer : public IqRenderer
 		TqInt				m_cropWindowYMax;
 
 		std::vector<SqCoordSys>	m_aCoordSystems; ///< List of registered coordinate systems.
+
+		CqInputSignature	m_inputSignature;	///< Hash of the interface calls for incremental rendering.
+		bool	m_incremental;		///< Reuse unchanged buckets from the previous frame.
+		std::map<std::string, TqInt>	m_fileGenerations;	///< Number of times each file has been written by the session.
+		std::set<std::string>	m_oldMapFilesRead;	///< Files opened through the old texture maps since takeFilesRead().
+		std::set<std::string>	m_sessionFilesRead;	///< Files which may be held in the texture caches.
+		std::map<std::string, CqInputSignature::TqHash>	m_fileSources;	///< Signature of the inputs of each file made by the session.
+		bool	m_renderingWorld;	///< Primitives are being rendered, rather than stored.
 }
 ;
 
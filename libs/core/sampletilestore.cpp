@@ -0,0 +1,103 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file
+		\brief Implements the CqSampleTileStore class for sharing pixels between buckets.
+*/
+
+#include "sampletilestore.h"
+
+namespace Aqsis {
+
+#ifdef	ENABLE_THREADING
+#	define AQSIS_TILE_STORE_LOCK boost::mutex::scoped_lock lock(m_mutex)
+#else
+#	define AQSIS_TILE_STORE_LOCK
+#endif
+
+void CqSampleTileStore::publish(const CqRegion& region,
+		std::vector<CqImagePixelPtr>& pixels, TqInt consumers)
+{
+	assert(static_cast<TqInt>(pixels.size()) == region.area());
+	if(consumers <= 0)
+	{
+		pixels.clear();
+		return;
+	}
+	AQSIS_TILE_STORE_LOCK;
+	SqTile& tile = m_tiles[tileKey(region)];
+	// There should only be one tile for each region.
+	assert(tile.pixels.empty());
+	tile.region = region;
+	tile.pixels.swap(pixels);
+	tile.consumers = consumers;
+	pixels.clear();
+}
+
+const std::vector<CqImagePixelPtr>* CqSampleTileStore::find(const CqRegion& region) const
+{
+	AQSIS_TILE_STORE_LOCK;
+	TqTileMap::const_iterator tile = m_tiles.find(tileKey(region));
+	if(tile == m_tiles.end())
+		return 0;
+	assert(tile->second.region.xMax() == region.xMax()
+			&& tile->second.region.yMax() == region.yMax());
+	// Pointers to map elements are stable under insertion, and the tile can't
+	// be erased before the caller releases it.
+	return &tile->second.pixels;
+}
+
+bool CqSampleTileStore::release(const CqRegion& region)
+{
+	std::vector<CqImagePixelPtr> pixels;
+	{
+		AQSIS_TILE_STORE_LOCK;
+		TqTileMap::iterator tile = m_tiles.find(tileKey(region));
+		if(tile == m_tiles.end())
+			return false;
+		if(--tile->second.consumers > 0)
+			return true;
+		// Free the pixels outside the lock.
+		pixels.swap(tile->second.pixels);
+		m_tiles.erase(tile);
+	}
+	return true;
+}
+
+void CqSampleTileStore::clear()
+{
+	TqTileMap tiles;
+	{
+		AQSIS_TILE_STORE_LOCK;
+		tiles.swap(m_tiles);
+	}
+}
+
+TqInt CqSampleTileStore::numTiles() const
+{
+	AQSIS_TILE_STORE_LOCK;
+	return m_tiles.size();
+}
+
+#undef AQSIS_TILE_STORE_LOCK
+
+} // namespace Aqsis
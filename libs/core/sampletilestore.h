@@ -0,0 +1,128 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file
+		\brief Declares a store for pixels shared between neighbouring buckets.
+*/
+
+#ifndef SAMPLETILESTORE_H_INCLUDED //{
+#define SAMPLETILESTORE_H_INCLUDED 1
+
+#include	<aqsis/aqsis.h>
+
+#include	<map>
+#include	<utility>
+#include	<vector>
+
+#include	<boost/noncopyable.hpp>
+#ifdef	ENABLE_THREADING
+#include	<boost/thread/mutex.hpp>
+#endif
+
+#include	<aqsis/math/region.h>
+#include	"imagepixel.h"
+
+namespace Aqsis {
+
+//------------------------------------------------------------------------------
+/** \brief Reference counted storage for pixels in the filter overlap between buckets.
+ *
+ * The pixels near the edge of a bucket lie under the filter of the
+ * neighbouring buckets too.  Once the first of the buckets has sampled them,
+ * it publishes the pixels as a tile, keyed by the region they cover in raster
+ * space.  The other buckets then use the pixels of the tile in place rather
+ * than sampling them again, and release the tile once they have filtered it.
+ * A tile is dropped when the last of the buckets counted when it was
+ * published has released it.
+ *
+ * Tiles may be published, found and released from several threads at once.
+ */
+class CqSampleTileStore : boost::noncopyable
+{
+	public:
+		CqSampleTileStore();
+
+		/** \brief Add a tile to the store.
+		 *
+		 * \param region - region covered by the tile in raster space.
+		 * \param pixels - pixels in the region, stored row by row.  The
+		 *                 pixels are moved into the store, leaving the vector
+		 *                 empty.
+		 * \param consumers - number of buckets which will release the tile.
+		 */
+		void publish(const CqRegion& region, std::vector<CqImagePixelPtr>& pixels,
+				TqInt consumers);
+		/** \brief Find the pixels of a tile.
+		 *
+		 * The pixels remain valid until the caller releases the tile.
+		 *
+		 * \param region - region covered by the tile in raster space.
+		 * \return The pixels of the tile, or null if there is no tile covering
+		 *         region.
+		 */
+		const std::vector<CqImagePixelPtr>* find(const CqRegion& region) const;
+		/** \brief Release one consumer's use of a tile.
+		 *
+		 * \param region - region covered by the tile in raster space.
+		 * \return false if there was no tile covering region.
+		 */
+		bool release(const CqRegion& region);
+		/// Drop all tiles, whether they have been released or not.
+		void clear();
+		/// Get the number of tiles in the store.
+		TqInt numTiles() const;
+
+	private:
+		struct SqTile
+		{
+			CqRegion region;	///< Region covered by the tile.
+			std::vector<CqImagePixelPtr> pixels;	///< Pixels in the region.
+			TqInt consumers;	///< Number of buckets which haven't released the tile.
+		};
+		/// Tiles are keyed by the minimum corner of their region.
+		typedef std::map<std::pair<TqInt, TqInt>, SqTile> TqTileMap;
+
+		static std::pair<TqInt, TqInt> tileKey(const CqRegion& region);
+
+		TqTileMap m_tiles;
+#ifdef	ENABLE_THREADING
+		mutable boost::mutex m_mutex;
+#endif
+};
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+
+inline CqSampleTileStore::CqSampleTileStore()
+	: m_tiles()
+{ }
+
+inline std::pair<TqInt, TqInt> CqSampleTileStore::tileKey(const CqRegion& region)
+{
+	return std::make_pair(region.xMin(), region.yMin());
+}
+
+} // namespace Aqsis
+
+#endif //} SAMPLETILESTORE_H_INCLUDED
@@ -0,0 +1,91 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file Unit tests for the store of pixels shared between buckets.
+ */
+
+#include "sampletilestore.h"
+
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(sampletilestore_tests)
+
+using namespace Aqsis;
+
+BOOST_AUTO_TEST_CASE(CqSampleTileStore_publish_find)
+{
+	CqSampleTileStore store;
+	CqRegion region(10, 20, 12, 23);
+	std::vector<CqImagePixelPtr> pixels(region.area());
+	store.publish(region, pixels, 1);
+	BOOST_CHECK(pixels.empty());
+	BOOST_CHECK_EQUAL(store.numTiles(), 1);
+
+	const std::vector<CqImagePixelPtr>* tile = store.find(region);
+	BOOST_REQUIRE(tile);
+	BOOST_CHECK_EQUAL(static_cast<TqInt>(tile->size()), region.area());
+	BOOST_CHECK(!store.find(CqRegion(12, 20, 14, 23)));
+}
+
+BOOST_AUTO_TEST_CASE(CqSampleTileStore_release)
+{
+	CqSampleTileStore store;
+	CqRegion region(0, 0, 4, 4);
+	std::vector<CqImagePixelPtr> pixels(region.area());
+	store.publish(region, pixels, 3);
+
+	// The tile is kept until each of the consumers has released it.
+	BOOST_CHECK(store.release(region));
+	BOOST_CHECK(store.release(region));
+	BOOST_CHECK(store.find(region));
+	BOOST_CHECK(store.release(region));
+	BOOST_CHECK(!store.find(region));
+	BOOST_CHECK_EQUAL(store.numTiles(), 0);
+	BOOST_CHECK(!store.release(region));
+}
+
+BOOST_AUTO_TEST_CASE(CqSampleTileStore_no_consumers)
+{
+	CqSampleTileStore store;
+	CqRegion region(0, 0, 2, 2);
+	std::vector<CqImagePixelPtr> pixels(region.area());
+	store.publish(region, pixels, 0);
+	BOOST_CHECK(pixels.empty());
+	BOOST_CHECK_EQUAL(store.numTiles(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CqSampleTileStore_clear)
+{
+	CqSampleTileStore store;
+	std::vector<CqImagePixelPtr> pixels(4);
+	store.publish(CqRegion(0, 0, 2, 2), pixels, 1);
+	pixels.resize(4);
+	store.publish(CqRegion(2, 0, 4, 2), pixels, 2);
+	BOOST_CHECK_EQUAL(store.numTiles(), 2);
+	store.clear();
+	BOOST_CHECK_EQUAL(store.numTiles(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,155 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+		\brief Declares a copy-on-write value array for primitive variable storage.
+*/
+
+#ifndef SHAREDVALUES_H_INCLUDED //{
+#define SHAREDVALUES_H_INCLUDED 1
+
+#include	<aqsis/aqsis.h>
+
+#include	<algorithm>
+#include	<cassert>
+#include	<vector>
+
+#include	<boost/shared_ptr.hpp>
+
+namespace Aqsis {
+
+//------------------------------------------------------------------------------
+/** \brief Array of values which is shared between copies until it's written.
+ *
+ * Copying a CqSharedValues only copies a reference to the underlying
+ * storage.  Non-const element access makes the storage unique first, so a
+ * copy behaves exactly as if the values had been copied eagerly.  This makes
+ * cloning a primitive cheap when most of the clones are never modified, as
+ * is the case for the copies of the scene made for each pass of a multipass
+ * render.
+ *
+ * Pointers obtained through non-const access are only valid until the next
+ * copy of the array is made: after that the storage is shared again.
+ *
+ * The reference count is atomic, so copies may be made and read from
+ * different threads.  As with std::vector, a single copy may not be written
+ * from one thread while being used from another.
+ */
+template<typename T>
+class CqSharedValues
+{
+	public:
+		/// Construct an array holding size default constructed values.
+		explicit CqSharedValues(TqInt size = 0);
+
+		/// Get the number of values.
+		TqUint size() const;
+		/// Change the number of values, preserving those which remain.
+		void resize(TqUint size);
+		/// Remove all values.
+		void clear();
+
+		/// Read-only element access; never copies the storage.
+		const T& operator[](TqUint i) const;
+		/// Writable element access; copies the storage if it's shared.
+		T& operator[](TqUint i);
+
+		/// Return true if the storage is shared with another array.
+		bool isShared() const;
+
+	private:
+		/// Make sure the storage isn't shared with any other array.
+		void makeUnique();
+
+		boost::shared_ptr<std::vector<T> > m_values;
+};
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+
+template<typename T>
+inline CqSharedValues<T>::CqSharedValues(TqInt size)
+	: m_values(new std::vector<T>(size))
+{ }
+
+template<typename T>
+inline TqUint CqSharedValues<T>::size() const
+{
+	return m_values->size();
+}
+
+template<typename T>
+void CqSharedValues<T>::resize(TqUint size)
+{
+	if(!m_values.unique())
+	{
+		// Copy only the values which will be kept.  This is important for
+		// primitive splitting, where a clone is immediately resized.
+		boost::shared_ptr<std::vector<T> > values(new std::vector<T>(size));
+		TqUint toCopy = std::min(size, static_cast<TqUint>(m_values->size()));
+		std::copy(m_values->begin(), m_values->begin() + toCopy, values->begin());
+		m_values = values;
+	}
+	else
+		m_values->resize(size);
+}
+
+template<typename T>
+inline void CqSharedValues<T>::clear()
+{
+	if(m_values.unique())
+		m_values->clear();
+	else
+		m_values.reset(new std::vector<T>());
+}
+
+template<typename T>
+inline const T& CqSharedValues<T>::operator[](TqUint i) const
+{
+	assert(i < m_values->size());
+	return (*m_values)[i];
+}
+
+template<typename T>
+inline T& CqSharedValues<T>::operator[](TqUint i)
+{
+	assert(i < m_values->size());
+	makeUnique();
+	return (*m_values)[i];
+}
+
+template<typename T>
+inline bool CqSharedValues<T>::isShared() const
+{
+	return !m_values.unique();
+}
+
+template<typename T>
+inline void CqSharedValues<T>::makeUnique()
+{
+	if(!m_values.unique())
+		m_values.reset(new std::vector<T>(*m_values));
+}
+
+} // namespace Aqsis
+
+#endif // SHAREDVALUES_H_INCLUDED
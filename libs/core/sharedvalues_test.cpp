@@ -0,0 +1,77 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+
+/** \file Unit tests for the copy-on-write value array.
+ */
+
+#include "sharedvalues.h"
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(sharedvalues_tests)
+
+using namespace Aqsis;
+
+BOOST_AUTO_TEST_CASE(CqSharedValues_copy_on_write)
+{
+	CqSharedValues<TqFloat> a(3);
+	a[0] = 1; a[1] = 2; a[2] = 3;
+	BOOST_CHECK(!a.isShared());
+
+	CqSharedValues<TqFloat> b = a;
+	BOOST_CHECK(a.isShared());
+	BOOST_CHECK(b.isShared());
+	// Reading doesn't unshare the storage.
+	const CqSharedValues<TqFloat>& constB = b;
+	BOOST_CHECK_EQUAL(constB[1], 2);
+	BOOST_CHECK(b.isShared());
+
+	b[1] = 5;
+	BOOST_CHECK(!a.isShared());
+	BOOST_CHECK(!b.isShared());
+	BOOST_CHECK_EQUAL(a[1], 2);
+	BOOST_CHECK_EQUAL(b[1], 5);
+	BOOST_CHECK_EQUAL(b[2], 3);
+}
+
+BOOST_AUTO_TEST_CASE(CqSharedValues_resize)
+{
+	CqSharedValues<TqInt> a(10);
+	for(TqInt i = 0; i < 10; ++i)
+		a[i] = i;
+
+	CqSharedValues<TqInt> b = a;
+	b.resize(4);
+	BOOST_CHECK(!a.isShared());
+	BOOST_CHECK_EQUAL(a.size(), 10U);
+	BOOST_REQUIRE_EQUAL(b.size(), 4U);
+	for(TqInt i = 0; i < 4; ++i)
+		BOOST_CHECK_EQUAL(b[i], i);
+
+	CqSharedValues<TqInt> c = a;
+	c.clear();
+	BOOST_CHECK_EQUAL(c.size(), 0U);
+	BOOST_CHECK_EQUAL(a.size(), 10U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,187 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+		\brief Implements the CqSobolSampler class providing scrambled Sobol sample positions.
+*/
+
+#include "sobolsampler.h"
+
+#include <algorithm>
+
+#include <aqsis/math/math.h>
+
+namespace Aqsis {
+
+namespace {
+
+/// Reverse the order of the bits in a 32 bit integer.
+inline TqUint32 reverseBits(TqUint32 x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/** \brief Nested uniform (Owen) scramble of the bits of x.
+ *
+ * This is the hash-based approximation from Burley, "Practical Hash-based
+ * Owen Scrambling" (JCGT 2020).  Every bit is flipped depending on a hash of
+ * the more significant bits, which permutes the elementary intervals of a
+ * (0,m,2)-net among themselves and so preserves its stratification.
+ */
+inline TqUint32 owenScramble(TqUint32 x, TqUint32 seed)
+{
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+/// First dimension of the Sobol sequence (the van der Corput sequence).
+inline TqUint32 sobolDim0(TqUint32 i)
+{
+	return reverseBits(i);
+}
+
+/// Second dimension of the Sobol sequence.
+inline TqUint32 sobolDim1(TqUint32 i)
+{
+	TqUint32 r = 0;
+	for(TqUint32 v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+	{
+		if(i & 1)
+			r ^= v;
+	}
+	return r;
+}
+
+/// Convert a 32 bit fixed point number into a float in [0,1).
+inline TqFloat toUnitFloat(TqUint32 x)
+{
+	// Use only the top 24 bits so the result can't round up to 1.
+	return (x >> 8) * (1.0f / (1 << 24));
+}
+
+/// Compute a well-mixed seed for pattern i.
+inline TqUint32 hashSeed(TqUint32 i)
+{
+	i ^= i >> 16;
+	i *= 0x7feb352du;
+	i ^= i >> 15;
+	i *= 0x846ca68bu;
+	i ^= i >> 16;
+	return i;
+}
+
+inline bool isPowerOfTwo(TqInt n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+} // anonymous namespace
+
+
+//----------------------------------------------------------------------
+
+CqSobolSampler::CqSobolSampler(TqInt pixelXSamples, TqInt pixelYSamples) :
+	m_pixelXSamples(pixelXSamples),
+	m_pixelYSamples(pixelYSamples)
+{
+	assert(supports(pixelXSamples, pixelYSamples));
+	m_2dSamples.resize(numSamples()*m_cacheSize);
+	m_1dSamples.resize(numSamples()*m_cacheSize);
+	m_shuffledIndices.resize(numSamples()*m_cacheSize);
+
+	for(TqInt i = 0; i < m_cacheSize; ++i)
+		setupPattern(i*numSamples(), hashSeed(i));
+}
+
+bool CqSobolSampler::supports(TqInt samplesPerPixelX, TqInt samplesPerPixelY)
+{
+	return isPowerOfTwo(samplesPerPixelX) && isPowerOfTwo(samplesPerPixelY);
+}
+
+void CqSobolSampler::setupPattern(TqInt offset, TqUint32 seed)
+{
+	TqInt nSamples = numSamples();
+	TqUint32 xSeed = hashSeed(seed ^ 0x9e3779b9u);
+	TqUint32 ySeed = hashSeed(xSeed);
+	TqUint32 tSeed = hashSeed(ySeed);
+
+	// Generate the points of the scrambled (0,2)-sequence, and store each one
+	// in the slot for the subpixel containing it.  The net property
+	// guarantees that each subpixel receives exactly one point.
+	for(TqInt i = 0; i < nSamples; ++i)
+	{
+		TqFloat x = toUnitFloat(owenScramble(sobolDim0(i), xSeed));
+		TqFloat y = toUnitFloat(owenScramble(sobolDim1(i), ySeed));
+		TqInt subPixel = lfloor(y*m_pixelYSamples)*m_pixelXSamples
+			+ lfloor(x*m_pixelXSamples);
+		assert(subPixel >= 0 && subPixel < nSamples);
+		m_2dSamples[offset + subPixel] = CqVector2D(x, y);
+	}
+
+	// 1D samples are stratified with sample i in the interval [i/N, (i+1)/N),
+	// since the motion blur code relies on the sample times being sorted.  A
+	// scrambled van der Corput sequence has one point in each interval, so
+	// sorting it gives the required order.
+	for(TqInt i = 0; i < nSamples; ++i)
+		m_1dSamples[offset + i] = toUnitFloat(owenScramble(sobolDim0(i), tSeed));
+	std::sort(m_1dSamples.begin() + offset, m_1dSamples.begin() + offset + nSamples);
+
+	// Setup a randomly shuffled array of indices, between 0 and nSamples.
+	for(TqInt i = 0; i < nSamples; ++i)
+		m_shuffledIndices[offset+i] = i;
+	TqInt j = nSamples;
+	while(j > 1)
+	{
+		TqInt j2 = m_random.RandomInt(j);
+		--j;
+		std::swap(m_shuffledIndices[offset+j], m_shuffledIndices[offset+j2]);
+	}
+}
+
+const CqVector2D* CqSobolSampler::get2DSamples()
+{
+	TqInt patternIndex = m_random.RandomInt(m_cacheSize);
+	return &m_2dSamples[this->numSamples()*patternIndex];
+}
+
+const TqFloat* CqSobolSampler::get1DSamples()
+{
+	TqInt patternIndex = m_random.RandomInt(m_cacheSize);
+	return &m_1dSamples[this->numSamples()*patternIndex];
+}
+
+const TqInt* CqSobolSampler::getShuffledIndices()
+{
+	TqInt patternIndex = m_random.RandomInt(m_cacheSize);
+	return &m_shuffledIndices[this->numSamples()*patternIndex];
+}
+
+//---------------------------------------------------------------------
+
+} // namespace Aqsis
@@ -0,0 +1,107 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+		\brief Declares a sampler providing Owen-scrambled Sobol sample patterns.
+*/
+
+#ifndef SOBOLSAMPLER_H_INCLUDED //{
+#define SOBOLSAMPLER_H_INCLUDED 1
+
+#include	<aqsis/aqsis.h>
+
+#include	<vector>
+
+#include	"isampler.h"
+#include	<aqsis/math/vector2d.h>
+#include	<aqsis/math/random.h>
+
+namespace Aqsis {
+
+//------------------------------------------------------------------------------
+/** \brief A class that produces stratified low-discrepancy samples.
+ *
+ * Sample positions and lens offsets are taken from the first two dimensions of
+ * the Sobol sequence, which form a (0,2)-sequence in base 2.  For a power of
+ * two number of samples this means that every elementary interval of the
+ * pixel - every way of cutting it into equal power of two sized rectangles -
+ * contains exactly one sample.  In particular the samples are stratified over
+ * the subpixel grid (as the rest of the hider expects) and in each row and
+ * column, but are also well distributed at every scale in between.
+ *
+ * Each of the precomputed patterns is decorrelated from the others by a
+ * hash-based Owen scramble, which retains the stratification.  As with
+ * CqMultiJitteredSampler, every request picks a pattern from the table at
+ * random so that positions, times and lens offsets are independently shuffled
+ * between pixels.
+ *
+ * The number of samples in each direction must be a power of two.
+ */
+class CqSobolSampler : public IqSampler
+{
+	public:
+		CqSobolSampler(TqInt samplesPerPixelX, TqInt samplesPerPixelY);
+
+		/** \brief Determine whether the sampler supports the given sampling rate.
+		 *
+		 * Only power of two numbers of samples in both directions are
+		 * supported, since other sampling rates can't be stratified over the
+		 * subpixel grid.
+		 */
+		static bool supports(TqInt samplesPerPixelX, TqInt samplesPerPixelY);
+
+		/* Interface functions from IqSampler */
+		virtual const CqVector2D* get2DSamples();
+		virtual const TqFloat* get1DSamples();
+		virtual const TqInt* getShuffledIndices();
+
+	private:
+		/// Static define for the number of distribution patterns to cache.
+		static const TqInt m_cacheSize = 256;
+		TqInt numSamples() const;
+		/** \brief Set up a scrambled sample pattern for a pixel's worth of samples.
+		 *
+		 * \param offset - The offset within the table of sample arrays to start
+		 * 					storing the values.
+		 * \param seed - The seed for the Owen scrambling of this pattern.
+		 */
+		void setupPattern(TqInt offset, TqUint32 seed);
+
+		TqInt					m_pixelXSamples;
+		TqInt					m_pixelYSamples;
+		std::vector<CqVector2D>	m_2dSamples;
+		std::vector<TqFloat>	m_1dSamples;
+		std::vector<TqInt>		m_shuffledIndices;
+		CqRandom				m_random;
+};
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+
+inline TqInt CqSobolSampler::numSamples() const
+{
+	return m_pixelXSamples * m_pixelYSamples;
+}
+
+
+} // namespace Aqsis
+
+#endif //} SOBOLSAMPLER_H_INCLUDED
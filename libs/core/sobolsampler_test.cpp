@@ -0,0 +1,110 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file Unit tests for the scrambled Sobol sampler.
+ */
+
+#include "sobolsampler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <aqsis/math/math.h>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(sobolsampler_tests)
+
+using namespace Aqsis;
+
+namespace {
+
+// Check that the samples for a single pixel are stratified over a grid of the
+// given size, with sample i lying in cell i.
+void checkGridStratified(const CqVector2D* samples, TqInt nx, TqInt ny)
+{
+	for(TqInt i = 0; i < nx*ny; ++i)
+	{
+		BOOST_CHECK(samples[i].x() >= 0 && samples[i].x() < 1);
+		BOOST_CHECK(samples[i].y() >= 0 && samples[i].y() < 1);
+		BOOST_CHECK_EQUAL(lfloor(samples[i].y()*ny)*nx
+				+ lfloor(samples[i].x()*nx), i);
+	}
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(CqSobolSampler_supports_test)
+{
+	BOOST_CHECK(CqSobolSampler::supports(1, 1));
+	BOOST_CHECK(CqSobolSampler::supports(4, 2));
+	BOOST_CHECK(CqSobolSampler::supports(16, 16));
+	BOOST_CHECK(!CqSobolSampler::supports(3, 3));
+	BOOST_CHECK(!CqSobolSampler::supports(4, 0));
+}
+
+BOOST_AUTO_TEST_CASE(CqSobolSampler_2d_stratification_test)
+{
+	const TqInt nx = 4;
+	const TqInt ny = 8;
+	CqSobolSampler sampler(nx, ny);
+	for(TqInt pattern = 0; pattern < 10; ++pattern)
+	{
+		const CqVector2D* samples = sampler.get2DSamples();
+		// Sample i must lie in subpixel i
+		checkGridStratified(samples, nx, ny);
+		// Every other elementary interval must contain exactly one sample
+		// too; check the grid with the aspect ratio swapped.
+		std::vector<TqInt> cellCounts(nx*ny, 0);
+		for(TqInt i = 0; i < nx*ny; ++i)
+			++cellCounts[lfloor(samples[i].y()*nx)*ny + lfloor(samples[i].x()*ny)];
+		for(TqInt i = 0; i < nx*ny; ++i)
+			BOOST_CHECK_EQUAL(cellCounts[i], 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CqSobolSampler_1d_stratification_test)
+{
+	const TqInt nx = 4;
+	const TqInt ny = 4;
+	const TqInt n = nx*ny;
+	CqSobolSampler sampler(nx, ny);
+	for(TqInt pattern = 0; pattern < 10; ++pattern)
+	{
+		// 1D samples must be sorted, with sample i in [i/n, (i+1)/n).
+		const TqFloat* samples = sampler.get1DSamples();
+		for(TqInt i = 0; i < n; ++i)
+			BOOST_CHECK_EQUAL(lfloor(samples[i]*n), i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CqSobolSampler_shuffled_indices_test)
+{
+	const TqInt n = 16;
+	CqSobolSampler sampler(4, 4);
+	const TqInt* indices = sampler.getShuffledIndices();
+	std::vector<TqInt> sorted(indices, indices + n);
+	std::sort(sorted.begin(), sorted.end());
+	for(TqInt i = 0; i < n; ++i)
+		BOOST_CHECK_EQUAL(sorted[i], i);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -23,6 +23,8 @@
 
 #include "stats.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <iomanip>
 #include <iostream>
 #include <cstring>
@@ -33,16 +35,10 @@
 #include "renderer.h"
 #include "transform.h"
 #include <aqsis/math/math.h>
+#include <aqsis/shadervm/ishader.h>
 
 namespace Aqsis {
 
-#ifdef USE_TIMERS
-
-/// Global collection of timer objects.
-CqTimerSet<EqTimerStats> g_timerSet;
-
-#endif // USE_TIMERS
-
 // Global accessor functions, defined like this so that other projects using libshadervm can
 // simply provide empty implementations and not have to link to libaqsis.
 void gStats_IncI( TqInt index )
@@ -69,8 +65,141 @@ void gStats_setF( TqInt index, TqFloat value )
 {
 	CqStats::setF( index, value );
 }
-TqFloat	 CqStats::m_floatVars[ CqStats::_Last_float ];		///< Float variables
-TqInt	 CqStats::m_intVars[ CqStats::_Last_int ];			///< Int variables
+boost::ptr_vector<CqStats::SqThreadStats> CqStats::m_allStats;
+#ifdef ENABLE_THREADING
+// Defined in this order so that the blocks and mutex outlive the cleanup of
+// m_threadStats at exit.
+std::vector<CqStats::SqThreadStats*> CqStats::m_freeStats;
+boost::mutex CqStats::m_statsMutex;
+boost::thread_specific_ptr<CqStats::SqThreadStats> CqStats::m_threadStats(
+		&CqStats::releaseThreadStats);
+#endif
+
+CqStats::SqThreadStats::SqThreadStats()
+{
+	std::fill(memory, memory + EqMemoryStats::size, 0);
+	reset();
+}
+
+void CqStats::SqThreadStats::reset()
+{
+	std::fill(intVars, intVars + _Last_int, 0);
+	std::fill(floatVars, floatVars + _Last_float, 0.0f);
+	// The conventional "unset" values, as checked for in PrintStats().
+	floatVars[ MPG_min_area ] = FLT_MAX;
+	floatVars[ MPG_max_area ] = FLT_MIN;
+	// Memory which is still allocated stays accounted for.
+	std::copy(memory, memory + EqMemoryStats::size, memoryPeak);
+}
+
+CqStats::SqThreadStats& CqStats::newThreadStats()
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock(m_statsMutex);
+	SqThreadStats* stats = 0;
+	if(!m_freeStats.empty())
+	{
+		// Counts recorded by the previous owner are kept, since they're
+		// merged by summing anyway.
+		stats = m_freeStats.back();
+		m_freeStats.pop_back();
+	}
+	else
+	{
+		stats = new SqThreadStats();
+		m_allStats.push_back(stats);
+	}
+	m_threadStats.reset(stats);
+	return *stats;
+#	else
+	m_allStats.push_back(new SqThreadStats());
+	return m_allStats.back();
+#	endif
+}
+
+#ifdef ENABLE_THREADING
+void CqStats::releaseThreadStats( SqThreadStats* stats )
+{
+	boost::mutex::scoped_lock lock(m_statsMutex);
+	m_freeStats.push_back(stats);
+}
+#endif
+
+TqInt CqStats::totalI( const TqInt index )
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock(m_statsMutex);
+#	endif
+	TqInt total = 0;
+	for(boost::ptr_vector<SqThreadStats>::const_iterator i = m_allStats.begin(),
+			end = m_allStats.end(); i != end; ++i)
+		total += i->intVars[ index ];
+	return total;
+}
+
+TqFloat CqStats::totalF( const TqInt index )
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock(m_statsMutex);
+#	endif
+	TqFloat total = 0;
+	if(index == MPG_min_area)
+		total = FLT_MAX;
+	else if(index == MPG_max_area)
+		total = FLT_MIN;
+	for(boost::ptr_vector<SqThreadStats>::const_iterator i = m_allStats.begin(),
+			end = m_allStats.end(); i != end; ++i)
+	{
+		TqFloat value = i->floatVars[ index ];
+		if(index == MPG_min_area)
+			total = std::min(total, value);
+		else if(index == MPG_max_area)
+			total = std::max(total, value);
+		else
+			total += value;
+	}
+	return total;
+}
+
+void CqStats::setMemory( EqMemoryStats::Enum category, TqMemorySize bytes )
+{
+	SqThreadStats& stats = threadStats();
+	stats.memory[ category ] = bytes;
+	stats.memoryPeak[ category ] = std::max(stats.memoryPeak[ category ], bytes);
+}
+
+CqStats::TqMemorySize CqStats::totalMemory( EqMemoryStats::Enum category )
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock(m_statsMutex);
+#	endif
+	TqMemorySize total = 0;
+	for(boost::ptr_vector<SqThreadStats>::const_iterator i = m_allStats.begin(),
+			end = m_allStats.end(); i != end; ++i)
+		total += i->memory[ category ];
+	return total;
+}
+
+CqStats::TqMemorySize CqStats::totalMemory()
+{
+	TqMemorySize total = 0;
+	for(TqInt category = 0; category < EqMemoryStats::size; ++category)
+		total += totalMemory( static_cast<EqMemoryStats::Enum>(category) );
+	return total;
+}
+
+CqStats::TqMemorySize CqStats::peakMemory( EqMemoryStats::Enum category )
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock(m_statsMutex);
+#	endif
+	TqMemorySize total = 0;
+	for(boost::ptr_vector<SqThreadStats>::const_iterator i = m_allStats.begin(),
+			end = m_allStats.end(); i != end; ++i)
+		total += i->memoryPeak[ category ];
+	return total;
+}
+
 /**
    Initialise every variable.
  
@@ -83,12 +212,15 @@ TqInt	 CqStats::m_intVars[ CqStats::_Last_int ];			///< Int variables
  */
 void CqStats::Initialise()
 {
-	TqInt i;
 	m_Complete = 0.0f;
-	for (i = _First_int; i < _Last_int; i++)
-		m_intVars[i] = 0;
-	for (i = _First_float; i < _Last_float; i++)
-		m_floatVars[i] = 0.0f;
+	{
+#		ifdef ENABLE_THREADING
+		boost::mutex::scoped_lock lock(m_statsMutex);
+#		endif
+		for(boost::ptr_vector<SqThreadStats>::iterator i = m_allStats.begin(),
+				end = m_allStats.end(); i != end; ++i)
+			i->reset();
+	}
 	//	m_timeTotal = 0;
 	InitialiseFrame();
 }
@@ -114,8 +246,8 @@ void CqStats::InitialiseFrame()
  */
 void CqStats::PrintStats( TqInt level ) const
 {
-#	define STATS_INT_GETI( index )	getI( index )
-#	define STATS_INT_GETF( index )	getF( index )
+#	define STATS_INT_GETI( index )	totalI( index )
+#	define STATS_INT_GETF( index )	totalF( index )
 
 	std::ostream& MSG = std::cout;
 	/*! Levels
@@ -126,7 +258,18 @@ void CqStats::PrintStats( TqInt level ) const
 	*/
 #	ifdef USE_TIMERS
 	if( level > 0 )
-		g_timerSet.printTimes(MSG);
+	{
+		CqTimerSet<EqTimerStats> timers;
+		{
+#			ifdef ENABLE_THREADING
+			boost::mutex::scoped_lock lock(m_statsMutex);
+#			endif
+			for(boost::ptr_vector<SqThreadStats>::const_iterator i = m_allStats.begin(),
+					end = m_allStats.end(); i != end; ++i)
+				timers.merge(i->timers);
+		}
+		timers.printTimes(MSG);
+	}
 #	endif // USE_TIMERS
 
 	MSG << std::setiosflags(std::ios_base::fixed)
@@ -191,7 +334,10 @@ void CqStats::PrintStats( TqInt level ) const
 		<<					"\t" << STATS_INT_GETI( GEO_prc_split ) << " split (" << _geo_prc_s_q << "%)\n\t\t"
 		<<							STATS_INT_GETI( GEO_prc_created_dl ) << " dynamic load,\n\t\t"
 		<<							STATS_INT_GETI( GEO_prc_created_dra ) << " dynamic read archive,\n\t\t"
-		<<							STATS_INT_GETI( GEO_prc_created_prp ) << " run program\n\t\t"
+		<<							STATS_INT_GETI( GEO_prc_created_prp ) << " run program\n\t"
+		<< "Archive cache:\n"
+		<<					"\t\t" << STATS_INT_GETI( ARC_cache_hits ) << " hits\n\t"
+		<<					"\t" << STATS_INT_GETI( ARC_cache_misses ) << " misses\n"
 		<< std::endl;
 		/*
 			GPrim stats - End
@@ -407,10 +553,27 @@ void CqStats::PrintStats( TqInt level ) const
 			-------------------------------------------------------------------
 		*/
 		MSG << "Attributes:\n\t";
-		MSG << ( TqInt ) Attribute_stack.size() << " created\n" << std::endl;
-		// MSG << "Transforms:\n\t";
-		// MSG << ( TqInt ) Transform_stack.size() << " created\n" << std::endl;
+		MSG << ( TqInt ) Attribute_stack.size() << " created, " << STATS_INT_GETI( ATR_interned ) << " interned, "
+		<< STATS_INT_GETI( ATR_shared ) << " shared by primitives\n" << std::endl;
+		MSG << "Transforms:\n\t" << STATS_INT_GETI( TRN_interned ) << " interned, "
+		<< STATS_INT_GETI( TRN_shared ) << " shared by primitives\n" << std::endl;
 		MSG << "Parameters:\n\t" << STATS_INT_GETI( PRM_created ) << " created, " << STATS_INT_GETI( PRM_peak ) << " peak\n" << std::endl;
+		TqUlong tempsAllocated = 0;
+		TqUlong tempsReused = 0;
+		shaderVMTemporaryCounts( tempsAllocated, tempsReused );
+		MSG << "Shader temporaries:\n\t" << tempsAllocated << " allocated, " << tempsReused << " reused\n" << std::endl;
+		/*
+			Memory stats
+			-------------------------------------------------------------------
+		*/
+		MSG << "Memory:\n";
+		for ( TqInt i = 0; i < EqMemoryStats::size; i++ )
+		{
+			EqMemoryStats::Enum category = static_cast<EqMemoryStats::Enum>( i );
+			MSG << "\t" << category << ": " << totalMemory( category ) / 1024
+			<< "K current, " << peakMemory( category ) / 1024 << "K peak\n";
+		}
+		MSG << std::endl;
 	}
 	if ( level == 3 )
 	{
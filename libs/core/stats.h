@@ -32,6 +32,13 @@
 #include <time.h>
 #include <iostream>
 
+#include <boost/cstdint.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#ifdef ENABLE_THREADING
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#endif
+
 #include <aqsis/util/timer.h>
 #include <aqsis/ri/ri.h>
 #include <aqsis/util/enum.h>
@@ -60,11 +67,11 @@ extern void gStats_setF( TqInt index, TqFloat value );
 
 /// Append time taken to the end of the current scope to the named timer.
 #define AQSIS_TIME_SCOPE(id) CqScopeTimer aq_scope_timer__(\
-		g_timerSet.getTimer(EqTimerStats::id))
+		CqStats::timers().getTimer(EqTimerStats::id))
 /// Start the named timer.
-#define AQSIS_TIMER_START(id) g_timerSet.getTimer(EqTimerStats::id).start()
+#define AQSIS_TIMER_START(id) CqStats::timers().getTimer(EqTimerStats::id).start()
 /// Stop the named timer and append the time since the corresponding TIMER_START
-#define AQSIS_TIMER_STOP(id) g_timerSet.getTimer(EqTimerStats::id).stop()
+#define AQSIS_TIMER_STOP(id) CqStats::timers().getTimer(EqTimerStats::id).stop()
 
 /// A class enum containing constants for each operation to be timed.
 struct EqTimerStats
@@ -145,8 +152,6 @@ AQSIS_ENUM_INFO_BEGIN(EqTimerStats::Enum, EqTimerStats::LAST)
 	"LAST"
 AQSIS_ENUM_INFO_END
 
-extern CqTimerSet<EqTimerStats> g_timerSet;
-
 #else // USE_TIMERS
 
 // dummy declarations if compiled without timers.
@@ -156,6 +161,40 @@ extern CqTimerSet<EqTimerStats> g_timerSet;
 
 #endif // USE_TIMERS
 
+//----------------------------------------------------------------------
+// Memory accounting.
+
+/// A class enum containing constants for each category of accounted memory.
+struct EqMemoryStats
+{
+	enum Enum
+	{
+		Gprims,				///< gprims waiting in buckets
+		Micropolygons,
+		Grids,
+		Shader_temporaries,	///< pooled shader temporary variables
+		Texture_tiles,
+		Point_clouds,
+		Sample_buffers,		///< pixels and their samples
+
+		// invalid
+		LAST,
+	};
+	static const TqInt size = LAST;
+};
+
+AQSIS_ENUM_INFO_BEGIN(EqMemoryStats::Enum, EqMemoryStats::LAST)
+	"Gprims",
+	"Micropolygons",
+	"Grids",
+	"Shader temporaries",
+	"Texture tiles",
+	"Point clouds",
+	"Sample buffers",
+	// invalid
+	"LAST"
+AQSIS_ENUM_INFO_END
+
 //----------------------------------------------------------------------
 /** \class CqStats
    \brief Class containing statistics information.
@@ -167,6 +206,17 @@ extern CqTimerSet<EqTimerStats> g_timerSet;
 	 IncXyz()-Method. To measure various times there are several pairs
 	 of StartXyzTimer() and StopXyZTimer() methods.
 	 The statistics for each frame can be printed with PrintStats().
+
+	 Each thread updates its own copy of the counters and timers, so that
+	 they need no locking, and the copies are merged when the statistics are
+	 printed.  Counters and timers are summed, so the times for work done in
+	 parallel add up to more than the elapsed time.  The peak counts are also
+	 summed, which makes them an upper bound when rendering with threads.
+
+	 Memory is accounted in bytes for each EqMemoryStats category with
+	 allocMemory() and freeMemory(), in the same per-thread fashion.
+	 Categories which are owned by other libraries are measured instead, and
+	 recorded with setMemory().
  */
 
 class CqStats
@@ -199,39 +249,84 @@ class CqStats
 		//! Increase an integer specified by an EqIntIndex value by one
 		static void IncI( const TqInt index )
 		{
-			m_intVars[ index ]++;
+			threadStats().intVars[ index ]++;
 		}
 
 		//! Decrease an integer specified by an EqIntIndex value by one
 		static void DecI( const TqInt index )
 		{
-			m_intVars[ index ]--;
+			threadStats().intVars[ index ]--;
 		}
 
 		//! Set an integer specified by an EqIntIndex value to value
 		static void setI( const TqInt index, const TqInt value )
 		{
-			m_intVars[ index ] = value;
+			threadStats().intVars[ index ] = value;
 		}
 
-		//! Get an integer specified by an EqIntIndex value
+		//! Get the calling thread's value of an integer specified by an EqIntIndex value
 		static TqInt getI( const TqInt index )
 		{
-			return m_intVars[ index ];
+			return threadStats().intVars[ index ];
 		}
 
 		//! Set a float specified by an EqfloatIndex value to value
 		static void setF( const TqInt index, const TqFloat value )
 		{
-			m_floatVars[ index ] = value;
+			threadStats().floatVars[ index ] = value;
 		}
 
-		//! Get a float specified by an EqfloatIndex value
+		//! Get the calling thread's value of a float specified by an EqfloatIndex value
 		static TqFloat getF( const TqInt index )
 		{
-			return m_floatVars[ index ];
+			return threadStats().floatVars[ index ];
 		}
 
+		//! Get an integer specified by an EqIntIndex value, merged over all threads
+		static TqInt totalI( const TqInt index );
+		//! Get a float specified by an EqfloatIndex value, merged over all threads
+		static TqFloat totalF( const TqInt index );
+
+		/// Type used to count bytes of memory.
+		typedef boost::int64_t TqMemorySize;
+
+		//! Account for bytes allocated in a memory category
+		static void allocMemory( EqMemoryStats::Enum category, TqMemorySize bytes )
+		{
+			SqThreadStats& stats = threadStats();
+			TqMemorySize current = stats.memory[ category ] += bytes;
+			if ( current > stats.memoryPeak[ category ] )
+				stats.memoryPeak[ category ] = current;
+		}
+
+		//! Account for bytes freed in a memory category
+		static void freeMemory( EqMemoryStats::Enum category, TqMemorySize bytes )
+		{
+			threadStats().memory[ category ] -= bytes;
+		}
+
+		/** \brief Record the measured size of a memory category.
+		 *
+		 * This replaces the previous measurement, so it should always be
+		 * called from the same thread.
+		 */
+		static void setMemory( EqMemoryStats::Enum category, TqMemorySize bytes );
+
+		//! Get the memory currently used by a category, merged over all threads
+		static TqMemorySize totalMemory( EqMemoryStats::Enum category );
+		//! Get the memory currently used by all categories
+		static TqMemorySize totalMemory();
+		//! Get the peak memory used by a category, merged over all threads
+		static TqMemorySize peakMemory( EqMemoryStats::Enum category );
+
+#		ifdef USE_TIMERS
+		//! Get the calling thread's timers
+		static CqTimerSet<EqTimerStats>& timers()
+		{
+			return threadStats().timers;
+		}
+#		endif
+
 		/**
 			\param	value	This has to be a 32-bit integer!
 		 */
@@ -317,6 +412,11 @@ class CqStats
 		       GEO_prc_created_dra,
 		       GEO_prc_created_prp,
 
+		       // Archive cache
+
+		       ARC_cache_hits,
+		       ARC_cache_misses,
+
 		       // Grid stats
 
 		       GRD_created,
@@ -381,6 +481,12 @@ class CqStats
 		       SPL_bound_hits,
 		       SPL_hits,
 
+		       // Graphics state sharing
+		       ATR_interned,
+		       ATR_shared,
+		       TRN_interned,
+		       TRN_shared,
+
 		       // Parameters
 		       PRM_created,
 		       PRM_current,
@@ -422,12 +528,51 @@ class CqStats
 		void PrintInfo() const;
 
 	private:
+		/** \brief Counters and timers updated by a single thread.
+		 *
+		 * The padding keeps the blocks of different threads on separate
+		 * cache lines.
+		 */
+		struct SqThreadStats
+		{
+			char headPadding[64];
+			TqInt intVars[ _Last_int ];			///< Int variables
+			TqFloat floatVars[ _Last_float ];	///< Float variables
+			TqMemorySize memory[ EqMemoryStats::size ];		///< Bytes in use
+			TqMemorySize memoryPeak[ EqMemoryStats::size ];	///< Peak bytes in use
+#			ifdef USE_TIMERS
+			CqTimerSet<EqTimerStats> timers;
+#			endif
+			char tailPadding[64];
+
+			SqThreadStats();
+			/// Reset the counters, but not the timers.
+			void reset();
+		};
+
+		/// Get the statistics block for the calling thread.
+		static SqThreadStats& threadStats();
+		/// Allocate a block for the calling thread.
+		static SqThreadStats& newThreadStats();
+#		ifdef ENABLE_THREADING
+		/// Make the block of an exiting thread available to new threads.
+		static void releaseThreadStats( SqThreadStats* stats );
+#		endif
+
 		std::ostream& TimeToString( std::ostream& os, TqFloat t, TqFloat tot ) const;
 
 		TqFloat	m_Complete;						///< Current percentage complete.
 
-		static TqFloat	 m_floatVars[ _Last_float ];		///< Float variables
-		static TqInt		m_intVars[ _Last_int ];			///< Int variables
+		/// Blocks of all threads which have recorded statistics.
+		static boost::ptr_vector<SqThreadStats> m_allStats;
+#		ifdef ENABLE_THREADING
+		/// Blocks of exited threads, available for reuse.
+		static std::vector<SqThreadStats*> m_freeStats;
+		/// Block of each thread.
+		static boost::thread_specific_ptr<SqThreadStats> m_threadStats;
+		/// Protects m_allStats and m_freeStats.
+		static boost::mutex m_statsMutex;
+#		endif
 
 		TqInt m_cTextureMemory;     ///< Count of the memory used by texturemap.cpp
 		TqInt m_cTextureHits[ 2 ][ 5 ];     ///< Count of the hits encountered used by texturemap.cpp
@@ -435,6 +580,23 @@ class CqStats
 };
 
 
+//==============================================================================
+// Implementation details
+//==============================================================================
+
+inline CqStats::SqThreadStats& CqStats::threadStats()
+{
+#	ifdef ENABLE_THREADING
+	SqThreadStats* stats = m_threadStats.get();
+	if(stats)
+		return *stats;
+#	else
+	if(!m_allStats.empty())
+		return m_allStats.front();
+#	endif
+	return newThreadStats();
+}
+
 //-----------------------------------------------------------------------
 
 } // namespace Aqsis
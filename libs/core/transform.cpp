@@ -25,15 +25,22 @@
 
 #include	<aqsis/aqsis.h>
 #include	"transform.h"
+
+#include	<boost/thread/mutex.hpp>
+
 #include	"renderer.h"
 
 namespace Aqsis {
 
+CqTransform::TqInternTable CqTransform::m_internTable;
+/// Guards CqTransform::m_internTable, as transforms may be released by the bucket threads.
+static boost::mutex internTableMutex;
+
 //---------------------------------------------------------------------
 /** Constructor.
  */
 
-CqTransform::CqTransform() : CqMotionSpec<SqTransformation>(SqTransformation()), m_IsMoving(false), m_Handedness(false)
+CqTransform::CqTransform() : CqMotionSpec<SqTransformation>(SqTransformation()), m_IsMoving(false), m_Handedness(false), m_interned(false)
 {}
 
 
@@ -41,7 +48,7 @@ CqTransform::CqTransform() : CqMotionSpec<SqTransformation>(SqTransformation()),
 /** Copy constructor.
  */
 
-CqTransform::CqTransform( const CqTransform& From ) : CqMotionSpec<SqTransformation>( From )
+CqTransform::CqTransform( const CqTransform& From ) : CqMotionSpec<SqTransformation>( From ), m_interned( false )
 {
 	m_IsMoving = From.m_IsMoving;
 	m_StaticMatrix = From.m_StaticMatrix;
@@ -93,7 +100,8 @@ CqTransform::CqTransform( const CqTransformPtr& From )
 		: CqMotionSpec<SqTransformation>( *From ),
 		m_IsMoving(false),
 		m_StaticMatrix( From->m_StaticMatrix ),
-		m_Handedness( From->m_Handedness )
+		m_Handedness( From->m_Handedness ),
+		m_interned( false )
 {
 	InitialiseDefaultObject( From );
 }
@@ -108,7 +116,8 @@ CqTransform::CqTransform( const CqTransformPtr& From, TqFloat time,
 		: CqMotionSpec<SqTransformation>( *From ),
 		m_IsMoving( From->m_IsMoving ),
 		m_StaticMatrix( From->m_StaticMatrix ),
-		m_Handedness( From->m_Handedness )
+		m_Handedness( From->m_Handedness ),
+		m_interned( false )
 {
 	SetTransform( time, matTrans );
 }
@@ -119,7 +128,8 @@ CqTransform::CqTransform( const CqTransformPtr& From, TqFloat time,
 		: CqMotionSpec<SqTransformation>( *From ),
 		m_IsMoving( From->m_IsMoving ),
 		m_StaticMatrix( From->m_StaticMatrix ),
-		m_Handedness( From->m_Handedness )
+		m_Handedness( From->m_Handedness ),
+		m_interned( false )
 {
 	ConcatCurrentTransform( time, matTrans );
 }
@@ -130,7 +140,8 @@ CqTransform::CqTransform( const CqTransformPtr& From, TqFloat time,
 		: CqMotionSpec<SqTransformation>( *From ),
 		m_IsMoving( From->m_IsMoving ),
 		m_StaticMatrix( From->m_StaticMatrix ),
-		m_Handedness( From->m_Handedness )
+		m_Handedness( From->m_Handedness ),
+		m_interned( false )
 {
 	SetCurrentTransform( time, matTrans );
 }
@@ -141,7 +152,82 @@ CqTransform::CqTransform( const CqTransformPtr& From, TqFloat time,
  */
 
 CqTransform::~CqTransform()
-{}
+{
+	if ( m_interned )
+	{
+		boost::mutex::scoped_lock lock( internTableMutex );
+		m_internTable.erase( m_internIterator );
+	}
+}
+
+
+//---------------------------------------------------------------------
+/** Find or add the shared transform equal to pTrans.
+ */
+
+CqTransformPtr CqTransform::Intern( const CqTransformPtr& pTrans )
+{
+	if ( !pTrans || pTrans->m_interned )
+		return ( pTrans );
+
+	TqUlong hash = pTrans->ValuesHash();
+	boost::mutex::scoped_lock lock( internTableMutex );
+	std::pair<TqInternTable::iterator, TqInternTable::iterator> range = m_internTable.equal_range( hash );
+	for ( TqInternTable::iterator i = range.first; i != range.second; ++i )
+	{
+		// Transforms being destroyed by another thread have expired already.
+		CqTransformPtr pInterned = i->second.lock();
+		if ( pInterned && pInterned->ValuesEqual( *pTrans ) )
+		{
+			STATS_INC( TRN_shared );
+			return ( pInterned );
+		}
+	}
+	pTrans->m_internIterator = m_internTable.insert( TqInternTable::value_type( hash, pTrans ) );
+	pTrans->m_interned = true;
+	STATS_INC( TRN_interned );
+	return ( pTrans );
+}
+
+
+//---------------------------------------------------------------------
+/** Compare the matrices and key times of two transforms.
+ */
+
+bool CqTransform::ValuesEqual( const CqTransform& From ) const
+{
+	if ( m_IsMoving != From.m_IsMoving || m_Handedness != From.m_Handedness ||
+	     m_StaticMatrix != From.m_StaticMatrix )
+		return ( false );
+	const CqMotionSpec<SqTransformation>& motion = *this;
+	const CqMotionSpec<SqTransformation>& fromMotion = From;
+	if ( motion.cTimes() != fromMotion.cTimes() ||
+	     motion.GetDefaultObject().m_matTransform != fromMotion.GetDefaultObject().m_matTransform ||
+	     motion.GetDefaultObject().m_Handedness != fromMotion.GetDefaultObject().m_Handedness )
+		return ( false );
+	for ( TqInt i = 0; i < motion.cTimes(); ++i )
+	{
+		if ( motion.Time( i ) != fromMotion.Time( i ) ||
+		     motion.GetMotionObject( i ).m_matTransform != fromMotion.GetMotionObject( i ).m_matTransform ||
+		     motion.GetMotionObject( i ).m_Handedness != fromMotion.GetMotionObject( i ).m_Handedness )
+			return ( false );
+	}
+	return ( true );
+}
+
+
+//---------------------------------------------------------------------
+/** Get a hash of the transform, consistent with ValuesEqual().
+ */
+
+TqUlong CqTransform::ValuesHash() const
+{
+	const CqMotionSpec<SqTransformation>& motion = *this;
+	TqUlong h = paramValueHash( m_StaticMatrix );
+	for ( TqInt i = 0; i < motion.cTimes(); ++i )
+		h = h * 31 + paramValueHash( motion.GetMotionObject( i ).m_matTransform );
+	return ( h * 2 + m_IsMoving );
+}
 
 //---------------------------------------------------------------------
 /** Copy function.
@@ -165,6 +251,8 @@ CqTransform& CqTransform::operator=( const CqTransform& From )
 
 void CqTransform::SetCurrentTransform( TqFloat time, const CqMatrix& matTrans )
 {
+	// Interned transforms are shared between primitives.
+	assert( !m_interned );
 	TqFloat det = matTrans.Determinant();
 	bool flip = ( !matTrans.fIdentity() && det < 0 );
 
@@ -336,6 +424,7 @@ bool CqTransform::GetHandedness( TqFloat time ) const
 
 void CqTransform::ResetTransform(const CqMatrix& mat, bool hand, bool makeStatic)
 {
+	assert( !m_interned );
 	if( makeStatic )
 	{
 		Reset();
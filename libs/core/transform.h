@@ -28,8 +28,10 @@
 #define TRANSFORM_H_INCLUDED 1
 
 #include	<vector>
+#include	<map>
 #include	<boost/utility.hpp>
 #include	<boost/shared_ptr.hpp>
+#include	<boost/weak_ptr.hpp>
 
 #include	<aqsis/aqsis.h>
 
@@ -122,6 +124,16 @@ class CqTransform : public CqMotionSpec<SqTransformation>, public IqTransform, p
 
 		CqTransform*	Inverse();
 
+		/** Get the shared transform equal to the given one.
+		 *
+		 * Transforms are replaced rather than modified, so primitives with
+		 * the same placement often hold separate but equal transforms.
+		 * Interning the transforms taken by primitives lets them share one.
+		 * \param pTrans the transform to look up.
+		 * \return the interned transform equal to pTrans, which is pTrans itself if no equal transform was interned.
+		 */
+		static CqTransformPtr Intern( const CqTransformPtr& pTrans );
+
 	private:
 		void	InitialiseDefaultObject( const CqTransformPtr& From );
 		void	SetTransform( TqFloat time, const CqMatrix& matTrans );
@@ -132,9 +144,17 @@ class CqTransform : public CqMotionSpec<SqTransformation>, public IqTransform, p
 		}
 
 
+		bool	ValuesEqual( const CqTransform& From ) const;
+		TqUlong	ValuesHash() const;
+
 		bool	m_IsMoving;			///< Flag indicating this transformation describes a changing transform.
 		CqMatrix	m_StaticMatrix;	///< Matrix storing the transformation should there be no motion involved.
 		bool	m_Handedness;	///< Current coordinate system orientation.
+
+		typedef std::multimap<TqUlong, boost::weak_ptr<CqTransform> > TqInternTable;
+		static TqInternTable	m_internTable;	///< interned transforms, by ValuesHash().
+		TqInternTable::iterator	m_internIterator;	///< the entry of this transform in m_internTable, valid if m_interned is set.
+		bool	m_interned;	///< this transform is in m_internTable, so must not be modified.
 }
 ;
 
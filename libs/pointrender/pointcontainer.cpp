@@ -118,7 +118,8 @@ bool loadPointFile(PointArray& points, const std::string& fileName)
 //------------------------------------------------------------------------------
 PointOctree::PointOctree(const PointArray& points)
     : m_root(0),
-    m_dataSize(points.stride)
+    m_dataSize(points.stride),
+    m_memoryUsage(0)
 {
     size_t npoints = points.size();
     // Super naive, recursive top-down construction.
@@ -160,6 +161,7 @@ PointOctree::PointOctree(const PointArray& points)
     bound.min = c - V3f(maxDim2);
     bound.max = c + V3f(maxDim2);
     m_root = makeTree(0, &workspace[0], npoints, m_dataSize, bound);
+    m_memoryUsage = treeMemory(m_root, m_dataSize);
 }
 
 
@@ -276,12 +278,23 @@ void PointOctree::deleteTree(Node* n)
 }
 
 
+size_t PointOctree::treeMemory(const Node* n, int dataSize)
+{
+    if(!n) return 0;
+    size_t bytes = sizeof(Node) + n->npoints*dataSize*sizeof(float);
+    for(int i = 0; i < 8; ++i)
+        bytes += treeMemory(n->children[i], dataSize);
+    return bytes;
+}
+
+
 //------------------------------------------------------------------------------
 const PointOctree* PointOctreeCache::find(const std::string& fileName)
 {
     MapType::const_iterator i = m_cache.find(fileName);
     if(i == m_cache.end())
     {
+        m_filesRead.insert(fileName);
         // Try to open the file
         //
         // TODO: Path handling
@@ -308,6 +321,25 @@ void PointOctreeCache::clear()
 }
 
 
+void PointOctreeCache::takeFilesRead(std::vector<std::string>& fileNames)
+{
+    fileNames.insert(fileNames.end(), m_filesRead.begin(), m_filesRead.end());
+    m_filesRead.clear();
+}
+
+
+size_t PointOctreeCache::memoryUsage() const
+{
+    size_t bytes = 0;
+    for(MapType::const_iterator i = m_cache.begin(); i != m_cache.end(); ++i)
+    {
+        if(i->second)
+            bytes += i->second->memoryUsage();
+    }
+    return bytes;
+}
+
+
 } // namespace Aqsis
 
 // vi: set et:
@@ -32,6 +32,8 @@
 #define AQSIS_POINTCONTAINER_H_INCLUDED
 
 #include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 #include <OpenEXR/ImathVec.h>
@@ -146,6 +148,9 @@ class PointOctree
         /// Get number of floats representing each point.
         int dataSize() const { return m_dataSize; }
 
+        /// Get number of bytes used by the tree nodes and point data.
+        size_t memoryUsage() const { return m_memoryUsage; }
+
     private:
         /// Build a tree node from the given points
         ///
@@ -159,8 +164,12 @@ class PointOctree
         /// Recursively delete tree, depth first.
         static void deleteTree(Node* n);
 
+        /// Recursively sum the memory used by a tree.
+        static size_t treeMemory(const Node* n, int dataSize);
+
         Node* m_root;
         int m_dataSize;
+        size_t m_memoryUsage;
 };
 
 
@@ -180,9 +189,18 @@ class PointOctreeCache
         /// Clear all trees from the cache
         void clear();
 
+        /// Get number of bytes used by all cached trees.
+        size_t memoryUsage() const;
+
+        /// Get the names of the files loaded since the last call.
+        ///
+        /// The names are appended to fileNames.
+        void takeFilesRead(std::vector<std::string>& fileNames);
+
     private:
         typedef std::map<std::string, boost::shared_ptr<PointOctree> > MapType;
         MapType m_cache;
+        std::set<std::string> m_filesRead;
 };
 
 
@@ -35,6 +35,7 @@
 
 #include <aqsis/ri/ri.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <boost/shared_ptr.hpp>
@@ -78,6 +79,9 @@ namespace Aqsis {
 // "RI2RIB_Indentation", "Type", "Space"
 // "RI2RIB_Indentation", "Type", "Tab"
 // "RI2RIB_Indentation", "Size", sz  (sz = num chars per indent, an integer)
+// "RI2RIB_SplitArchives", "Threshold", n  (n = min num parameter values, an integer)
+// "RI2RIB_SplitArchives", "Prefix", "name"
+// "RI2RIB_SplitArchives", "Threads", n
 //
 // Note that a previous version of libri2rib also supported the following
 // option:
@@ -129,6 +133,18 @@ void riToRiCxxOptionPreBegin(RtToken name, RtInt count, RtToken* tokens,
             else if(!strcmp(tokens[i], "Size"))
                 g_writerOpts.indentStep = *static_cast<int*>(values[i]);
         }
+        else if(!strcmp(name, "RI2RIB_SplitArchives"))
+        {
+            if(!strcmp(tokens[i], "Threshold"))
+                g_writerOpts.splitArchiveThreshold =
+                    std::max(0, *static_cast<int*>(values[i]));
+            else if(!strcmp(tokens[i], "Prefix"))
+                g_writerOpts.splitArchivePrefix =
+                    *static_cast<RtToken*>(values[i]);
+            else if(!strcmp(tokens[i], "Threads"))
+                g_writerOpts.splitArchiveThreads =
+                    *static_cast<int*>(values[i]);
+        }
     }
 }
 }
@@ -142,6 +158,7 @@ AQSIS_RI_SHARE RtVoid RiBegin(RtToken name)
     std::ostream* outStream = &std::cout;
     if(g_ostream)
         outStream = g_ostream;
+    RibWriterOptions writerOpts = g_writerOpts;
     if(name && strcmp(name, "") != 0 && strcmp(name, "stdout") != 0)
     {
         g_context->outFile.open(name, std::ios::out | std::ios::binary);
@@ -151,8 +168,9 @@ AQSIS_RI_SHARE RtVoid RiBegin(RtToken name)
             return;
         }
         outStream = &g_context->outFile;
+        writerOpts.outputFileName = name;
     }
-    g_context->writerServices.reset(createRibWriter(*outStream, g_writerOpts));
+    g_context->writerServices.reset(createRibWriter(*outStream, writerOpts));
     g_context->writerServices->addFilter("validate");
     registerStdFuncs(*g_context->writerServices);
     g_context->riToRiCxxData = riToRiCxxBegin(*g_context->writerServices);
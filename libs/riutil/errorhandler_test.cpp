@@ -121,6 +121,23 @@ BOOST_AUTO_TEST_CASE(ErrorHandler_lazy_formatting_test)
 }
 
 
+BOOST_AUTO_TEST_CASE(ErrorHandler_error_count_test)
+{
+    ErrorHandlerTestImpl handler(Aqsis::Ri::ErrorHandler::Severe);
+    BOOST_CHECK_EQUAL(handler.errorCount(), 0);
+
+    handler.warning(0, "not an error");
+    handler.message(0, "not an error either");
+    BOOST_CHECK_EQUAL(handler.errorCount(), 0);
+
+    // Errors are counted even when they are below the verbosity threshold.
+    handler.error(0, "an error");
+    handler.severe(0, "a severe error");
+    handler.log(Aqsis::Ri::ErrorHandler::Error | 1, "a logged error");
+    BOOST_CHECK_EQUAL(handler.errorCount(), 3);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
 
 // vi: set et:
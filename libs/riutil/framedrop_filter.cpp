@@ -33,6 +33,7 @@
 /// \author Chris Foster [chris42f (at) g mail (d0t) com]
 
 #include <aqsis/riutil/ricxx_filter.h>
+#include <aqsis/riutil/ribindex.h>
 
 #include <algorithm>
 #include <cstdlib>
@@ -72,25 +73,11 @@ class FrameDropFilter : public OnOffFilter
 };
 
 
-static void parseFrames(const Ri::ParamList& pList,
-                        std::vector<int>& desiredFrames)
+void parseFrameList(const char* frames, std::vector<int>& desiredFrames)
 {
     desiredFrames.clear();
-    // search for the "frames" parameter; if it's an integer array, just use
-    // those frames.
-    int idx = pList.find(Ri::TypeSpec(Ri::TypeSpec::Integer), "frames");
-    if(idx >= 0)
-    {
-        desiredFrames.assign(pList[idx].intData().begin(),
-                             pList[idx].intData().end());
-        return;
-    }
-    idx = pList.find(Ri::TypeSpec(Ri::TypeSpec::String), "frames");
-    if(idx < 0 || pList[idx].size() == 0)
-        AQSIS_THROW_XQERROR(XqValidation, EqE_BadToken, "no frames found");
-    // If it's a string array, parse it as a comma separated list of ranges, eg,
+    // Parse frames as a comma separated list of ranges, eg,
     // "1,3,5,6-9,10-20"
-    const char* frames = pList[idx].stringData()[0];
     const char* nptr = frames;
     while(*nptr)
     {
@@ -130,6 +117,26 @@ static void parseFrames(const Ri::ParamList& pList,
     }
 }
 
+static void parseFrames(const Ri::ParamList& pList,
+                        std::vector<int>& desiredFrames)
+{
+    desiredFrames.clear();
+    // search for the "frames" parameter; if it's an integer array, just use
+    // those frames.
+    int idx = pList.find(Ri::TypeSpec(Ri::TypeSpec::Integer), "frames");
+    if(idx >= 0)
+    {
+        desiredFrames.assign(pList[idx].intData().begin(),
+                             pList[idx].intData().end());
+        return;
+    }
+    idx = pList.find(Ri::TypeSpec(Ri::TypeSpec::String), "frames");
+    if(idx < 0 || pList[idx].size() == 0)
+        AQSIS_THROW_XQERROR(XqValidation, EqE_BadToken, "no frames found");
+    // If it's a string array, parse it as a frame list.
+    parseFrameList(pList[idx].stringData()[0], desiredFrames);
+}
+
 Ri::Filter* createFrameDropFilter(const Ri::ParamList& pList)
 {
     std::vector<int> desiredFrames;
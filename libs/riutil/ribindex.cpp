@@ -0,0 +1,274 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+/// \brief Index of the frames in a multi-frame RIB file.
+
+#include <aqsis/riutil/ribindex.h>
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+namespace Aqsis {
+
+namespace {
+
+/// Lexical state of the RIB scanner.
+enum ScanState
+{
+    Scan_Space,     ///< Between tokens
+    Scan_Token,     ///< Inside a request name or number
+    Scan_String,    ///< Inside a quoted string
+    Scan_Escape,    ///< After a backslash inside a quoted string
+    Scan_Comment    ///< Inside a comment
+};
+
+/// Header line of saved indices; bump the version if the format changes.
+const char* const indexHeader = "##RibIndex 1";
+
+/// Append a range, merging it with the last one if they're contiguous.
+void appendRange(std::vector<RibIndex::Range>& ranges,
+                 const RibIndex::Range& r)
+{
+    if(r.first == r.second)
+        return;
+    if(!ranges.empty() && ranges.back().second == r.first)
+        ranges.back().second = r.second;
+    else
+        ranges.push_back(r);
+}
+
+} // anon namespace
+
+
+RibIndex::RibIndex()
+    : m_streamSize(0),
+    m_frames()
+{ }
+
+bool RibIndex::build(std::istream& ribStream)
+{
+    m_streamSize = 0;
+    m_frames.clear();
+    std::streambuf& buf = *ribStream.rdbuf();
+
+    ScanState state = Scan_Space;
+    // Current bare token and the offset at which it started.  Only request
+    // names short enough to be FrameBegin or FrameEnd are interesting.
+    char token[16];
+    int tokenLen = 0;
+    Offset tokenStart = 0;
+    // Set if we're inside a frame block, or waiting for a frame number.
+    bool inFrame = false;
+    bool wantNumber = false;
+    Frame frame;
+
+    const int bufSize = 1 << 16;
+    std::vector<char> chunk(bufSize);
+    Offset pos = 0;
+    for(std::streamsize n = buf.sgetn(&chunk[0], bufSize); n > 0;
+        n = buf.sgetn(&chunk[0], bufSize))
+    {
+        if(pos == 0 && n >= 2 && static_cast<unsigned char>(chunk[0]) == 0x1f
+           && static_cast<unsigned char>(chunk[1]) == 0x8b)
+        {
+            // gzipped; can't seek into the uncompressed data.
+            return false;
+        }
+        for(std::streamsize i = 0; i < n; ++i, ++pos)
+        {
+            unsigned char c = chunk[i];
+            switch(state)
+            {
+                case Scan_String:
+                    if(c == '\\')
+                        state = Scan_Escape;
+                    else if(c == '"')
+                        state = Scan_Space;
+                    continue;
+                case Scan_Escape:
+                    state = Scan_String;
+                    continue;
+                case Scan_Comment:
+                    if(c == '\n' || c == '\r')
+                        state = Scan_Space;
+                    continue;
+                default:
+                    break;
+            }
+            bool delimiter = c == ' ' || c == '\t' || c == '\n' || c == '\r'
+                || c == '"' || c == '#' || c == '[' || c == ']';
+            if(!delimiter)
+            {
+                if(c >= 0200)
+                {
+                    // Binary encoded RIB.
+                    m_frames.clear();
+                    return false;
+                }
+                if(state == Scan_Space)
+                {
+                    state = Scan_Token;
+                    tokenLen = 0;
+                    tokenStart = pos;
+                }
+                if(tokenLen < static_cast<int>(sizeof(token)))
+                    token[tokenLen] = c;
+                ++tokenLen;
+                continue;
+            }
+            if(state == Scan_Token)
+            {
+                // End of a bare token; see whether it delimits a frame.
+                if(wantNumber)
+                {
+                    std::istringstream numStream(std::string(token,
+                            std::min<int>(tokenLen, sizeof(token))));
+                    if(!(numStream >> frame.number))
+                    {
+                        m_frames.clear();
+                        return false;
+                    }
+                    wantNumber = false;
+                }
+                else if(tokenLen == 10 && std::memcmp(token, "FrameBegin", 10) == 0)
+                {
+                    if(inFrame)
+                    {
+                        m_frames.clear();
+                        return false;
+                    }
+                    inFrame = true;
+                    wantNumber = true;
+                    frame.range.first = tokenStart;
+                }
+                else if(tokenLen == 8 && std::memcmp(token, "FrameEnd", 8) == 0)
+                {
+                    if(!inFrame || wantNumber)
+                    {
+                        m_frames.clear();
+                        return false;
+                    }
+                    inFrame = false;
+                    frame.range.second = pos;
+                    m_frames.push_back(frame);
+                }
+            }
+            state = Scan_Space;
+            if(c == '"')
+                state = Scan_String;
+            else if(c == '#')
+                state = Scan_Comment;
+        }
+    }
+    if(state == Scan_Token && tokenLen == 8 && inFrame && !wantNumber
+       && std::memcmp(token, "FrameEnd", 8) == 0)
+    {
+        // FrameEnd right at the end of the stream.
+        inFrame = false;
+        frame.range.second = pos;
+        m_frames.push_back(frame);
+    }
+    if(inFrame)
+    {
+        // Unterminated frame.
+        m_frames.clear();
+        return false;
+    }
+    m_streamSize = pos;
+    return true;
+}
+
+bool RibIndex::read(std::istream& in)
+{
+    m_streamSize = 0;
+    m_frames.clear();
+    std::string header;
+    std::getline(in, header);
+    std::string key;
+    if(header != indexHeader || !(in >> key >> m_streamSize) || key != "size")
+        return false;
+    Frame frame;
+    while(in >> key)
+    {
+        if(key != "frame" || !(in >> frame.number >> frame.range.first
+                                  >> frame.range.second)
+           || frame.range.first > frame.range.second
+           || frame.range.second > m_streamSize)
+        {
+            m_frames.clear();
+            return false;
+        }
+        m_frames.push_back(frame);
+    }
+    return true;
+}
+
+void RibIndex::write(std::ostream& out) const
+{
+    out << indexHeader << "\n"
+        << "size " << m_streamSize << "\n";
+    for(std::vector<Frame>::const_iterator f = m_frames.begin();
+        f != m_frames.end(); ++f)
+    {
+        out << "frame " << f->number << " " << f->range.first << " "
+            << f->range.second << "\n";
+    }
+}
+
+std::vector<RibIndex::Range> RibIndex::ranges(
+        const std::vector<int>& desiredFrames) const
+{
+    std::vector<Range> result;
+    Offset pos = 0;
+    for(std::vector<Frame>::const_iterator f = m_frames.begin();
+        f != m_frames.end(); ++f)
+    {
+        appendRange(result, Range(pos, f->range.first));
+        if(std::find(desiredFrames.begin(), desiredFrames.end(), f->number)
+           != desiredFrames.end())
+            appendRange(result, f->range);
+        pos = f->range.second;
+    }
+    appendRange(result, Range(pos, m_streamSize));
+    return result;
+}
+
+std::string ribIndexFileName(const std::string& ribFileName)
+{
+    return ribFileName + ".idx";
+}
+
+} // namespace Aqsis
+
+// vi: set et:
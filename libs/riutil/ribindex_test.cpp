@@ -0,0 +1,136 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+/// \brief Unit tests for the RIB frame index.
+
+#include <aqsis/riutil/ribindex.h>
+
+#define BOOST_TEST_DYN_LINK
+
+#include <cstring>
+#include <sstream>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace Aqsis;
+
+namespace {
+
+const char* const multiFrameRib =
+    "Option \"searchpath\" \"shader\" \"@\"\n"   // 0
+    "FrameBegin 1\n"                            // 33
+    "  Sphere 1 -1 1 360 # FrameEnd\n"          // 46
+    "FrameEnd\n"                                // 77
+    "Declare \"FrameBegin\" \"uniform float\"\n"// 86
+    "FrameBegin 2\n"                            // 123
+    "FrameEnd\n"                                // 136
+    "FrameBegin 3 Sphere 1 -1 1 360 FrameEnd";  // 145
+
+} // anon namespace
+
+BOOST_AUTO_TEST_SUITE(ribindex_tests)
+
+BOOST_AUTO_TEST_CASE(RibIndex_build)
+{
+    std::istringstream in(multiFrameRib);
+    RibIndex index;
+    BOOST_REQUIRE(index.build(in));
+    BOOST_CHECK_EQUAL(index.streamSize(), std::strlen(multiFrameRib));
+    BOOST_REQUIRE_EQUAL(index.frames().size(), 3U);
+    BOOST_CHECK_EQUAL(index.frames()[0].number, 1);
+    BOOST_CHECK_EQUAL(index.frames()[0].range.first, 33U);
+    BOOST_CHECK_EQUAL(index.frames()[0].range.second, 85U);
+    BOOST_CHECK_EQUAL(index.frames()[1].number, 2);
+    BOOST_CHECK_EQUAL(index.frames()[1].range.first, 123U);
+    BOOST_CHECK_EQUAL(index.frames()[2].number, 3);
+    BOOST_CHECK_EQUAL(index.frames()[2].range.second, index.streamSize());
+}
+
+BOOST_AUTO_TEST_CASE(RibIndex_ranges)
+{
+    std::istringstream in(multiFrameRib);
+    RibIndex index;
+    BOOST_REQUIRE(index.build(in));
+
+    std::vector<int> frames;
+    frames.push_back(2);
+    std::vector<RibIndex::Range> ranges = index.ranges(frames);
+    // The header, then the gap after frame 1 merged with frame 2 and the
+    // gap before frame 3.
+    BOOST_REQUIRE_EQUAL(ranges.size(), 2U);
+    BOOST_CHECK_EQUAL(ranges[0].first, 0U);
+    BOOST_CHECK_EQUAL(ranges[0].second, 33U);
+    BOOST_CHECK_EQUAL(ranges[1].first, 85U);
+    BOOST_CHECK_EQUAL(ranges[1].second, 145U);
+}
+
+BOOST_AUTO_TEST_CASE(RibIndex_read_write)
+{
+    std::istringstream in(multiFrameRib);
+    RibIndex index;
+    BOOST_REQUIRE(index.build(in));
+
+    std::stringstream saved;
+    index.write(saved);
+    RibIndex index2;
+    BOOST_REQUIRE(index2.read(saved));
+    BOOST_CHECK_EQUAL(index2.streamSize(), index.streamSize());
+    BOOST_REQUIRE_EQUAL(index2.frames().size(), index.frames().size());
+    BOOST_CHECK_EQUAL(index2.frames()[1].range.first,
+                      index.frames()[1].range.first);
+
+    std::istringstream bad("not an index\n");
+    BOOST_CHECK(!index2.read(bad));
+}
+
+BOOST_AUTO_TEST_CASE(RibIndex_unindexable)
+{
+    RibIndex index;
+    std::istringstream gzipped(std::string("\x1f\x8b\x08\x00", 4));
+    BOOST_CHECK(!index.build(gzipped));
+    std::istringstream binary("FrameBegin 1 \x81\x02 FrameEnd");
+    BOOST_CHECK(!index.build(binary));
+    std::istringstream unterminated("FrameBegin 1 Sphere 1 -1 1 360");
+    BOOST_CHECK(!index.build(unterminated));
+}
+
+BOOST_AUTO_TEST_CASE(parseFrameList_test)
+{
+    std::vector<int> frames;
+    parseFrameList("1,3-5", frames);
+    BOOST_REQUIRE_EQUAL(frames.size(), 4U);
+    BOOST_CHECK_EQUAL(frames[0], 1);
+    BOOST_CHECK_EQUAL(frames[3], 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// vi: set et:
@@ -38,16 +38,24 @@
 
 #include <algorithm>
 #include <cstring>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <string>
 
 #ifdef USE_GZIPPED_RIB
 #   include <boost/iostreams/filtering_stream.hpp>
 #   include <boost/iostreams/filter/gzip.hpp>
 #endif
+#include <boost/bind.hpp>
 #include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <aqsis/riutil/ribparser.h>
 #include <aqsis/riutil/tokendictionary.h>
@@ -2407,6 +2415,418 @@ RtVoid RibWriter<Formatter>::ArchiveEnd()
 //[[[end]]]
 
 
+//------------------------------------------------------------------------------
+/// Pool of threads which compress and write split archive files.
+///
+/// The archive contents are handed over as strings; the threads take care of
+/// the (possibly gzipped) file output, which is usually the expensive part.
+/// Errors in the threads are collected and logged from the thread queueing
+/// the archives.
+class ArchiveWriterPool : boost::noncopyable
+{
+    private:
+        struct Job
+        {
+            std::string fileName;
+            std::string contents;
+        };
+
+        bool m_useGzip;
+        size_t m_maxQueued;
+        std::deque<Job> m_jobs;
+        bool m_finished;
+        std::vector<std::string> m_errors;
+        boost::mutex m_mutex;
+        boost::condition_variable m_jobAdded;
+        boost::condition_variable m_jobRemoved;
+        boost::thread_group m_threads;
+
+        /// Write an archive file, returning false if it couldn't be written.
+        bool writeFile(const Job& job)
+        {
+            std::ofstream file(job.fileName.c_str(),
+                               std::ios::out | std::ios::binary);
+            if(!file)
+                return false;
+            if(!m_useGzip)
+            {
+                file.write(job.contents.data(), job.contents.size());
+                file.close();
+                return !file.fail();
+            }
+#           ifdef USE_GZIPPED_RIB
+            namespace io = boost::iostreams;
+            io::filtering_stream<io::output> gzipStream;
+            gzipStream.push(io::gzip_compressor());
+            gzipStream.push(file);
+            gzipStream.write(job.contents.data(), job.contents.size());
+            // Flush the compressor before checking the file.
+            gzipStream.reset();
+#           endif
+            file.close();
+            return !file.fail();
+        }
+
+        void work()
+        {
+            while(true)
+            {
+                Job job;
+                {
+                    boost::mutex::scoped_lock lock(m_mutex);
+                    while(m_jobs.empty() && !m_finished)
+                        m_jobAdded.wait(lock);
+                    if(m_jobs.empty())
+                        return;
+                    job.fileName.swap(m_jobs.front().fileName);
+                    job.contents.swap(m_jobs.front().contents);
+                    m_jobs.pop_front();
+                }
+                m_jobRemoved.notify_one();
+                std::string err;
+                try
+                {
+                    if(!writeFile(job))
+                        err = "Could not write split archive \"" + job.fileName + "\"";
+                }
+                catch(std::exception& e)
+                {
+                    err = "Could not write split archive \"" + job.fileName
+                        + "\": " + e.what();
+                }
+                if(!err.empty())
+                {
+                    boost::mutex::scoped_lock lock(m_mutex);
+                    m_errors.push_back(err);
+                }
+            }
+        }
+
+        /// Log the errors from the writer threads.
+        void reportErrors()
+        {
+            std::vector<std::string> errors;
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                errors.swap(m_errors);
+            }
+            for(size_t i = 0; i < errors.size(); ++i)
+                Aqsis::log() << error << errors[i] << std::endl;
+        }
+
+    public:
+        ArchiveWriterPool(int numThreads, bool useGzip)
+            : m_useGzip(useGzip),
+            m_maxQueued(0),
+            m_jobs(),
+            m_finished(false),
+            m_errors()
+        {
+            if(numThreads <= 0)
+                numThreads = std::max(1u, boost::thread::hardware_concurrency());
+            // Limit the number of formatted archives held in memory.
+            m_maxQueued = 2*numThreads;
+            for(int i = 0; i < numThreads; ++i)
+                m_threads.create_thread(
+                        boost::bind(&ArchiveWriterPool::work, this));
+        }
+
+        /// Wait for all the queued archives to be written.
+        ~ArchiveWriterPool()
+        {
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                m_finished = true;
+            }
+            m_jobAdded.notify_all();
+            m_threads.join_all();
+            reportErrors();
+        }
+
+        /// Queue an archive for writing.  contents is cleared.
+        void write(const std::string& fileName, std::string& contents)
+        {
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                while(m_jobs.size() >= m_maxQueued)
+                    m_jobRemoved.wait(lock);
+                m_jobs.push_back(Job());
+                m_jobs.back().fileName = fileName;
+                m_jobs.back().contents.swap(contents);
+            }
+            m_jobAdded.notify_one();
+            reportErrors();
+        }
+};
+
+
+//------------------------------------------------------------------------------
+/// Filter which moves large geometric primitives into separate archives.
+///
+/// Primitives with at least RibWriterOptions::splitArchiveThreshold parameter
+/// values are formatted into memory and replaced by a ReadArchive of the file
+/// they're written to.  The archive files are written in parallel by an
+/// ArchiveWriterPool.
+///
+/// Primitives inside motion blocks and object definitions are always written
+/// inline, since ReadArchive isn't allowed there.
+class ArchiveSplitFilter : public PassthroughFilter
+{
+    private:
+        /// Writer for the main stream
+        boost::shared_ptr<Ri::Renderer> m_writer;
+        /// Options for the RIB writers which format archives
+        RibWriterOptions m_archiveOpts;
+        size_t m_threshold;
+        /// Prefix of the archive file names, and of the names they're read
+        /// by in the main stream
+        std::string m_filePrefix;
+        std::string m_readPrefix;
+        std::string m_suffix;
+        int m_archiveCount;
+        /// Nesting depth of blocks in which primitives may not be split.
+        int m_noSplitDepth;
+        /// Buffer and writer for the archive currently being formatted
+        std::ostringstream m_archiveStream;
+        boost::shared_ptr<RibWriterServices> m_archiveWriter;
+        /// m_pool must be last, so that it's destroyed first.
+        ArchiveWriterPool m_pool;
+
+        /// Get a writer for a new archive if the primitive with the given
+        /// parameters should be split, or null if not.
+        Ri::Renderer* beginArchive(const ParamList& pList)
+        {
+            if(m_noSplitDepth > 0)
+                return 0;
+            size_t numValues = 0;
+            for(size_t i = 0; i < pList.size(); ++i)
+                numValues += pList[i].size();
+            if(numValues < m_threshold)
+                return 0;
+            m_archiveStream.str("");
+            m_archiveWriter.reset(createRibWriter(m_archiveStream,
+                                                  m_archiveOpts));
+            return &m_archiveWriter->firstFilter();
+        }
+
+        /// Queue the current archive for writing, and reference it from the
+        /// main stream.
+        void endArchive()
+        {
+            m_archiveWriter.reset();
+            std::ostringstream name;
+            name << '_' << std::setfill('0') << std::setw(6)
+                << m_archiveCount++ << m_suffix;
+            std::string contents = m_archiveStream.str();
+            m_archiveStream.str("");
+            m_pool.write(m_filePrefix + name.str(), contents);
+            nextFilter().ReadArchive((m_readPrefix + name.str()).c_str(), 0,
+                                     ParamList());
+        }
+
+        /// Work out the archive name prefixes, as described for
+        /// RibWriterOptions::splitArchivePrefix.
+        void setPrefix(const RibWriterOptions& opts)
+        {
+            boostfs::path outputPath = opts.outputFileName;
+            std::string prefix = opts.splitArchivePrefix;
+            if(prefix.empty() && !opts.outputFileName.empty())
+            {
+                prefix = filename(outputPath);
+                const char* exts[] = {".gz", ".rib"};
+                for(int i = 0; i < 2; ++i)
+                {
+                    size_t len = std::strlen(exts[i]);
+                    if(prefix.size() > len &&
+                       prefix.compare(prefix.size() - len, len, exts[i]) == 0)
+                        prefix.erase(prefix.size() - len);
+                }
+            }
+            if(prefix.empty())
+                prefix = "archive";
+            m_readPrefix = prefix;
+            if(boostfs::path(prefix).has_root_directory())
+                m_filePrefix = prefix;
+            else
+                m_filePrefix = native(outputPath.parent_path() / prefix);
+        }
+
+    public:
+        ArchiveSplitFilter(const boost::shared_ptr<Ri::Renderer>& writer,
+                           const RibWriterOptions& opts)
+            : m_writer(writer),
+            m_archiveOpts(opts),
+            m_threshold(opts.splitArchiveThreshold),
+            m_filePrefix(),
+            m_readPrefix(),
+            m_suffix(opts.useGzip ? ".rib.gz" : ".rib"),
+            m_archiveCount(0),
+            m_noSplitDepth(0),
+            m_archiveStream(),
+            m_archiveWriter(),
+            m_pool(opts.splitArchiveThreads, opts.useGzip)
+        {
+            // Archives are compressed by the writer pool rather than while
+            // being formatted.
+            m_archiveOpts.useGzip = false;
+            m_archiveOpts.splitArchiveThreshold = 0;
+            setPrefix(opts);
+            setNextFilter(*m_writer);
+        }
+
+        virtual RtVoid MotionBegin(const FloatArray& times)
+        {
+            ++m_noSplitDepth;
+            nextFilter().MotionBegin(times);
+        }
+        virtual RtVoid MotionEnd()
+        {
+            --m_noSplitDepth;
+            nextFilter().MotionEnd();
+        }
+        virtual RtVoid ObjectBegin(RtConstToken name)
+        {
+            ++m_noSplitDepth;
+            nextFilter().ObjectBegin(name);
+        }
+        virtual RtVoid ObjectEnd()
+        {
+            --m_noSplitDepth;
+            nextFilter().ObjectEnd();
+        }
+
+        virtual RtVoid Polygon(const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->Polygon(pList);
+                endArchive();
+            }
+            else
+                nextFilter().Polygon(pList);
+        }
+        virtual RtVoid GeneralPolygon(const IntArray& nverts,
+                                      const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->GeneralPolygon(nverts, pList);
+                endArchive();
+            }
+            else
+                nextFilter().GeneralPolygon(nverts, pList);
+        }
+        virtual RtVoid PointsPolygons(const IntArray& nverts,
+                                      const IntArray& verts,
+                                      const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->PointsPolygons(nverts, verts, pList);
+                endArchive();
+            }
+            else
+                nextFilter().PointsPolygons(nverts, verts, pList);
+        }
+        virtual RtVoid PointsGeneralPolygons(const IntArray& nloops,
+                                             const IntArray& nverts,
+                                             const IntArray& verts,
+                                             const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->PointsGeneralPolygons(nloops, nverts, verts, pList);
+                endArchive();
+            }
+            else
+                nextFilter().PointsGeneralPolygons(nloops, nverts, verts,
+                                                   pList);
+        }
+        virtual RtVoid PatchMesh(RtConstToken type, RtInt nu,
+                                 RtConstToken uwrap, RtInt nv,
+                                 RtConstToken vwrap, const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->PatchMesh(type, nu, uwrap, nv, vwrap, pList);
+                endArchive();
+            }
+            else
+                nextFilter().PatchMesh(type, nu, uwrap, nv, vwrap, pList);
+        }
+        virtual RtVoid NuPatch(RtInt nu, RtInt uorder, const FloatArray& uknot,
+                               RtFloat umin, RtFloat umax, RtInt nv,
+                               RtInt vorder, const FloatArray& vknot,
+                               RtFloat vmin, RtFloat vmax,
+                               const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->NuPatch(nu, uorder, uknot, umin, umax, nv, vorder,
+                                 vknot, vmin, vmax, pList);
+                endArchive();
+            }
+            else
+                nextFilter().NuPatch(nu, uorder, uknot, umin, umax, nv,
+                                     vorder, vknot, vmin, vmax, pList);
+        }
+        virtual RtVoid SubdivisionMesh(RtConstToken scheme,
+                                       const IntArray& nvertices,
+                                       const IntArray& vertices,
+                                       const TokenArray& tags,
+                                       const IntArray& nargs,
+                                       const IntArray& intargs,
+                                       const FloatArray& floatargs,
+                                       const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->SubdivisionMesh(scheme, nvertices, vertices, tags,
+                                         nargs, intargs, floatargs, pList);
+                endArchive();
+            }
+            else
+                nextFilter().SubdivisionMesh(scheme, nvertices, vertices,
+                                             tags, nargs, intargs, floatargs,
+                                             pList);
+        }
+        virtual RtVoid Points(const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->Points(pList);
+                endArchive();
+            }
+            else
+                nextFilter().Points(pList);
+        }
+        virtual RtVoid Curves(RtConstToken type, const IntArray& nvertices,
+                              RtConstToken wrap, const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->Curves(type, nvertices, wrap, pList);
+                endArchive();
+            }
+            else
+                nextFilter().Curves(type, nvertices, wrap, pList);
+        }
+        virtual RtVoid Blobby(RtInt nleaf, const IntArray& code,
+                              const FloatArray& floats,
+                              const TokenArray& strings,
+                              const ParamList& pList)
+        {
+            if(Ri::Renderer* archive = beginArchive(pList))
+            {
+                archive->Blobby(nleaf, code, floats, strings, pList);
+                endArchive();
+            }
+            else
+                nextFilter().Blobby(nleaf, code, floats, strings, pList);
+        }
+};
+
+
 //------------------------------------------------------------------------------
 /// Create an object which serializes Ri::Renderer calls into a RIB stream.
 RibWriterServices* createRibWriter(std::ostream& out,
@@ -2418,6 +2838,14 @@ RibWriterServices* createRibWriter(std::ostream& out,
         writer.reset(new RibWriter<BinaryFormatter>(*services, out, opts));
     else
         writer.reset(new RibWriter<AsciiFormatter>(*services, out, opts));
+    // Splitting is pointless when archives are interpolated back inline.
+    if(opts.splitArchiveThreshold > 0 && !opts.interpolateArchives)
+    {
+        boost::shared_ptr<ArchiveSplitFilter> splitter(
+                new ArchiveSplitFilter(writer, opts));
+        splitter->setRendererServices(*services);
+        writer = splitter;
+    }
     services->setWriter(writer);
     return services;
 }
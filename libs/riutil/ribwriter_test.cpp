@@ -0,0 +1,126 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+/// \brief Unit tests for the RIB writer.
+
+#include <aqsis/riutil/ribwriter.h>
+
+#define BOOST_TEST_DYN_LINK
+
+#include <sstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+#include <aqsis/util/file.h>
+
+using namespace Aqsis;
+
+namespace {
+
+const char* const splitRib =
+    "WorldBegin\n"
+    "Polygon \"P\" [0 0 0  1 0 0  1 1 0]\n"
+    "Sphere 1 -1 1 360\n"
+    "MotionBegin [0 1]\n"
+    "Polygon \"P\" [0 0 0  1 0 0  1 1 0]\n"
+    "Polygon \"P\" [0 0 1  1 0 1  1 1 1]\n"
+    "MotionEnd\n"
+    "Points \"P\" [0 0 0  1 1 1] \"constantwidth\" [0.1]\n"
+    "WorldEnd\n";
+
+// Write a RIB stream through a RIB writer with the given options.
+std::string writeRib(const std::string& rib, const RibWriterOptions& opts)
+{
+    std::ostringstream out;
+    {
+        boost::scoped_ptr<RibWriterServices> writer(createRibWriter(out, opts));
+        std::istringstream in(rib);
+        writer->parseRib(in, "test");
+    }
+    return out.str();
+}
+
+} // anon namespace
+
+BOOST_AUTO_TEST_SUITE(ribwriter_tests)
+
+BOOST_AUTO_TEST_CASE(RibWriter_split_archives)
+{
+    boostfs::path dir = "ribwriter_split_test";
+    boostfs::remove_all(dir);
+    boostfs::create_directories(dir);
+
+    RibWriterOptions opts;
+    opts.outputFileName = native(dir / "scene.rib");
+    opts.splitArchiveThreshold = 6;
+    std::string mainRib = writeRib(splitRib, opts);
+
+    // The archives are named after the output file, and read relative to it.
+    // Primitives in motion blocks and with few values aren't split.
+    BOOST_CHECK(mainRib.find("ReadArchive \"scene_000000.rib\"") != std::string::npos);
+    BOOST_CHECK(mainRib.find("ReadArchive \"scene_000001.rib\"") != std::string::npos);
+    BOOST_CHECK(mainRib.find("scene_000002") == std::string::npos);
+    BOOST_CHECK(boostfs::exists(dir / "scene_000000.rib"));
+    BOOST_CHECK(boostfs::exists(dir / "scene_000001.rib"));
+    BOOST_CHECK(mainRib.find("Sphere") != std::string::npos);
+
+    // Reading the archives back in gives the original stream.
+    RibWriterOptions readOpts;
+    readOpts.interpolateArchives = true;
+    readOpts.archivePath = native(dir);
+    BOOST_CHECK_EQUAL(writeRib(mainRib, readOpts),
+                      writeRib(splitRib, RibWriterOptions()));
+
+    boostfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(RibWriter_split_archive_prefix)
+{
+    boostfs::path dir = "ribwriter_prefix_test";
+    boostfs::remove_all(dir);
+    boostfs::create_directories(dir / "geom");
+
+    // A relative prefix is resolved against the output file's directory.
+    RibWriterOptions opts;
+    opts.outputFileName = native(dir / "scene.rib");
+    opts.splitArchivePrefix = "geom/part";
+    opts.splitArchiveThreshold = 6;
+    std::string mainRib = writeRib(splitRib, opts);
+    BOOST_CHECK(mainRib.find("ReadArchive \"geom/part_000000.rib\"") != std::string::npos);
+    BOOST_CHECK(boostfs::exists(dir / "geom" / "part_000000.rib"));
+
+    boostfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -34,16 +34,20 @@
 
 #include <aqsis/riutil/ricxx_filter.h>
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <map>
 #include <sstream>
 #include <stack>
 #include <string.h>
+#include <vector>
 
 #include <aqsis/riutil/errorhandler.h>
 #include <aqsis/riutil/interpclasscounts.h>
 #include <aqsis/riutil/ricxxutil.h>
 #include <aqsis/util/exception.h>
+#include <aqsis/util/timer.h>
 
 namespace Aqsis {
 
@@ -84,17 +88,60 @@ class RiCxxValidate : public Ri::Filter
         };
         std::stack<ApiScope> m_scopeStack;
 
-        // Attributes we need to keep track of to determine array lengths.
+        // Attributes we need to keep track of to determine array lengths,
+        // along with the validate options, which are scoped in the same way.
         struct AttrState
         {
             int ustep;
             int vstep;
-            AttrState(int ustep, int vstep) : ustep(ustep), vstep(vstep) {}
+            bool trusted;
+            AttrState(int ustep, int vstep, bool trusted)
+                : ustep(ustep), vstep(vstep), trusted(trusted) {}
         };
         std::stack<AttrState> m_attrStack;
         /// True if the attribute state isn't actually completely known from
         /// context, for example, if we're validating a RIB fragment.
         bool m_relaxedAttributeState;
+        /// True if the input is known to be valid, so that only the cheap
+        /// scope and range checks need be done.  This is a copy of the flag
+        /// in the current AttrState.
+        bool m_trusted;
+
+        /// True if the time spent validating each call should be reported.
+        bool m_timing;
+        /// Time spent validating each kind of call, keyed by procedure name.
+        typedef std::map<const char*, CqTimer> CallTimes;
+        CallTimes m_callTimes;
+
+        /// Times one call to the validator, when timing is turned on.
+        ///
+        /// stop() should be called before the call is passed on to the next
+        /// filter, so that only the time spent validating is counted.
+        class CallTimer
+        {
+            public:
+                CallTimer(RiCxxValidate& validator, const char* procName)
+                    : m_timer(validator.m_timing ?
+                              &validator.m_callTimes[procName] : 0)
+                {
+                    if(m_timer)
+                        m_timer->start();
+                }
+                ~CallTimer()
+                {
+                    stop();
+                }
+                void stop()
+                {
+                    if(m_timer)
+                    {
+                        m_timer->stop();
+                        m_timer = 0;
+                    }
+                }
+            private:
+                CqTimer* m_timer;
+        };
 
         void pushAttributes()
         {
@@ -104,6 +151,7 @@ class RiCxxValidate : public Ri::Filter
         {
             if(m_attrStack.size() > 1)
                 m_attrStack.pop();
+            m_trusted = m_attrStack.top().trusted;
         }
 
         /// Return a string corresponding to the given ApiScope
@@ -120,18 +168,25 @@ class RiCxxValidate : public Ri::Filter
         void checkParamListArraySizes(const Ri::ParamList& pList,
                                       const SqInterpClassCounts& iclassCounts,
                                       const char* procName);
+        /// Handle Option "validate" "trusted" and "timing"
+        void handleValidateOption(RtConstToken name, const Ri::ParamList& pList);
+        /// Report the time spent validating calls since the last report.
+        void reportTimes();
 
     public:
-        RiCxxValidate(bool outerScopeRelaxed)
+        RiCxxValidate(bool outerScopeRelaxed, bool trusted, bool timing)
             : m_scopeStack(),
             m_attrStack(),
-            m_relaxedAttributeState(outerScopeRelaxed)
+            m_relaxedAttributeState(outerScopeRelaxed),
+            m_trusted(trusted),
+            m_timing(timing),
+            m_callTimes()
         {
             if(outerScopeRelaxed)
                 m_scopeStack.push(Scope_Any);
             else
                 m_scopeStack.push(Scope_BeginEnd);
-            m_attrStack.push(AttrState(3,3));
+            m_attrStack.push(AttrState(3,3,trusted));
         }
 
         // Code generator for autogenerated method declarations
@@ -442,6 +497,58 @@ void RiCxxValidate::checkParamListArraySizes(const Ri::ParamList& pList,
     }
 }
 
+void RiCxxValidate::handleValidateOption(RtConstToken name,
+                                         const Ri::ParamList& pList)
+{
+    if(strcmp(name, "validate") != 0)
+        return;
+    // Options are scoped by frame and world blocks, which push and pop the
+    // attribute state along with them.
+    Ri::IntArray trusted = pList.findInt("trusted");
+    if(trusted)
+        m_trusted = m_attrStack.top().trusted = trusted[0] != 0;
+    Ri::IntArray timing = pList.findInt("timing");
+    if(timing)
+        m_timing = timing[0] != 0;
+}
+
+namespace {
+
+bool longerTime(const std::pair<const char*, const CqTimer*>& a,
+                const std::pair<const char*, const CqTimer*>& b)
+{
+    return a.second->totalTime() > b.second->totalTime();
+}
+
+}
+
+void RiCxxValidate::reportTimes()
+{
+    if(m_callTimes.empty())
+        return;
+    std::vector<std::pair<const char*, const CqTimer*> > sorted;
+    double totalTime = 0;
+    long totalCalls = 0;
+    for(CallTimes::const_iterator i = m_callTimes.begin();
+        i != m_callTimes.end(); ++i)
+    {
+        sorted.push_back(std::make_pair(i->first, &i->second));
+        totalTime += i->second.totalTime();
+        totalCalls += i->second.numSamples();
+    }
+    std::sort(sorted.begin(), sorted.end(), longerTime);
+    Ri::ErrorHandler& handler = services().errorHandler();
+    handler.message(0, "validate filter: %.3f ms over %d calls",
+                    1e3*totalTime, totalCalls);
+    for(size_t i = 0; i < sorted.size(); ++i)
+    {
+        handler.message(0, "validate filter:   %-24s %10.3f ms %10d calls",
+                        sorted[i].first, 1e3*sorted[i].second->totalTime(),
+                        sorted[i].second->numSamples());
+    }
+    m_callTimes.clear();
+}
+
 /*[[[cog
 from codegenutils import *
 from Cheetah.Template import Template
@@ -453,6 +560,8 @@ def getExtraSnippet(procName):
     ignoredScopes = set(('Transform', 'If'))
     if procName == 'Basis':
         return 'AttrState& attrs = m_attrStack.top(); attrs.ustep = ustep; attrs.vstep = vstep;'
+    elif procName == 'Option':
+        return 'handleValidateOption(name, pList);'
     elif procName.endswith('Begin') and procName[:-5] not in ignoredScopes:
         return 'pushAttributes();'
     elif procName.endswith('End') and procName[:-3] not in ignoredScopes:
@@ -488,6 +597,7 @@ rangeCheckOps = {
 methodTemplate = r'''
 $wrapDecl($riCxxMethodDecl($proc, className='RiCxxValidate'), 80)
 {
+    CallTimer timer(*this, "$procName");
 ## --------------- Scope checking -------------
 #if $doScopeCheck
     checkScope(ApiScope(${' | '.join($validScopeNames)}), "$procName");
@@ -515,50 +625,64 @@ $wrapDecl($riCxxMethodDecl($proc, className='RiCxxValidate'), 80)
     }
     #end for
   #end if
-  ## ------------ Array length check ------------
-  #if $arg.findall('Length')
-    checkArraySize($arg.findtext('Length'), ${argName}.size(),
-                   "$argName", "$procName");
-  #end if
+#end for
+## Array lengths are the expensive part of validation, since computing them
+## means walking the index arrays.  They're skipped for trusted input.
+#set $lengthArgs = [$arg for $arg in $args if $arg.findall('Length')]
+#set $hasParamList = len($proc.findall('Arguments/ParamList')) > 0
+#if $lengthArgs or $hasParamList
+    if(!m_trusted)
+    {
+#end if
+## ------------ Array length check ------------
+#for $arg in $lengthArgs
+  #set $argName = $arg.findtext('Name')
+        checkArraySize($arg.findtext('Length'), ${argName}.size(),
+                       "$argName", "$procName");
 #end for
 ## ------------ Param list check -----------
-#if $proc.findall('Arguments/ParamList')
+#if $hasParamList
  ## ----------- Param array length check --------
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
  #set $icLen = $proc.find('IClassLengths')
  #if $icLen is not None
   #if $icLen.findall('ComplicatedCustomImpl')
-    $iclassCountSnippets[$procName]
+        $iclassCountSnippets[$procName]
   #else
    #if $icLen.findall('Uniform')
-    iclassCounts.uniform = $icLen.findtext('Uniform');
+        iclassCounts.uniform = $icLen.findtext('Uniform');
    #end if
    #if $icLen.findall('Varying')
-    iclassCounts.varying = $icLen.findtext('Varying');
+        iclassCounts.varying = $icLen.findtext('Varying');
    #end if
    #if $icLen.findall('Vertex')
-    iclassCounts.vertex = $icLen.findtext('Vertex');
+        iclassCounts.vertex = $icLen.findtext('Vertex');
    #else
-    iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.vertex = iclassCounts.varying;
    #end if
    #if $icLen.findall('FaceVarying')
-    iclassCounts.facevarying = $icLen.findtext('FaceVarying');
+        iclassCounts.facevarying = $icLen.findtext('FaceVarying');
    #else
-    iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
    #end if
    #if $icLen.findall('FaceVertex')
-    iclassCounts.facevertex = $icLen.findtext('FaceVertex');
+        iclassCounts.facevertex = $icLen.findtext('FaceVertex');
    #else
-    iclassCounts.facevertex = iclassCounts.facevarying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
    #end if
   #end if
  #end if
  #if $procName in set(('PatchMesh', 'Curves'))
  ## Avoid checking params when they depend on the attribute state and we're in
  ## an archive.
-    if(m_scopeStack.top() != Scope_Archive)
+        if(m_scopeStack.top() != Scope_Archive)
  #end if
-    checkParamListArraySizes(pList, iclassCounts, "$procName");
+        checkParamListArraySizes(pList, iclassCounts, "$procName");
+#end if
+#if $lengthArgs or $hasParamList
+    }
+#end if
+#if $hasParamList
  ## ----------- Required param check --------
  #set $requiredParams = $proc.findall('Arguments/ParamList/Param')
  #if len($requiredParams) > 0
@@ -577,6 +701,7 @@ $wrapDecl($riCxxMethodDecl($proc, className='RiCxxValidate'), 80)
 #if $procName.endswith('Begin') and $procName[:-5] not in $irrelevantScopes
     pushScope(Scope_$procName[:-5]);
 #end if
+    timer.stop();
 #if $proc.findtext('ReturnType') != 'RtVoid'
     return
 #end if
@@ -584,6 +709,9 @@ $wrapDecl($riCxxMethodDecl($proc, className='RiCxxValidate'), 80)
 #if $procName.endswith('End') and $procName[:-3] not in $irrelevantScopes
     popScope(Scope_$procName[:-3]);
 #end if
+#if $procName == 'WorldEnd'
+    reportTimes();
+#end if
 }
 '''
 
@@ -603,66 +731,86 @@ for proc in riXml.findall('Procedures/Procedure'):
 
 RtVoid RiCxxValidate::Declare(RtConstString name, RtConstString declaration)
 {
+    CallTimer timer(*this, "Declare");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Declare");
+    timer.stop();
     return
     nextFilter().Declare(name, declaration);
 }
 
 RtVoid RiCxxValidate::FrameBegin(RtInt number)
 {
+    CallTimer timer(*this, "FrameBegin");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Archive), "FrameBegin");
     pushAttributes();
     pushScope(Scope_Frame);
+    timer.stop();
     nextFilter().FrameBegin(number);
 }
 
 RtVoid RiCxxValidate::FrameEnd()
 {
+    CallTimer timer(*this, "FrameEnd");
     checkScope(ApiScope(Scope_Frame | Scope_Archive), "FrameEnd");
     popAttributes();
+    timer.stop();
     nextFilter().FrameEnd();
     popScope(Scope_Frame);
 }
 
 RtVoid RiCxxValidate::WorldBegin()
 {
+    CallTimer timer(*this, "WorldBegin");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "WorldBegin");
     pushAttributes();
     pushScope(Scope_World);
+    timer.stop();
     nextFilter().WorldBegin();
 }
 
 RtVoid RiCxxValidate::WorldEnd()
 {
+    CallTimer timer(*this, "WorldEnd");
     checkScope(ApiScope(Scope_Archive | Scope_World), "WorldEnd");
     popAttributes();
+    timer.stop();
     nextFilter().WorldEnd();
     popScope(Scope_World);
+    reportTimes();
 }
 
 RtVoid RiCxxValidate::IfBegin(RtConstString condition)
 {
+    CallTimer timer(*this, "IfBegin");
+    timer.stop();
     nextFilter().IfBegin(condition);
 }
 
 RtVoid RiCxxValidate::ElseIf(RtConstString condition)
 {
+    CallTimer timer(*this, "ElseIf");
+    timer.stop();
     nextFilter().ElseIf(condition);
 }
 
 RtVoid RiCxxValidate::Else()
 {
+    CallTimer timer(*this, "Else");
+    timer.stop();
     nextFilter().Else();
 }
 
 RtVoid RiCxxValidate::IfEnd()
 {
+    CallTimer timer(*this, "IfEnd");
+    timer.stop();
     nextFilter().IfEnd();
 }
 
 RtVoid RiCxxValidate::Format(RtInt xresolution, RtInt yresolution,
                              RtFloat pixelaspectratio)
 {
+    CallTimer timer(*this, "Format");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Format");
     if(!(xresolution != 0))
     {
@@ -685,11 +833,13 @@ RtVoid RiCxxValidate::Format(RtInt xresolution, RtInt yresolution,
             "[pixelaspectratio = " << pixelaspectratio << "]"
         );
     }
+    timer.stop();
     nextFilter().Format(xresolution, yresolution, pixelaspectratio);
 }
 
 RtVoid RiCxxValidate::FrameAspectRatio(RtFloat frameratio)
 {
+    CallTimer timer(*this, "FrameAspectRatio");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "FrameAspectRatio");
     if(!(frameratio > 0))
     {
@@ -698,12 +848,14 @@ RtVoid RiCxxValidate::FrameAspectRatio(RtFloat frameratio)
             "[frameratio = " << frameratio << "]"
         );
     }
+    timer.stop();
     nextFilter().FrameAspectRatio(frameratio);
 }
 
 RtVoid RiCxxValidate::ScreenWindow(RtFloat left, RtFloat right, RtFloat bottom,
                                    RtFloat top)
 {
+    CallTimer timer(*this, "ScreenWindow");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "ScreenWindow");
     if(!(left < right))
     {
@@ -719,12 +871,14 @@ RtVoid RiCxxValidate::ScreenWindow(RtFloat left, RtFloat right, RtFloat bottom,
             "[bottom = " << bottom << ", " << "top = " << top << "]";
         );
     }
+    timer.stop();
     nextFilter().ScreenWindow(left, right, bottom, top);
 }
 
 RtVoid RiCxxValidate::CropWindow(RtFloat xmin, RtFloat xmax, RtFloat ymin,
                                  RtFloat ymax)
 {
+    CallTimer timer(*this, "CropWindow");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "CropWindow");
     if(!(xmin >= 0))
     {
@@ -768,19 +922,26 @@ RtVoid RiCxxValidate::CropWindow(RtFloat xmin, RtFloat xmax, RtFloat ymin,
             "[ymax = " << ymax << "]"
         );
     }
+    timer.stop();
     nextFilter().CropWindow(xmin, xmax, ymin, ymax);
 }
 
 RtVoid RiCxxValidate::Projection(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Projection");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Projection");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Projection");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Projection");
+    }
+    timer.stop();
     nextFilter().Projection(name, pList);
 }
 
 RtVoid RiCxxValidate::Clipping(RtFloat cnear, RtFloat cfar)
 {
+    CallTimer timer(*this, "Clipping");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Clipping");
     if(!(cnear >= RI_EPSILON))
     {
@@ -796,18 +957,22 @@ RtVoid RiCxxValidate::Clipping(RtFloat cnear, RtFloat cfar)
             "[cfar = " << cfar << ", " << "cnear = " << cnear << "]";
         );
     }
+    timer.stop();
     nextFilter().Clipping(cnear, cfar);
 }
 
 RtVoid RiCxxValidate::ClippingPlane(RtFloat x, RtFloat y, RtFloat z, RtFloat nx,
                                     RtFloat ny, RtFloat nz)
 {
+    CallTimer timer(*this, "ClippingPlane");
+    timer.stop();
     nextFilter().ClippingPlane(x, y, z, nx, ny, nz);
 }
 
 RtVoid RiCxxValidate::DepthOfField(RtFloat fstop, RtFloat focallength,
                                    RtFloat focaldistance)
 {
+    CallTimer timer(*this, "DepthOfField");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "DepthOfField");
     if(!(fstop > 0))
     {
@@ -830,11 +995,13 @@ RtVoid RiCxxValidate::DepthOfField(RtFloat fstop, RtFloat focallength,
             "[focaldistance = " << focaldistance << "]"
         );
     }
+    timer.stop();
     nextFilter().DepthOfField(fstop, focallength, focaldistance);
 }
 
 RtVoid RiCxxValidate::Shutter(RtFloat opentime, RtFloat closetime)
 {
+    CallTimer timer(*this, "Shutter");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Shutter");
     if(!(opentime <= closetime))
     {
@@ -843,11 +1010,13 @@ RtVoid RiCxxValidate::Shutter(RtFloat opentime, RtFloat closetime)
             "[opentime = " << opentime << ", " << "closetime = " << closetime << "]";
         );
     }
+    timer.stop();
     nextFilter().Shutter(opentime, closetime);
 }
 
 RtVoid RiCxxValidate::PixelVariance(RtFloat variance)
 {
+    CallTimer timer(*this, "PixelVariance");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "PixelVariance");
     if(!(variance >= 0))
     {
@@ -856,11 +1025,13 @@ RtVoid RiCxxValidate::PixelVariance(RtFloat variance)
             "[variance = " << variance << "]"
         );
     }
+    timer.stop();
     nextFilter().PixelVariance(variance);
 }
 
 RtVoid RiCxxValidate::PixelSamples(RtFloat xsamples, RtFloat ysamples)
 {
+    CallTimer timer(*this, "PixelSamples");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "PixelSamples");
     if(!(xsamples >= 1))
     {
@@ -876,12 +1047,14 @@ RtVoid RiCxxValidate::PixelSamples(RtFloat xsamples, RtFloat ysamples)
             "[ysamples = " << ysamples << "]"
         );
     }
+    timer.stop();
     nextFilter().PixelSamples(xsamples, ysamples);
 }
 
 RtVoid RiCxxValidate::PixelFilter(RtFilterFunc function, RtFloat xwidth,
                                   RtFloat ywidth)
 {
+    CallTimer timer(*this, "PixelFilter");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "PixelFilter");
     if(!(xwidth > 0))
     {
@@ -897,11 +1070,13 @@ RtVoid RiCxxValidate::PixelFilter(RtFilterFunc function, RtFloat xwidth,
             "[ywidth = " << ywidth << "]"
         );
     }
+    timer.stop();
     nextFilter().PixelFilter(function, xwidth, ywidth);
 }
 
 RtVoid RiCxxValidate::Exposure(RtFloat gain, RtFloat gamma)
 {
+    CallTimer timer(*this, "Exposure");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Exposure");
     if(!(gain > 0))
     {
@@ -917,20 +1092,27 @@ RtVoid RiCxxValidate::Exposure(RtFloat gain, RtFloat gamma)
             "[gamma = " << gamma << "]"
         );
     }
+    timer.stop();
     nextFilter().Exposure(gain, gamma);
 }
 
 RtVoid RiCxxValidate::Imager(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Imager");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Imager");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Imager");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Imager");
+    }
+    timer.stop();
     nextFilter().Imager(name, pList);
 }
 
 RtVoid RiCxxValidate::Quantize(RtConstToken type, RtInt one, RtInt min,
                                RtInt max, RtFloat ditheramplitude)
 {
+    CallTimer timer(*this, "Quantize");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Quantize");
     if(!(one >= 0))
     {
@@ -953,37 +1135,54 @@ RtVoid RiCxxValidate::Quantize(RtConstToken type, RtInt one, RtInt min,
             "[ditheramplitude = " << ditheramplitude << "]"
         );
     }
+    timer.stop();
     nextFilter().Quantize(type, one, min, max, ditheramplitude);
 }
 
 RtVoid RiCxxValidate::Display(RtConstToken name, RtConstToken type,
                               RtConstToken mode, const ParamList& pList)
 {
+    CallTimer timer(*this, "Display");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Display");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Display");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Display");
+    }
+    timer.stop();
     nextFilter().Display(name, type, mode, pList);
 }
 
 RtVoid RiCxxValidate::Hider(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Hider");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Hider");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Hider");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Hider");
+    }
+    timer.stop();
     nextFilter().Hider(name, pList);
 }
 
 RtVoid RiCxxValidate::ColorSamples(const FloatArray& nRGB,
                                    const FloatArray& RGBn)
 {
+    CallTimer timer(*this, "ColorSamples");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "ColorSamples");
-    checkArraySize(size(nRGB), RGBn.size(),
-                   "RGBn", "ColorSamples");
+    if(!m_trusted)
+    {
+        checkArraySize(size(nRGB), RGBn.size(),
+                       "RGBn", "ColorSamples");
+    }
+    timer.stop();
     nextFilter().ColorSamples(nRGB, RGBn);
 }
 
 RtVoid RiCxxValidate::RelativeDetail(RtFloat relativedetail)
 {
+    CallTimer timer(*this, "RelativeDetail");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "RelativeDetail");
     if(!(relativedetail >= 0))
     {
@@ -992,42 +1191,57 @@ RtVoid RiCxxValidate::RelativeDetail(RtFloat relativedetail)
             "[relativedetail = " << relativedetail << "]"
         );
     }
+    timer.stop();
     nextFilter().RelativeDetail(relativedetail);
 }
 
 RtVoid RiCxxValidate::Option(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Option");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "Option");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Option");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Option");
+    }
+    handleValidateOption(name, pList);
+    timer.stop();
     nextFilter().Option(name, pList);
 }
 
 RtVoid RiCxxValidate::AttributeBegin()
 {
+    CallTimer timer(*this, "AttributeBegin");
     checkScope(ApiScope(Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Archive), "AttributeBegin");
     pushAttributes();
     pushScope(Scope_Attribute);
+    timer.stop();
     nextFilter().AttributeBegin();
 }
 
 RtVoid RiCxxValidate::AttributeEnd()
 {
+    CallTimer timer(*this, "AttributeEnd");
     checkScope(ApiScope(Scope_Archive | Scope_Attribute), "AttributeEnd");
     popAttributes();
+    timer.stop();
     nextFilter().AttributeEnd();
     popScope(Scope_Attribute);
 }
 
 RtVoid RiCxxValidate::Color(RtConstColor Cq)
 {
+    CallTimer timer(*this, "Color");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Color");
+    timer.stop();
     nextFilter().Color(Cq);
 }
 
 RtVoid RiCxxValidate::Opacity(RtConstColor Os)
 {
+    CallTimer timer(*this, "Opacity");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Opacity");
+    timer.stop();
     nextFilter().Opacity(Os);
 }
 
@@ -1035,16 +1249,23 @@ RtVoid RiCxxValidate::TextureCoordinates(RtFloat s1, RtFloat t1, RtFloat s2,
                                          RtFloat t2, RtFloat s3, RtFloat t3,
                                          RtFloat s4, RtFloat t4)
 {
+    CallTimer timer(*this, "TextureCoordinates");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "TextureCoordinates");
+    timer.stop();
     nextFilter().TextureCoordinates(s1, t1, s2, t2, s3, t3, s4, t4);
 }
 
 RtVoid RiCxxValidate::LightSource(RtConstToken shadername, RtConstToken name,
                                   const ParamList& pList)
 {
+    CallTimer timer(*this, "LightSource");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "LightSource");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "LightSource");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "LightSource");
+    }
+    timer.stop();
     return
     nextFilter().LightSource(shadername, name, pList);
 }
@@ -1053,56 +1274,88 @@ RtVoid RiCxxValidate::AreaLightSource(RtConstToken shadername,
                                       RtConstToken name,
                                       const ParamList& pList)
 {
+    CallTimer timer(*this, "AreaLightSource");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "AreaLightSource");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "AreaLightSource");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "AreaLightSource");
+    }
+    timer.stop();
     return
     nextFilter().AreaLightSource(shadername, name, pList);
 }
 
 RtVoid RiCxxValidate::Illuminate(RtConstToken name, RtBoolean onoff)
 {
+    CallTimer timer(*this, "Illuminate");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Illuminate");
+    timer.stop();
     nextFilter().Illuminate(name, onoff);
 }
 
 RtVoid RiCxxValidate::Surface(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Surface");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Surface");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Surface");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Surface");
+    }
+    timer.stop();
     nextFilter().Surface(name, pList);
 }
 
 RtVoid RiCxxValidate::Displacement(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Displacement");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Displacement");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Displacement");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Displacement");
+    }
+    timer.stop();
     nextFilter().Displacement(name, pList);
 }
 
 RtVoid RiCxxValidate::Atmosphere(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Atmosphere");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Atmosphere");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Atmosphere");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Atmosphere");
+    }
+    timer.stop();
     nextFilter().Atmosphere(name, pList);
 }
 
 RtVoid RiCxxValidate::Interior(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Interior");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Interior");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Interior");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Interior");
+    }
+    timer.stop();
     nextFilter().Interior(name, pList);
 }
 
 RtVoid RiCxxValidate::Exterior(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Exterior");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Exterior");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Exterior");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Exterior");
+    }
+    timer.stop();
     nextFilter().Exterior(name, pList);
 }
 
@@ -1110,9 +1363,14 @@ RtVoid RiCxxValidate::ShaderLayer(RtConstToken type, RtConstToken name,
                                   RtConstToken layername,
                                   const ParamList& pList)
 {
+    CallTimer timer(*this, "ShaderLayer");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "ShaderLayer");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "ShaderLayer");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "ShaderLayer");
+    }
+    timer.stop();
     nextFilter().ShaderLayer(type, name, layername, pList);
 }
 
@@ -1122,11 +1380,14 @@ RtVoid RiCxxValidate::ConnectShaderLayers(RtConstToken type,
                                           RtConstToken layer2,
                                           RtConstToken variable2)
 {
+    CallTimer timer(*this, "ConnectShaderLayers");
+    timer.stop();
     nextFilter().ConnectShaderLayers(type, layer1, variable1, layer2, variable2);
 }
 
 RtVoid RiCxxValidate::ShadingRate(RtFloat size)
 {
+    CallTimer timer(*this, "ShadingRate");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "ShadingRate");
     if(!(size > 0))
     {
@@ -1135,36 +1396,46 @@ RtVoid RiCxxValidate::ShadingRate(RtFloat size)
             "[size = " << size << "]"
         );
     }
+    timer.stop();
     nextFilter().ShadingRate(size);
 }
 
 RtVoid RiCxxValidate::ShadingInterpolation(RtConstToken type)
 {
+    CallTimer timer(*this, "ShadingInterpolation");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "ShadingInterpolation");
+    timer.stop();
     nextFilter().ShadingInterpolation(type);
 }
 
 RtVoid RiCxxValidate::Matte(RtBoolean onoff)
 {
+    CallTimer timer(*this, "Matte");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Matte");
+    timer.stop();
     nextFilter().Matte(onoff);
 }
 
 RtVoid RiCxxValidate::Bound(RtConstBound bound)
 {
+    CallTimer timer(*this, "Bound");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Bound");
+    timer.stop();
     nextFilter().Bound(bound);
 }
 
 RtVoid RiCxxValidate::Detail(RtConstBound bound)
 {
+    CallTimer timer(*this, "Detail");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Detail");
+    timer.stop();
     nextFilter().Detail(bound);
 }
 
 RtVoid RiCxxValidate::DetailRange(RtFloat offlow, RtFloat onlow, RtFloat onhigh,
                                   RtFloat offhigh)
 {
+    CallTimer timer(*this, "DetailRange");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "DetailRange");
     if(!(offlow <= onlow))
     {
@@ -1187,11 +1458,13 @@ RtVoid RiCxxValidate::DetailRange(RtFloat offlow, RtFloat onlow, RtFloat onhigh,
             "[onhigh = " << onhigh << ", " << "offhigh = " << offhigh << "]";
         );
     }
+    timer.stop();
     nextFilter().DetailRange(offlow, onlow, onhigh, offhigh);
 }
 
 RtVoid RiCxxValidate::GeometricApproximation(RtConstToken type, RtFloat value)
 {
+    CallTimer timer(*this, "GeometricApproximation");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "GeometricApproximation");
     if(!(value >= 0))
     {
@@ -1200,47 +1473,61 @@ RtVoid RiCxxValidate::GeometricApproximation(RtConstToken type, RtFloat value)
             "[value = " << value << "]"
         );
     }
+    timer.stop();
     nextFilter().GeometricApproximation(type, value);
 }
 
 RtVoid RiCxxValidate::Orientation(RtConstToken orientation)
 {
+    CallTimer timer(*this, "Orientation");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Orientation");
+    timer.stop();
     nextFilter().Orientation(orientation);
 }
 
 RtVoid RiCxxValidate::ReverseOrientation()
 {
+    CallTimer timer(*this, "ReverseOrientation");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "ReverseOrientation");
+    timer.stop();
     nextFilter().ReverseOrientation();
 }
 
 RtVoid RiCxxValidate::Sides(RtInt nsides)
 {
+    CallTimer timer(*this, "Sides");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Sides");
+    timer.stop();
     nextFilter().Sides(nsides);
 }
 
 RtVoid RiCxxValidate::Identity()
 {
+    CallTimer timer(*this, "Identity");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Identity");
+    timer.stop();
     nextFilter().Identity();
 }
 
 RtVoid RiCxxValidate::Transform(RtConstMatrix transform)
 {
+    CallTimer timer(*this, "Transform");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Transform");
+    timer.stop();
     nextFilter().Transform(transform);
 }
 
 RtVoid RiCxxValidate::ConcatTransform(RtConstMatrix transform)
 {
+    CallTimer timer(*this, "ConcatTransform");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "ConcatTransform");
+    timer.stop();
     nextFilter().ConcatTransform(transform);
 }
 
 RtVoid RiCxxValidate::Perspective(RtFloat fov)
 {
+    CallTimer timer(*this, "Perspective");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Perspective");
     if(!(fov > 0))
     {
@@ -1249,56 +1536,73 @@ RtVoid RiCxxValidate::Perspective(RtFloat fov)
             "[fov = " << fov << "]"
         );
     }
+    timer.stop();
     nextFilter().Perspective(fov);
 }
 
 RtVoid RiCxxValidate::Translate(RtFloat dx, RtFloat dy, RtFloat dz)
 {
+    CallTimer timer(*this, "Translate");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Translate");
+    timer.stop();
     nextFilter().Translate(dx, dy, dz);
 }
 
 RtVoid RiCxxValidate::Rotate(RtFloat angle, RtFloat dx, RtFloat dy, RtFloat dz)
 {
+    CallTimer timer(*this, "Rotate");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Rotate");
+    timer.stop();
     nextFilter().Rotate(angle, dx, dy, dz);
 }
 
 RtVoid RiCxxValidate::Scale(RtFloat sx, RtFloat sy, RtFloat sz)
 {
+    CallTimer timer(*this, "Scale");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Scale");
+    timer.stop();
     nextFilter().Scale(sx, sy, sz);
 }
 
 RtVoid RiCxxValidate::Skew(RtFloat angle, RtFloat dx1, RtFloat dy1, RtFloat dz1,
                            RtFloat dx2, RtFloat dy2, RtFloat dz2)
 {
+    CallTimer timer(*this, "Skew");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Skew");
+    timer.stop();
     nextFilter().Skew(angle, dx1, dy1, dz1, dx2, dy2, dz2);
 }
 
 RtVoid RiCxxValidate::CoordinateSystem(RtConstToken space)
 {
+    CallTimer timer(*this, "CoordinateSystem");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive), "CoordinateSystem");
+    timer.stop();
     nextFilter().CoordinateSystem(space);
 }
 
 RtVoid RiCxxValidate::CoordSysTransform(RtConstToken space)
 {
+    CallTimer timer(*this, "CoordSysTransform");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "CoordSysTransform");
+    timer.stop();
     nextFilter().CoordSysTransform(space);
 }
 
 RtVoid RiCxxValidate::TransformBegin()
 {
+    CallTimer timer(*this, "TransformBegin");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive), "TransformBegin");
     pushScope(Scope_Transform);
+    timer.stop();
     nextFilter().TransformBegin();
 }
 
 RtVoid RiCxxValidate::TransformEnd()
 {
+    CallTimer timer(*this, "TransformEnd");
     checkScope(ApiScope(Scope_Transform | Scope_Archive), "TransformEnd");
+    timer.stop();
     nextFilter().TransformEnd();
     popScope(Scope_Transform);
 }
@@ -1306,55 +1610,79 @@ RtVoid RiCxxValidate::TransformEnd()
 RtVoid RiCxxValidate::Resource(RtConstToken handle, RtConstToken type,
                                const ParamList& pList)
 {
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Resource");
+    CallTimer timer(*this, "Resource");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Resource");
+    }
+    timer.stop();
     nextFilter().Resource(handle, type, pList);
 }
 
 RtVoid RiCxxValidate::ResourceBegin()
 {
+    CallTimer timer(*this, "ResourceBegin");
     pushAttributes();
+    timer.stop();
     nextFilter().ResourceBegin();
 }
 
 RtVoid RiCxxValidate::ResourceEnd()
 {
+    CallTimer timer(*this, "ResourceEnd");
     popAttributes();
+    timer.stop();
     nextFilter().ResourceEnd();
 }
 
 RtVoid RiCxxValidate::Attribute(RtConstToken name, const ParamList& pList)
 {
+    CallTimer timer(*this, "Attribute");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Attribute");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "Attribute");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "Attribute");
+    }
+    timer.stop();
     nextFilter().Attribute(name, pList);
 }
 
 RtVoid RiCxxValidate::Polygon(const ParamList& pList)
 {
+    CallTimer timer(*this, "Polygon");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Polygon");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = countP(pList);
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Polygon");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = countP(pList);
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Polygon");
+    }
     checkPointParamPresent(pList);
+    timer.stop();
     nextFilter().Polygon(pList);
 }
 
 RtVoid RiCxxValidate::GeneralPolygon(const IntArray& nverts,
                                      const ParamList& pList)
 {
+    CallTimer timer(*this, "GeneralPolygon");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "GeneralPolygon");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = sum(nverts);
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "GeneralPolygon");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = sum(nverts);
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "GeneralPolygon");
+    }
     checkPointParamPresent(pList);
+    timer.stop();
     nextFilter().GeneralPolygon(nverts, pList);
 }
 
@@ -1362,17 +1690,22 @@ RtVoid RiCxxValidate::PointsPolygons(const IntArray& nverts,
                                      const IntArray& verts,
                                      const ParamList& pList)
 {
+    CallTimer timer(*this, "PointsPolygons");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "PointsPolygons");
-    checkArraySize(sum(nverts), verts.size(),
-                   "verts", "PointsPolygons");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.uniform = size(nverts);
-    iclassCounts.varying = max(verts)+1;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = sum(nverts);
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "PointsPolygons");
+    if(!m_trusted)
+    {
+        checkArraySize(sum(nverts), verts.size(),
+                       "verts", "PointsPolygons");
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.uniform = size(nverts);
+        iclassCounts.varying = max(verts)+1;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = sum(nverts);
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "PointsPolygons");
+    }
     checkPointParamPresent(pList);
+    timer.stop();
     nextFilter().PointsPolygons(nverts, verts, pList);
 }
 
@@ -1381,24 +1714,30 @@ RtVoid RiCxxValidate::PointsGeneralPolygons(const IntArray& nloops,
                                             const IntArray& verts,
                                             const ParamList& pList)
 {
+    CallTimer timer(*this, "PointsGeneralPolygons");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "PointsGeneralPolygons");
-    checkArraySize(sum(nloops), nverts.size(),
-                   "nverts", "PointsGeneralPolygons");
-    checkArraySize(sum(nverts), verts.size(),
-                   "verts", "PointsGeneralPolygons");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.uniform = size(nloops);
-    iclassCounts.varying = max(verts)+1;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = sum(nverts);
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "PointsGeneralPolygons");
+    if(!m_trusted)
+    {
+        checkArraySize(sum(nloops), nverts.size(),
+                       "nverts", "PointsGeneralPolygons");
+        checkArraySize(sum(nverts), verts.size(),
+                       "verts", "PointsGeneralPolygons");
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.uniform = size(nloops);
+        iclassCounts.varying = max(verts)+1;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = sum(nverts);
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "PointsGeneralPolygons");
+    }
+    timer.stop();
     nextFilter().PointsGeneralPolygons(nloops, nverts, verts, pList);
 }
 
 RtVoid RiCxxValidate::Basis(RtConstBasis ubasis, RtInt ustep,
                             RtConstBasis vbasis, RtInt vstep)
 {
+    CallTimer timer(*this, "Basis");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "Basis");
     if(!(ustep > 0))
     {
@@ -1415,18 +1754,24 @@ RtVoid RiCxxValidate::Basis(RtConstBasis ubasis, RtInt ustep,
         );
     }
     AttrState& attrs = m_attrStack.top(); attrs.ustep = ustep; attrs.vstep = vstep;
+    timer.stop();
     nextFilter().Basis(ubasis, ustep, vbasis, vstep);
 }
 
 RtVoid RiCxxValidate::Patch(RtConstToken type, const ParamList& pList)
 {
+    CallTimer timer(*this, "Patch");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Patch");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = strcmp(type,"bilinear")==0 ? 4 : 16;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Patch");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = strcmp(type,"bilinear")==0 ? 4 : 16;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Patch");
+    }
+    timer.stop();
     nextFilter().Patch(type, pList);
 }
 
@@ -1434,6 +1779,7 @@ RtVoid RiCxxValidate::PatchMesh(RtConstToken type, RtInt nu, RtConstToken uwrap,
                                 RtInt nv, RtConstToken vwrap,
                                 const ParamList& pList)
 {
+    CallTimer timer(*this, "PatchMesh");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "PatchMesh");
     if(!(nu > 0))
     {
@@ -1449,10 +1795,14 @@ RtVoid RiCxxValidate::PatchMesh(RtConstToken type, RtInt nu, RtConstToken uwrap,
             "[nv = " << nv << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts = patchMeshIClassCounts(type, nu, uwrap, nv, vwrap, m_attrStack.top().ustep, m_attrStack.top().vstep, !m_relaxedAttributeState);
-    if(m_scopeStack.top() != Scope_Archive)
-    checkParamListArraySizes(pList, iclassCounts, "PatchMesh");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts = patchMeshIClassCounts(type, nu, uwrap, nv, vwrap, m_attrStack.top().ustep, m_attrStack.top().vstep, !m_relaxedAttributeState);
+        if(m_scopeStack.top() != Scope_Archive)
+        checkParamListArraySizes(pList, iclassCounts, "PatchMesh");
+    }
+    timer.stop();
     nextFilter().PatchMesh(type, nu, uwrap, nv, vwrap, pList);
 }
 
@@ -1462,6 +1812,7 @@ RtVoid RiCxxValidate::NuPatch(RtInt nu, RtInt uorder, const FloatArray& uknot,
                               RtFloat vmin, RtFloat vmax,
                               const ParamList& pList)
 {
+    CallTimer timer(*this, "NuPatch");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "NuPatch");
     if(!(nu > 0))
     {
@@ -1477,8 +1828,6 @@ RtVoid RiCxxValidate::NuPatch(RtInt nu, RtInt uorder, const FloatArray& uknot,
             "[uorder = " << uorder << "]"
         );
     }
-    checkArraySize(nu+uorder, uknot.size(),
-                   "uknot", "NuPatch");
     if(!(umin < umax))
     {
         AQSIS_THROW_XQERROR(XqValidation, EqE_Range,
@@ -1500,8 +1849,6 @@ RtVoid RiCxxValidate::NuPatch(RtInt nu, RtInt uorder, const FloatArray& uknot,
             "[vorder = " << vorder << "]"
         );
     }
-    checkArraySize(nv+vorder, vknot.size(),
-                   "vknot", "NuPatch");
     if(!(vmin < vmax))
     {
         AQSIS_THROW_XQERROR(XqValidation, EqE_Range,
@@ -1509,13 +1856,21 @@ RtVoid RiCxxValidate::NuPatch(RtInt nu, RtInt uorder, const FloatArray& uknot,
             "[vmin = " << vmin << ", " << "vmax = " << vmax << "]";
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.uniform = (1+nu-uorder+1)*(1+nv-vorder+1);
-    iclassCounts.varying = (1+nu-uorder+1)*(1+nv-vorder+1);
-    iclassCounts.vertex = nu*nv;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "NuPatch");
+    if(!m_trusted)
+    {
+        checkArraySize(nu+uorder, uknot.size(),
+                       "uknot", "NuPatch");
+        checkArraySize(nv+vorder, vknot.size(),
+                       "vknot", "NuPatch");
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.uniform = (1+nu-uorder+1)*(1+nv-vorder+1);
+        iclassCounts.varying = (1+nu-uorder+1)*(1+nv-vorder+1);
+        iclassCounts.vertex = nu*nv;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "NuPatch");
+    }
+    timer.stop();
     nextFilter().NuPatch(nu, uorder, uknot, umin, umax, nv, vorder, vknot, vmin, vmax, pList);
 }
 
@@ -1525,23 +1880,28 @@ RtVoid RiCxxValidate::TrimCurve(const IntArray& ncurves, const IntArray& order,
                                 const FloatArray& u, const FloatArray& v,
                                 const FloatArray& w)
 {
+    CallTimer timer(*this, "TrimCurve");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "TrimCurve");
-    checkArraySize(sum(ncurves), order.size(),
-                   "order", "TrimCurve");
-    checkArraySize(sum(order)+sum(n), knot.size(),
-                   "knot", "TrimCurve");
-    checkArraySize(size(order), min.size(),
-                   "min", "TrimCurve");
-    checkArraySize(size(order), max.size(),
-                   "max", "TrimCurve");
-    checkArraySize(size(order), n.size(),
-                   "n", "TrimCurve");
-    checkArraySize(sum(n), u.size(),
-                   "u", "TrimCurve");
-    checkArraySize(size(u), v.size(),
-                   "v", "TrimCurve");
-    checkArraySize(size(u), w.size(),
-                   "w", "TrimCurve");
+    if(!m_trusted)
+    {
+        checkArraySize(sum(ncurves), order.size(),
+                       "order", "TrimCurve");
+        checkArraySize(sum(order)+sum(n), knot.size(),
+                       "knot", "TrimCurve");
+        checkArraySize(size(order), min.size(),
+                       "min", "TrimCurve");
+        checkArraySize(size(order), max.size(),
+                       "max", "TrimCurve");
+        checkArraySize(size(order), n.size(),
+                       "n", "TrimCurve");
+        checkArraySize(sum(n), u.size(),
+                       "u", "TrimCurve");
+        checkArraySize(size(u), v.size(),
+                       "v", "TrimCurve");
+        checkArraySize(size(u), w.size(),
+                       "w", "TrimCurve");
+    }
+    timer.stop();
     nextFilter().TrimCurve(ncurves, order, knot, min, max, n, u, v, w);
 }
 
@@ -1554,28 +1914,34 @@ RtVoid RiCxxValidate::SubdivisionMesh(RtConstToken scheme,
                                       const FloatArray& floatargs,
                                       const ParamList& pList)
 {
+    CallTimer timer(*this, "SubdivisionMesh");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "SubdivisionMesh");
-    checkArraySize(sum(nvertices), vertices.size(),
-                   "vertices", "SubdivisionMesh");
-    checkArraySize(2*size(tags), nargs.size(),
-                   "nargs", "SubdivisionMesh");
-    checkArraySize(sum(nargs,0,2), intargs.size(),
-                   "intargs", "SubdivisionMesh");
-    checkArraySize(sum(nargs,1,2), floatargs.size(),
-                   "floatargs", "SubdivisionMesh");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.uniform = size(nvertices);
-    iclassCounts.varying = max(vertices)+1;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = sum(nvertices);
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "SubdivisionMesh");
+    if(!m_trusted)
+    {
+        checkArraySize(sum(nvertices), vertices.size(),
+                       "vertices", "SubdivisionMesh");
+        checkArraySize(2*size(tags), nargs.size(),
+                       "nargs", "SubdivisionMesh");
+        checkArraySize(sum(nargs,0,2), intargs.size(),
+                       "intargs", "SubdivisionMesh");
+        checkArraySize(sum(nargs,1,2), floatargs.size(),
+                       "floatargs", "SubdivisionMesh");
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.uniform = size(nvertices);
+        iclassCounts.varying = max(vertices)+1;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = sum(nvertices);
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "SubdivisionMesh");
+    }
+    timer.stop();
     nextFilter().SubdivisionMesh(scheme, nvertices, vertices, tags, nargs, intargs, floatargs, pList);
 }
 
 RtVoid RiCxxValidate::Sphere(RtFloat radius, RtFloat zmin, RtFloat zmax,
                              RtFloat thetamax, const ParamList& pList)
 {
+    CallTimer timer(*this, "Sphere");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Sphere");
     if(!(radius != 0))
     {
@@ -1598,18 +1964,23 @@ RtVoid RiCxxValidate::Sphere(RtFloat radius, RtFloat zmin, RtFloat zmax,
             "[thetamax = " << thetamax << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Sphere");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Sphere");
+    }
+    timer.stop();
     nextFilter().Sphere(radius, zmin, zmax, thetamax, pList);
 }
 
 RtVoid RiCxxValidate::Cone(RtFloat height, RtFloat radius, RtFloat thetamax,
                            const ParamList& pList)
 {
+    CallTimer timer(*this, "Cone");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Cone");
     if(!(radius != 0))
     {
@@ -1625,18 +1996,23 @@ RtVoid RiCxxValidate::Cone(RtFloat height, RtFloat radius, RtFloat thetamax,
             "[thetamax = " << thetamax << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Cone");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Cone");
+    }
+    timer.stop();
     nextFilter().Cone(height, radius, thetamax, pList);
 }
 
 RtVoid RiCxxValidate::Cylinder(RtFloat radius, RtFloat zmin, RtFloat zmax,
                                RtFloat thetamax, const ParamList& pList)
 {
+    CallTimer timer(*this, "Cylinder");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Cylinder");
     if(!(radius != 0))
     {
@@ -1659,18 +2035,23 @@ RtVoid RiCxxValidate::Cylinder(RtFloat radius, RtFloat zmin, RtFloat zmax,
             "[thetamax = " << thetamax << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Cylinder");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Cylinder");
+    }
+    timer.stop();
     nextFilter().Cylinder(radius, zmin, zmax, thetamax, pList);
 }
 
 RtVoid RiCxxValidate::Hyperboloid(RtConstPoint point1, RtConstPoint point2,
                                   RtFloat thetamax, const ParamList& pList)
 {
+    CallTimer timer(*this, "Hyperboloid");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Hyperboloid");
     if(!(thetamax != 0))
     {
@@ -1679,18 +2060,23 @@ RtVoid RiCxxValidate::Hyperboloid(RtConstPoint point1, RtConstPoint point2,
             "[thetamax = " << thetamax << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Hyperboloid");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Hyperboloid");
+    }
+    timer.stop();
     nextFilter().Hyperboloid(point1, point2, thetamax, pList);
 }
 
 RtVoid RiCxxValidate::Paraboloid(RtFloat rmax, RtFloat zmin, RtFloat zmax,
                                  RtFloat thetamax, const ParamList& pList)
 {
+    CallTimer timer(*this, "Paraboloid");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Paraboloid");
     if(!(rmax != 0))
     {
@@ -1713,18 +2099,23 @@ RtVoid RiCxxValidate::Paraboloid(RtFloat rmax, RtFloat zmin, RtFloat zmax,
             "[thetamax = " << thetamax << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Paraboloid");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Paraboloid");
+    }
+    timer.stop();
     nextFilter().Paraboloid(rmax, zmin, zmax, thetamax, pList);
 }
 
 RtVoid RiCxxValidate::Disk(RtFloat height, RtFloat radius, RtFloat thetamax,
                            const ParamList& pList)
 {
+    CallTimer timer(*this, "Disk");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Disk");
     if(!(radius != 0))
     {
@@ -1740,12 +2131,16 @@ RtVoid RiCxxValidate::Disk(RtFloat height, RtFloat radius, RtFloat thetamax,
             "[thetamax = " << thetamax << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Disk");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Disk");
+    }
+    timer.stop();
     nextFilter().Disk(height, radius, thetamax, pList);
 }
 
@@ -1753,6 +2148,7 @@ RtVoid RiCxxValidate::Torus(RtFloat majorrad, RtFloat minorrad, RtFloat phimin,
                             RtFloat phimax, RtFloat thetamax,
                             const ParamList& pList)
 {
+    CallTimer timer(*this, "Torus");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Torus");
     if(!(majorrad != 0))
     {
@@ -1782,37 +2178,51 @@ RtVoid RiCxxValidate::Torus(RtFloat majorrad, RtFloat minorrad, RtFloat phimin,
             "[thetamax = " << thetamax << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = 4;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Torus");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = 4;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Torus");
+    }
+    timer.stop();
     nextFilter().Torus(majorrad, minorrad, phimin, phimax, thetamax, pList);
 }
 
 RtVoid RiCxxValidate::Points(const ParamList& pList)
 {
+    CallTimer timer(*this, "Points");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Points");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = countP(pList);
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Points");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = countP(pList);
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Points");
+    }
     checkPointParamPresent(pList);
+    timer.stop();
     nextFilter().Points(pList);
 }
 
 RtVoid RiCxxValidate::Curves(RtConstToken type, const IntArray& nvertices,
                              RtConstToken wrap, const ParamList& pList)
 {
+    CallTimer timer(*this, "Curves");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Curves");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts = curvesIClassCounts(type, nvertices, wrap, m_attrStack.top().vstep, !m_relaxedAttributeState);
-    if(m_scopeStack.top() != Scope_Archive)
-    checkParamListArraySizes(pList, iclassCounts, "Curves");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts = curvesIClassCounts(type, nvertices, wrap, m_attrStack.top().vstep, !m_relaxedAttributeState);
+        if(m_scopeStack.top() != Scope_Archive)
+        checkParamListArraySizes(pList, iclassCounts, "Curves");
+    }
     checkPointParamPresent(pList);
+    timer.stop();
     nextFilter().Curves(type, nvertices, wrap, pList);
 }
 
@@ -1820,13 +2230,18 @@ RtVoid RiCxxValidate::Blobby(RtInt nleaf, const IntArray& code,
                              const FloatArray& floats,
                              const TokenArray& strings, const ParamList& pList)
 {
+    CallTimer timer(*this, "Blobby");
     checkScope(ApiScope(Scope_Motion | Scope_Object | Scope_Transform | Scope_World | Scope_Attribute | Scope_Solid | Scope_Archive), "Blobby");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts.varying = nleaf;
-    iclassCounts.vertex = iclassCounts.varying;
-    iclassCounts.facevarying = iclassCounts.varying;
-    iclassCounts.facevertex = iclassCounts.facevarying;
-    checkParamListArraySizes(pList, iclassCounts, "Blobby");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts.varying = nleaf;
+        iclassCounts.vertex = iclassCounts.varying;
+        iclassCounts.facevarying = iclassCounts.varying;
+        iclassCounts.facevertex = iclassCounts.facevarying;
+        checkParamListArraySizes(pList, iclassCounts, "Blobby");
+    }
+    timer.stop();
     nextFilter().Blobby(nleaf, code, floats, strings, pList);
 }
 
@@ -1834,70 +2249,91 @@ RtVoid RiCxxValidate::Procedural(RtPointer data, RtConstBound bound,
                                  RtProcSubdivFunc refineproc,
                                  RtProcFreeFunc freeproc)
 {
+    CallTimer timer(*this, "Procedural");
     checkScope(ApiScope(Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Archive), "Procedural");
+    timer.stop();
     nextFilter().Procedural(data, bound, refineproc, freeproc);
 }
 
 RtVoid RiCxxValidate::Geometry(RtConstToken type, const ParamList& pList)
 {
+    CallTimer timer(*this, "Geometry");
     checkScope(ApiScope(Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Archive), "Geometry");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    iclassCounts = SqInterpClassCounts(-1,-1,-1,-1,-1);
-    checkParamListArraySizes(pList, iclassCounts, "Geometry");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        iclassCounts = SqInterpClassCounts(-1,-1,-1,-1,-1);
+        checkParamListArraySizes(pList, iclassCounts, "Geometry");
+    }
+    timer.stop();
     nextFilter().Geometry(type, pList);
 }
 
 RtVoid RiCxxValidate::SolidBegin(RtConstToken type)
 {
+    CallTimer timer(*this, "SolidBegin");
     checkScope(ApiScope(Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Archive), "SolidBegin");
     pushAttributes();
     pushScope(Scope_Solid);
+    timer.stop();
     nextFilter().SolidBegin(type);
 }
 
 RtVoid RiCxxValidate::SolidEnd()
 {
+    CallTimer timer(*this, "SolidEnd");
     checkScope(ApiScope(Scope_Solid | Scope_Archive), "SolidEnd");
     popAttributes();
+    timer.stop();
     nextFilter().SolidEnd();
     popScope(Scope_Solid);
 }
 
 RtVoid RiCxxValidate::ObjectBegin(RtConstToken name)
 {
+    CallTimer timer(*this, "ObjectBegin");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive), "ObjectBegin");
     pushAttributes();
     pushScope(Scope_Object);
+    timer.stop();
     return
     nextFilter().ObjectBegin(name);
 }
 
 RtVoid RiCxxValidate::ObjectEnd()
 {
+    CallTimer timer(*this, "ObjectEnd");
     checkScope(ApiScope(Scope_Archive | Scope_Object), "ObjectEnd");
     popAttributes();
+    timer.stop();
     nextFilter().ObjectEnd();
     popScope(Scope_Object);
 }
 
 RtVoid RiCxxValidate::ObjectInstance(RtConstToken name)
 {
+    CallTimer timer(*this, "ObjectInstance");
     checkScope(ApiScope(Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Archive), "ObjectInstance");
+    timer.stop();
     nextFilter().ObjectInstance(name);
 }
 
 RtVoid RiCxxValidate::MotionBegin(const FloatArray& times)
 {
+    CallTimer timer(*this, "MotionBegin");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive), "MotionBegin");
     pushAttributes();
     pushScope(Scope_Motion);
+    timer.stop();
     nextFilter().MotionBegin(times);
 }
 
 RtVoid RiCxxValidate::MotionEnd()
 {
+    CallTimer timer(*this, "MotionEnd");
     checkScope(ApiScope(Scope_Motion | Scope_Archive), "MotionEnd");
     popAttributes();
+    timer.stop();
     nextFilter().MotionEnd();
     popScope(Scope_Motion);
 }
@@ -1908,6 +2344,7 @@ RtVoid RiCxxValidate::MakeTexture(RtConstString imagefile,
                                   RtFloat swidth, RtFloat twidth,
                                   const ParamList& pList)
 {
+    CallTimer timer(*this, "MakeTexture");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "MakeTexture");
     if(!(swidth >= 1))
     {
@@ -1923,8 +2360,12 @@ RtVoid RiCxxValidate::MakeTexture(RtConstString imagefile,
             "[twidth = " << twidth << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "MakeTexture");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "MakeTexture");
+    }
+    timer.stop();
     nextFilter().MakeTexture(imagefile, texturefile, swrap, twrap, filterfunc, swidth, twidth, pList);
 }
 
@@ -1934,6 +2375,7 @@ RtVoid RiCxxValidate::MakeLatLongEnvironment(RtConstString imagefile,
                                              RtFloat swidth, RtFloat twidth,
                                              const ParamList& pList)
 {
+    CallTimer timer(*this, "MakeLatLongEnvironment");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "MakeLatLongEnvironment");
     if(!(swidth >= 1))
     {
@@ -1949,8 +2391,12 @@ RtVoid RiCxxValidate::MakeLatLongEnvironment(RtConstString imagefile,
             "[twidth = " << twidth << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "MakeLatLongEnvironment");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "MakeLatLongEnvironment");
+    }
+    timer.stop();
     nextFilter().MakeLatLongEnvironment(imagefile, reflfile, filterfunc, swidth, twidth, pList);
 }
 
@@ -1966,6 +2412,7 @@ RtVoid RiCxxValidate::MakeCubeFaceEnvironment(RtConstString px,
                                               RtFloat swidth, RtFloat twidth,
                                               const ParamList& pList)
 {
+    CallTimer timer(*this, "MakeCubeFaceEnvironment");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "MakeCubeFaceEnvironment");
     if(!(swidth >= 1))
     {
@@ -1981,8 +2428,12 @@ RtVoid RiCxxValidate::MakeCubeFaceEnvironment(RtConstString px,
             "[twidth = " << twidth << "]"
         );
     }
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "MakeCubeFaceEnvironment");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "MakeCubeFaceEnvironment");
+    }
+    timer.stop();
     nextFilter().MakeCubeFaceEnvironment(px, nx, py, ny, pz, nz, reflfile, fov, filterfunc, swidth, twidth, pList);
 }
 
@@ -1990,9 +2441,14 @@ RtVoid RiCxxValidate::MakeShadow(RtConstString picfile,
                                  RtConstString shadowfile,
                                  const ParamList& pList)
 {
+    CallTimer timer(*this, "MakeShadow");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "MakeShadow");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "MakeShadow");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "MakeShadow");
+    }
+    timer.stop();
     nextFilter().MakeShadow(picfile, shadowfile, pList);
 }
 
@@ -2000,39 +2456,58 @@ RtVoid RiCxxValidate::MakeOcclusion(const StringArray& picfiles,
                                     RtConstString shadowfile,
                                     const ParamList& pList)
 {
+    CallTimer timer(*this, "MakeOcclusion");
     checkScope(ApiScope(Scope_BeginEnd | Scope_Frame | Scope_Archive), "MakeOcclusion");
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "MakeOcclusion");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "MakeOcclusion");
+    }
+    timer.stop();
     nextFilter().MakeOcclusion(picfiles, shadowfile, pList);
 }
 
 RtVoid RiCxxValidate::ErrorHandler(RtErrorFunc handler)
 {
+    CallTimer timer(*this, "ErrorHandler");
     checkScope(ApiScope(Scope_BeginEnd | Scope_World | Scope_Object | Scope_Transform | Scope_Attribute | Scope_Solid | Scope_Frame | Scope_Archive | Scope_Motion), "ErrorHandler");
+    timer.stop();
     nextFilter().ErrorHandler(handler);
 }
 
 RtVoid RiCxxValidate::ReadArchive(RtConstToken name, RtArchiveCallback callback,
                                   const ParamList& pList)
 {
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "ReadArchive");
+    CallTimer timer(*this, "ReadArchive");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "ReadArchive");
+    }
+    timer.stop();
     nextFilter().ReadArchive(name, callback, pList);
 }
 
 RtVoid RiCxxValidate::ArchiveBegin(RtConstToken name, const ParamList& pList)
 {
-    SqInterpClassCounts iclassCounts(1,1,1,1,1);
-    checkParamListArraySizes(pList, iclassCounts, "ArchiveBegin");
+    CallTimer timer(*this, "ArchiveBegin");
+    if(!m_trusted)
+    {
+        SqInterpClassCounts iclassCounts(1,1,1,1,1);
+        checkParamListArraySizes(pList, iclassCounts, "ArchiveBegin");
+    }
     pushAttributes();
     pushScope(Scope_Archive);
+    timer.stop();
     return
     nextFilter().ArchiveBegin(name, pList);
 }
 
 RtVoid RiCxxValidate::ArchiveEnd()
 {
+    CallTimer timer(*this, "ArchiveEnd");
     popAttributes();
+    timer.stop();
     nextFilter().ArchiveEnd();
     popScope(Scope_Archive);
 }
@@ -2043,7 +2518,11 @@ RtVoid RiCxxValidate::ArchiveEnd()
 Ri::Filter* createValidateFilter(const Ri::ParamList& pList)
 {
     Ri::IntArray outerScopeRelaxed = pList.findInt("relaxed_outer_scope");
-    return new RiCxxValidate(outerScopeRelaxed ? outerScopeRelaxed[0] : false);
+    Ri::IntArray trusted = pList.findInt("trusted");
+    Ri::IntArray timing = pList.findInt("timing");
+    return new RiCxxValidate(outerScopeRelaxed ? outerScopeRelaxed[0] : false,
+                             trusted ? trusted[0] : false,
+                             timing ? timing[0] : false);
 }
 
 } // namespace Aqsis
@@ -0,0 +1,128 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+
+/// \file
+/// \brief Unit tests for the interface validation filter.
+
+#include <aqsis/riutil/ricxx_filter.h>
+
+#define BOOST_TEST_DYN_LINK
+
+#include <sstream>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+#include <aqsis/riutil/ribwriter.h>
+#include <aqsis/riutil/ricxxutil.h>
+#include <aqsis/util/exception.h>
+
+using namespace Aqsis;
+
+namespace {
+
+// A RIB writer with a validate filter at the front of its filter chain.
+struct ValidateFixture
+{
+    std::ostringstream out;
+    boost::scoped_ptr<RibWriterServices> writer;
+
+    ValidateFixture(const Ri::ParamList& filterParams = Ri::ParamList())
+        : out(),
+        writer(createRibWriter(out, RibWriterOptions()))
+    {
+        writer->addFilter("validate", filterParams);
+    }
+
+    Ri::Renderer& ri()
+    {
+        return writer->firstFilter();
+    }
+
+    // Pass a triangle with only two points in "P".
+    void shortPointsPolygons()
+    {
+        const RtInt nverts[] = {3};
+        const RtInt verts[] = {0, 1, 2};
+        std::vector<RtFloat> P(6, 0.0f);
+        ri().PointsPolygons(Ri::IntArray(nverts, 1), Ri::IntArray(verts, 3),
+                            ParamListBuilder()("vertex point P", P));
+    }
+};
+
+} // anon namespace
+
+BOOST_AUTO_TEST_SUITE(ricxx_validate_tests)
+
+BOOST_AUTO_TEST_CASE(RiCxxValidate_rejects_short_arrays)
+{
+    ValidateFixture f;
+    f.ri().WorldBegin();
+    BOOST_CHECK_THROW(f.shortPointsPolygons(), XqValidation);
+}
+
+BOOST_AUTO_TEST_CASE(RiCxxValidate_trusted_skips_array_lengths)
+{
+    ValidateFixture f(ParamListBuilder()("trusted", 1));
+    f.ri().WorldBegin();
+    BOOST_CHECK_NO_THROW(f.shortPointsPolygons());
+    // Cheap structural checks are still done in trusted mode.
+    BOOST_CHECK_THROW(f.ri().FrameBegin(1), XqValidation);
+}
+
+BOOST_AUTO_TEST_CASE(RiCxxValidate_trusted_option_is_frame_scoped)
+{
+    ValidateFixture f;
+    f.ri().FrameBegin(1);
+    f.ri().Option("validate", ParamListBuilder()("trusted", 1));
+    f.ri().WorldBegin();
+    BOOST_CHECK_NO_THROW(f.shortPointsPolygons());
+    f.ri().WorldEnd();
+    f.ri().FrameEnd();
+
+    // The option set inside the frame no longer applies.
+    f.ri().WorldBegin();
+    BOOST_CHECK_THROW(f.shortPointsPolygons(), XqValidation);
+    f.ri().WorldEnd();
+
+    // An option set outside any frame lasts until it's changed.
+    f.ri().Option("validate", ParamListBuilder()("trusted", 1));
+    f.ri().FrameBegin(2);
+    f.ri().WorldBegin();
+    BOOST_CHECK_NO_THROW(f.shortPointsPolygons());
+    f.ri().WorldEnd();
+    f.ri().FrameEnd();
+    f.ri().WorldBegin();
+    BOOST_CHECK_NO_THROW(f.shortPointsPolygons());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
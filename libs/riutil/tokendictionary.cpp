@@ -146,9 +146,11 @@ const CqPrimvarToken standardVarsInit[] = {
 	// Option "limits"
 	CqPrimvarToken(class_uniform,  type_integer, 1, "gridsize"),
 	CqPrimvarToken(class_uniform,  type_integer, 1, "texturememory"),
+	CqPrimvarToken(class_uniform,  type_integer, 1, "memory"),
 	CqPrimvarToken(class_uniform,  type_integer, 2, "bucketsize"),
 	CqPrimvarToken(class_uniform,  type_integer, 1, "eyesplits"),
 	CqPrimvarToken(class_uniform,  type_color,   1, "zthreshold"),
+	CqPrimvarToken(class_uniform,  type_color,   1, "othreshold"),
 	// Option "searchpath"
 	CqPrimvarToken(class_uniform,  type_string,  1, "shader"),
 	CqPrimvarToken(class_uniform,  type_string,  1, "archive"),
@@ -186,6 +188,18 @@ const CqPrimvarToken standardVarsInit[] = {
 	// Hider
 	CqPrimvarToken(class_uniform,  type_integer, 1, "jitter"),
 	CqPrimvarToken(class_uniform,  type_string,  1, "depthfilter"),
+	CqPrimvarToken(class_uniform,  type_string,  1, "samplepattern"),
+	CqPrimvarToken(class_uniform,  type_integer, 1, "adaptive"),
+	CqPrimvarToken(class_uniform,  type_float,   1, "adaptivethreshold"),
+	CqPrimvarToken(class_uniform,  type_integer, 1, "progressive"),
+	// Option "stereo"
+	CqPrimvarToken(class_uniform,  type_float,   1, "eyeseparation"),
+	CqPrimvarToken(class_uniform,  type_float,   1, "convergence"),
+	// Option "validate"
+	CqPrimvarToken(class_uniform,  type_integer, 1, "trusted"),
+	CqPrimvarToken(class_uniform,  type_integer, 1, "timing"),
+	// Option "archive"
+	CqPrimvarToken(class_uniform,  type_string,  1, "cachedir"),
 	// Attribute "dice"
 	CqPrimvarToken(class_uniform,  type_integer, 1, "binary"),
 	// Attribute "mpdump"
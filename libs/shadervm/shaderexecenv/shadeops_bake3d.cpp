@@ -23,6 +23,7 @@
 #endif
 
 #include <cstring>
+#include <set>
 
 #include <Partio.h>
 
@@ -167,13 +168,25 @@ class Bake3dCache
         void flush()
         {
             for(FileMap::iterator i = m_files.begin(); i != m_files.end(); ++i)
+            {
                 Partio::write(i->first.c_str(), *i->second);
+                m_filesWritten.insert(i->first);
+            }
             m_files.clear();
         }
 
+        /// Get the names of the files written since the last call.
+        void takeFilesWritten(std::vector<std::string>& fileNames)
+        {
+            fileNames.insert(fileNames.end(), m_filesWritten.begin(),
+                             m_filesWritten.end());
+            m_filesWritten.clear();
+        }
+
     private:
         typedef std::map<std::string, boost::shared_ptr<Partio::ParticlesDataMutable> > FileMap;
         FileMap m_files;
+        std::set<std::string> m_filesWritten;
 };
 }
 
@@ -190,6 +203,7 @@ class Texture3dCache
             FileMap::iterator ptcIter = m_files.find(fileName);
             if(ptcIter == m_files.end())
             {
+                m_filesRead.insert(fileName);
                 // Create new bake file & insert into map.
                 pointFile = Partio::read(fileName.c_str());
                 m_files[fileName].reset(pointFile, releasePartioFile);
@@ -218,9 +232,18 @@ class Texture3dCache
             m_files.clear();
         }
 
+        /// Get the names of the files read since the last call.
+        void takeFilesRead(std::vector<std::string>& fileNames)
+        {
+            fileNames.insert(fileNames.end(), m_filesRead.begin(),
+                             m_filesRead.end());
+            m_filesRead.clear();
+        }
+
     private:
         typedef std::map<std::string, boost::shared_ptr<Partio::ParticlesDataMutable> > FileMap;
         FileMap m_files;
+        std::set<std::string> m_filesRead;
 };
 }
 
@@ -235,6 +258,16 @@ void flushBake3dCache()
     g_texture3dCloudCache.clear();
 }
 
+void takeTexture3dFilesRead(std::vector<std::string>& fileNames)
+{
+    g_texture3dCloudCache.takeFilesRead(fileNames);
+}
+
+void takePointCloudFilesWritten(std::vector<std::string>& fileNames)
+{
+    g_bakeCloudCache.takeFilesWritten(fileNames);
+}
+
 //------------------------------------------------------------------------------
 /// Shadeop to bake vertices to point cloud
 ///
@@ -1093,6 +1093,17 @@ void clearPointCloudCache()
 	g_pointOctreeCache.clear();
 }
 
+TqUlong pointCloudCacheMemory()
+{
+	return g_pointOctreeCache.memoryUsage();
+}
+
+void takePointCloudFilesRead(std::vector<std::string>& fileNames)
+{
+	g_pointOctreeCache.takeFilesRead(fileNames);
+	takeTexture3dFilesRead(fileNames);
+}
+
 
 namespace {
 /// Store zeros in shader variable, depending on integrator type:
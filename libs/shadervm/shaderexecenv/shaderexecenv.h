@@ -657,10 +657,9 @@ class AQSIS_SHADERVM_SHARE CqShaderExecEnv : public IqShaderExecEnv, boost::nonc
 /// Flush any caches of bake3d() data to disk and clear the cache.
 void flushBake3dCache();
 
-/// Clear static caches of point cloud data ready for next frame
-///
-/// TODO: Remove this - it's a bit of a hack!
-void clearPointCloudCache();
+/// Get the names of the point clouds opened by texture3d() since the last
+/// call.
+void takeTexture3dFilesRead(std::vector<std::string>& fileNames);
 
 //==============================================================================
 // Implementation details
@@ -27,6 +27,12 @@
 #include	"shaderstack.h"
 #include	<aqsis/shadervm/ishaderdata.h>
 
+#include	<boost/ptr_container/ptr_vector.hpp>
+#ifdef ENABLE_THREADING
+#include	<boost/thread/mutex.hpp>
+#include	<boost/thread/tss.hpp>
+#endif
+
 #undef SHADERSTACKSTATS /* define if you want to know at run-time the max. depth of stack */
 
 
@@ -35,21 +41,168 @@ namespace Aqsis {
 TqUint   CqShaderStack::m_samples = 18;
 TqUint   CqShaderStack::m_maxsamples = 18;
 
-std::deque<CqShaderVariableUniformFloat*>			CqShaderStack::m_UFPool;
-std::deque<CqShaderVariableUniformPoint*>			CqShaderStack::m_UPPool;
-std::deque<CqShaderVariableUniformString*>			CqShaderStack::m_USPool;
-std::deque<CqShaderVariableUniformColor*>			CqShaderStack::m_UCPool;
-std::deque<CqShaderVariableUniformNormal*>			CqShaderStack::m_UNPool;
-std::deque<CqShaderVariableUniformVector*>			CqShaderStack::m_UVPool;
-std::deque<CqShaderVariableUniformMatrix*>			CqShaderStack::m_UMPool;
+namespace {
+
+//----------------------------------------------------------------------
+/** \brief Free list of temporary variables of a single type and class.
+ */
+template<typename T>
+struct SqTemporaryPool
+{
+	std::vector<T*> m_free;
+
+	~SqTemporaryPool()
+	{
+		clear();
+	}
+
+	IqShaderData* get( TqUlong& allocated, TqUlong& reused )
+	{
+		if ( m_free.empty() )
+		{
+			++allocated;
+			return ( new T() );
+		}
+		++reused;
+		T* ret = m_free.back();
+		m_free.pop_back();
+		return ( ret );
+	}
+
+	void release( IqShaderData* data )
+	{
+		m_free.push_back( static_cast<T*>( data ) );
+	}
+
+	void clear()
+	{
+		for ( typename std::vector<T*>::iterator i = m_free.begin(); i != m_free.end(); ++i )
+			delete ( *i );
+		m_free.clear();
+	}
+
+	/// Approximate size of the pool, where valueSize is the size of each
+	/// value held by a varying variable.
+	TqUlong memory( TqUlong valueSize ) const
+	{
+		TqUlong bytes = 0;
+		for ( typename std::vector<T*>::const_iterator i = m_free.begin(); i != m_free.end(); ++i )
+			bytes += sizeof( T ) + ( *i )->Size() * valueSize;
+		return ( bytes );
+	}
+};
+
+//----------------------------------------------------------------------
+/** \brief The pools of free temporary variables belonging to one thread.
+ *
+ * Temporaries are handed out most recently released first, so consecutive
+ * grids shaded by a thread end up using the same variables.  Resizing a
+ * varying variable doesn't give back the capacity of its value array, so
+ * once the pools hold variables which have been sized for the largest grid,
+ * creating temporaries doesn't allocate at all.
+ */
+struct SqTemporaryPools
+{
+	SqTemporaryPool<CqShaderVariableUniformFloat>	m_UF;
+	SqTemporaryPool<CqShaderVariableUniformPoint>	m_UP;
+	SqTemporaryPool<CqShaderVariableUniformString>	m_US;
+	SqTemporaryPool<CqShaderVariableUniformColor>	m_UC;
+	SqTemporaryPool<CqShaderVariableUniformNormal>	m_UN;
+	SqTemporaryPool<CqShaderVariableUniformVector>	m_UV;
+	SqTemporaryPool<CqShaderVariableUniformMatrix>	m_UM;
+
+	SqTemporaryPool<CqShaderVariableVaryingFloat>	m_VF;
+	SqTemporaryPool<CqShaderVariableVaryingPoint>	m_VP;
+	SqTemporaryPool<CqShaderVariableVaryingString>	m_VS;
+	SqTemporaryPool<CqShaderVariableVaryingColor>	m_VC;
+	SqTemporaryPool<CqShaderVariableVaryingNormal>	m_VN;
+	SqTemporaryPool<CqShaderVariableVaryingVector>	m_VV;
+	SqTemporaryPool<CqShaderVariableVaryingMatrix>	m_VM;
+
+	TqUlong	m_allocated;	///< Number of temporaries created.
+	TqUlong	m_reused;		///< Number of temporaries taken from the pools.
+
+	SqTemporaryPools() : m_allocated( 0 ), m_reused( 0 )
+	{}
+
+	void clear()
+	{
+		m_UF.clear(); m_UP.clear(); m_US.clear(); m_UC.clear();
+		m_UN.clear(); m_UV.clear(); m_UM.clear();
+		m_VF.clear(); m_VP.clear(); m_VS.clear(); m_VC.clear();
+		m_VN.clear(); m_VV.clear(); m_VM.clear();
+	}
+
+	TqUlong memory() const
+	{
+		// The values of uniform variables are held in the variable itself.
+		return ( m_UF.memory( 0 ) + m_UP.memory( 0 ) + m_US.memory( 0 ) +
+		         m_UC.memory( 0 ) + m_UN.memory( 0 ) + m_UV.memory( 0 ) +
+		         m_UM.memory( 0 ) +
+		         m_VF.memory( sizeof( TqFloat ) ) +
+		         m_VP.memory( sizeof( CqVector3D ) ) +
+		         m_VS.memory( sizeof( CqString ) ) +
+		         m_VC.memory( sizeof( CqColor ) ) +
+		         m_VN.memory( sizeof( CqVector3D ) ) +
+		         m_VV.memory( sizeof( CqVector3D ) ) +
+		         m_VM.memory( sizeof( CqMatrix ) ) );
+	}
+};
+
+// The pools are never deleted while the library is loaded: the pools of a
+// thread which exits are kept for use by the next thread started, in the
+// same way as the statistics blocks in the core.
+boost::ptr_vector<SqTemporaryPools> g_allPools;
+#ifdef ENABLE_THREADING
+// Defined in this order so that the pools and mutex outlive the cleanup of
+// g_threadPools at exit.
+std::vector<SqTemporaryPools*> g_freePools;
+boost::mutex g_poolsMutex;
+
+void releasePools( SqTemporaryPools* pools )
+{
+	boost::mutex::scoped_lock lock( g_poolsMutex );
+	g_freePools.push_back( pools );
+}
+
+boost::thread_specific_ptr<SqTemporaryPools> g_threadPools( &releasePools );
+#endif
+
+SqTemporaryPools& newPools()
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock( g_poolsMutex );
+	SqTemporaryPools* pools = 0;
+	if ( !g_freePools.empty() )
+	{
+		pools = g_freePools.back();
+		g_freePools.pop_back();
+	}
+	else
+	{
+		pools = new SqTemporaryPools();
+		g_allPools.push_back( pools );
+	}
+	g_threadPools.reset( pools );
+	return ( *pools );
+#	else
+	g_allPools.push_back( new SqTemporaryPools() );
+	return ( g_allPools.back() );
+#	endif
+}
 
-std::deque<CqShaderVariableVaryingFloat*>			CqShaderStack::m_VFPool;
-std::deque<CqShaderVariableVaryingPoint*>			CqShaderStack::m_VPPool;
-std::deque<CqShaderVariableVaryingString*>			CqShaderStack::m_VSPool;
-std::deque<CqShaderVariableVaryingColor*>			CqShaderStack::m_VCPool;
-std::deque<CqShaderVariableVaryingNormal*>			CqShaderStack::m_VNPool;
-std::deque<CqShaderVariableVaryingVector*>			CqShaderStack::m_VVPool;
-std::deque<CqShaderVariableVaryingMatrix*>			CqShaderStack::m_VMPool;
+/// Get the pools belonging to the calling thread.
+inline SqTemporaryPools& threadPools()
+{
+#	ifdef ENABLE_THREADING
+	SqTemporaryPools* pools = g_threadPools.get();
+	return ( pools ? *pools : newPools() );
+#	else
+	return ( g_allPools.empty() ? newPools() : g_allPools.front() );
+#	endif
+}
+
+} // unnamed namespace
 
 
 //----------------------------------------------------------------------
@@ -59,277 +212,136 @@ std::deque<CqShaderVariableVaryingMatrix*>			CqShaderStack::m_VMPool;
 
 IqShaderData* CqShaderStack::GetNextTemp( EqVariableType type, EqVariableClass _class )
 {
+	SqTemporaryPools& pools = threadPools();
+	TqUlong& allocated = pools.m_allocated;
+	TqUlong& reused = pools.m_reused;
+	bool uniform = _class == class_uniform;
 	switch ( type )
 	{
 			case type_float:
-			{
-				if ( _class == class_uniform )
-				{
-					if( m_UFPool.empty() )
-						return( new CqShaderVariableUniformFloat() );
-					else
-					{
-						IqShaderData* ret = m_UFPool.front();
-						m_UFPool.pop_front();
-						return( ret );
-					}
-				}
-				else
-				{
-					if( m_VFPool.empty() )
-						return( new CqShaderVariableVaryingFloat() );
-					else
-					{
-						IqShaderData* ret = m_VFPool.front();
-						m_VFPool.pop_front();
-						return( ret );
-					}
-				}
-			}
-
+			return ( uniform ? pools.m_UF.get( allocated, reused ) : pools.m_VF.get( allocated, reused ) );
 			case type_point:
-			{
-				if ( _class == class_uniform )
-				{
-					if( m_UPPool.empty() )
-						return( new CqShaderVariableUniformPoint() );
-					else
-					{
-						IqShaderData* ret = m_UPPool.front();
-						m_UPPool.pop_front();
-						return( ret );
-					}
-				}
-				else
-				{
-					if( m_VPPool.empty() )
-						return( new CqShaderVariableVaryingPoint() );
-					else
-					{
-						IqShaderData* ret = m_VPPool.front();
-						m_VPPool.pop_front();
-						return( ret );
-					}
-				}
-			}
-
+			return ( uniform ? pools.m_UP.get( allocated, reused ) : pools.m_VP.get( allocated, reused ) );
 			case type_string:
-			{
-				if ( _class == class_uniform )
-				{
-					if( m_USPool.empty() )
-						return( new CqShaderVariableUniformString() );
-					else
-					{
-						IqShaderData* ret = m_USPool.front();
-						m_USPool.pop_front();
-						return( ret );
-					}
-				}
-				else
-				{
-					if( m_VSPool.empty() )
-						return( new CqShaderVariableVaryingString() );
-					else
-					{
-						IqShaderData* ret = m_VSPool.front();
-						m_VSPool.pop_front();
-						return( ret );
-					}
-				}
-			}
-
+			return ( uniform ? pools.m_US.get( allocated, reused ) : pools.m_VS.get( allocated, reused ) );
 			case type_color:
-			{
-				if ( _class == class_uniform )
-				{
-					if( m_UCPool.empty() )
-						return( new CqShaderVariableUniformColor() );
-					else
-					{
-						IqShaderData* ret = m_UCPool.front();
-						m_UCPool.pop_front();
-						return( ret );
-					}
-				}
-				else
-				{
-					if( m_VCPool.empty() )
-						return( new CqShaderVariableVaryingColor() );
-					else
-					{
-						IqShaderData* ret = m_VCPool.front();
-						m_VCPool.pop_front();
-						return( ret );
-					}
-				}
-			}
-
+			return ( uniform ? pools.m_UC.get( allocated, reused ) : pools.m_VC.get( allocated, reused ) );
 			case type_normal:
-			{
-				if ( _class == class_uniform )
-				{
-					if( m_UNPool.empty() )
-						return( new CqShaderVariableUniformNormal() );
-					else
-					{
-						IqShaderData* ret = m_UNPool.front();
-						m_UNPool.pop_front();
-						return( ret );
-					}
-				}
-				else
-				{
-					if( m_VNPool.empty() )
-						return( new CqShaderVariableVaryingNormal() );
-					else
-					{
-						IqShaderData* ret = m_VNPool.front();
-						m_VNPool.pop_front();
-						return( ret );
-					}
-				}
-			}
-
+			return ( uniform ? pools.m_UN.get( allocated, reused ) : pools.m_VN.get( allocated, reused ) );
 			case type_vector:
-			{
-				if ( _class == class_uniform )
-				{
-					if( m_UVPool.empty() )
-						return( new CqShaderVariableUniformVector() );
-					else
-					{
-						IqShaderData* ret = m_UVPool.front();
-						m_UVPool.pop_front();
-						return( ret );
-					}
-				}
-				else
-				{
-					if( m_VVPool.empty() )
-						return( new CqShaderVariableVaryingVector() );
-					else
-					{
-						IqShaderData* ret = m_VVPool.front();
-						m_VVPool.pop_front();
-						return( ret );
-					}
-				}
-			}
-
+			return ( uniform ? pools.m_UV.get( allocated, reused ) : pools.m_VV.get( allocated, reused ) );
 			case type_matrix:
-			{
-				if ( _class == class_uniform )
-				{
-					if( m_UMPool.empty() )
-						return( new CqShaderVariableUniformMatrix() );
-					else
-					{
-						IqShaderData* ret = m_UMPool.front();
-						m_UMPool.pop_front();
-						return( ret );
-					}
-				}
-				else
-				{
-					if( m_VMPool.empty() )
-						return( new CqShaderVariableVaryingMatrix() );
-					else
-					{
-						IqShaderData* ret = m_VMPool.front();
-						m_VMPool.pop_front();
-						return( ret );
-					}
-				}
-			}
-
+			return ( uniform ? pools.m_UM.get( allocated, reused ) : pools.m_VM.get( allocated, reused ) );
 			default:
-				break;
+			break;
 	}
 	assert( false );
 	return( NULL );
 }
 
 //----------------------------------------------------------------------
-/** Release the stack value passed in, if it is a temporary, return it to the bucket.
+/** Release the stack value passed in, if it is a temporary, return it to the
+ * pools of the calling thread.
  * \param s Stack entry to be released.
  */
 void CqShaderStack::Release( SqStackEntry s )
 {
-	if( s.m_IsTemp )
+	if( !s.m_IsTemp )
+		return;
+	SqTemporaryPools& pools = threadPools();
+	bool uniform = s.m_Data->Class() == class_uniform;
+	switch( s.m_Data->Type() )
 	{
-		switch( s.m_Data->Type() )
-		{
-				case type_float:
-				{
-					if ( s.m_Data->Class() == class_uniform )
-						m_UFPool.push_back(reinterpret_cast<CqShaderVariableUniformFloat*>(s.m_Data) );
-					else
-						m_VFPool.push_back(reinterpret_cast<CqShaderVariableVaryingFloat*>(s.m_Data) );
-					break;
-				}
-
-				case type_point:
-				{
-					if ( s.m_Data->Class() == class_uniform )
-						m_UPPool.push_back(reinterpret_cast<CqShaderVariableUniformPoint*>(s.m_Data) );
-					else
-						m_VPPool.push_back(reinterpret_cast<CqShaderVariableVaryingPoint*>(s.m_Data) );
-					break;
-				}
-
-				case type_string:
-				{
-					if ( s.m_Data->Class() == class_uniform )
-						m_USPool.push_back(reinterpret_cast<CqShaderVariableUniformString*>(s.m_Data) );
-					else
-						m_VSPool.push_back(reinterpret_cast<CqShaderVariableVaryingString*>(s.m_Data) );
-					break;
-				}
-
-				case type_color:
-				{
-					if ( s.m_Data->Class() == class_uniform )
-						m_UCPool.push_back(reinterpret_cast<CqShaderVariableUniformColor*>(s.m_Data) );
-					else
-						m_VCPool.push_back(reinterpret_cast<CqShaderVariableVaryingColor*>(s.m_Data) );
-					break;
-				}
-
-				case type_normal:
-				{
-					if ( s.m_Data->Class() == class_uniform )
-						m_UNPool.push_back(reinterpret_cast<CqShaderVariableUniformNormal*>(s.m_Data) );
-					else
-						m_VNPool.push_back(reinterpret_cast<CqShaderVariableVaryingNormal*>(s.m_Data) );
-					break;
-				}
-
-				case type_vector:
-				{
-					if ( s.m_Data->Class() == class_uniform )
-						m_UVPool.push_back(reinterpret_cast<CqShaderVariableUniformVector*>(s.m_Data) );
-					else
-						m_VVPool.push_back(reinterpret_cast<CqShaderVariableVaryingVector*>(s.m_Data) );
-					break;
-				}
-
-				case type_matrix:
-				{
-					if ( s.m_Data->Class() == class_uniform )
-						m_UMPool.push_back(reinterpret_cast<CqShaderVariableUniformMatrix*>(s.m_Data) );
-					else
-						m_VMPool.push_back(reinterpret_cast<CqShaderVariableVaryingMatrix*>(s.m_Data) );
-					break;
-				}
-				
-				default:
-					break;
-		}
+			case type_float:
+			if ( uniform )
+				pools.m_UF.release( s.m_Data );
+			else
+				pools.m_VF.release( s.m_Data );
+			break;
+			case type_point:
+			if ( uniform )
+				pools.m_UP.release( s.m_Data );
+			else
+				pools.m_VP.release( s.m_Data );
+			break;
+			case type_string:
+			if ( uniform )
+				pools.m_US.release( s.m_Data );
+			else
+				pools.m_VS.release( s.m_Data );
+			break;
+			case type_color:
+			if ( uniform )
+				pools.m_UC.release( s.m_Data );
+			else
+				pools.m_VC.release( s.m_Data );
+			break;
+			case type_normal:
+			if ( uniform )
+				pools.m_UN.release( s.m_Data );
+			else
+				pools.m_VN.release( s.m_Data );
+			break;
+			case type_vector:
+			if ( uniform )
+				pools.m_UV.release( s.m_Data );
+			else
+				pools.m_VV.release( s.m_Data );
+			break;
+			case type_matrix:
+			if ( uniform )
+				pools.m_UM.release( s.m_Data );
+			else
+				pools.m_VM.release( s.m_Data );
+			break;
+			default:
+			break;
 	}
 }
 
 
+//----------------------------------------------------------------------
+/** Sum the sizes of the variables in the pools of all threads.
+ */
+
+TqUlong CqShaderStack::PooledMemory()
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock( g_poolsMutex );
+#	endif
+	TqUlong bytes = 0;
+	for ( boost::ptr_vector<SqTemporaryPools>::const_iterator i = g_allPools.begin();
+	        i != g_allPools.end(); ++i )
+		bytes += i->memory();
+	return ( bytes );
+}
+
+void CqShaderStack::TemporaryCounts( TqUlong& allocated, TqUlong& reused )
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock( g_poolsMutex );
+#	endif
+	allocated = 0;
+	reused = 0;
+	for ( boost::ptr_vector<SqTemporaryPools>::const_iterator i = g_allPools.begin();
+	        i != g_allPools.end(); ++i )
+	{
+		allocated += i->m_allocated;
+		reused += i->m_reused;
+	}
+}
+
+void CqShaderStack::FreePools()
+{
+#	ifdef ENABLE_THREADING
+	boost::mutex::scoped_lock lock( g_poolsMutex );
+#	endif
+	for ( boost::ptr_vector<SqTemporaryPools>::iterator i = g_allPools.begin();
+	        i != g_allPools.end(); ++i )
+		i->clear();
+}
+
+
 //----------------------------------------------------------------------
 /** Prints the max. depth stack for now to stdout.
  *  if SHADERSTACKSTATS is defined
@@ -29,7 +29,6 @@
 
 #include	<stack>
 #include	<vector>
-#include	<deque>
 
 #include	<aqsis/aqsis.h>
 
@@ -246,10 +245,7 @@ class AQSIS_SHADERVM_SHARE CqShaderStack
 		void	Push( IqShaderData* pv )
 		{
 			if ( m_iTop >= m_Stack.size() )
-			{
-				m_Stack.resize( m_iTop + 4 );
-				m_Stack.reserve( m_iTop + 4 );
-			}
+				m_Stack.resize( 2 * m_iTop + 4 );
 
 			m_Stack[ m_iTop ].m_Data = pv;
 			m_Stack[ m_iTop ].m_IsTemp = true;
@@ -266,10 +262,7 @@ class AQSIS_SHADERVM_SHARE CqShaderStack
 		{
 			assert( NULL != pv );
 			if ( m_iTop >= m_Stack.size() )
-			{
-				m_Stack.resize( m_iTop + 4 );
-				m_Stack.reserve( m_iTop + 4 );
-			}
+				m_Stack.resize( 2 * m_iTop + 4 );
 
 			m_Stack[ m_iTop ].m_Data = pv;
 			m_Stack[ m_iTop ].m_IsTemp = false;
@@ -323,6 +316,23 @@ class AQSIS_SHADERVM_SHARE CqShaderStack
 		 */
 		static void Statistics();
 
+		/** Get the approximate number of bytes held by the pools of free
+		 * temporary variables.
+		 */
+		static TqUlong PooledMemory();
+
+		/** Get the number of temporary variables which have been allocated,
+		 * and the number of requests for one which were met from the pools.
+		 */
+		static void TemporaryCounts( TqUlong& allocated, TqUlong& reused );
+
+		/** Delete the free temporary variables held in the pools.
+		 *
+		 * The pools of all threads are emptied, so this must not be called
+		 * while any shader is executing.
+		 */
+		static void FreePools();
+
 		/** set the more efficient number of samples per type of variable at run-time.
 		 */
 		static void	SetSamples(TqInt n)
@@ -334,32 +344,6 @@ class AQSIS_SHADERVM_SHARE CqShaderStack
 		std::vector<SqStackEntry>	m_Stack;
 		TqUint	m_iTop;										///< Index of the top entry.
 
-		static std::deque<CqShaderVariableUniformFloat*>				m_UFPool;
-		// Integer
-		static std::deque<CqShaderVariableUniformPoint*>				m_UPPool;
-		static std::deque<CqShaderVariableUniformString*>			m_USPool;
-		static std::deque<CqShaderVariableUniformColor*>				m_UCPool;
-		// Triple
-		// hPoint
-		static std::deque<CqShaderVariableUniformNormal*>			m_UNPool;
-		static std::deque<CqShaderVariableUniformVector*>			m_UVPool;
-		// Void
-		static std::deque<CqShaderVariableUniformMatrix*>			m_UMPool;
-		// SixteenTuple
-
-		static std::deque<CqShaderVariableVaryingFloat*>				m_VFPool;
-		// Integer
-		static std::deque<CqShaderVariableVaryingPoint*>				m_VPPool;
-		static std::deque<CqShaderVariableVaryingString*>			m_VSPool;
-		static std::deque<CqShaderVariableVaryingColor*>				m_VCPool;
-		// Triple
-		// hPoint
-		static std::deque<CqShaderVariableVaryingNormal*>			m_VNPool;
-		static std::deque<CqShaderVariableVaryingVector*>			m_VVPool;
-		// Void
-		static std::deque<CqShaderVariableVaryingMatrix*>			m_VMPool;
-		// SixteenTuple
-
 		static TqUint    m_samples; // by default == 18 see shaderstack.cpp
 		static TqUint    m_maxsamples;
 }
@@ -64,6 +64,16 @@ void shutdownShaderVM()
 	CqShaderVM::ShutdownShaderEngine();
 }
 
+TqUlong shaderVMPooledMemory()
+{
+	return CqShaderVM::PooledMemory();
+}
+
+void shaderVMTemporaryCounts(TqUlong& allocated, TqUlong& reused)
+{
+	CqShaderVM::TemporaryCounts(allocated, reused);
+}
+
 //------------------------------------------------------------------------------
 
 /*
@@ -795,8 +805,56 @@ IqShaderData* CqShaderVM::CreateVariableArray( EqVariableType VarType, EqVariabl
 
 IqShaderData* CqShaderVM::CreateTemporaryStorage( EqVariableType type, EqVariableClass _class )
 {
-	CqString strName( "__temporary__" );
-	return ( CreateVariable( type, _class, strName, IqShaderData::Temporary ) );
+	// Take the variable from the pools of stack temporaries where possible,
+	// resetting it to look like a newly created one.
+	IqShaderData* pData = 0;
+	switch ( type )
+	{
+			case type_bool:
+			case type_integer:
+			case type_float:
+			pData = GetNextTemp( type_float, _class );
+			pData->SetSize( 1 );
+			pData->SetFloat( 0.0f );
+			break;
+			case type_point:
+			pData = GetNextTemp( type, _class );
+			pData->SetSize( 1 );
+			pData->SetPoint( CqVector3D( 0, 0, 0 ) );
+			break;
+			case type_normal:
+			pData = GetNextTemp( type, _class );
+			pData->SetSize( 1 );
+			pData->SetNormal( CqVector3D( 0, 0, 0 ) );
+			break;
+			case type_vector:
+			pData = GetNextTemp( type, _class );
+			pData->SetSize( 1 );
+			pData->SetVector( CqVector3D( 0, 0, 0 ) );
+			break;
+			case type_color:
+			pData = GetNextTemp( type, _class );
+			pData->SetSize( 1 );
+			pData->SetColor( CqColor( 0, 0, 0 ) );
+			break;
+			case type_string:
+			pData = GetNextTemp( type, _class );
+			pData->SetSize( 1 );
+			pData->SetString( CqString() );
+			break;
+			case type_matrix:
+			pData = GetNextTemp( type, _class );
+			pData->SetSize( 1 );
+			pData->SetMatrix( CqMatrix() );
+			break;
+			default:
+			{
+				CqString strName( "__temporary__" );
+				pData = CreateVariable( type, _class, strName, IqShaderData::Temporary );
+			}
+			break;
+	}
+	return ( pData );
 }
 
 
@@ -807,7 +865,26 @@ IqShaderData* CqShaderVM::CreateTemporaryStorage( EqVariableType type, EqVariabl
 
 void CqShaderVM::DeleteTemporaryStorage( IqShaderData* pData )
 {
-	delete( pData );
+	switch ( pData->Type() )
+	{
+			case type_float:
+			case type_point:
+			case type_normal:
+			case type_vector:
+			case type_color:
+			case type_string:
+			case type_matrix:
+			{
+				SqStackEntry entry;
+				entry.m_IsTemp = true;
+				entry.m_Data = pData;
+				Release( entry );
+			}
+			break;
+			default:
+			delete( pData );
+			break;
+	}
 }
 
 //---------------------------------------------------------------------
@@ -1554,9 +1631,9 @@ void CqShaderVM::Execute(IqShaderExecEnv* pEnv)
 		pE = &ReadNext();
 		( this->*pE->m_Command ) ();
 	}
-	// Check that the stack is empty.
+	// Check that the stack is empty.  The entries themselves are kept for
+	// the next grid.
 	assert( m_iTop == 0 );
-	m_Stack.clear();
 }
 
 
@@ -1588,9 +1665,9 @@ void CqShaderVM::ExecuteInit()
 		pE = &ReadNext();
 		( this->*pE->m_Command ) ();
 	}
-	// Check that the stack is empty.
+	// Check that the stack is empty.  The entries themselves are kept for
+	// the next grid.
 	assert( m_iTop == 0 );
-	m_Stack.clear();
 
 	m_pEnv = pOldEnv;
 }
@@ -1935,83 +2012,8 @@ const std::vector<IqShaderData*>& CqShaderVM::GetArguments() const
 
 void CqShaderVM::ShutdownShaderEngine()
 {
-	// Free any temporary variables in the buckets.
-	while( !m_UFPool.empty() )
-	{
-		delete(m_UFPool.front());
-		m_UFPool.pop_front();
-	}
-	while( !m_VFPool.empty() )
-	{
-		delete(m_VFPool.front());
-		m_VFPool.pop_front();
-	}
-
-	while( !m_UPPool.empty() )
-	{
-		delete(m_UPPool.front());
-		m_UPPool.pop_front();
-	}
-	while( !m_VPPool.empty() )
-	{
-		delete(m_VPPool.front());
-		m_VPPool.pop_front();
-	}
-
-	while( !m_USPool.empty() )
-	{
-		delete(m_USPool.front());
-		m_USPool.pop_front();
-	}
-	while( !m_VSPool.empty() )
-	{
-		delete(m_VSPool.front());
-		m_VSPool.pop_front();
-	}
-
-	while( !m_UCPool.empty() )
-	{
-		delete(m_UCPool.front());
-		m_UCPool.pop_front();
-	}
-	while( !m_VCPool.empty() )
-	{
-		delete(m_VCPool.front());
-		m_VCPool.pop_front();
-	}
-
-	while( !m_UNPool.empty() )
-	{
-		delete(m_UNPool.front());
-		m_UNPool.pop_front();
-	}
-	while( !m_VNPool.empty() )
-	{
-		delete(m_VNPool.front());
-		m_VNPool.pop_front();
-	}
-
-	while( !m_UVPool.empty() )
-	{
-		delete(m_UVPool.front());
-		m_UVPool.pop_front();
-	}
-	while( !m_VVPool.empty() )
-	{
-		delete(m_VVPool.front());
-		m_VVPool.pop_front();
-	}
-
-	while( !m_UMPool.empty() )
-	{
-		delete(m_UMPool.front());
-		m_UMPool.pop_front();
-	}
-	while( !m_VMPool.empty() )
-	{
-		delete(m_VMPool.front());
-		m_VMPool.pop_front();
-	}
+	// Free any temporary variables in the pools.
+	FreePools();
 }
 
 
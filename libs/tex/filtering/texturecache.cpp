@@ -69,6 +69,8 @@ CqTextureCache::CqTextureCache(TqSearchPathCallback searchPathCallback)
 	m_shadowCache(),
 	m_occlusionCache(),
 	m_texFileCache(),
+	m_fileNames(),
+	m_filesRead(),
 	m_currToWorld(),
 	m_searchPathCallback(searchPathCallback)
 { }
@@ -102,6 +104,18 @@ void CqTextureCache::flush()
 	m_texFileCache.clear();
 }
 
+void CqTextureCache::takeFilesRead(std::vector<std::string>& fileNames)
+{
+	for(std::set<TqUlong>::const_iterator i = m_filesRead.begin();
+			i != m_filesRead.end(); ++i)
+	{
+		std::map<TqUlong, std::string>::const_iterator name = m_fileNames.find(*i);
+		if(name != m_fileNames.end())
+			fileNames.push_back(name->second);
+	}
+	m_filesRead.clear();
+}
+
 const CqTexFileHeader* CqTextureCache::textureInfo(const char* name)
 {
 	boost::shared_ptr<IqTiledTexInputFile> file;
@@ -129,6 +143,7 @@ SamplerT& CqTextureCache::findSampler(
 		const char* name)
 {
 	TqUlong hash = CqString::hash(name);
+	m_filesRead.insert(hash);
 	typename std::map<TqUlong, boost::shared_ptr<SamplerT> >::const_iterator
 		texIter = samplerMap.find(hash);
 	if(texIter != samplerMap.end())
@@ -188,6 +203,7 @@ boost::shared_ptr<IqTiledTexInputFile> CqTextureCache::getTextureFile(
 			<< e.what() << ".  Rendering will continue, but may be slower.\n";
 	}
 	m_texFileCache[hash] = file;
+	m_fileNames[hash] = native(fullName);
 	return file;
 }
 
@@ -41,6 +41,7 @@
 #include <aqsis/aqsis.h>
 
 #include <map>
+#include <set>
 
 #include <boost/utility.hpp>
 
@@ -77,6 +78,7 @@ class AQSIS_TEX_SHARE CqTextureCache : public IqTextureCache, private boost::non
 		virtual IqShadowSampler& findShadowSampler(const char* name);
 		virtual IqOcclusionSampler& findOcclusionSampler(const char* name);
 		virtual void flush();
+		virtual void takeFilesRead(std::vector<std::string>& fileNames);
 		virtual const CqTexFileHeader* textureInfo(const char* name);
 		virtual void setCurrToWorldMatrix(const CqMatrix& currToWorld);
 
@@ -118,6 +120,10 @@ class AQSIS_TEX_SHARE CqTextureCache : public IqTextureCache, private boost::non
 		std::map<TqUlong, boost::shared_ptr<IqOcclusionSampler> > m_occlusionCache;
 		/// Cached texture files live in here:
 		std::map<TqUlong, boost::shared_ptr<IqTiledTexInputFile> > m_texFileCache;
+		/// Full paths of the texture files opened, by name hash.
+		std::map<TqUlong, std::string> m_fileNames;
+		/// Name hashes of the textures looked up since the last takeFilesRead()
+		std::set<TqUlong> m_filesRead;
 		/// Camera -> world transformation - used for creating shadow maps.
 		CqMatrix m_currToWorld;
 		/// Callback function to obtain the current texture search path.
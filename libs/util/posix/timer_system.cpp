@@ -0,0 +1,54 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+/** \file
+		\brief Implements the monotonic clock used by the performance timers on posix systems.
+*/
+
+#include	<aqsis/util/timer.h>
+
+#ifdef AQSIS_SYSTEM_MACOSX
+#include	<mach/mach_time.h>
+#else
+#include	<time.h>
+#endif
+
+namespace Aqsis {
+
+double monotonicTime()
+{
+#	ifdef AQSIS_SYSTEM_MACOSX
+	static double secondsPerTick = 0;
+	if(secondsPerTick == 0)
+	{
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+		secondsPerTick = 1e-9 * timebase.numer / timebase.denom;
+	}
+	return secondsPerTick * mach_absolute_time();
+#	else
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+#	endif
+}
+
+} // namespace Aqsis
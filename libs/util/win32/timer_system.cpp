@@ -0,0 +1,46 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+
+/** \file
+		\brief Implements the monotonic clock used by the performance timers on windows.
+*/
+
+#include	<aqsis/util/timer.h>
+
+#include	<windows.h>
+
+namespace Aqsis {
+
+double monotonicTime()
+{
+	static double secondsPerTick = 0;
+	if(secondsPerTick == 0)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		secondsPerTick = 1.0 / frequency.QuadPart;
+	}
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return secondsPerTick * count.QuadPart;
+}
+
+} // namespace Aqsis
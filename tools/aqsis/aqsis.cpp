@@ -42,6 +42,7 @@
 
 #include <fcntl.h>
 
+#include <algorithm>
 #include <cstring>  // for memset
 #include <iostream>
 #include <iomanip>
@@ -56,6 +57,7 @@
 #include <memory>
 
 #include <aqsis/core/corecontext.h>
+#include <aqsis/riutil/ribindex.h>
 #include <aqsis/riutil/ricxxutil.h>
 #include <aqsis/riutil/ricxx_filter.h>
 #include <aqsis/util/exception.h>
@@ -64,6 +66,7 @@
 #include <aqsis/util/logging.h>
 #include <aqsis/util/logging_streambufs.h>
 #include <aqsis/ri/ri.h>
+#include <boost/filesystem.hpp>
 #include <aqsis/version.h>
 #include <aqsis/util/exception.h>
 
@@ -126,6 +129,8 @@ ArgParse::apintvec g_cl_frames;
 ArgParse::apflag g_cl_beep = 0;
 ArgParse::apint g_cl_verbose = 1;
 ArgParse::apflag g_cl_echoapi = 0;
+ArgParse::apflag g_cl_incremental = 0;
+ArgParse::apflag g_cl_ribindex = 0;
 ArgParse::apfloatvec g_cl_cropWindow;
 ArgParse::apstring g_cl_shader_path = "";
 ArgParse::apstring g_cl_archive_path = "";
@@ -312,6 +317,105 @@ std::string getFrameList()
 	return frameList;
 }
 
+/** \brief Stream buffer reading a limited number of bytes from another stream.
+ *
+ * Used to parse the byte ranges of a RIB file selected by a RibIndex.
+ */
+class RangeBuf : public std::streambuf
+{
+	public:
+		RangeBuf(std::istream& in, Aqsis::RibIndex::Offset size)
+			: m_in(in),
+			m_remaining(size)
+		{ }
+
+	protected:
+		virtual int_type underflow()
+		{
+			if(gptr() < egptr())
+				return traits_type::to_int_type(*gptr());
+			std::streamsize n = static_cast<std::streamsize>(
+				std::min<Aqsis::RibIndex::Offset>(m_remaining, bufSize));
+			n = m_in.rdbuf()->sgetn(m_buf, n);
+			if(n <= 0)
+				return traits_type::eof();
+			m_remaining -= n;
+			setg(m_buf, m_buf, m_buf + n);
+			return traits_type::to_int_type(*gptr());
+		}
+
+	private:
+		static const int bufSize = 1 << 16;
+		std::istream& m_in;
+		Aqsis::RibIndex::Offset m_remaining;
+		char m_buf[bufSize];
+};
+
+/** \brief Parse only the selected frames of a RIB file, using a frame index.
+ *
+ * The index is cached next to the RIB file.  A cached index is used whenever
+ * it's newer than the file; a new index is only built and saved when
+ * -ribindex is given, since that writes to the directory of the input.
+ *
+ * \return false if no usable index is available, in which case the whole
+ * file should be parsed as usual.
+ */
+bool parseIndexedRib(const std::string& fileName, const std::string& frameList)
+{
+	Aqsis::RibIndex index;
+	bool haveIndex = false;
+	try
+	{
+		Aqsis::boostfs::path ribPath(fileName);
+		Aqsis::boostfs::path indexPath(Aqsis::ribIndexFileName(fileName));
+		if(Aqsis::boostfs::exists(indexPath) && Aqsis::boostfs::last_write_time(indexPath)
+				>= Aqsis::boostfs::last_write_time(ribPath))
+		{
+			std::ifstream indexFile(indexPath.string().c_str());
+			haveIndex = index.read(indexFile)
+				&& index.streamSize() == Aqsis::boostfs::file_size(ribPath);
+		}
+		if(!haveIndex && g_cl_ribindex)
+		{
+			std::ifstream ribFile(fileName.c_str(), std::ios::binary);
+			if(!index.build(ribFile))
+			{
+				Aqsis::log() << Aqsis::warning << "Cannot index \""
+					<< fileName << "\" (compressed or binary RIB)\n";
+				return false;
+			}
+			haveIndex = true;
+			std::ofstream indexFile(indexPath.string().c_str());
+			index.write(indexFile);
+			if(!indexFile)
+				Aqsis::log() << Aqsis::warning << "Could not save RIB index \""
+					<< indexPath.string() << "\"\n";
+		}
+	}
+	catch(Aqsis::boostfs::filesystem_error& e)
+	{
+		Aqsis::log() << Aqsis::warning << e.what() << "\n";
+		return false;
+	}
+	if(!haveIndex)
+		return false;
+
+	std::vector<int> frames;
+	Aqsis::parseFrameList(frameList.c_str(), frames);
+	std::vector<Aqsis::RibIndex::Range> ranges = index.ranges(frames);
+	std::ifstream ribFile(fileName.c_str(), std::ios::binary);
+	for(std::vector<Aqsis::RibIndex::Range>::const_iterator r = ranges.begin();
+			r != ranges.end(); ++r)
+	{
+		ribFile.clear();
+		ribFile.seekg(static_cast<std::streamoff>(r->first));
+		RangeBuf rangeBuf(ribFile, r->second - r->first);
+		std::istream rangeStream(&rangeBuf);
+		Aqsis::cxxRenderContext()->parseRib(rangeStream, fileName.c_str());
+	}
+	return true;
+}
+
 /** \brief Event handler to restore the color for the console when catching an
  * asyncronous interruption.
  *
@@ -464,6 +568,8 @@ void setupOptions()
 {
 	if ( g_cl_echoapi )
 		Aqsis::cxxRenderContext()->addFilter("echorib");
+	if ( g_cl_incremental )
+		Aqsis::cxxRenderContext()->addFilter("incremental");
 
 	std::string frameList = getFrameList();
 	if(!frameList.empty())
@@ -529,6 +635,7 @@ int main( int argc, const char** argv )
 		           "\a3 = debug", &g_cl_verbose );
 		ap.alias( "verbose", "v" );
 		ap.argFlag( "echoapi", "\aEcho all RI API calls to stdout as RIB", &g_cl_echoapi);
+		ap.argFlag( "incremental", "\aOnly render the buckets which changed since the same frame was last rendered", &g_cl_incremental);
 
 		ap.argInt( "priority", "=integer\aControl the priority class of aqsis.\n"
 			"\a0 = idle\n"
@@ -546,6 +653,7 @@ int main( int argc, const char** argv )
 		ap.argFlag( "nocolor", "\aDisable colored output", &g_cl_no_color );
 		ap.argInts( "frames", " f1 f2\aSpecify a starting/ending frame to render (inclusive).", &g_cl_frames, ArgParse::SEP_ARGV, 2);
 		ap.argString( "framelist", "=string\aSpecify a range of frames to render, ',' separated with '-' to indicate ranges.", &g_cl_frameList);
+		ap.argFlag( "ribindex", "\aIndex the frames of RIB files given with -frames or -framelist, and cache the index next to the file", &g_cl_ribindex );
 		ap.argFlag( "beep", "\aBeep on completion of all ribs", &g_cl_beep );
 		ap.alias( "nocolor", "nc" );
 		ap.argInts( "res", " x y\aSpecify the resolution of the render.", &g_cl_res, ArgParse::SEP_ARGV, 2);
@@ -646,11 +754,17 @@ int main( int argc, const char** argv )
 			}
 			else
 			{
+				std::string frameList = getFrameList();
 				for(ArgParse::apstringvec::const_iterator fileName = ap.leftovers().begin();
 						fileName != ap.leftovers().end(); fileName++)
 				{
 					std::ifstream inFile(fileName->c_str());
-					if(inFile)
+					if(inFile && !frameList.empty()
+						&& parseIndexedRib(*fileName, frameList))
+					{
+						returnCode = RiLastError;
+					}
+					else if(inFile)
 					{
 						Aqsis::cxxRenderContext()->parseRib(inFile, fileName->c_str());
 						returnCode = RiLastError;
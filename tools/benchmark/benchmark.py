@@ -0,0 +1,499 @@
+#!/usr/bin/env python
+######################################################################
+# Render performance and image regression benchmark for Aqsis.
+#
+# Renders a set of the example scenes with an installed aqsis, and
+# records the wall time, peak memory, timings and end of frame
+# statistics of each render pass as JSON.  The rendered images may be compared against a
+# set of reference images with pdiff, and the timings against those
+# of an earlier run.
+#
+# Requirements:
+#
+# - Python 2.5 or higher
+# - aqsis, aqsl and teqser; pdiff for image comparisons
+#
+# See benchmark.py -h for usage information.
+######################################################################
+
+import sys, os, os.path, re, shutil, subprocess, time, platform, optparse
+
+try:
+    import json
+except ImportError:
+    import simplejson as json
+
+
+# The scenes of the suite.  Paths are relative to the source tree.  Each
+# scene is rendered in a copy of its directory, after compiling its shaders
+# and making its textures.  The passes are rendered in order, and the
+# images are those which are compared against the references.
+SCENES = [
+    {
+        "name" : "vase",
+        "description" : "Displacement and shadow maps",
+        "directory" : "examples/scenes/vase",
+        "shaders" : ["shaders/displacement/dented.sl",
+                     "shaders/light/shadowspot.sl"],
+        "passes" : ["vase.rib"],
+        "images" : ["vase.tif"],
+    },
+    {
+        "name" : "microbe",
+        "description" : "Displacement and procedural shading",
+        "directory" : "examples/scenes/microbe",
+        "shaders" : ["shaders/displacement/micro_bumps.sl",
+                     "shaders/surface/microscope.sl"],
+        "passes" : ["microbe.rib"],
+        "images" : ["microbe.tif"],
+    },
+    {
+        "name" : "motionblur_camera",
+        "description" : "Camera motion blur",
+        "directory" : "examples/features/motionblur",
+        "passes" : ["camera.rib"],
+        "images" : ["camera.tif"],
+    },
+    {
+        "name" : "motionblur_deformation",
+        "description" : "Deformation motion blur",
+        "directory" : "examples/features/motionblur",
+        "passes" : ["deformation.rib"],
+        "images" : ["deformation.tif"],
+    },
+    {
+        "name" : "depthoffield",
+        "description" : "Depth of field",
+        "directory" : "examples/features/depthoffield",
+        "passes" : ["dof.rib"],
+        "images" : ["dof.tif"],
+    },
+    {
+        "name" : "adaptive_gap",
+        "description" : "Adaptive sampling through a subpixel gap",
+        "directory" : "examples/features/adaptive",
+        "passes" : ["gap.rib"],
+        "images" : ["gap_full.tif", "gap_adaptive.tif"],
+    },
+    {
+        "name" : "curves",
+        "description" : "Curves, as used for hair",
+        "directory" : "examples/features/curves",
+        "passes" : ["bezier.rib"],
+        "images" : ["bezier.tif"],
+    },
+    {
+        "name" : "textures",
+        "description" : "Texture filtering",
+        "directory" : "examples/features/textures",
+        "shaders" : ["shaders/surface/sticky_texture.sl"],
+        "textures" : [["-wrap=periodic", "grid.tif", "grid.tex"]],
+        "passes" : ["sticky.rib"],
+        "images" : ["sticky.tif"],
+    },
+    {
+        "name" : "cornellbox_occlusion",
+        "description" : "Point-based occlusion",
+        "directory" : "examples/point_based_gi/cornellbox",
+        "shaders" : ["ao.sl", "bake_points.sl"],
+        "passes" : ["shadow_pass.rib", "bake_pass.rib", "beauty_pass_ao.rib"],
+        "images" : ["cornellbox.tif"],
+    },
+]
+
+# Display types which would open a window; these are written to files
+# instead, so that the benchmark can run unattended.
+framebufferDisplayRe = re.compile(r'Display(\s+)"(\+?)([^"]*)"(\s+)"z?framebuffer"')
+
+# A line of the timings printed with the end of frame statistics.
+timerRe = re.compile(r'^(.+?) took ([0-9.]+) (seconds|milli secs|micro secs)'
+                     r' ?\(called ([0-9,]+) times?\)')
+timerUnits = {"seconds" : 1.0, "milli secs" : 1e-3, "micro secs" : 1e-6}
+
+# The counts printed with the end of frame statistics (level 2 and up),
+# as (group, pattern, names of the pattern groups).  Percentages are
+# skipped, as they can be worked out from the counts.
+statisticsPatterns = [
+    ("gprims", r"^Input geometry:\n\t(\d+) primitives created", ["created"]),
+    ("gprims", r"^GPrims:\n\t(\d+) allocated\n\t(\d+) used [^,]*, (\d+) peak,"
+               r"\n\t(\d+) culled [^\n]*\n\t(\d+) occlusion culled",
+     ["allocated", "used", "peak", "culled", "occlusion_culled"]),
+    ("curves", r"^\tCurves:\n\t\t(\d+) created\n\t\t(\d+) split [^\n]*"
+               r"\n\t\t\t(\d+) [^\n]* into (\d+) subcurves\n\t\t\t(\d+) [^\n]* into (\d+) patches",
+     ["created", "split", "split_to_curves", "subcurves", "split_to_patches", "patches"]),
+    ("procedurals", r"^\tProcedurals:\n\t\t(\d+) created\n\t\t(\d+) split",
+     ["created", "split"]),
+    ("archive_cache", r"^\tArchive cache:\n\t\t(\d+) hits\n\t\t(\d+) misses",
+     ["hits", "misses"]),
+    ("grids", r"^Grids:\n\t(\d+) created, (\d+) peak,\n\t(\d+) initialized [^\n]*"
+              r"\n\t(\d+) shaded [^,]*, (\d+) culled",
+     ["created", "peak", "initialized", "shaded", "culled"]),
+    ("micropolygons", r"^Micropolygons:\n\t(\d+) created \((\d+) culled\)"
+                      r"\n\t(\d+) peak, (\d+) trimmed, \( (\d+) completely \) (\d+) missed",
+     ["created", "culled", "peak", "trimmed", "trimmed_out", "missed"]),
+    ("micropolygons", r"^\tPushes:\t(\d+) MPGs pushed [^\n]*\n\t\t(\d+) forward [^,]*, "
+                      r"(\d+) down [^\n]*\n\t\t(\d+) far down",
+     ["pushed", "pushed_forward", "pushed_down", "pushed_far_down"]),
+    ("sampling", r"^\t(\d+) samples\n\tHits: (\d+) [^,]*, bound hits: (\d+)",
+     ["samples", "hits", "bound_hits"]),
+    ("attributes", r"^Attributes:\n\t(\d+) created, (\d+) interned, (\d+) shared",
+     ["created", "interned", "shared"]),
+    ("transforms", r"^Transforms:\n\t(\d+) interned, (\d+) shared", ["interned", "shared"]),
+    ("parameters", r"^Parameters:\n\t(\d+) created, (\d+) peak", ["created", "peak"]),
+    ("shader_temporaries", r"^Shader temporaries:\n\t(\d+) allocated, (\d+) reused",
+     ["allocated", "reused"]),
+    ("textures", r"^Textures +: (\d+) bytes used", ["memory_bytes"]),
+]
+statisticsPatterns = [(group, re.compile(pattern, re.M), names)
+                      for group, pattern, names in statisticsPatterns]
+# The per category memory use, printed after the counts above.
+memoryHeaderRe = re.compile(r'^Memory:$', re.M)
+memoryLineRe = re.compile(r'^\t([^:\n]+): (\d+)K current, (\d+)K peak$')
+
+
+def findProgram(name, bindir):
+    """Find an executable, in bindir if given, otherwise on the path."""
+    exeNames = [name]
+    if sys.platform == "win32":
+        exeNames = [name + ".exe", name]
+    dirs = []
+    if bindir:
+        dirs.append(bindir)
+    dirs += os.environ.get("PATH", "").split(os.pathsep)
+    for d in dirs:
+        for exeName in exeNames:
+            path = os.path.join(d, exeName)
+            if os.path.isfile(path):
+                return path
+    return None
+
+
+def runProgram(args, cwd):
+    """Run a program, returning its exit status, wall time in seconds, peak
+    resident memory in kilobytes (or None where unknown) and output."""
+    startTime = time.time()
+    proc = subprocess.Popen(args, cwd=cwd, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    if hasattr(os, "wait4"):
+        # Read the output before waiting, so the child can't block on a
+        # full pipe; wait4 then gives the usage of this child alone.
+        output = proc.stdout.read()
+        proc.stdout.close()
+        pid, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+        peakRss = usage.ru_maxrss
+        if sys.platform == "darwin":
+            peakRss //= 1024
+    else:
+        output = proc.communicate()[0]
+        peakRss = None
+    wallTime = time.time() - startTime
+    if not isinstance(output, str):
+        output = output.decode("utf-8", "replace")
+    return proc.returncode, wallTime, peakRss, output
+
+
+def parseTimers(output):
+    """Extract the timings from the end of frame statistics."""
+    timers = {}
+    for line in output.splitlines():
+        match = timerRe.match(line.strip())
+        if match:
+            name = match.group(1)
+            seconds = float(match.group(2)) * timerUnits[match.group(3)]
+            calls = int(match.group(4).replace(",", ""))
+            timer = timers.setdefault(name, {"seconds" : 0.0, "calls" : 0})
+            timer["seconds"] += seconds
+            timer["calls"] += calls
+    return timers
+
+
+def mergeStatistic(group, total, name, value):
+    # Snapshots of memory use and peaks are combined over the frames of a
+    # render by taking the largest; the counts are summed.
+    if group == "memory" or name.endswith("peak") or name.startswith("memory"):
+        total[name] = max(total.get(name, 0), value)
+    else:
+        total[name] = total.get(name, 0) + value
+
+
+def parseStatistics(output):
+    """Extract the counts from the end of frame statistics, summing the
+    statistics of each frame rendered."""
+    output = output.replace("\r\n", "\n")
+    statistics = {}
+    for group, pattern, names in statisticsPatterns:
+        for match in pattern.finditer(output):
+            counts = statistics.setdefault(group, {})
+            for name, value in zip(names, match.groups()):
+                mergeStatistic(group, counts, name, int(value))
+    for header in memoryHeaderRe.finditer(output):
+        for line in output[header.end():].lstrip("\n").splitlines():
+            match = memoryLineRe.match(line)
+            if not match:
+                break
+            memory = statistics.setdefault("memory", {}).setdefault(match.group(1), {})
+            mergeStatistic("memory", memory, "current_kb", int(match.group(2)))
+            mergeStatistic("memory", memory, "peak_kb", int(match.group(3)))
+    return statistics
+
+
+def mergeTimers(total, timers):
+    for name, timer in timers.items():
+        t = total.setdefault(name, {"seconds" : 0.0, "calls" : 0})
+        t["seconds"] += timer["seconds"]
+        t["calls"] += timer["calls"]
+
+
+def prepareScene(scene, options, programs, workDir):
+    """Copy a scene into the work directory, compile its shaders and make
+    its textures.  Return a list of error messages."""
+    errors = []
+    if os.path.exists(workDir):
+        shutil.rmtree(workDir)
+    shutil.copytree(os.path.join(options.source, scene["directory"]), workDir)
+
+    # Replace the framebuffer displays.
+    for fileName in os.listdir(workDir):
+        if not fileName.endswith(".rib"):
+            continue
+        path = os.path.join(workDir, fileName)
+        rib = open(path).read()
+        rib = framebufferDisplayRe.sub(r'Display\1"\2\3.framebuffer.tif"\4"file"', rib)
+        open(path, "w").write(rib)
+
+    for shader in scene.get("shaders", []):
+        shaderPath = os.path.join(options.source, scene["directory"], shader)
+        if not os.path.exists(shaderPath):
+            shaderPath = os.path.join(options.source, shader)
+        status, wallTime, peakRss, output = runProgram(
+            [programs["aqsl"], shaderPath], workDir)
+        if status != 0:
+            errors.append("aqsl %s failed:\n%s" % (shader, output))
+
+    for textureArgs in scene.get("textures", []):
+        status, wallTime, peakRss, output = runProgram(
+            [programs["teqser"]] + textureArgs, workDir)
+        if status != 0:
+            errors.append("teqser %s failed:\n%s" % (" ".join(textureArgs), output))
+    return errors
+
+
+def renderScene(scene, options, programs, workDir):
+    """Render the passes of a scene, returning the results for each pass."""
+    passes = []
+    for rib in scene["passes"]:
+        args = [programs["aqsis"], "-endofframe=%d" % options.statistics, rib]
+        status, wallTime, peakRss, output = runProgram(args, workDir)
+        result = {
+            "rib" : rib,
+            "status" : status,
+            "wall_time" : wallTime,
+            "peak_rss_kb" : peakRss,
+            "timers" : parseTimers(output),
+            "statistics" : parseStatistics(output),
+        }
+        if options.keep_output:
+            result["output"] = output
+        passes.append(result)
+        if status != 0:
+            result["output"] = output
+            break
+    return passes
+
+
+def compareImages(scene, options, programs, workDir):
+    """Compare the images of a scene against the references."""
+    images = {}
+    for image in scene["images"]:
+        imagePath = os.path.join(workDir, image)
+        refPath = os.path.join(options.references, scene["name"], image)
+        if not os.path.exists(imagePath):
+            images[image] = {"result" : "missing image"}
+        elif options.update_references:
+            refDir = os.path.dirname(refPath)
+            if not os.path.isdir(refDir):
+                os.makedirs(refDir)
+            shutil.copyfile(imagePath, refPath)
+            images[image] = {"result" : "reference updated"}
+        elif not os.path.exists(refPath):
+            images[image] = {"result" : "missing reference"}
+        else:
+            args = [programs["pdiff"], refPath, imagePath]
+            if options.threshold is not None:
+                args += ["-threshold", str(options.threshold)]
+            status, wallTime, peakRss, output = runProgram(args, workDir)
+            # pdiff prints PASS or FAIL, followed by the reason.
+            lines = output.strip().splitlines()
+            lastLine = lines and lines[-1] or ""
+            if lastLine.startswith("PASS"):
+                result = "pass"
+            else:
+                result = "fail"
+            images[image] = {"result" : result, "pdiff" : output.strip()}
+    return images
+
+
+def benchmarkScene(scene, options, programs):
+    workDir = os.path.join(options.output, scene["name"])
+    result = {"description" : scene["description"]}
+    errors = prepareScene(scene, options, programs, workDir)
+    if errors:
+        result["status"] = "setup failed"
+        result["errors"] = errors
+        return result
+
+    wallTimes = []
+    peakRss = None
+    for i in range(options.repeat):
+        passes = renderScene(scene, options, programs, workDir)
+        if [p for p in passes if p["status"] != 0]:
+            result["status"] = "render failed"
+            result["passes"] = passes
+            return result
+        wallTimes.append(sum([p["wall_time"] for p in passes]))
+        for p in passes:
+            if p["peak_rss_kb"] is not None:
+                peakRss = max(peakRss or 0, p["peak_rss_kb"])
+
+    timers = {}
+    for p in passes:
+        mergeTimers(timers, p["timers"])
+    result["wall_time"] = min(wallTimes)
+    result["wall_times"] = wallTimes
+    result["peak_rss_kb"] = peakRss
+    result["timers"] = timers
+    result["passes"] = passes
+    result["status"] = "ok"
+
+    if options.references and (programs["pdiff"] or options.update_references):
+        result["images"] = compareImages(scene, options, programs, workDir)
+        if [i for i in result["images"].values() if i["result"] in ("fail", "missing image")]:
+            result["status"] = "image mismatch"
+    return result
+
+
+def compareTimings(results, baseline, maxSlowdown):
+    """Print the change in wall time against a baseline run, returning the
+    names of the scenes which slowed down by more than maxSlowdown percent."""
+    slower = []
+    sys.stderr.write("\n%-26s %10s %10s %8s\n" % ("scene", "baseline", "current", "change"))
+    for name, result in sorted(results["scenes"].items()):
+        base = baseline.get("scenes", {}).get(name, {})
+        if "wall_time" not in result or "wall_time" not in base:
+            continue
+        change = 100.0 * (result["wall_time"] - base["wall_time"]) / base["wall_time"]
+        sys.stderr.write("%-26s %9.2fs %9.2fs %+7.1f%%\n" % (name, base["wall_time"],
+                                                           result["wall_time"], change))
+        if maxSlowdown is not None and change > maxSlowdown:
+            slower.append(name)
+    return slower
+
+
+def main():
+    usage = "%prog [options] [scene ...]"
+    parser = optparse.OptionParser(usage=usage, description=
+        "Render the benchmark scenes with an installed aqsis, recording "
+        "timings and statistics as JSON, and optionally compare the images "
+        "against references.  All scenes are rendered if none are given.")
+    sourceDir = os.path.normpath(os.path.join(os.path.dirname(
+                    os.path.abspath(__file__)), "..", ".."))
+    parser.add_option("--source", default=sourceDir,
+                      help="aqsis source tree [%default]")
+    parser.add_option("--bindir", default=None,
+                      help="directory holding aqsis, aqsl, teqser and pdiff; "
+                      "the path is searched by default")
+    parser.add_option("--output", default="benchmark",
+                      help="directory to render the scenes in [%default]")
+    parser.add_option("--json", default=None,
+                      help="file to write the results to; stdout by default")
+    parser.add_option("--references", default=None,
+                      help="directory of reference images to compare against")
+    parser.add_option("--update-references", action="store_true", default=False,
+                      help="copy the rendered images to the reference directory")
+    parser.add_option("--threshold", type="int", default=None,
+                      help="number of differing pixels pdiff ignores")
+    parser.add_option("--baseline", default=None,
+                      help="results of an earlier run to compare timings with")
+    parser.add_option("--max-slowdown", type="float", default=None,
+                      help="fail if a scene is this many percent slower than the baseline")
+    parser.add_option("--repeat", type="int", default=1,
+                      help="render each scene this many times, keeping the "
+                      "fastest time [%default]")
+    parser.add_option("--statistics", type="int", default=3,
+                      help="end of frame statistics level [%default]")
+    parser.add_option("--keep-output", action="store_true", default=False,
+                      help="keep the output of each render in the results")
+    parser.add_option("--list", action="store_true", default=False,
+                      help="list the scenes and exit")
+    options, args = parser.parse_args()
+
+    if options.list:
+        for scene in SCENES:
+            print("%-26s %s" % (scene["name"], scene["description"]))
+        return 0
+
+    scenes = SCENES
+    if args:
+        names = [s["name"] for s in SCENES]
+        for name in args:
+            if name not in names:
+                parser.error("unknown scene \"%s\"" % name)
+        scenes = [s for s in SCENES if s["name"] in args]
+    if options.update_references and not options.references:
+        parser.error("--update-references needs --references")
+
+    programs = {}
+    for name in ("aqsis", "aqsl", "teqser", "pdiff"):
+        programs[name] = findProgram(name, options.bindir)
+        if not programs[name] and name != "pdiff":
+            sys.stderr.write("Could not find %s\n" % name)
+            return 1
+    if options.references and not options.update_references and not programs["pdiff"]:
+        sys.stderr.write("Could not find pdiff; the images won't be compared\n")
+
+    options.output = os.path.abspath(options.output)
+    if options.references:
+        options.references = os.path.abspath(options.references)
+    if not os.path.isdir(options.output):
+        os.makedirs(options.output)
+
+    version = runProgram([programs["aqsis"], "-version"], options.output)[3]
+    results = {
+        "aqsis_version" : (version.strip().splitlines() or [""])[0],
+        "date" : time.strftime("%Y-%m-%d %H:%M:%S"),
+        "host" : platform.node(),
+        "platform" : platform.platform(),
+        "scenes" : {},
+    }
+    failed = []
+    for scene in scenes:
+        sys.stderr.write("Rendering %s...\n" % scene["name"])
+        result = benchmarkScene(scene, options, programs)
+        results["scenes"][scene["name"]] = result
+        if result["status"] != "ok":
+            failed.append(scene["name"])
+            sys.stderr.write("  %s\n" % result["status"])
+        else:
+            sys.stderr.write("  %.2fs\n" % result["wall_time"])
+
+    text = json.dumps(results, indent=2, sort_keys=True)
+    if options.json:
+        out = open(options.json, "w")
+        out.write(text + "\n")
+        out.close()
+    else:
+        print(text)
+
+    if options.baseline:
+        baseline = json.load(open(options.baseline))
+        failed += compareTimings(results, baseline, options.max_slowdown)
+
+    if failed:
+        sys.stderr.write("Failed: %s\n" % ", ".join(failed))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
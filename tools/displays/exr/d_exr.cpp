@@ -92,6 +92,25 @@
 //      See function DspyImageOpen(), below, for a list of valid
 //      "exrpixeltype" and "exrcompression" values.
 //
+//      Images are written as tiled files, with tiles the size of the
+//      renderer's buckets.  Finished tiles are written as soon as they
+//      complete a row or column of tiles, or once a row or column's worth
+//      are waiting, so only a few tiles are held in memory whatever the
+//      bucket order.  OpenEXR compresses the tiles written together in
+//      parallel, using one thread per processor by default.  The number of threads
+//      can be set with an "exrthreads" argument; zero compresses on the
+//      renderer's thread:
+//
+//          Declare "exrthreads" "integer"
+//          Display "gnome.rgba.exr" "exr" "rgba" "exrthreads" 4
+//
+//      Several Display requests for the same file name are written as
+//      layers of a single file, named by the "layername" argument, so any
+//      number of arbitrary output variables can share one file:
+//
+//          Display "gnome.exr" "exr" "rgba" "layername" "beauty"
+//          Display "+gnome.exr" "exr" "N" "layername" "normal"
+//
 //-----------------------------------------------------------------------------
 
 #include <aqsis/aqsis.h>
@@ -99,12 +118,15 @@
 #include <assert.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
 
 // Lower the warning level to eliminate unavoidable warnings from the OpenEXR headers.
 #if AQSIS_SYSTEM_WIN32 && (defined(AQSIS_COMPILER_MSVC6) || defined(AQSIS_COMPILER_MSVC7))
 #	pragma warning(push,1)
 #endif
-#include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/OpenEXRConfig.h>
+#include <OpenEXR/ImfTiledOutputFile.h>
+#include <OpenEXR/ImfThreading.h>
 #include <OpenEXR/ImfChannelList.h>
 #include <OpenEXR/ImfIntAttribute.h>
 #include <OpenEXR/ImfFloatAttribute.h>
@@ -123,6 +145,12 @@
 #	pragma warning(pop)
 #endif
 
+// DWA compression was added in OpenEXR 2.2
+#if defined(OPENEXR_VERSION_MAJOR) && \
+	(OPENEXR_VERSION_MAJOR > 2 || (OPENEXR_VERSION_MAJOR == 2 && OPENEXR_VERSION_MINOR >= 2))
+#	define AQSIS_EXR_HAVE_DWA 1
+#endif
+
 #include <string>
 #include <map>
 #include <vector>
@@ -172,6 +200,22 @@ struct SqImageLayer
 };
 typedef std::map<std::string, SqImageLayer> LayerList;
 
+// A tile which has been partly filled by the layers of an image.
+struct SqTile
+{
+	SqTile() : pixelsRemaining(0) {}
+	std::vector<char>	data;
+	int					pixelsRemaining;
+};
+
+// Progress of each tile of an image.
+enum EqTileState
+{
+	Tile_Empty,		// Waiting for pixels.
+	Tile_Finished,	// Filled by all layers, waiting to be written.
+	Tile_Written
+};
+
 
 #include "dspyhlpr.h"
 
@@ -195,17 +239,31 @@ class Image
 										 std::string layerName);
 		void				addLayer(SqImageLayer& layer);
 		void				open();
+		void				finish();
 	private:
-
-		boost::shared_ptr<OutputFile>          _file;
+		void				copyPixels (const SqImageLayer& layer,
+		                                const unsigned char *from, char *to,
+		                                int numPixels, int entrySize);
+		EqTileState&		tileState (int tx, int ty);
+		void				tileFinished (int tx, int ty);
+		void				writeFinishedRuns (int tx0, int tx1, int ty0, int ty1);
+		void				writeTiles (int tx0, int tx1, int ty0, int ty1);
+
+		boost::shared_ptr<TiledOutputFile>	_file;
 		std::string			_fileName;
 		Header				_header;
-		Array <char>        _buffer;
-		std::map<int, std::vector<char> >	_scanlines;
-		std::map<int, int >	_scanlinesReceived;
+		// Tiles which have pixels but haven't been written yet, by index.
+		std::map<int, SqTile>	_tiles;
+		std::vector<EqTileState>	_tileStates;
+		int					_tilesFinished;
+		// All channels of all layers, with their full names.
+		LayerChannelList	_slices;
 		int                 _bufferPixelSize;
-		int                 _bufferXMin;
-		int                 _bufferNumPixels;
+		int                 _tileWidth;
+		int                 _tileHeight;
+		int                 _tilesAcross;
+		int                 _tilesDown;
+		int                 _layerCount;
 		LayerList			_layers;
 };
 
@@ -224,9 +282,13 @@ Image::Image (const char filename[],
 		:
 		_fileName (filename),
 		_header (header),
+		_tilesFinished (0),
 		_bufferPixelSize (0),
-		_bufferXMin (header.dataWindow().min.x),
-		_bufferNumPixels (header.dataWindow().max.x - _bufferXMin + 1)
+		_tileWidth (header.tileDescription().xSize),
+		_tileHeight (header.tileDescription().ySize),
+		_tilesAcross (0),
+		_tilesDown (0),
+		_layerCount (0)
 {}
 
 
@@ -283,76 +345,159 @@ const LayerList& Image::layers() const
 
 void Image::open()
 {
-	V2i dwSize = _header.dataWindow().size();
-
-	_buffer.resizeErase (_bufferNumPixels * _bufferPixelSize);
-
-	FrameBuffer  fb;
-	int          yStride = 0;
-	char        *base = &_buffer[0] -
-	                    _bufferXMin * _bufferPixelSize;
-
-
+	// The layers are all known by now; note their channels, as the layers
+	// are removed from the image as they are closed.
 	for(LayerList::iterator layer = _layers.begin(), layerEnd = _layers.end(); layer != layerEnd; ++layer)
 	{
 		for(LayerChannelList::iterator chan = layer->second.channelList.begin(), chanEnd = layer->second.channelList.end(); chan != chanEnd; ++chan)
 		{
-			fb.insert((layer->second.layerName+"."+chan->channelName).c_str(),
-				Slice(chan->channel.type,
-				base + chan->bufferOffset,
-				_bufferPixelSize,
-				yStride,
-				1,
-				1));
+			_slices.push_back(*chan);
+			_slices.back().channelName = layer->second.layerName+"."+chan->channelName;
 		}
 	}
+	_layerCount = _layers.size();
 
-	_file = boost::shared_ptr<OutputFile>(new OutputFile(_fileName.c_str(), _header));
-	_file->setFrameBuffer (fb);
+	V2i dwSize = _header.dataWindow().size();
+	_tilesAcross = (dwSize.x + _tileWidth) / _tileWidth;
+	_tilesDown = (dwSize.y + _tileHeight) / _tileHeight;
+	_tileStates.assign(_tilesAcross * _tilesDown, Tile_Empty);
+
+	_file = boost::shared_ptr<TiledOutputFile>(new TiledOutputFile(_fileName.c_str(), _header));
 }
 
-void
-Image::writePixels (int xMin, int xMaxPlusone,
-                    int yMin, int yMaxPlusone,
-                    int entrySize,
-                    const unsigned char *data,
-					std::string layerName)
+EqTileState&
+Image::tileState (int tx, int ty)
 {
-	// If the image isn't open yet, open it now, the
-	// channel setup must be complete by the time the
-	// first data is written.
-	if(!_file)
-		open();
+	return _tileStates[ty * _tilesAcross + tx];
+}
 
+void
+Image::writeTiles (int tx0, int tx1, int ty0, int ty1)
+{
 	//
-	// We can only deal with one scan line at a time.
+	// Gather a rectangle of tiles into one buffer, and point a frame buffer
+	// at it so that its first pixel lies where OpenEXR expects it.  Writing
+	// the tiles together lets OpenEXR compress them in parallel.  Tiles
+	// without any pixels are written blank.
 	//
 
-	assert (yMin == yMaxPlusone - 1);
+	const Box2i &dw = _header.dataWindow();
+	int tileLineLength = _tileWidth * _bufferPixelSize;
+	int yStride = (tx1 - tx0 + 1) * tileLineLength;
+	std::vector<char> data (yStride * (ty1 - ty0 + 1) * _tileHeight);
+	for(int ty = ty0; ty <= ty1; ++ty)
+	{
+		for(int tx = tx0; tx <= tx1; ++tx)
+		{
+			std::map<int, SqTile>::iterator tile = _tiles.find(ty * _tilesAcross + tx);
+			if(tile != _tiles.end())
+			{
+				char *to = &data[(ty - ty0) * _tileHeight * yStride + (tx - tx0) * tileLineLength];
+				for(int y = 0; y < _tileHeight; ++y)
+					memcpy(to + y * yStride, &tile->second.data[y * tileLineLength], tileLineLength);
+				_tiles.erase(tile);
+			}
+			if(tileState(tx, ty) == Tile_Finished)
+				--_tilesFinished;
+			tileState(tx, ty) = Tile_Written;
+		}
+	}
 
+	char *base = &data[0] -
+	             (dw.min.x + tx0 * _tileWidth) * _bufferPixelSize -
+	             (dw.min.y + ty0 * _tileHeight) * yStride;
 
-	int      numPixels = xMaxPlusone - xMin;
-	int      j = 0;
+	FrameBuffer  fb;
+	for(LayerChannelList::iterator slice = _slices.begin(), sliceEnd = _slices.end(); slice != sliceEnd; ++slice)
+	{
+		fb.insert(slice->channelName.c_str(),
+			Slice(slice->channel.type,
+			base + slice->bufferOffset,
+			_bufferPixelSize,
+			yStride,
+			1,
+			1));
+	}
 
-	char    *toBase;
-	int      toInc;
+	_file->setFrameBuffer (fb);
+	_file->writeTiles (tx0, tx1, ty0, ty1);
+}
 
+void
+Image::writeFinishedRuns (int tx0, int tx1, int ty0, int ty1)
+{
+	// Write each run of finished tiles in a row or column of tiles.
+	int dx = tx0 == tx1 ? 0 : 1;
+	int dy = 1 - dx;
+	int runStart = -1;
+	for(int i = 0, n = dx ? tx1 - tx0 + 1 : ty1 - ty0 + 1; i <= n; ++i)
+	{
+		bool finished = i < n && tileState(tx0 + i*dx, ty0 + i*dy) == Tile_Finished;
+		if(finished && runStart < 0)
+			runStart = i;
+		else if(!finished && runStart >= 0)
+		{
+			writeTiles(tx0 + runStart*dx, tx0 + (i - 1)*dx,
+			           ty0 + runStart*dy, ty0 + (i - 1)*dy);
+			runStart = -1;
+		}
+	}
+}
+
+void
+Image::tileFinished (int tx, int ty)
+{
 	//
-	// Copy the pixels into our internal scanline array, collating multiple layers
-	// before copying to the fb and then to the file.
+	// Write the tile along with its row or column once all of that row or
+	// column is finished, so that row and column bucket orders both write
+	// whole runs at a time.  A tile which only completes a row or column
+	// by itself waits for its other row or column, or is written in runs
+	// along rows when too many tiles are waiting.
 	//
 
-	// If there is no scanline for this y position, allocate one now.
-	if(_scanlines.find(yMin) == _scanlines.end())
+	tileState(tx, ty) = Tile_Finished;
+	++_tilesFinished;
+
+	int rowFinished = 0;
+	bool rowDone = true;
+	for(int x = 0; rowDone && x < _tilesAcross; ++x)
+	{
+		rowDone = tileState(x, ty) != Tile_Empty;
+		rowFinished += tileState(x, ty) == Tile_Finished;
+	}
+	if(rowDone && (rowFinished > 1 || _tilesAcross == 1))
+	{
+		writeFinishedRuns(0, _tilesAcross - 1, ty, ty);
+		return;
+	}
+	int columnFinished = 0;
+	bool columnDone = true;
+	for(int y = 0; columnDone && y < _tilesDown; ++y)
+	{
+		columnDone = tileState(tx, y) != Tile_Empty;
+		columnFinished += tileState(tx, y) == Tile_Finished;
+	}
+	if(columnDone && (columnFinished > 1 || _tilesDown == 1))
 	{
-		_scanlines[yMin].resize (_bufferNumPixels * _bufferPixelSize);
-		_scanlinesReceived[yMin] = 0;
+		writeFinishedRuns(tx, tx, 0, _tilesDown - 1);
+		return;
 	}
+	if(_tilesFinished >= std::max(_tilesAcross, _tilesDown))
+	{
+		for(int y = 0; _tilesFinished > 0 && y < _tilesDown; ++y)
+			writeFinishedRuns(0, _tilesAcross - 1, y, y);
+	}
+}
 
-	toBase = &(_scanlines[yMin][0]) + _bufferPixelSize * xMin;
-	toInc = _bufferPixelSize;
+void
+Image::copyPixels (const SqImageLayer& layer,
+                   const unsigned char *data, char *toBase,
+                   int numPixels, int entrySize)
+{
+	int      j = 0;
+	int      toInc = _bufferPixelSize;
 
-	for(LayerChannelList::iterator i = layers()[layerName].channelList.begin(), e = layers()[layerName].channelList.end(); i != e; ++i)
+	for(LayerChannelList::const_iterator i = layer.channelList.begin(), e = layer.channelList.end(); i != e; ++i)
 	{
 		const unsigned char *from = data + i->dataOffset;
 		const unsigned char *end  = from + numPixels * entrySize;
@@ -363,7 +508,7 @@ Image::writePixels (int xMin, int xMaxPlusone,
 		{
 				case HALF:
 				{
-					halfFunction <half> &lut = *layers()[layerName].channelLuts[j];
+					halfFunction <half> &lut = *layer.channelLuts[j];
 
 					while (from < end)
 					{
@@ -394,24 +539,113 @@ Image::writePixels (int xMin, int xMaxPlusone,
 
 		++j;
 	}
+}
 
+void
+Image::writePixels (int xMin, int xMaxPlusone,
+                    int yMin, int yMaxPlusone,
+                    int entrySize,
+                    const unsigned char *data,
+					std::string layerName)
+{
+	// If the image isn't open yet, open it now, the
+	// channel setup must be complete by the time the
+	// first data is written.
+	if(!_file)
+		open();
+
+	const Box2i &dw = _header.dataWindow();
+	int x0 = std::max(xMin, dw.min.x);
+	int x1 = std::min(xMaxPlusone, dw.max.x + 1);
+	int y0 = std::max(yMin, dw.min.y);
+	int y1 = std::min(yMaxPlusone, dw.max.y + 1);
+	if(x0 >= x1 || y0 >= y1)
+		return;
 
-	_scanlinesReceived[yMin] += numPixels;
+	const SqImageLayer& layer = layers()[layerName];
+	int bucketLineLength = (xMaxPlusone - xMin) * entrySize;
+
+	//
+	// Copy the pixels into the tiles they cover, collating multiple layers
+	// before writing each tile to the file.  A tile is finished once all
+	// layers have filled it, so the buckets may arrive in any order.
+	//
 
-	if(_scanlinesReceived[yMin] == _bufferNumPixels*static_cast<int>(layers().size()))
+	std::vector<int> finished;
+	for(int ty = (y0 - dw.min.y) / _tileHeight; ty <= (y1 - 1 - dw.min.y) / _tileHeight; ++ty)
 	{
-		//
-		// If our one-line frame buffer is full, then write it to
-		// the output file.
-		//
-		for(int i = 0; i < (_bufferNumPixels * _bufferPixelSize); ++i)
-			_buffer[i] = _scanlines[yMin][i];
+		int tileYMin = dw.min.y + ty * _tileHeight;
+		int cy0 = std::max(y0, tileYMin);
+		int cy1 = std::min(y1, tileYMin + _tileHeight);
+		for(int tx = (x0 - dw.min.x) / _tileWidth; tx <= (x1 - 1 - dw.min.x) / _tileWidth; ++tx)
+		{
+			if(tileState(tx, ty) != Tile_Empty)
+				continue;
+
+			int tileXMin = dw.min.x + tx * _tileWidth;
+			int cx0 = std::max(x0, tileXMin);
+			int cx1 = std::min(x1, tileXMin + _tileWidth);
+
+			// If there is no data for this tile yet, allocate it now.
+			SqTile& tile = _tiles[ty * _tilesAcross + tx];
+			if(tile.data.empty())
+			{
+				tile.data.resize (_tileWidth * _tileHeight * _bufferPixelSize);
+				tile.pixelsRemaining = _layerCount *
+					(std::min(tileXMin + _tileWidth, dw.max.x + 1) - tileXMin) *
+					(std::min(tileYMin + _tileHeight, dw.max.y + 1) - tileYMin);
+			}
 
-		_file->writePixels();
+			for(int y = cy0; y < cy1; ++y)
+			{
+				copyPixels(layer,
+					data + (y - yMin) * bucketLineLength + (cx0 - xMin) * entrySize,
+					&tile.data[((y - tileYMin) * _tileWidth + cx0 - tileXMin) * _bufferPixelSize],
+					cx1 - cx0, entrySize);
+			}
+			tile.pixelsRemaining -= (cx1 - cx0) * (cy1 - cy0);
 
-		_scanlines.erase(yMin);
-		_scanlinesReceived.erase(yMin);
+			if(tile.pixelsRemaining <= 0)
+			{
+				finished.push_back(tx);
+				finished.push_back(ty);
+			}
+		}
 	}
+	for(int i = 0, n = finished.size(); i < n; i += 2)
+	{
+		if(tileState(finished[i], finished[i+1]) == Tile_Empty)
+			tileFinished(finished[i], finished[i+1]);
+	}
+}
+
+void
+Image::finish ()
+{
+	if(!_file)
+		open();
+
+	//
+	// Write out the tiles which weren't completed, a row at a time, so that
+	// the file is whole.
+	//
+
+	for(int ty = 0; ty < _tilesDown; ++ty)
+	{
+		int runStart = -1;
+		for(int tx = 0; tx <= _tilesAcross; ++tx)
+		{
+			bool pending = tx < _tilesAcross && tileState(tx, ty) != Tile_Written;
+			if(pending && runStart < 0)
+				runStart = tx;
+			else if(!pending && runStart >= 0)
+			{
+				writeTiles(runStart, tx - 1, ty, ty);
+				runStart = -1;
+			}
+		}
+	}
+	_tiles.clear();
 }
 
 
@@ -456,7 +690,6 @@ extern "C"
 			if(gImages.find(filename) != gImages.end())
 			{
 				image = gImages.find(filename);
-				flagstuff->flags |= PkDspyFlagsWantsScanLineOrder;
 			}
 			else
 			{
@@ -556,11 +789,23 @@ extern "C"
 				}
 
 				//
-				// Line order
+				// Tiles, matched to the renderer's buckets so that each
+				// bucket completes the tiles it covers, and they can be
+				// written in whatever order the buckets finish.
 				//
 
-				header.lineOrder() = INCREASING_Y;
-				flagstuff->flags |= PkDspyFlagsWantsScanLineOrder;
+				{
+					int bucketSize[2] = { 16, 16 };
+					int n = 2;
+
+					DspyFindIntsInParamList ("BucketSize", &n, bucketSize,
+											 paramCount, parameters);
+
+					header.setTileDescription (TileDescription (
+						std::max (bucketSize[0], 1), std::max (bucketSize[1], 1),
+						ONE_LEVEL));
+					header.lineOrder() = RANDOM_Y;
+				}
 
 				//
 				// Compression
@@ -584,6 +829,12 @@ extern "C"
 							header.compression() = ZIP_COMPRESSION;
 						else if (!strcmp (comp, "piz"))
 							header.compression() = PIZ_COMPRESSION;
+#ifdef AQSIS_EXR_HAVE_DWA
+						else if (!strcmp (comp, "dwaa"))
+							header.compression() = DWAA_COMPRESSION;
+						else if (!strcmp (comp, "dwab"))
+							header.compression() = DWAB_COMPRESSION;
+#endif
 
 						else if (!strcmp (comp, "piz12"))
 						{
@@ -620,6 +871,21 @@ extern "C"
 					}
 				}
 
+				//
+				// Compression threads; these are shared by all files, and
+				// must be set before the file is created.
+				//
+
+				{
+					int threads = boost::thread::hardware_concurrency();
+
+					DspyFindIntInParamList ("exrthreads", &threads,
+											paramCount, parameters);
+
+					if (threads != globalThreadCount())
+						setGlobalThreadCount (std::max (threads, 0));
+				}
+
 				Image *newImage = new Image (filename, header);
 				gImages[filename] = boost::shared_ptr<Image>(newImage);
 			}
@@ -776,6 +1042,8 @@ extern "C"
 			if(gImages.find(imageName) != gImages.end())
 			{
 				boost::shared_ptr<Image> image = gImages[imageName];
+				if(image->layers().size() == 1)
+					image->finish();
 				image->layers().erase(gImageLayers[imageLayerIndex].second);
 				if(image->layers().size() == 0)
 					gImages.erase(imageName);
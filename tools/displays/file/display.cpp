@@ -28,11 +28,13 @@
 #include <iostream>
 #include <iomanip>
 #include <ios>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <fstream>
 #include <algorithm>
+#include <vector>
 #include <float.h>
 #include <time.h>
 #include <cstring>
@@ -60,6 +62,15 @@ enum EqDisplayTypes
     Type_Shadowmap,
 };
 
+/// A tile of a tiled image which has been partly filled by buckets.
+struct SqPendingTile
+{
+	SqPendingTile() : data(), pixelsRemaining(0)
+	{}
+	std::vector<TqUchar>	data;
+	TqInt		pixelsRemaining;
+};
+
 struct SqDisplayInstance
 {
 	SqDisplayInstance() :
@@ -76,7 +87,12 @@ struct SqDisplayInstance
 			m_imageType(Type_File),
 			m_append(0),
 			m_pixelsReceived(0),
-			m_data(0)
+			m_data(0),
+			m_tiff(0),
+			m_tileWidth(0),
+			m_tileHeight(0),
+			m_pendingTiles(),
+			m_tileWritten()
 	{}
 	std::string	m_filename;
 	TqInt		m_width;
@@ -96,7 +112,15 @@ struct SqDisplayInstance
 	TqFloat		m_matWorldToScreen[ 4 ][ 4 ];
 	// The number of pixels that have already been rendered (used for progress reporting)
 	TqInt		m_pixelsReceived;
+	// Whole image buffer, for the zfile and shadow map types.
 	void*		m_data;
+	// Tiled TIFF file for the file type, which is written a tile at a time
+	// as buckets arrive, so that the whole image is never held in memory.
+	TIFF*		m_tiff;
+	TqInt		m_tileWidth;
+	TqInt		m_tileHeight;
+	std::map<TqInt, SqPendingTile>	m_pendingTiles;
+	std::vector<bool>	m_tileWritten;
 };
 //------------------------------------------------------------------------------
 
@@ -220,16 +244,13 @@ void SaveAsShadowMap(const std::string& filename, SqDisplayInstance* image, char
 }
 
 //----------------------------------------------------------------------
-/** WriteTIFF() Save as a tiff the output of the renderer
-*
+/** DescribeImage() Fill in the date and description of an image which is
+*  being saved now.
 */
 
-void WriteTIFF(const std::string& filename, SqDisplayInstance* image)
+void DescribeImage(char* mydescription)
 {
-	uint16 photometric = PHOTOMETRIC_RGB;
-	uint16 config = PLANARCONFIG_CONTIG;
 	struct tm *ct;
-	char mydescription[80];
 	int year;
 
 	time_t long_time;
@@ -252,9 +273,18 @@ void WriteTIFF(const std::string& filename, SqDisplayInstance* image)
 	{
 		strcpy(mydescription, description.c_str());
 	}
+}
 
+//----------------------------------------------------------------------
+/** WriteTIFF() Save the zfile or shadowmap output of the renderer
+*
+*/
+
+void WriteTIFF(const std::string& filename, SqDisplayInstance* image)
+{
+	char mydescription[80];
+	DescribeImage(mydescription);
 
-	// Set common tags
 	// If in "shadowmap" mode, write as a shadowmap.
 	if( image->m_imageType == Type_Shadowmap )
 	{
@@ -290,126 +320,213 @@ void WriteTIFF(const std::string& filename, SqDisplayInstance* image)
 		}
 		return;
 	}
+}
+
+//----------------------------------------------------------------------
+/** OpenTiledTIFF() Open the tiled tiff file for the output of the renderer,
+*  ready for the buckets to be written as they arrive.
+*
+*/
 
-	TIFF* pOut = TIFFOpen( filename.c_str(), "w" );
+bool OpenTiledTIFF(const std::string& filename, SqDisplayInstance* image)
+{
+	image->m_tiff = TIFFOpen( filename.c_str(), "w" );
+	TIFF* pOut = image->m_tiff;
+	if ( !pOut )
+		return false;
 
-	if ( pOut )
+	uint16 photometric = PHOTOMETRIC_RGB;
+	uint16 config = PLANARCONFIG_CONTIG;
+	char version[ 80 ];
+
+	short ExtraSamplesTypes[ 1 ] = {EXTRASAMPLE_ASSOCALPHA};
+
+	sprintf( version, "Aqsis %s (%s %s)", AQSIS_VERSION_STR, __DATE__, __TIME__);
+	bool use_logluv = false;
+
+	TIFFSetField( pOut, TIFFTAG_SOFTWARE, ( char* ) version );
+	TIFFSetField( pOut, TIFFTAG_IMAGEWIDTH, ( uint32 ) image->m_width );
+	TIFFSetField( pOut, TIFFTAG_IMAGELENGTH, ( uint32 ) image->m_height );
+	TIFFSetField( pOut, TIFFTAG_RESOLUTIONUNIT, RESUNIT_NONE );
+	TIFFSetField( pOut, TIFFTAG_XRESOLUTION, (float) 1.0 );
+	TIFFSetField( pOut, TIFFTAG_YRESOLUTION, (float) 1.0 );
+	TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, (short) 8 );
+	TIFFSetField( pOut, TIFFTAG_PIXAR_MATRIX_WORLDTOCAMERA, image->m_matWorldToCamera );
+	TIFFSetField( pOut, TIFFTAG_PIXAR_MATRIX_WORLDTOSCREEN, image->m_matWorldToScreen );
+	TIFFSetField( pOut, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT );
+	TIFFSetField( pOut, TIFFTAG_SAMPLESPERPIXEL, image->m_iFormatCount );
+	TIFFSetField( pOut, TIFFTAG_TILEWIDTH, ( uint32 ) image->m_tileWidth );
+	TIFFSetField( pOut, TIFFTAG_TILELENGTH, ( uint32 ) image->m_tileHeight );
+	if (!image->m_hostname.empty())
+		TIFFSetField( pOut, TIFFTAG_HOSTCOMPUTER, image->m_hostname.c_str() );
+
+	// Set the position tages in case we aer dealing with a cropped image.
+	TIFFSetField( pOut, TIFFTAG_XPOSITION, ( float ) image->m_origin[0] );
+	TIFFSetField( pOut, TIFFTAG_YPOSITION, ( float ) image->m_origin[1] );
+	TIFFSetField( pOut, TIFFTAG_PIXAR_IMAGEFULLWIDTH, (uint32) image->m_OriginalSize[0] );
+	TIFFSetField( pOut, TIFFTAG_PIXAR_IMAGEFULLLENGTH, (uint32) image->m_OriginalSize[1] );
+
+	// Write out an 8 bits per pixel integer image.
+	if ( image->m_format == PkDspyUnsigned8 )
 	{
-		// Write the image to a tiff file.
-		char version[ 80 ];
-
-		short ExtraSamplesTypes[ 1 ] = {EXTRASAMPLE_ASSOCALPHA};
-
-		sprintf( version, "Aqsis %s (%s %s)", AQSIS_VERSION_STR, __DATE__, __TIME__);
-		bool use_logluv = false;
-
-		TIFFSetField( pOut, TIFFTAG_SOFTWARE, ( char* ) version );
-		TIFFSetField( pOut, TIFFTAG_IMAGEWIDTH, ( uint32 ) image->m_width );
-		TIFFSetField( pOut, TIFFTAG_IMAGELENGTH, ( uint32 ) image->m_height );
-		TIFFSetField( pOut, TIFFTAG_RESOLUTIONUNIT, RESUNIT_NONE );
-		TIFFSetField( pOut, TIFFTAG_XRESOLUTION, (float) 1.0 );
-		TIFFSetField( pOut, TIFFTAG_YRESOLUTION, (float) 1.0 );
-		TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, (short) 8 );
-		TIFFSetField( pOut, TIFFTAG_PIXAR_MATRIX_WORLDTOCAMERA, image->m_matWorldToCamera );
-		TIFFSetField( pOut, TIFFTAG_PIXAR_MATRIX_WORLDTOSCREEN, image->m_matWorldToScreen );
-		TIFFSetField( pOut, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT );
-		TIFFSetField( pOut, TIFFTAG_SAMPLESPERPIXEL, image->m_iFormatCount );
-		TIFFSetField( pOut, TIFFTAG_DATETIME, datetime);
-		if (!image->m_hostname.empty())
-			TIFFSetField( pOut, TIFFTAG_HOSTCOMPUTER, image->m_hostname.c_str() );
-		TIFFSetField( pOut, TIFFTAG_IMAGEDESCRIPTION, mydescription);
-
-		// Set the position tages in case we aer dealing with a cropped image.
-		TIFFSetField( pOut, TIFFTAG_XPOSITION, ( float ) image->m_origin[0] );
-		TIFFSetField( pOut, TIFFTAG_YPOSITION, ( float ) image->m_origin[1] );
-		TIFFSetField( pOut, TIFFTAG_PIXAR_IMAGEFULLWIDTH, (uint32) image->m_OriginalSize[0] );
-		TIFFSetField( pOut, TIFFTAG_PIXAR_IMAGEFULLLENGTH, (uint32) image->m_OriginalSize[1] );
-
-		// Write out an 8 bits per pixel integer image.
-		if ( image->m_format == PkDspyUnsigned8 )
+		TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 8 );
+		TIFFSetField( pOut, TIFFTAG_PLANARCONFIG, config );
+		TIFFSetField( pOut, TIFFTAG_COMPRESSION, image->m_compression );
+		if ( image->m_compression == COMPRESSION_JPEG )
+			TIFFSetField( pOut, TIFFTAG_JPEGQUALITY, image->m_quality );
+		TIFFSetField( pOut, TIFFTAG_PHOTOMETRIC, photometric );
+
+		if ( image->m_iFormatCount == 4 )
+			TIFFSetField( pOut, TIFFTAG_EXTRASAMPLES, 1, ExtraSamplesTypes );
+	}
+	else
+	{
+		// Write out a floating point image.
+		TIFFSetField( pOut, TIFFTAG_STONITS, ( double ) 1.0 );
+
+		//			if(/* user wants logluv compression*/)
+		//			{
+		//				if(/* user wants to save the alpha channel */)
+		//				{
+		//					warn("SGI LogLuv encoding does not allow an alpha channel"
+		//							" - using uncompressed IEEEFP instead");
+		//				}
+		//				else
+		//				{
+		//					use_logluv = true;
+		//				}
+		//
+		//				if(/* user wants LZW compression*/)
+		//				{
+		//					warn("LZW compression is not available with SGI LogLuv encoding\n");
+		//				}
+		//			}
+
+		if ( use_logluv )
+		{
+			/* use SGI LogLuv compression */
+			TIFFSetField( pOut, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT );
+			TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 16 );
+			TIFFSetField( pOut, TIFFTAG_COMPRESSION, COMPRESSION_SGILOG );
+			TIFFSetField( pOut, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_LOGLUV );
+			TIFFSetField( pOut, TIFFTAG_SGILOGDATAFMT, SGILOGDATAFMT_FLOAT );
+		}
+		else
 		{
-			TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 8 );
-			TIFFSetField( pOut, TIFFTAG_PLANARCONFIG, config );
+			/* use uncompressed IEEEFP pixels */
+			TIFFSetField( pOut, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP );
+			TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 32 );
+			TIFFSetField( pOut, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB );
 			TIFFSetField( pOut, TIFFTAG_COMPRESSION, image->m_compression );
-			if ( image->m_compression == COMPRESSION_JPEG )
-				TIFFSetField( pOut, TIFFTAG_JPEGQUALITY, image->m_quality );
-			TIFFSetField( pOut, TIFFTAG_PHOTOMETRIC, photometric );
-			TIFFSetField( pOut, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize( pOut, 0 ) );
+		}
+		if (image->m_format == PkDspyUnsigned16)
+		{
+			TIFFSetField( pOut, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT );
+			TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 16 );
+		}
 
-			if ( image->m_iFormatCount == 4 )
-				TIFFSetField( pOut, TIFFTAG_EXTRASAMPLES, 1, ExtraSamplesTypes );
+		TIFFSetField( pOut, TIFFTAG_SAMPLESPERPIXEL, image->m_iFormatCount );
 
-			TqInt row;
-			for ( row = 0; row < image->m_height; row++ )
-			{
-				if ( TIFFWriteScanline( pOut, reinterpret_cast<void*>(reinterpret_cast<char*>(image->m_data) + ( row * image->m_lineLength ))
-				                        , row, 0 ) < 0 )
-					break;
-			}
-			TIFFClose( pOut );
-		}
-		else
+		if ( image->m_iFormatCount == 4 )
+			TIFFSetField( pOut, TIFFTAG_EXTRASAMPLES, 1, ExtraSamplesTypes );
+		TIFFSetField( pOut, TIFFTAG_PLANARCONFIG, config );
+	}
+
+	TqInt tilesAcross = ( image->m_width + image->m_tileWidth - 1 ) / image->m_tileWidth;
+	TqInt tilesDown = ( image->m_height + image->m_tileHeight - 1 ) / image->m_tileHeight;
+	image->m_tileWritten.assign( tilesAcross * tilesDown, false );
+	return true;
+}
+
+//----------------------------------------------------------------------
+/** AddToTiles() Copy a region of a bucket into the tiles of the image,
+*  writing each tile to the file as soon as it is complete.
+*
+*  The region is given in image coordinates, with data pointing at its first
+*  pixel and rows of the bucket being bucketlinelen bytes apart.
+*/
+
+void AddToTiles(SqDisplayInstance* image, TqInt xmin, TqInt xmaxplus1,
+		TqInt ymin, TqInt ymaxplus1, const TqUchar* data, TqInt bucketlinelen)
+{
+	const TqInt tw = image->m_tileWidth;
+	const TqInt th = image->m_tileHeight;
+	const TqInt tilesAcross = ( image->m_width + tw - 1 ) / tw;
+	const TqInt entrySize = image->m_entrySize;
+	for ( TqInt ty = ymin / th; ty <= ( ymaxplus1 - 1 ) / th; ty++ )
+	{
+		for ( TqInt tx = xmin / tw; tx <= ( xmaxplus1 - 1 ) / tw; tx++ )
 		{
-			// Write out a floating point image.
-			TIFFSetField( pOut, TIFFTAG_STONITS, ( double ) 1.0 );
-
-			//			if(/* user wants logluv compression*/)
-			//			{
-			//				if(/* user wants to save the alpha channel */)
-			//				{
-			//					warn("SGI LogLuv encoding does not allow an alpha channel"
-			//							" - using uncompressed IEEEFP instead");
-			//				}
-			//				else
-			//				{
-			//					use_logluv = true;
-			//				}
-			//
-			//				if(/* user wants LZW compression*/)
-			//				{
-			//					warn("LZW compression is not available with SGI LogLuv encoding\n");
-			//				}
-			//			}
-
-			if ( use_logluv )
+			TqInt tile = ty * tilesAcross + tx;
+			// Pixels sent again after their tile has been written can't
+			// be stored; only interactive displays are sent overwrites.
+			if ( image->m_tileWritten[tile] )
+				continue;
+			SqPendingTile& pending = image->m_pendingTiles[tile];
+			if ( pending.data.empty() )
 			{
-				/* use SGI LogLuv compression */
-				TIFFSetField( pOut, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT );
-				TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 16 );
-				TIFFSetField( pOut, TIFFTAG_COMPRESSION, COMPRESSION_SGILOG );
-				TIFFSetField( pOut, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_LOGLUV );
-				TIFFSetField( pOut, TIFFTAG_SGILOGDATAFMT, SGILOGDATAFMT_FLOAT );
+				pending.data.resize( tw * th * entrySize, 0 );
+				pending.pixelsRemaining = ( min( ( tx + 1 ) * tw, image->m_width ) - tx * tw )
+					* ( min( ( ty + 1 ) * th, image->m_height ) - ty * th );
 			}
-			else
+			// Part of the region inside this tile.
+			TqInt x0 = max( xmin, tx * tw );
+			TqInt x1 = min( xmaxplus1, ( tx + 1 ) * tw );
+			TqInt y0 = max( ymin, ty * th );
+			TqInt y1 = min( ymaxplus1, ( ty + 1 ) * th );
+			for ( TqInt y = y0; y < y1; y++ )
 			{
-				/* use uncompressed IEEEFP pixels */
-				TIFFSetField( pOut, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP );
-				TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 32 );
-				TIFFSetField( pOut, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB );
-				TIFFSetField( pOut, TIFFTAG_COMPRESSION, image->m_compression );
+				memcpy( &pending.data[ ( ( y - ty * th ) * tw + ( x0 - tx * tw ) ) * entrySize ],
+				        data + ( y - ymin ) * bucketlinelen + ( x0 - xmin ) * entrySize,
+				        ( x1 - x0 ) * entrySize );
 			}
-			if (image->m_format == PkDspyUnsigned16)
+			pending.pixelsRemaining -= ( x1 - x0 ) * ( y1 - y0 );
+			if ( pending.pixelsRemaining <= 0 )
 			{
-				TIFFSetField( pOut, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT );
-				TIFFSetField( pOut, TIFFTAG_BITSPERSAMPLE, 16 );
+				TIFFWriteTile( image->m_tiff, &pending.data[0], tx * tw, ty * th, 0, 0 );
+				image->m_tileWritten[tile] = true;
+				image->m_pendingTiles.erase( tile );
 			}
+		}
+	}
+}
 
-			TIFFSetField( pOut, TIFFTAG_SAMPLESPERPIXEL, image->m_iFormatCount );
-
-			if ( image->m_iFormatCount == 4 )
-				TIFFSetField( pOut, TIFFTAG_EXTRASAMPLES, 1, ExtraSamplesTypes );
-			TIFFSetField( pOut, TIFFTAG_PLANARCONFIG, config );
+//----------------------------------------------------------------------
+/** CloseTiledTIFF() Finish the tiled tiff file, filling in any tiles which
+*  the renderer didn't complete.
+*
+*/
 
-			TqInt row = 0;
-			for ( row = 0; row < image->m_height; row++ )
-			{
-				if ( TIFFWriteScanline( pOut, reinterpret_cast<void*>(reinterpret_cast<TqUchar*>(image->m_data) + ( row * image->m_lineLength )), row, 0 )
-				        < 0 )
-					break;
-			}
-			TIFFClose( pOut );
+void CloseTiledTIFF(SqDisplayInstance* image)
+{
+	const TqInt tilesAcross = ( image->m_width + image->m_tileWidth - 1 ) / image->m_tileWidth;
+	std::vector<TqUchar> blankTile;
+	for ( TqInt tile = 0, ntiles = image->m_tileWritten.size(); tile < ntiles; tile++ )
+	{
+		if ( image->m_tileWritten[tile] )
+			continue;
+		std::map<TqInt, SqPendingTile>::iterator pending = image->m_pendingTiles.find( tile );
+		TqUchar* tileData = 0;
+		if ( pending != image->m_pendingTiles.end() )
+			tileData = &pending->second.data[0];
+		else
+		{
+			if ( blankTile.empty() )
+				blankTile.resize( image->m_tileWidth * image->m_tileHeight * image->m_entrySize, 0 );
+			tileData = &blankTile[0];
 		}
+		TIFFWriteTile( image->m_tiff, tileData, ( tile % tilesAcross ) * image->m_tileWidth,
+		               ( tile / tilesAcross ) * image->m_tileHeight, 0, 0 );
 	}
+	image->m_pendingTiles.clear();
+
+	// The date and description are only known now.
+	char mydescription[80];
+	DescribeImage(mydescription);
+	TIFFSetField( image->m_tiff, TIFFTAG_DATETIME, datetime );
+	TIFFSetField( image->m_tiff, TIFFTAG_IMAGEDESCRIPTION, mydescription );
+	TIFFClose( image->m_tiff );
+	image->m_tiff = 0;
 }
 
 } // unnamed namespace
@@ -491,27 +608,19 @@ extern "C" PtDspyError DspyImageOpen(PtDspyImageHandle * image,
 
 		// Determine the appropriate format to save into.
 		if(widestFormat == PkDspyUnsigned8)
-		{
-			pImage->m_data = malloc( pImage->m_width * pImage->m_height * pImage->m_iFormatCount * sizeof(PtDspyUnsigned8));
 			pImage->m_entrySize = pImage->m_iFormatCount * sizeof(PtDspyUnsigned8);
-		}
 		else if(widestFormat == PkDspyUnsigned16)
-		{
-			pImage->m_data = malloc( pImage->m_width * pImage->m_height * pImage->m_iFormatCount * sizeof(PtDspyUnsigned16));
 			pImage->m_entrySize = pImage->m_iFormatCount * sizeof(PtDspyUnsigned16);
-		}
 		else if(widestFormat == PkDspyUnsigned32)
-		{
-			pImage->m_data = malloc( pImage->m_width * pImage->m_height * pImage->m_iFormatCount * sizeof(PtDspyUnsigned32));
 			pImage->m_entrySize = pImage->m_iFormatCount * sizeof(PtDspyUnsigned32);
-		}
 		else if(widestFormat == PkDspyFloat32)
-		{
-			pImage->m_data = malloc( pImage->m_width * pImage->m_height * pImage->m_iFormatCount * sizeof(PtDspyFloat32));
 			pImage->m_entrySize = pImage->m_iFormatCount * sizeof(PtDspyFloat32);
-		}
 		pImage->m_lineLength = pImage->m_entrySize * pImage->m_width;
 		pImage->m_format = widestFormat;
+		// Plain images are written to a tiled file as the buckets arrive, the
+		// others need the whole image when they're saved.
+		if(pImage->m_imageType != Type_File)
+			pImage->m_data = malloc( pImage->m_lineLength * pImage->m_height );
 
 		// Extract any important data from the user parameters.
 		char* compression;
@@ -567,6 +676,19 @@ extern "C" PtDspyError DspyImageOpen(PtDspyImageHandle * image,
 			if (ydesc && *ydesc)
 				description = ydesc;
 		}
+
+		if(pImage->m_imageType == Type_File)
+		{
+			// Match the tiles to the buckets, so that each bucket completes
+			// its tiles.  TIFF needs tile sizes to be multiples of 16.
+			TqInt bucketSize[2] = { 16, 16 };
+			count = 2;
+			DspyFindIntsInParamList("BucketSize", &count, bucketSize, paramCount, parameters);
+			pImage->m_tileWidth = max(16, (bucketSize[0] + 15) / 16 * 16);
+			pImage->m_tileHeight = max(16, (bucketSize[1] + 15) / 16 * 16);
+			if(!OpenTiledTIFF(pImage->m_filename, pImage))
+				return(PkDspyErrorUndefined);
+		}
 	}
 	else
 		return(PkDspyErrorNoMemory);
@@ -609,7 +731,11 @@ extern "C" PtDspyError DspyImageData(PtDspyImageHandle image,
 	const TqUchar* pdatarow = data;
 	pdatarow += (row * bucketlinelen) + (col * entrysize);
 
-	if( pImage && data && xmin__ >= 0 && ymin__ >= 0 && xmaxplus1__ <= pImage->m_width && ymaxplus1__ <= pImage->m_height )
+	if( pImage && pImage->m_tiff && data && xmin__ < xmaxplus1__ && ymin__ < ymaxplus1__ )
+	{
+		AddToTiles(pImage, xmin__, xmaxplus1__, ymin__, ymaxplus1__, pdatarow, bucketlinelen);
+	}
+	else if( pImage && pImage->m_data && data && xmin__ >= 0 && ymin__ >= 0 && xmaxplus1__ <= pImage->m_width && ymaxplus1__ <= pImage->m_height )
 	{
 		for (TqInt y = ymin__; y < ymaxplus1__; y++ )
 		{
@@ -629,8 +755,9 @@ extern "C" PtDspyError DspyImageClose(PtDspyImageHandle image)
 	pImage = reinterpret_cast<SqDisplayInstance*>(image);
 
 	// Write the image to disk
-	if( pImage->m_imageType == Type_File ||
-	        pImage->m_imageType == Type_ZFile ||
+	if( pImage->m_tiff )
+		CloseTiledTIFF( pImage );
+	else if( pImage->m_imageType == Type_ZFile ||
 	        pImage->m_imageType == Type_Shadowmap )
 		WriteTIFF( pImage->m_filename, pImage);
 
@@ -650,7 +777,7 @@ extern "C" PtDspyError DspyImageDelayClose(PtDspyImageHandle image)
 	SqDisplayInstance* pImage;
 	pImage = reinterpret_cast<SqDisplayInstance*>(image);
 
-	if(pImage && pImage->m_data)
+	if(pImage && (pImage->m_data || pImage->m_tiff))
 		return DspyImageClose(image);
 	return(PkDspyErrorNone);
 }
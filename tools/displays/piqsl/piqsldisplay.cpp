@@ -21,12 +21,16 @@
 /** \file
 		\brief A display device that communicates with a separate process
 			using sockets and XML based data packets.
+
+		Bucket data is sent as binary packets instead where piqsl
+		supports them.
 		\author Paul C. Gregory (pgregory@aqsis.org)
 */
 
 #include <aqsis/aqsis.h>
 
 #include <cstring>
+#include <deque>
 #include <sstream>
 #include <string>
 #include <algorithm>
@@ -36,7 +40,12 @@
 #include <boost/archive/iterators/base64_from_binary.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
 #include <boost/archive/iterators/insert_linebreaks.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #ifdef AQSIS_SYSTEM_WIN32
 	#include <winsock2.h>
@@ -57,6 +66,7 @@
 #endif
 
 #include <tinyxml.h>
+#include <zlib.h>
 
 #include <aqsis/ri/ndspy.h>
 #include "dspyhlpr.h"
@@ -65,9 +75,52 @@
 #include <aqsis/util/logging.h>
 #include <aqsis/util/logging_streambufs.h>
 #include <aqsis/math/math.h>
+#include "piqslprotocol.h"
 
 using namespace Aqsis;
 
+//------------------------------------------------------------------------------
+/** \brief Send binary bucket messages to piqsl from a background thread.
+ *
+ * Compressing and sending a bucket of float data can take as long as
+ * rendering it, so buckets are queued and sent while the renderer carries
+ * on.  The queue is bounded so that a slow connection holds up the renderer
+ * rather than accumulating every bucket of the image in memory.
+ */
+class CqPiqslSender : boost::noncopyable
+{
+	public:
+		CqPiqslSender(CqSocket& socket, EqPiqslCompression compression);
+		~CqPiqslSender();
+
+		/// Queue a copy of a bucket of pixel data to be sent.
+		void send(int xmin, int xmaxplus1, int ymin, int ymaxplus1,
+				int entrysize, const unsigned char* data);
+		/// Wait until all queued buckets have been sent, and stop the thread.
+		void finish();
+
+	private:
+		struct SqBucket
+		{
+			SqPiqslBucketHeader header;
+			std::vector<unsigned char> data;
+		};
+
+		void run();
+		std::string encode(SqBucket& bucket) const;
+
+		/// Maximum number of buckets waiting to be sent.
+		static const TqUint m_maxQueued = 16;
+
+		CqSocket& m_socket;
+		EqPiqslCompression m_compression;
+		std::deque<boost::shared_ptr<SqBucket> > m_queue;
+		bool m_finished;
+		boost::mutex m_mutex;
+		boost::condition_variable m_queueChanged;
+		boost::thread m_thread;
+};
+
 struct SqPiqslDisplayInstance
 {
 	std::string		m_filename;
@@ -76,6 +129,8 @@ struct SqPiqslDisplayInstance
 	CqSocket		m_socket;
 	// The number of pixels that have already been rendered (used for progress reporting)
 	TqInt		m_pixelsReceived;
+	// Sender for binary bucket messages, or null if piqsl only accepts XML.
+	boost::shared_ptr<CqPiqslSender> m_sender;
 
 	friend std::istream& operator >>(std::istream &is,struct SqPiqslDisplayInstance &obj);
 	friend std::ostream& operator <<(std::ostream &os,const struct SqPiqslDisplayInstance &obj);
@@ -106,6 +161,100 @@ g_mapTypeToName[name] = #name;
 std::map<std::string, TqInt>	g_mapNameToType;
 std::map<TqInt, std::string>	g_mapTypeToName;
 
+
+CqPiqslSender::CqPiqslSender(CqSocket& socket, EqPiqslCompression compression)
+	: m_socket(socket),
+	m_compression(compression),
+	m_queue(),
+	m_finished(false),
+	m_mutex(),
+	m_queueChanged(),
+	m_thread(boost::bind(&CqPiqslSender::run, this))
+{ }
+
+CqPiqslSender::~CqPiqslSender()
+{
+	finish();
+}
+
+void CqPiqslSender::send(int xmin, int xmaxplus1, int ymin, int ymaxplus1,
+		int entrysize, const unsigned char* data)
+{
+	boost::shared_ptr<SqBucket> bucket(new SqBucket());
+	SqPiqslBucketHeader& header = bucket->header;
+	header.magic = SqPiqslBucketHeader::magicNumber;
+	header.xmin = xmin;
+	header.xmaxplus1 = xmaxplus1;
+	header.ymin = ymin;
+	header.ymaxplus1 = ymaxplus1;
+	header.elementSize = entrysize;
+	header.rawSize = entrysize * (xmaxplus1 - xmin) * (ymaxplus1 - ymin);
+	bucket->data.assign(data, data + header.rawSize);
+
+	boost::mutex::scoped_lock lock(m_mutex);
+	while(m_queue.size() >= m_maxQueued)
+		m_queueChanged.wait(lock);
+	m_queue.push_back(bucket);
+	m_queueChanged.notify_all();
+}
+
+void CqPiqslSender::finish()
+{
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_finished = true;
+		m_queueChanged.notify_all();
+	}
+	if(m_thread.joinable())
+		m_thread.join();
+}
+
+void CqPiqslSender::run()
+{
+	while(true)
+	{
+		boost::shared_ptr<SqBucket> bucket;
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			while(m_queue.empty() && !m_finished)
+				m_queueChanged.wait(lock);
+			if(m_queue.empty())
+				return;
+			bucket = m_queue.front();
+			m_queue.pop_front();
+			m_queueChanged.notify_all();
+		}
+		m_socket.sendData(encode(*bucket));
+	}
+}
+
+/// Build the message for a bucket, compressing the data if that helps.
+std::string CqPiqslSender::encode(SqBucket& bucket) const
+{
+	SqPiqslBucketHeader& header = bucket.header;
+	const TqInt headerSize = SqPiqslBucketHeader::size;
+	std::string message(headerSize, '\0');
+	header.compression = PiqslCompression_None;
+	header.dataSize = header.rawSize;
+	if(m_compression == PiqslCompression_Zlib && !bucket.data.empty())
+	{
+		// Use the fastest compression level; the aim is to save time.
+		uLongf compressedSize = compressBound(header.rawSize);
+		std::vector<Bytef> compressed(compressedSize);
+		if(compress2(&compressed[0], &compressedSize, &bucket.data[0],
+				header.rawSize, 1) == Z_OK && compressedSize < header.rawSize)
+		{
+			header.compression = PiqslCompression_Zlib;
+			header.dataSize = compressedSize;
+			message.append(reinterpret_cast<const char*>(&compressed[0]), compressedSize);
+		}
+	}
+	if(header.compression == PiqslCompression_None && !bucket.data.empty())
+		message.append(reinterpret_cast<const char*>(&bucket.data[0]), header.rawSize);
+	header.write(&message[0]);
+	return message;
+}
+
 extern "C" PtDspyError DspyImageOpen(PtDspyImageHandle * image,
                           const char *drivername,
                           const char *filename,
@@ -162,6 +311,12 @@ extern "C" PtDspyError DspyImageOpen(PtDspyImageHandle * image,
 		else 
 			pImage->m_port = 49515;
 
+		// Compression of binary bucket data: "zlib" or "none".
+		std::string compression = "zlib";
+		char *compressionParam = NULL;
+		if( DspyFindStringInParamList("compression", &compressionParam, paramCount, parameters ) == PkDspyErrorNone )
+			compression = compressionParam;
+
 		// First, see if piqsl is running, by trying to connect to it.
 		CqSocket::initialiseSockets();
 		pImage->m_socket.connect(pImage->m_hostname, pImage->m_port);
@@ -375,6 +530,12 @@ extern "C" PtDspyError DspyImageOpen(PtDspyImageHandle * image,
 				formatsXML->LinkEndChild(formatv);
 			}
 			openMsgXML->LinkEndChild(formatsXML);
+
+			// Offer to send the bucket data as binary.
+			TiXmlElement* binaryXML = new TiXmlElement("BinaryData");
+			binaryXML->SetAttribute("compression", compression == "none" ? "none" : "zlib");
+			openMsgXML->LinkEndChild(binaryXML);
+
 			displaydoc.LinkEndChild(displaydecl);
 			displaydoc.LinkEndChild(openMsgXML);
 			sendXMLMessage(displaydoc, pImage->m_socket);
@@ -412,6 +573,14 @@ extern "C" PtDspyError DspyImageOpen(PtDspyImageHandle * image,
 				{
 					return(err);
 				}
+				// Versions of piqsl which don't understand binary data won't
+				// answer the offer, so we keep to XML.
+				if(const char* binary = child->Attribute("binary"))
+				{
+					pImage->m_sender.reset(new CqPiqslSender(pImage->m_socket,
+						std::string(binary) == "zlib" ? PiqslCompression_Zlib
+						: PiqslCompression_None));
+				}
 			}
 		}
 		else 
@@ -435,6 +604,12 @@ extern "C" PtDspyError DspyImageData(PtDspyImageHandle image,
 	SqPiqslDisplayInstance* pImage;
 	pImage = reinterpret_cast<SqPiqslDisplayInstance*>(image);
 
+	if(pImage->m_sender)
+	{
+		pImage->m_sender->send(xmin, xmaxplus1, ymin, ymaxplus1, entrysize, data);
+		return(PkDspyErrorNone);
+	}
+
 	TqInt bucketlinelen = entrysize * (xmaxplus1 - xmin);
 	TqInt bufferlength = bucketlinelen * (ymaxplus1 - ymin);
 	TiXmlDocument msg;
@@ -484,6 +659,9 @@ extern "C" PtDspyError DspyImageDelayClose(PtDspyImageHandle image)
 	// Close the socket
 	if(pImage && pImage->m_socket)
 	{
+		// Make sure all the buckets arrive before the close message.
+		if(pImage->m_sender)
+			pImage->m_sender->finish();
 		TiXmlDocument doc("close.xml");
 		TiXmlDeclaration* decl = new TiXmlDeclaration("1.0","","yes");
 		TiXmlElement* closeMsgXML = new TiXmlElement("Close");
@@ -512,6 +690,17 @@ extern "C" PtDspyError DspyImageQuery(PtDspyImageHandle image,
 	if(size <= 0 || !data)
 		return PkDspyErrorBadParams;
 
+	if(type == PkOverwriteQuery)
+	{
+		// piqsl replaces any part of the image which is sent again, so the
+		// renderer may send previews to be refined by later buckets.
+		PtDspyOverwriteInfo overwriteInfo;
+		overwriteInfo.overwrite = 1;
+		overwriteInfo.interactive = 1;
+		memcpy(data, &overwriteInfo, std::min(size, sizeof(overwriteInfo)));
+		return PkDspyErrorNone;
+	}
+
 #if 0
 	switch (type)
 	{
@@ -0,0 +1,110 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+		\brief Declares the binary bucket messages shared by the piqsl display
+			driver and the piqsl framebuffer.
+*/
+
+#ifndef PIQSLPROTOCOL_H_INCLUDED
+#define PIQSLPROTOCOL_H_INCLUDED 1
+
+#include	<aqsis/aqsis.h>
+
+namespace Aqsis {
+
+/** \brief Compression applied to the data of a binary bucket message.
+ *
+ * The names are used in the XML messages which negotiate the protocol while
+ * opening an image.
+ */
+enum EqPiqslCompression
+{
+	PiqslCompression_None = 0,	///< "none": raw pixel data.
+	PiqslCompression_Zlib = 1	///< "zlib": data compressed with zlib.
+};
+
+/** \brief Header of a binary bucket message.
+ *
+ * When the piqsl "Open" message carries a BinaryData element, and piqsl
+ * answers with a "binary" attribute on its Formats reply, buckets are sent
+ * as binary messages in place of the base64 encoded XML "Data" message.
+ * Each message is the header, followed by dataSize bytes of bucket data
+ * and a terminating zero byte, like the XML messages.
+ *
+ * The header fields are written as 32 bit integers in network byte order,
+ * so that piqsl may run on a machine of different endianness.
+ */
+struct SqPiqslBucketHeader
+{
+	/// Identifies a binary message; XML messages always start with '<'.
+	static const TqUint32 magicNumber = 0x41514244;
+	/// Size of the header when written to a message.
+	static const TqInt size = 9*4;
+
+	TqUint32 magic;
+	TqUint32 xmin;
+	TqUint32 xmaxplus1;
+	TqUint32 ymin;
+	TqUint32 ymaxplus1;
+	TqUint32 elementSize;
+	TqUint32 compression;	///< An EqPiqslCompression.
+	TqUint32 dataSize;		///< Number of bytes of data following the header.
+	TqUint32 rawSize;		///< Number of bytes of pixel data once decompressed.
+
+	/// Write the header into the first size bytes of buf.
+	void write(char* buf) const
+	{
+		const TqUint32 fields[] = { magic, xmin, xmaxplus1, ymin, ymaxplus1,
+			elementSize, compression, dataSize, rawSize };
+		for(TqInt i = 0; i < 9; ++i, buf += 4)
+		{
+			buf[0] = static_cast<char>((fields[i] >> 24) & 0xFF);
+			buf[1] = static_cast<char>((fields[i] >> 16) & 0xFF);
+			buf[2] = static_cast<char>((fields[i] >> 8) & 0xFF);
+			buf[3] = static_cast<char>(fields[i] & 0xFF);
+		}
+	}
+
+	/// Read the header from the first size bytes of buf.
+	void read(const char* buf)
+	{
+		TqUint32* fields[] = { &magic, &xmin, &xmaxplus1, &ymin, &ymaxplus1,
+			&elementSize, &compression, &dataSize, &rawSize };
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(buf);
+		for(TqInt i = 0; i < 9; ++i, in += 4)
+			*fields[i] = (TqUint32(in[0]) << 24) | (TqUint32(in[1]) << 16)
+				| (TqUint32(in[2]) << 8) | TqUint32(in[3]);
+	}
+};
+
+} // namespace Aqsis
+
+#endif // PIQSLPROTOCOL_H_INCLUDED
@@ -68,6 +68,7 @@ ArgParse::apintvec g_cl_frames;
 ArgParse::apstring g_cl_indentation = "space";
 ArgParse::apint g_cl_compression = 0;	// Default None
 ArgParse::apstring g_cl_output = "";
+ArgParse::apint g_cl_splitArchives = 0;
 Aqsis::RibWriterOptions g_writerOpts;
 #ifdef AQSIS_SYSTEM_POSIX
 ArgParse::apflag g_cl_syslog = false;
@@ -133,6 +134,11 @@ int main( int argc, const char** argv )
 	ap.argString( "archives", "=string\aOverride the initial archive searchpath(s) (default \"%default\")", &g_writerOpts.archivePath );
 	ap.argFlag( "readarchives", "\aInterpolate all ReadArchive calls into the output", &g_writerOpts.interpolateArchives );
 	ap.alias("readarchives", "ra");
+	ap.argInt( "splitarchives", "=integer\aWrite primitives with at least this many parameter values to\n"
+	           "\aseparate archive files (default 0 = off)", &g_cl_splitArchives );
+	ap.argString( "splitprefix", "=string\aPrefix for split archive file names, relative to the output\n"
+	           "\afile (default: the output file name, or \"archive\")", &g_writerOpts.splitArchivePrefix );
+	ap.argInt( "splitthreads", "=integer\aNumber of threads writing split archives (default 0 = one per core)", &g_writerOpts.splitArchiveThreads );
 	ap.allowUnrecognizedOptions();
 
 	if ( argc > 1 && !ap.parse( argc - 1, argv + 1 ) )
@@ -195,6 +201,7 @@ int main( int argc, const char** argv )
 	else
 		Aqsis::log() << Aqsis::warning << "unknown indent character";
 	g_writerOpts.useGzip = g_cl_compression;
+	g_writerOpts.splitArchiveThreshold = std::max(0, g_cl_splitArchives);
 
 	// Get output stream
 	std::ostream* outStream = &std::cout;
@@ -205,6 +212,7 @@ int main( int argc, const char** argv )
 		if(!outFile)
 			return EXIT_FAILURE;
 		outStream = &outFile;
+		g_writerOpts.outputFileName = g_cl_output;
 	}
 
 	// Open writer
@@ -47,10 +47,13 @@
 #include	<boost/archive/iterators/transform_width.hpp>
 #include	<boost/archive/iterators/insert_linebreaks.hpp>
 #include        <boost/archive/iterators/remove_whitespace.hpp>
+#include	<boost/cstdint.hpp>
 #include	<boost/format.hpp>
 #include	<boost/filesystem.hpp>
+#include	<zlib.h>
 
 #include	"displayserverimage.h"
+#include	"piqslprotocol.h"
 
 #include	<aqsis/math/math.h>
 #include 	<aqsis/util/file.h>
@@ -179,6 +182,93 @@ typedef
     > 
     base64_text; // compose all the above operations in to a new iterator
 
+//----------------------------------------------------------------------
+/** Check that a bucket header describes data which fits this image.
+ *
+ * The bucket must lie within the image resolution, use the pixel format
+ * given when the image was opened, and carry exactly the pixel data it
+ * claims: the uncompressed size must match the bucket dimensions, and the
+ * message size must be no more than zlib could produce from that.
+ */
+bool CqDisplayServerImage::validBucketHeader(const SqPiqslBucketHeader& header) const
+{
+	if(!m_realData
+		|| header.xmaxplus1 < header.xmin || header.ymaxplus1 < header.ymin
+		|| header.xmaxplus1 - header.xmin > static_cast<TqUint32>(imageWidth())
+		|| header.ymaxplus1 - header.ymin > static_cast<TqUint32>(imageHeight())
+		|| header.elementSize != static_cast<TqUint32>(m_realData->channelList().bytesPerPixel()))
+		return false;
+	boost::uint64_t rawSize = boost::uint64_t(header.elementSize)
+		* (header.xmaxplus1 - header.xmin) * (header.ymaxplus1 - header.ymin);
+	if(header.rawSize != rawSize)
+		return false;
+	switch(header.compression)
+	{
+		case PiqslCompression_None:
+			return header.dataSize == header.rawSize;
+		case PiqslCompression_Zlib:
+			return header.dataSize <= compressBound(header.rawSize);
+		default:
+			return false;
+	}
+}
+
+//----------------------------------------------------------------------
+/** Process a binary bucket message once the whole of it has arrived.
+ *
+ * \return false if the message is incomplete, in which case nothing is
+ * read from the socket.
+ */
+bool CqDisplayServerImage::processBinaryMessage()
+{
+	char headerBuf[SqPiqslBucketHeader::size];
+	if(socket->peek(headerBuf, SqPiqslBucketHeader::size) < SqPiqslBucketHeader::size)
+		return false;
+	SqPiqslBucketHeader header;
+	header.read(headerBuf);
+	if(header.magic != SqPiqslBucketHeader::magicNumber)
+	{
+		Aqsis::log() << error << "Bad message received for \"" << name()
+			<< "\", discarding data" << std::endl;
+		socket->readAll();
+		return true;
+	}
+	// Check the sizes before waiting for the data or allocating space for it,
+	// so that a corrupt header can't claim an arbitrary amount of memory.
+	if(!validBucketHeader(header))
+	{
+		Aqsis::log() << error << "Bad bucket received for \"" << name()
+			<< "\", discarding data" << std::endl;
+		socket->readAll();
+		return true;
+	}
+	// The data is followed by the message terminator.
+	if(socket->bytesAvailable() < SqPiqslBucketHeader::size + header.dataSize + 1)
+		return false;
+	socket->read(headerBuf, SqPiqslBucketHeader::size);
+
+	std::vector<unsigned char> data(header.dataSize + 1);
+	socket->read(reinterpret_cast<char*>(&data[0]), header.dataSize + 1);
+	if(header.rawSize == 0)
+		return true;
+	if(header.compression == PiqslCompression_Zlib)
+	{
+		std::vector<unsigned char> rawData(header.rawSize);
+		uLongf rawSize = header.rawSize;
+		if(uncompress(&rawData[0], &rawSize, &data[0], header.dataSize) != Z_OK
+			|| rawSize != header.rawSize)
+		{
+			Aqsis::log() << error << "Could not decompress bucket data for \""
+				<< name() << "\"" << std::endl;
+			return true;
+		}
+		data.swap(rawData);
+	}
+	acceptData(header.xmin, header.xmaxplus1, header.ymin, header.ymaxplus1,
+			header.elementSize, &data[0]);
+	return true;
+}
+
     void CqDisplayServerImage::processMessage()
     {
         QByteArray msg;
@@ -186,6 +276,24 @@ typedef
         if (socket->state() != QAbstractSocket::ConnectedState)
             return;
 
+        // Binary bucket messages start with the first byte of the magic
+        // number, where XML messages start with '<'.
+        const char binaryStart = static_cast<char>(SqPiqslBucketHeader::magicNumber >> 24);
+        char first;
+        if (socket->peek(&first, 1) == 1 && first == binaryStart)
+        {
+            do
+            {
+                // Wait for readyRead() if the message is incomplete.
+                if (!processBinaryMessage())
+                    return;
+            }
+            while (socket->peek(&first, 1) == 1 && first == binaryStart);
+            if (socket->bytesAvailable() > 0)
+                QTimer::singleShot(0, this, SLOT(processMessage()));
+            return;
+        }
+
         const int bytesAvailable = socket->bytesAvailable();
 
         int bytesRead = 1;
@@ -285,6 +393,15 @@ typedef
                             param = param->NextSiblingElement("FloatsParameter");
                         }
                     }
+                    // Accept binary bucket data if the driver offers it.
+                    const char* binaryCompression = 0;
+                    child = root->FirstChildElement("BinaryData");
+                    if(child)
+                    {
+                        binaryCompression = child->Attribute("compression");
+                        if(!binaryCompression || std::string(binaryCompression) != "zlib")
+                            binaryCompression = "none";
+                    }
                     child = root->FirstChildElement("Formats");
                     if(child)
                     {
@@ -308,6 +425,8 @@ typedef
                         TiXmlDocument doc("formats.xml");
                         TiXmlDeclaration* decl = new TiXmlDeclaration("1.0","","yes");
                         TiXmlElement* formatsXML = new TiXmlElement("Formats");
+                        if(binaryCompression)
+                            formatsXML->SetAttribute("binary", binaryCompression);
                         for(CqChannelList::const_iterator ichan = channelList.begin();
                                 ichan != channelList.end(); ++ichan)
                         {
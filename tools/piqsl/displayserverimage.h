@@ -53,6 +53,7 @@ namespace Aqsis {
 
 struct SqDDMessageBase;
 struct SqDDMessageData;
+struct SqPiqslBucketHeader;
 
 //---------------------------------------------------------------------
 /** \class CqDDClient
@@ -106,6 +107,8 @@ public:
 	void processMessage();
 
 private:
+	bool validBucketHeader(const SqPiqslBucketHeader& header) const;
+	bool processBinaryMessage();
 
 	QTcpSocket* socket;
 };
@@ -0,0 +1,737 @@
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+#include "pointlod.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <queue>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#include <Partio.h>
+
+namespace Aqsis {
+
+namespace {
+
+const char lodMagic[8] = {'A', 'Q', 'P', 'T', 'L', 'O', 'D', '\0'};
+const int lodVersion = 1;
+
+/// Maximum number of points held by a node, unless at the maximum depth.
+const int nodeCapacity = 16384;
+/// Maximum depth of the octree; this limits the recursion for clouds with
+/// many coincident points.
+const int maxDepth = 20;
+/// Size of a node record in the file.
+const int nodeRecordSize = 6*sizeof(float) + sizeof(long long) + 9*sizeof(int);
+
+template<typename T>
+void writeValue(std::ostream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return in.good();
+}
+
+void writeString(std::ostream& out, const std::string& str)
+{
+    writeValue<int>(out, str.size());
+    out.write(str.data(), str.size());
+}
+
+bool readString(std::istream& in, std::string& str)
+{
+    int size = 0;
+    if(!readValue(in, size) || size < 0 || size > 4096)
+        return false;
+    str.resize(size);
+    if(size > 0)
+        in.read(&str[0], size);
+    return in.good();
+}
+
+void releasePartioFile(Partio::ParticlesInfo* file)
+{
+    if(file) file->release();
+}
+
+/// Node of the octree while it's being built.
+struct BuildNode
+{
+    Box3f bound;
+    int depth;
+    std::vector<int> points;
+    int children[8];
+
+    BuildNode(const Box3f& bound, int depth)
+        : bound(bound),
+        depth(depth),
+        points()
+    {
+        for(int i = 0; i < 8; ++i)
+            children[i] = -1;
+    }
+};
+
+/// Get the bound of one octant of a box.
+Box3f octantBound(const Box3f& bound, int octant)
+{
+    V3f c = bound.center();
+    Box3f b(bound.min, c);
+    if(octant & 1) { b.min.x = c.x; b.max.x = bound.max.x; }
+    if(octant & 2) { b.min.y = c.y; b.max.y = bound.max.y; }
+    if(octant & 4) { b.min.z = c.z; b.max.z = bound.max.z; }
+    return b;
+}
+
+/// Return false if a box lies entirely outside the view frustum.
+bool inFrustum(const Box3f& b, const Imath::M44f& worldToClip)
+{
+    // The box is outside if all its corners are outside one clipping plane.
+    int outside[6] = {0, 0, 0, 0, 0, 0};
+    for(int i = 0; i < 8; ++i)
+    {
+        Imath::V4f c = Imath::V4f((i & 1) ? b.max.x : b.min.x,
+                                  (i & 2) ? b.max.y : b.min.y,
+                                  (i & 4) ? b.max.z : b.min.z, 1) * worldToClip;
+        outside[0] += c.x < -c.w;
+        outside[1] += c.x > c.w;
+        outside[2] += c.y < -c.w;
+        outside[3] += c.y > c.w;
+        outside[4] += c.z < -c.w;
+        outside[5] += c.z > c.w;
+    }
+    for(int i = 0; i < 6; ++i)
+    {
+        if(outside[i] == 8)
+            return false;
+    }
+    return true;
+}
+
+QString lodFileName(const QString& fileName)
+{
+    return fileName + ".lod";
+}
+
+/// Get the name of the hierarchy file for a point cloud in the cache
+/// directory, used when the cloud's own directory can't be written.
+QString cachedLodFileName(const QString& fileName)
+{
+    QString cacheDir = QDir::temp().filePath("ptview-cache");
+    // Name the file after the whole path, so clouds with the same name in
+    // different directories don't share a file.
+    QByteArray pathHash = QCryptographicHash::hash(
+            QFileInfo(fileName).absoluteFilePath().toUtf8(),
+            QCryptographicHash::Md5).toHex();
+    return QDir(cacheDir).filePath(QString::fromLatin1(pathHash) + "-" +
+                                   QFileInfo(fileName).fileName() + ".lod");
+}
+
+/// Write the hierarchy of a point cloud to a stream.
+bool writeLod(const std::string& pointFileName, std::ostream& out,
+              const std::string& colorChannel,
+              const boost::function<bool ()>& cancelled)
+{
+    namespace Pio = Partio;
+    boost::shared_ptr<Pio::ParticlesData> ptFile(
+                Pio::read(pointFileName.c_str()), releasePartioFile);
+    // The read can't be interrupted, so check again once it's done.
+    if(!ptFile || (cancelled && cancelled()))
+        return false;
+    Pio::ParticleAttribute positionAttr;
+    Pio::ParticleAttribute normalAttr;
+    Pio::ParticleAttribute radiusAttr;
+    Pio::ParticleAttribute colorAttr;
+    if(!ptFile->attributeInfo("position", positionAttr) ||
+       !ptFile->attributeInfo("normal", normalAttr)   ||
+       !ptFile->attributeInfo("radius", radiusAttr) ||
+       positionAttr.type != Pio::VECTOR ||
+       normalAttr.type != Pio::VECTOR ||
+       radiusAttr.type != Pio::FLOAT || radiusAttr.count != 1)
+        return false;
+    // Find the channels which look like colors, and the one to use.
+    std::vector<std::string> colorChannels;
+    Pio::ParticleAttribute attr;
+    for(int i = 0; i < ptFile->numAttributes(); ++i)
+    {
+        ptFile->attributeInfo(i, attr);
+        if(attr.type == Pio::FLOAT && attr.count == 3)
+            colorChannels.push_back(attr.name);
+    }
+    std::string colorName = colorChannel;
+    if(colorName.empty() && !colorChannels.empty())
+        colorName = colorChannels[0];
+    bool hasColor = !colorName.empty() &&
+                    ptFile->attributeInfo(colorName.c_str(), colorAttr) &&
+                    colorAttr.type == Pio::FLOAT && colorAttr.count == 3;
+    if(!hasColor)
+        colorName.clear();
+
+    // Find a cubic bound for the octree.
+    int npoints = ptFile->numParticles();
+    Box3f bound;
+    for(int i = 0; i < npoints; ++i)
+        bound.extendBy(*ptFile->data<V3f>(positionAttr, i));
+    if(npoints == 0)
+        bound = Box3f(V3f(0));
+    V3f boundSize = bound.size();
+    float halfWidth = 0.5f*std::max(std::max(boundSize.x, boundSize.y),
+                                    boundSize.z);
+    bound = Box3f(bound.center() - V3f(halfWidth),
+                  bound.center() + V3f(halfWidth));
+
+    // Insert the points in a random order, so that each node keeps an even
+    // sample of the points in its cell, and passes the rest to its children.
+    std::vector<int> order(npoints);
+    for(int i = 0; i < npoints; ++i)
+        order[i] = i;
+    std::random_shuffle(order.begin(), order.end());
+    std::deque<BuildNode> nodes;
+    nodes.push_back(BuildNode(bound, 0));
+    for(int i = 0; i < npoints; ++i)
+    {
+        if((i & 0xFFFF) == 0 && cancelled && cancelled())
+            return false;
+        const V3f& p = *ptFile->data<V3f>(positionAttr, order[i]);
+        int n = 0;
+        while(static_cast<int>(nodes[n].points.size()) >= nodeCapacity &&
+              nodes[n].depth < maxDepth)
+        {
+            V3f c = nodes[n].bound.center();
+            int octant = (p.x > c.x) | ((p.y > c.y) << 1) | ((p.z > c.z) << 2);
+            if(nodes[n].children[octant] < 0)
+            {
+                nodes[n].children[octant] = nodes.size();
+                nodes.push_back(BuildNode(octantBound(nodes[n].bound, octant),
+                                          nodes[n].depth + 1));
+            }
+            n = nodes[n].children[octant];
+        }
+        nodes[n].points.push_back(order[i]);
+    }
+
+    // Write the header and node table, followed by the points of each node.
+    out.write(lodMagic, sizeof(lodMagic));
+    writeValue(out, lodVersion);
+    writeValue<long long>(out, npoints);
+    writeValue<int>(out, colorChannels.size());
+    for(int i = 0, iend = colorChannels.size(); i < iend; ++i)
+        writeString(out, colorChannels[i]);
+    writeString(out, colorName);
+    writeValue<int>(out, nodes.size());
+    const int floatsPerPoint = hasColor ? 10 : 7;
+    long long offset = static_cast<long long>(out.tellp()) +
+                       static_cast<long long>(nodes.size())*nodeRecordSize;
+    for(int i = 0, iend = nodes.size(); i < iend; ++i)
+    {
+        const BuildNode& node = nodes[i];
+        out.write(reinterpret_cast<const char*>(&node.bound.min), 3*sizeof(float));
+        out.write(reinterpret_cast<const char*>(&node.bound.max), 3*sizeof(float));
+        writeValue(out, offset);
+        writeValue<int>(out, node.points.size());
+        for(int c = 0; c < 8; ++c)
+            writeValue(out, node.children[c]);
+        offset += static_cast<long long>(node.points.size())*floatsPerPoint*sizeof(float);
+    }
+    std::vector<float> data;
+    for(int i = 0, iend = nodes.size(); i < iend; ++i)
+    {
+        if(cancelled && cancelled())
+            break;
+        const std::vector<int>& points = nodes[i].points;
+        int n = points.size();
+        // Points are stored as an array of each attribute in turn.
+        data.resize(n*floatsPerPoint);
+        if(n == 0)
+            continue;
+        V3f* P = reinterpret_cast<V3f*>(&data[0]);
+        V3f* N = P + n;
+        float* r = reinterpret_cast<float*>(N + n);
+        C3f* col = reinterpret_cast<C3f*>(r + n);
+        for(int j = 0; j < n; ++j)
+        {
+            P[j] = *ptFile->data<V3f>(positionAttr, points[j]);
+            N[j] = *ptFile->data<V3f>(normalAttr, points[j]);
+            r[j] = *ptFile->data<float>(radiusAttr, points[j]);
+            if(hasColor)
+                col[j] = *ptFile->data<C3f>(colorAttr, points[j]);
+        }
+        out.write(reinterpret_cast<const char*>(&data[0]), data.size()*sizeof(float));
+    }
+    return !(cancelled && cancelled());
+}
+
+
+
+} // anonymous namespace
+
+
+//------------------------------------------------------------------------------
+// PointLodFile implementation
+
+PointLodFile::PointLodFile()
+    : m_file(),
+    m_nodes(),
+    m_totalPoints(0),
+    m_colorChannels(),
+    m_colorChannel()
+{ }
+
+
+bool PointLodFile::build(const std::string& pointFileName,
+                         const std::string& lodFileName,
+                         const std::string& colorChannel,
+                         const boost::function<bool ()>& cancelled)
+{
+    if(cancelled && cancelled())
+        return false;
+    // Write to a temporary file and rename it into place once complete, so
+    // that a cancelled or failed build never leaves a partial file, and
+    // other viewers building the same file don't clash.  The output is
+    // opened first, so an unwritable directory is found before reading
+    // the whole cloud.
+    std::string tmpFileName = lodFileName + "." +
+        QString::number(QCoreApplication::applicationPid()).toStdString() + ".tmp";
+    std::ofstream out(tmpFileName.c_str(), std::ios::out | std::ios::binary);
+    if(!out)
+        return false;
+    bool written = writeLod(pointFileName, out, colorChannel, cancelled);
+    out.close();
+    if(!written || !out)
+    {
+        std::remove(tmpFileName.c_str());
+        return false;
+    }
+    QFile::remove(QString::fromStdString(lodFileName));
+    if(!QFile::rename(QString::fromStdString(tmpFileName),
+                      QString::fromStdString(lodFileName)))
+    {
+        std::remove(tmpFileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool PointLodFile::open(const std::string& lodFileName)
+{
+    m_nodes.clear();
+    m_colorChannels.clear();
+    m_colorChannel.clear();
+    m_totalPoints = 0;
+    m_file.close();
+    m_file.clear();
+    m_file.open(lodFileName.c_str(), std::ios::in | std::ios::binary);
+    char magic[sizeof(lodMagic)];
+    int version = 0;
+    if(!m_file.read(magic, sizeof(magic)) ||
+       std::memcmp(magic, lodMagic, sizeof(lodMagic)) != 0 ||
+       !readValue(m_file, version) || version != lodVersion ||
+       !readValue(m_file, m_totalPoints))
+        return false;
+    int nchannels = 0;
+    if(!readValue(m_file, nchannels))
+        return false;
+    std::string name;
+    for(int i = 0; i < nchannels; ++i)
+    {
+        if(!readString(m_file, name))
+            return false;
+        m_colorChannels.push_back(QString::fromStdString(name));
+    }
+    if(!readString(m_file, name))
+        return false;
+    m_colorChannel = QString::fromStdString(name);
+    int nnodes = 0;
+    if(!readValue(m_file, nnodes) || nnodes < 0)
+        return false;
+    m_nodes.resize(nnodes);
+    for(int i = 0; i < nnodes; ++i)
+    {
+        Node& node = m_nodes[i];
+        m_file.read(reinterpret_cast<char*>(&node.bound.min), 3*sizeof(float));
+        m_file.read(reinterpret_cast<char*>(&node.bound.max), 3*sizeof(float));
+        readValue(m_file, node.offset);
+        readValue(m_file, node.npoints);
+        for(int c = 0; c < 8; ++c)
+            readValue(m_file, node.children[c]);
+    }
+    if(!m_file)
+    {
+        m_nodes.clear();
+        return false;
+    }
+    return true;
+}
+
+
+bool PointLodFile::readNode(int node, PointBlock& block)
+{
+    if(node < 0 || node >= static_cast<int>(m_nodes.size()))
+        return false;
+    int n = m_nodes[node].npoints;
+    block.P.resize(n);
+    block.N.resize(n);
+    block.r.resize(n);
+    block.color.resize(m_colorChannel.isEmpty() ? 0 : n);
+    if(n == 0)
+        return true;
+    m_file.clear();
+    m_file.seekg(m_nodes[node].offset);
+    m_file.read(reinterpret_cast<char*>(&block.P[0]), n*sizeof(V3f));
+    m_file.read(reinterpret_cast<char*>(&block.N[0]), n*sizeof(V3f));
+    m_file.read(reinterpret_cast<char*>(&block.r[0]), n*sizeof(float));
+    if(!block.color.empty())
+        m_file.read(reinterpret_cast<char*>(&block.color[0]), n*sizeof(C3f));
+    return m_file.good();
+}
+
+
+//------------------------------------------------------------------------------
+// PointLodModel implementation
+
+PointLodModel::Loader::Loader(PointLodModel* model, const QString& fileName,
+                              const QString& colorChannel, bool rebuild,
+                              size_t maxCachedPoints)
+    : fileName(fileName),
+    colorChannel(colorChannel),
+    rebuild(rebuild),
+    lodFile(),
+    mutex(),
+    requestsChanged(),
+    model(model),
+    ready(false),
+    requests(),
+    cache(),
+    cachedPoints(0),
+    maxCachedPoints(maxCachedPoints),
+    frame(0)
+{ }
+
+
+bool PointLodModel::Loader::stopRequested() const
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return !model;
+}
+
+
+void PointLodModel::Loader::evictNodes()
+{
+    if(cachedPoints <= maxCachedPoints)
+        return;
+    // Remove the least recently used nodes, but never those in use for the
+    // current frame.
+    std::vector<std::pair<long long, int> > byAge;
+    for(NodeCache::const_iterator i = cache.begin(); i != cache.end(); ++i)
+    {
+        if(i->second.lastUsed < frame)
+            byAge.push_back(std::make_pair(i->second.lastUsed, i->first));
+    }
+    std::sort(byAge.begin(), byAge.end());
+    for(size_t i = 0; i < byAge.size() && cachedPoints > maxCachedPoints; ++i)
+    {
+        NodeCache::iterator cached = cache.find(byAge[i].second);
+        cachedPoints -= cached->second.block->size();
+        cache.erase(cached);
+    }
+}
+
+
+PointLodModel::PointLodModel()
+    : m_fileName(),
+    m_colorChannel(),
+    m_rebuild(false),
+    m_maxCachedPoints(20000000),
+    m_loader()
+{ }
+
+
+PointLodModel::~PointLodModel()
+{
+    stopLoader();
+}
+
+
+void PointLodModel::open(const QString& fileName)
+{
+    stopLoader();
+    m_fileName = fileName;
+    m_colorChannel.clear();
+    m_rebuild = false;
+    startLoader();
+}
+
+
+bool PointLodModel::ready() const
+{
+    if(!m_loader)
+        return false;
+    boost::mutex::scoped_lock lock(m_loader->mutex);
+    return m_loader->ready;
+}
+
+
+QStringList PointLodModel::colorChannels() const
+{
+    if(!ready())
+        return QStringList();
+    return m_loader->lodFile.colorChannels();
+}
+
+
+void PointLodModel::setColorChannel(const QString& name)
+{
+    if(ready() && m_loader->lodFile.colorChannel() == name)
+        return;
+    stopLoader();
+    m_colorChannel = name;
+    m_rebuild = true;
+    startLoader();
+}
+
+
+V3f PointLodModel::center() const
+{
+    if(!ready() || m_loader->lodFile.nodes().empty())
+        return V3f(0);
+    return m_loader->lodFile.nodes()[0].bound.center();
+}
+
+
+void PointLodModel::setCacheSize(size_t maxPoints)
+{
+    m_maxCachedPoints = maxPoints;
+    if(!m_loader)
+        return;
+    boost::mutex::scoped_lock lock(m_loader->mutex);
+    m_loader->maxCachedPoints = maxPoints;
+}
+
+
+void PointLodModel::selectNodes(const V3f& cameraPos,
+        const Imath::M44f& worldToClip, float pixelScale, size_t pointBudget,
+        std::vector<boost::shared_ptr<const PointBlock> >& blocks)
+{
+    if(!ready())
+        return;
+    Loader& loader = *m_loader;
+    const std::vector<PointLodFile::Node>& nodes = loader.lodFile.nodes();
+    if(nodes.empty())
+        return;
+    // A node is refined into its children while its points would be more
+    // than a pixel or so apart on screen.
+    const float refinePixels = std::sqrt(float(nodeCapacity));
+
+    boost::mutex::scoped_lock lock(loader.mutex);
+    ++loader.frame;
+    typedef std::pair<float, int> NodePriority;
+    std::priority_queue<NodePriority> queue;
+    queue.push(NodePriority(FLT_MAX, 0));
+    std::deque<int> requests;
+    size_t npoints = 0;
+    while(!queue.empty())
+    {
+        int i = queue.top().second;
+        queue.pop();
+        const PointLodFile::Node& node = nodes[i];
+        if(!inFrustum(node.bound, worldToClip))
+            continue;
+        if(npoints + node.npoints > pointBudget)
+            break;
+        NodeCache::iterator cached = loader.cache.find(i);
+        if(cached == loader.cache.end())
+        {
+            // The children refine the points of this node, so wait for it
+            // before going further.
+            requests.push_back(i);
+            continue;
+        }
+        cached->second.lastUsed = loader.frame;
+        blocks.push_back(cached->second.block);
+        npoints += node.npoints;
+        for(int c = 0; c < 8; ++c)
+        {
+            int child = node.children[c];
+            if(child < 0)
+                continue;
+            const Box3f& b = nodes[child].bound;
+            float radius = 0.5f*(b.max - b.min).length();
+            float dist = std::max((b.center() - cameraPos).length() - radius,
+                                  1e-3f*radius);
+            float pixels = pixelScale*radius/dist;
+            if(pixels > refinePixels)
+                queue.push(NodePriority(pixels, child));
+        }
+    }
+    // Replace any old requests; the loader only needs to follow the latest
+    // view.
+    loader.requests.swap(requests);
+    loader.evictNodes();
+    loader.requestsChanged.notify_one();
+}
+
+
+void PointLodModel::startLoader()
+{
+    m_loader.reset(new Loader(this, m_fileName, m_colorChannel, m_rebuild,
+                              m_maxCachedPoints));
+    boost::thread thread(boost::bind(&PointLodModel::loaderThread, m_loader));
+    thread.detach();
+}
+
+
+void PointLodModel::stopLoader()
+{
+    if(!m_loader)
+        return;
+    // Don't wait for the thread, which may be stuck reading the point
+    // cloud; it sees that it's been stopped and exits when it can.
+    {
+        boost::mutex::scoped_lock lock(m_loader->mutex);
+        m_loader->model = 0;
+    }
+    m_loader->requestsChanged.notify_all();
+    m_loader.reset();
+}
+
+
+/// Open the hierarchy file of a point cloud, if it's up to date.
+static bool openLodFile(PointLodFile& lodFile, const QString& fileName,
+                        const QString& lodName)
+{
+    QFileInfo pointInfo(fileName);
+    QFileInfo lodInfo(lodName);
+    return lodInfo.exists() &&
+           lodInfo.lastModified() >= pointInfo.lastModified() &&
+           lodFile.open(lodName.toStdString());
+}
+
+
+void PointLodModel::loaderThread(const boost::shared_ptr<Loader>& loaderPtr)
+{
+    // Keep the loader alive until the thread exits, even once the model
+    // has moved on.
+    boost::shared_ptr<Loader> keepAlive = loaderPtr;
+    Loader& loader = *keepAlive;
+
+    // Open the hierarchy file, building it first if it's missing or older
+    // than the point cloud.  It's kept next to the point cloud if possible,
+    // or in the cache directory otherwise.
+    QString lodNames[2] = { lodFileName(loader.fileName),
+                            cachedLodFileName(loader.fileName) };
+    bool valid = false;
+    for(int i = 0; i < 2 && !valid && !loader.rebuild; ++i)
+        valid = openLodFile(loader.lodFile, loader.fileName, lodNames[i]);
+    for(int i = 0; i < 2 && !valid; ++i)
+    {
+        QDir().mkpath(QFileInfo(lodNames[i]).path());
+        valid = PointLodFile::build(loader.fileName.toStdString(),
+                    lodNames[i].toStdString(), loader.colorChannel.toStdString(),
+                    boost::bind(&Loader::stopRequested, &loader))
+                && loader.lodFile.open(lodNames[i].toStdString());
+        if(loader.stopRequested())
+            return;
+    }
+    if(!valid)
+    {
+        boost::mutex::scoped_lock lock(loader.mutex);
+        if(loader.model)
+        {
+            emit loader.model->failed(
+                tr("Couldn't build the level of detail file for \"%1\"")
+                .arg(loader.fileName));
+        }
+        return;
+    }
+    {
+        boost::mutex::scoped_lock lock(loader.mutex);
+        if(!loader.model)
+            return;
+        loader.ready = true;
+        // The view lives in another thread, so its slots are queued rather
+        // than called here, and it's safe to signal with the lock held.
+        // Holding it stops the model from being deleted meanwhile.
+        emit loader.model->opened();
+    }
+
+    // Load nodes as they're asked for by the view.
+    while(true)
+    {
+        int node = 0;
+        {
+            boost::mutex::scoped_lock lock(loader.mutex);
+            while(loader.model && loader.requests.empty())
+                loader.requestsChanged.wait(lock);
+            if(!loader.model)
+                return;
+            node = loader.requests.front();
+            loader.requests.pop_front();
+            if(loader.cache.find(node) != loader.cache.end())
+                continue;
+        }
+        boost::shared_ptr<PointBlock> block(new PointBlock());
+        if(!loader.lodFile.readNode(node, *block))
+            continue;
+        {
+            boost::mutex::scoped_lock lock(loader.mutex);
+            if(!loader.model)
+                return;
+            CachedNode& cached = loader.cache[node];
+            cached.block = block;
+            cached.lastUsed = loader.frame;
+            loader.cachedPoints += block->size();
+            emit loader.model->nodesLoaded();
+        }
+    }
+}
+
+
+} // namespace Aqsis
+
+// vi: set et:
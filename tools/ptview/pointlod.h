@@ -0,0 +1,258 @@
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+#ifndef AQSIS_POINTLOD_H_INCLUDED
+#define AQSIS_POINTLOD_H_INCLUDED
+
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+
+#include <OpenEXR/ImathVec.h>
+#include <OpenEXR/ImathBox.h>
+#include <OpenEXR/ImathColor.h>
+#include <OpenEXR/ImathMatrix.h>
+
+namespace Aqsis {
+
+using Imath::V3f;
+using Imath::C3f;
+using Imath::Box3f;
+
+
+//------------------------------------------------------------------------------
+/// A block of points belonging to one node of a level of detail hierarchy.
+struct PointBlock
+{
+    std::vector<V3f> P;
+    std::vector<V3f> N;
+    std::vector<float> r;
+    std::vector<C3f> color;  ///< Empty if the cloud has no color channel
+
+    size_t size() const { return P.size(); }
+};
+
+
+//------------------------------------------------------------------------------
+/// A level of detail hierarchy of points, stored on disk.
+///
+/// The hierarchy is an octree where each node holds a random subset of the
+/// points inside its cell, up to a fixed number.  Together with the points
+/// of its ancestors, a node's points are a coarse but evenly spread sample
+/// of the cloud in its cell, so a view may draw the tree down to any depth
+/// and still show the whole cloud.
+///
+/// The file holds a small header, with the node table, followed by the
+/// points of each node.  The header is read when the file is opened, and
+/// the points of a node only when they're asked for, so opening a file
+/// takes the same time regardless of its size.  The file is written in
+/// native byte order, since it's only a cache of the point cloud.
+class PointLodFile
+{
+    public:
+        struct Node
+        {
+            Box3f bound;        ///< Octree cell of the node
+            long long offset;   ///< Position of the points in the file
+            int npoints;        ///< Number of points held by the node
+            int children[8];    ///< Child node indices, or -1
+        };
+
+        PointLodFile();
+
+        /// Build a hierarchy file from a point cloud.
+        ///
+        /// This needs to read the whole point cloud once; it's intended to
+        /// be cached next to the point cloud.  The points are colored from
+        /// the named channel, or the first color-like channel if the name is
+        /// empty.  The build gives up early if cancelled() returns true.
+        ///
+        /// The file is written under a temporary name and renamed when
+        /// complete, so other readers never see a partial file.  Returns
+        /// false without reading the cloud if the file can't be created.
+        static bool build(const std::string& pointFileName,
+                          const std::string& lodFileName,
+                          const std::string& colorChannel,
+                          const boost::function<bool ()>& cancelled
+                            = boost::function<bool ()>());
+
+        /// Open a hierarchy file, reading only the header.
+        bool open(const std::string& lodFileName);
+
+        /// Read the points of a node.
+        bool readNode(int node, PointBlock& block);
+
+        const std::vector<Node>& nodes() const { return m_nodes; }
+        /// Total number of points in the cloud
+        long long totalPoints() const { return m_totalPoints; }
+        /// Names of all the channels which look like colors
+        const QStringList& colorChannels() const { return m_colorChannels; }
+        /// Name of the channel the points are colored by, or empty
+        const QString& colorChannel() const { return m_colorChannel; }
+
+    private:
+        std::ifstream m_file;
+        std::vector<Node> m_nodes;
+        long long m_totalPoints;
+        QStringList m_colorChannels;
+        QString m_colorChannel;
+};
+
+
+//------------------------------------------------------------------------------
+/// Point cloud viewed through a level of detail hierarchy, which is streamed
+/// from disk as the view changes.
+///
+/// The hierarchy file is built next to the point cloud the first time the
+/// cloud is opened, and reused afterward while it's newer than the cloud.
+/// If the cloud's directory can't be written, the file is kept in a cache
+/// directory under the system temporary directory instead.
+///
+/// Building and loading happen in a background thread; the view draws
+/// whichever nodes have been loaded so far, and is told to update through
+/// the nodesLoaded() signal as more arrive.  Reading the point cloud can't
+/// be interrupted, so a thread which is stopped is left to finish on its
+/// own and its results are dropped, rather than waiting for it.
+class PointLodModel : public QObject
+{
+    Q_OBJECT
+
+    public:
+        PointLodModel();
+        ~PointLodModel();
+
+        /// Start opening a point cloud, building its hierarchy if necessary.
+        void open(const QString& fileName);
+
+        /// Return true once the hierarchy has been opened.
+        bool ready() const;
+
+        /// Get the channels which look like color channels.
+        QStringList colorChannels() const;
+        /// Recolor the points from the given channel.  This rebuilds the
+        /// hierarchy in the background.
+        void setColorChannel(const QString& name);
+
+        /// Return the center of the bound of the cloud.
+        V3f center() const;
+
+        /// Set the maximum number of points kept in memory.
+        void setCacheSize(size_t maxPoints);
+
+        /// Choose the nodes to draw for a view.
+        ///
+        /// Nodes are chosen from the root down, largest on screen first,
+        /// until pointBudget points have been chosen.  Nodes which are
+        /// wanted but not yet in memory are queued for loading, in order of
+        /// importance.
+        ///
+        /// \param cameraPos - position of the camera
+        /// \param worldToClip - transformation from world to clip space
+        /// \param pixelScale - size in pixels of an object of unit size at
+        ///                     unit distance
+        /// \param pointBudget - maximum number of points to draw
+        /// \param blocks - the loaded nodes to draw are appended here
+        void selectNodes(const V3f& cameraPos, const Imath::M44f& worldToClip,
+                         float pixelScale, size_t pointBudget,
+                         std::vector<boost::shared_ptr<const PointBlock> >& blocks);
+
+    signals:
+        /// Emitted from the loading thread when the hierarchy is opened
+        void opened();
+        /// Emitted from the loading thread when new nodes are in memory
+        void nodesLoaded();
+        /// Emitted from the loading thread if the hierarchy can't be opened
+        void failed(const QString& message);
+
+    private:
+        struct CachedNode
+        {
+            boost::shared_ptr<const PointBlock> block;
+            long long lastUsed;
+        };
+        typedef std::map<int, CachedNode> NodeCache;
+
+        /// State shared between the model and one run of the loading
+        /// thread.  A stopped thread keeps its state alive until it exits.
+        struct Loader
+        {
+            Loader(PointLodModel* model, const QString& fileName,
+                   const QString& colorChannel, bool rebuild,
+                   size_t maxCachedPoints);
+
+            const QString fileName;
+            const QString colorChannel;
+            const bool rebuild;
+            /// Only used by the loading thread until ready is set.
+            PointLodFile lodFile;
+
+            /// Protects all the members below
+            mutable boost::mutex mutex;
+            boost::condition_variable requestsChanged;
+            /// Model to signal, or null once the thread has been stopped
+            PointLodModel* model;
+            bool ready;
+            std::deque<int> requests;
+            NodeCache cache;
+            size_t cachedPoints;
+            size_t maxCachedPoints;
+            long long frame;
+
+            bool stopRequested() const;
+            void evictNodes();
+        };
+
+        void startLoader();
+        void stopLoader();
+        static void loaderThread(const boost::shared_ptr<Loader>& loader);
+
+        QString m_fileName;
+        QString m_colorChannel;
+        bool m_rebuild;
+        size_t m_maxCachedPoints;
+        boost::shared_ptr<Loader> m_loader;
+};
+
+
+} // namespace Aqsis
+
+#endif // AQSIS_POINTLOD_H_INCLUDED
+
+// vi: set et:
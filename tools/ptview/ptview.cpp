@@ -30,6 +30,7 @@
 
 #define GL_GLEXT_PROTOTYPES
 
+#include <QtCore/QFileInfo>
 #include <QtCore/QSignalMapper>
 #include <QtGui/QApplication>
 #include <QtGui/QKeyEvent>
@@ -38,6 +39,8 @@
 #include <QtGui/QFileDialog>
 #include <QtGui/QColorDialog>
 
+#include <algorithm>
+
 #include <boost/program_options.hpp>
 
 #define NOMINMAX
@@ -531,6 +534,12 @@ PointView::PointView(QWidget *parent)
     m_drawAxes(false),
     m_lighting(false),
     m_points(),
+    m_lodPoints(),
+    m_lodBlocks(),
+    m_lodCentered(false),
+    m_pointBudget(3000000),
+    m_lodCacheSize(20000000),
+    m_lodThreshold(256*1024*1024),
     m_pointTree(),
     m_cloudCenter(0)
 {
@@ -544,14 +553,35 @@ PointView::PointView(QWidget *parent)
 void PointView::loadPointFiles(const QStringList& fileNames)
 {
     m_points.clear();
+    m_lodPoints.clear();
+    m_lodBlocks.clear();
+    m_lodCentered = false;
     for(int i = 0; i < fileNames.size(); ++i)
     {
+        if(m_lodThreshold >= 0 &&
+           QFileInfo(fileNames[i]).size() >= m_lodThreshold)
+        {
+            // Stream large clouds from disk rather than loading them whole.
+            // The view is centered on them once they're opened.
+            boost::shared_ptr<PointLodModel> points(new PointLodModel());
+            points->setCacheSize(m_lodCacheSize);
+            connect(points.get(), SIGNAL(opened()), this, SLOT(lodOpened()));
+            connect(points.get(), SIGNAL(failed(const QString&)),
+                    this, SLOT(lodFailed(const QString&)));
+            connect(points.get(), SIGNAL(nodesLoaded()), this, SLOT(update()));
+            points->open(fileNames[i]);
+            m_lodPoints.push_back(points);
+            continue;
+        }
         boost::shared_ptr<PointArrayModel> points(new PointArrayModel());
         if(points->loadPointFile(fileNames[i]) && !points->empty())
             m_points.push_back(points);
     }
     if(m_points.empty())
+    {
+        updateGL();
         return;
+    }
     emit colorChannelsChanged(m_points[0]->colorChannels());
     m_cloudCenter = m_points[0]->centroid();
     m_cursorPos = m_cloudCenter;
@@ -574,6 +604,17 @@ void PointView::setProbeParams(int cubeFaceRes, float maxSolidAngle)
 }
 
 
+void PointView::setLodParams(size_t pointBudget, size_t cacheSize,
+                             qint64 threshold)
+{
+    m_pointBudget = pointBudget;
+    m_lodCacheSize = cacheSize;
+    m_lodThreshold = threshold;
+    for(size_t i = 0; i < m_lodPoints.size(); ++i)
+        m_lodPoints[i]->setCacheSize(cacheSize);
+}
+
+
 PointView::VisMode PointView::visMode() const
 {
     return m_visMode;
@@ -604,10 +645,35 @@ void PointView::setColorChannel(QString channel)
 {
     for(size_t i = 0; i < m_points.size(); ++i)
         m_points[i]->setColorChannel(channel);
+    for(size_t i = 0; i < m_lodPoints.size(); ++i)
+        m_lodPoints[i]->setColorChannel(channel);
     updateGL();
 }
 
 
+void PointView::lodOpened()
+{
+    // Center on the first cloud if none were loaded whole.  This is only
+    // done once, since the clouds are reopened when recolored.
+    if(!m_lodCentered && m_points.empty() && !m_lodPoints.empty() &&
+       sender() == m_lodPoints[0].get())
+    {
+        m_lodCentered = true;
+        emit colorChannelsChanged(m_lodPoints[0]->colorChannels());
+        m_cloudCenter = m_lodPoints[0]->center();
+        m_cursorPos = m_cloudCenter;
+        m_camera.setCenter(exr2qt(m_cloudCenter));
+    }
+    updateGL();
+}
+
+
+void PointView::lodFailed(const QString& message)
+{
+    QMessageBox::critical(this, tr("Error"), message);
+}
+
+
 QSize PointView::sizeHint() const
 {
     // Size hint, mainly for getting the initial window size right.
@@ -653,7 +719,35 @@ void PointView::paintGL()
     if(m_drawAxes)
         drawAxes();
     for(size_t i = 0; i < m_points.size(); ++i)
-        drawPoints(*m_points[i], m_visMode, m_lighting);
+    {
+        const PointArrayModel& points = *m_points[i];
+        drawPoints(points.P(), points.N(), points.r(), points.color(),
+                   points.size(), m_visMode, m_lighting);
+    }
+    m_lodBlocks.clear();
+    if(!m_lodPoints.empty())
+    {
+        // Choose the parts of the large clouds to draw for this view,
+        // sharing the point budget between them.
+        QMatrix4x4 viewMatrix = m_camera.viewMatrix();
+        QMatrix4x4 projMatrix = m_camera.projectionMatrix();
+        V3f cameraPos = qt2exr(viewMatrix.inverted().map(QVector3D(0,0,0)));
+        Imath::M44f worldToClip = qt2exr(projMatrix*viewMatrix);
+        float pixelScale = 0.5f*height()*projMatrix(1,1);
+        size_t budget = m_pointBudget/m_lodPoints.size();
+        for(size_t i = 0; i < m_lodPoints.size(); ++i)
+            m_lodPoints[i]->selectNodes(cameraPos, worldToClip, pixelScale,
+                                        budget, m_lodBlocks);
+        for(size_t i = 0; i < m_lodBlocks.size(); ++i)
+        {
+            const PointBlock& block = *m_lodBlocks[i];
+            if(block.size() == 0)
+                continue;
+            drawPoints(&block.P[0], &block.N[0], &block.r[0],
+                       block.color.empty() ? 0 : &block.color[0],
+                       block.size(), m_visMode, m_lighting);
+        }
+    }
 //    if(m_pointTree)
 //        splitNode(m_cursorPos, m_probeMaxSolidAngle, m_pointTree->dataSize(),
 //                  m_pointTree->root());
@@ -759,6 +853,20 @@ void PointView::keyPressEvent(QKeyEvent *event)
                 }
             }
         }
+        // Only the parts of large clouds in the current view are in memory.
+        for(size_t j = 0; j < m_lodBlocks.size(); ++j)
+        {
+            const std::vector<V3f>& P = m_lodBlocks[j]->P;
+            for(size_t i = 0; i < P.size(); ++i)
+            {
+                float dist = (m_cursorPos - P[i]).length2();
+                if(dist < nearestDist)
+                {
+                    nearestDist = dist;
+                    newPos = P[i];
+                }
+            }
+        }
         m_cursorPos = newPos;
         m_camera.setCenter(exr2qt(newPos));
         updateGL();
@@ -865,10 +973,11 @@ void PointView::drawCursor(const V3f& p) const
 
 
 /// Draw point cloud using OpenGL
-void PointView::drawPoints(const PointArrayModel& points, VisMode visMode,
-                           bool useLighting)
+void PointView::drawPoints(const V3f* P, const V3f* N, const float* r,
+                           const C3f* color, size_t npoints,
+                           VisMode visMode, bool useLighting)
 {
-    if(points.empty())
+    if(npoints == 0)
         return;
     switch(visMode)
     {
@@ -888,14 +997,14 @@ void PointView::drawPoints(const PointArrayModel& points, VisMode visMode,
             // Draw all points at once using vertex arrays.
             glEnableClientState(GL_VERTEX_ARRAY);
             glVertexPointer(3, GL_FLOAT, 3*sizeof(float),
-                            reinterpret_cast<const float*>(points.P()));
-            const float* col = reinterpret_cast<const float*>(points.color());
+                            reinterpret_cast<const float*>(P));
+            const float* col = reinterpret_cast<const float*>(color);
             if(col)
             {
                 glEnableClientState(GL_COLOR_ARRAY);
                 glColorPointer(3, GL_FLOAT, 3*sizeof(float), col);
             }
-            glDrawArrays(GL_POINTS, 0, points.size());
+            glDrawArrays(GL_POINTS, 0, npoints);
             glDisableClientState(GL_VERTEX_ARRAY);
             glDisableClientState(GL_COLOR_ARRAY);
         }
@@ -959,11 +1068,8 @@ void PointView::drawPoints(const PointArrayModel& points, VisMode visMode,
             // perhaps just compile into a display list?
             if(useLighting)
                 glEnable(GL_LIGHTING);
-            const V3f* P = points.P();
-            const V3f* N = points.N();
-            const float* r = points.r();
-            const C3f* col = points.color();
-            for(size_t i = 0; i < points.size(); ++i, ++P, ++N, ++r)
+            const C3f* col = color;
+            for(size_t i = 0; i < npoints; ++i, ++P, ++N, ++r)
             {
                 glColor(col ? *col++ : C3f(1));
                 if(N->length2() == 0)
@@ -1114,6 +1220,9 @@ void PointViewerMainWindow::helpDialog()
         "'v' = toggle view mode between points and disks\n"
         "'s' = snap 3D cursor to nearest point\n"
         "\n"
+        "Large point clouds are streamed from disk and drawn with a level\n"
+        "of detail to suit the view; more detail appears as it's loaded.\n"
+        "\n"
         "(LMB, RMB = left & right mouse buttons)\n"
     );
     QMessageBox::information(this, tr("ptview control summary"), message);
@@ -1193,6 +1302,12 @@ int main(int argc, char *argv[])
          "resolution of point cloud")
         ("radiusmult,r", po::value<float>()->default_value(1),
          "multiplying factor for surfel radius")
+        ("lodthreshold,l", po::value<float>()->default_value(256),
+         "size in MB above which point clouds are streamed from disk by level of detail (negative to disable)")
+        ("pointbudget,b", po::value<int>()->default_value(3000000),
+         "maximum number of points drawn from streamed point clouds")
+        ("lodcache", po::value<int>()->default_value(20000000),
+         "maximum number of points kept in memory for each streamed point cloud")
         ("point_files", po::value<std::vector<std::string> >()->default_value(std::vector<std::string>(), "[]"),
          "file to display")
     ;
@@ -1224,10 +1339,17 @@ int main(int argc, char *argv[])
     for(int i = 0, iend = pointFileNamesStd.size(); i < iend; ++i)
         pointFileNames.push_back(QString::fromStdString(pointFileNamesStd[i]));
 
-    PointViewerMainWindow window(pointFileNames);
+    PointViewerMainWindow window;
     float maxSolidAngle = opts["maxsolidangle"].as<float>();
     int probeRes = opts["proberes"].as<int>();
     window.pointView().setProbeParams(probeRes, maxSolidAngle);
+    float lodThreshold = opts["lodthreshold"].as<float>();
+    window.pointView().setLodParams(
+            std::max(opts["pointbudget"].as<int>(), 0),
+            std::max(opts["lodcache"].as<int>(), 0),
+            lodThreshold < 0 ? -1 : qint64(lodThreshold*1024*1024));
+    if(!pointFileNames.empty())
+        window.pointView().loadPointFiles(pointFileNames);
     window.show();
 
     return app.exec();
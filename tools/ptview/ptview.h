@@ -47,6 +47,7 @@
 #include <aqsis/util/interactivecamera.h>
 
 #include "pointcontainer.h"
+#include "pointlod.h"
 
 class QActionGroup;
 class QSignalMapper;
@@ -128,6 +129,14 @@ class PointView : public QGLWidget
         void loadPointFiles(const QStringList& fileNames);
         /// Set properties for rendering probe environment map
         void setProbeParams(int cubeFaceRes, float maxSolidAngle);
+        /// Set properties for viewing clouds by level of detail
+        ///
+        /// \param pointBudget - maximum number of points drawn from them
+        /// \param cacheSize - maximum number of points kept in memory for each
+        /// \param threshold - files of at least this many bytes are viewed
+        ///                    by level of detail; negative to disable.
+        void setLodParams(size_t pointBudget, size_t cacheSize,
+                          qint64 threshold);
 
         /// Get the visualization mode
         VisMode visMode() const;
@@ -145,6 +154,10 @@ class PointView : public QGLWidget
     signals:
         void colorChannelsChanged(QStringList channels);
 
+    private slots:
+        void lodOpened();
+        void lodFailed(const QString& message);
+
     protected:
         // Qt OpenGL callbacks
         void initializeGL();
@@ -160,8 +173,9 @@ class PointView : public QGLWidget
     private:
         static void drawAxes();
         void drawCursor(const V3f& P) const;
-        static void drawPoints(const PointArrayModel& points, VisMode visMode,
-                               bool useLighting);
+        static void drawPoints(const V3f* P, const V3f* N, const float* r,
+                               const C3f* color, size_t npoints,
+                               VisMode visMode, bool useLighting);
 
         /// Mouse-based camera positioning
         InteractiveCamera m_camera;
@@ -181,6 +195,14 @@ class PointView : public QGLWidget
         bool m_lighting;
         /// Point cloud data
         std::vector<boost::shared_ptr<PointArrayModel> > m_points;
+        /// Point clouds too large to hold in memory
+        std::vector<boost::shared_ptr<PointLodModel> > m_lodPoints;
+        /// Nodes of the level of detail clouds drawn in the last frame
+        std::vector<boost::shared_ptr<const PointBlock> > m_lodBlocks;
+        bool m_lodCentered;
+        size_t m_pointBudget;
+        size_t m_lodCacheSize;
+        qint64 m_lodThreshold;
         boost::shared_ptr<const PointOctree> m_pointTree;
         V3f m_cloudCenter;
 };